@@ -1,4 +1,160 @@
 #include "app.hpp"
+#include "config.hpp"
+#include "logger.hpp"
+#include "message-pump.hpp"
+#include "../resources/scheme-handler.hpp"
+#include "../sandbox/bridge-messages.hpp"
+#include "../sandbox/bridge-metrics.hpp"
+#include "../sandbox/extension-sandbox.hpp"
+#include "../sandbox/preload.hpp"
+#include "../utils/shared-ring.hpp"
 
 SimpleApp::SimpleApp() {
-}
\ No newline at end of file
+}
+
+SimpleApp::~SimpleApp() {
+}
+
+CefRefPtr<CefBrowserProcessHandler> SimpleApp::GetBrowserProcessHandler() {
+    return this;
+}
+
+CefRefPtr<CefRenderProcessHandler> SimpleApp::GetRenderProcessHandler() {
+    return this;
+}
+
+void SimpleApp::OnRegisterCustomSchemes(CefRawPtr<CefSchemeRegistrar> registrar) {
+    // Runs in every process, so the UI bundle scheme behaves like https:// everywhere
+    registrar->AddCustomScheme(MikoIDE::Resources::kAppScheme,
+                               CEF_SCHEME_OPTION_STANDARD |
+                               CEF_SCHEME_OPTION_SECURE |
+                               CEF_SCHEME_OPTION_CORS_ENABLED |
+                               CEF_SCHEME_OPTION_FETCH_ENABLED);
+}
+
+void SimpleApp::OnContextInitialized() {
+    std::string packPath = AppConfig::GetResourcePackPath();
+    if (!MikoIDE::Resources::PackSchemeHandlerFactory::Register(packPath)) {
+        Logger::LogMessage("UI resource pack unavailable: " + packPath);
+    }
+}
+
+void SimpleApp::OnScheduleMessagePumpWork(int64_t delay_ms) {
+    // Only called when CefSettings.external_message_pump is enabled
+    MessagePump::GetInstance().ScheduleWork(delay_ms);
+}
+
+void SimpleApp::OnBrowserCreated(CefRefPtr<CefBrowser> browser,
+                                 CefRefPtr<CefDictionaryValue> extra_info) {
+    // extra_info is only delivered here, so keep it for later contexts
+    browser_extra_info_[browser->GetIdentifier()] = extra_info ? extra_info->Copy(false) : nullptr;
+}
+
+void SimpleApp::OnBrowserDestroyed(CefRefPtr<CefBrowser> browser) {
+    browser_extra_info_.erase(browser->GetIdentifier());
+    sandboxes_.erase(browser->GetIdentifier());
+    stream_rings_.erase(browser->GetIdentifier());
+}
+
+void SimpleApp::OnContextCreated(CefRefPtr<CefBrowser> browser,
+                                 CefRefPtr<CefFrame> frame,
+                                 CefRefPtr<CefV8Context> context) {
+    if (!frame->IsMain()) {
+        return;
+    }
+    
+    // Runs before any page script: install the sandbox globals, then the preload
+    auto sandbox = std::make_unique<MikoIDE::Sandbox::ExtensionSandbox>();
+    if (!sandbox->Initialize(context)) {
+        Logger::LogMessage("Failed to initialize extension sandbox for browser " +
+                           std::to_string(browser->GetIdentifier()));
+        return;
+    }
+    
+    auto options = MikoIDE::Sandbox::PreloadOptions::FromDictionary(browser_extra_info_[browser->GetIdentifier()]);
+    for (const auto& name : options.async_functions) {
+        sandbox->RegisterAsyncFunction(name);
+    }
+    sandbox->RegisterBatchFunction();
+    
+    // getBridgeMetrics(reset = false): per-function counters for this renderer
+    sandbox->RegisterNativeFunction("getBridgeMetrics", [](CefRefPtr<CefListValue> args) {
+        CefRefPtr<CefValue> snapshot = MikoIDE::Sandbox::BridgeMetrics::GetInstance().Snapshot();
+        if (MikoIDE::Sandbox::ValueCodec::GetBool(args, 0)) {
+            MikoIDE::Sandbox::BridgeMetrics::GetInstance().Reset();
+        }
+        return snapshot;
+    });
+    
+    std::string preload = MikoIDE::Sandbox::Preload::BuildScript(options);
+    if (!preload.empty() && !sandbox->ExecuteScript(preload)) {
+        Logger::LogMessage("Preload script failed for " + frame->GetURL().ToString());
+    }
+    
+    sandboxes_[browser->GetIdentifier()] = std::move(sandbox);
+    
+    // A new render process (first page, crash, cross-process navigation)
+    // has no ring yet; same-process navigations keep theirs
+    if (stream_rings_.find(browser->GetIdentifier()) == stream_rings_.end()) {
+        frame->SendProcessMessage(PID_BROWSER,
+            CefProcessMessage::Create(MikoIDE::Sandbox::kStreamRequestMessage));
+    }
+}
+
+void SimpleApp::OnContextReleased(CefRefPtr<CefBrowser> browser,
+                                  CefRefPtr<CefFrame> frame,
+                                  CefRefPtr<CefV8Context> context) {
+    if (frame->IsMain()) {
+        sandboxes_.erase(browser->GetIdentifier());
+    }
+}
+
+bool SimpleApp::OnProcessMessageReceived(CefRefPtr<CefBrowser> browser,
+                                         CefRefPtr<CefFrame> frame,
+                                         CefProcessId source_process,
+                                         CefRefPtr<CefProcessMessage> message) {
+    std::string name = message->GetName().ToString();
+    if (name == MikoIDE::Sandbox::kStreamOpenMessage) {
+        auto ring = std::make_unique<MikoIDE::Utils::SharedRing>();
+        if (ring->Open(message->GetArgumentList()->GetString(0).ToString())) {
+            stream_rings_[browser->GetIdentifier()] = std::move(ring);
+        } else {
+            Logger::LogMessage("Stream channel unavailable: " + ring->GetLastError());
+        }
+        return true;
+    }
+    if (name == MikoIDE::Sandbox::kStreamDoorbellMessage) {
+        DrainStream(browser);
+        return true;
+    }
+    
+    // Native call results for the main frame's sandbox
+    auto it = sandboxes_.find(browser->GetIdentifier());
+    return it != sandboxes_.end() && it->second->OnProcessMessageReceived(message);
+}
+
+void SimpleApp::DrainStream(CefRefPtr<CefBrowser> browser) {
+    auto ringIt = stream_rings_.find(browser->GetIdentifier());
+    if (ringIt == stream_rings_.end()) {
+        return;
+    }
+    MikoIDE::Utils::SharedRing& ring = *ringIt->second;
+    
+    // Re-arm before draining so records written meanwhile ring again
+    ring.ResetDoorbell();
+    
+    auto sandboxIt = sandboxes_.find(browser->GetIdentifier());
+    if (sandboxIt != sandboxes_.end()) {
+        sandboxIt->second->DispatchStream(ring);
+    } else {
+        MikoIDE::Utils::SharedRing::Record record;
+        while (ring.Peek(record)) {
+            ring.Release(record);
+        }
+    }
+    
+    if (ring.TakeProducerBlocked()) {
+        browser->GetMainFrame()->SendProcessMessage(PID_BROWSER,
+            CefProcessMessage::Create(MikoIDE::Sandbox::kStreamDrainedMessage));
+    }
+}
@@ -1,10 +1,57 @@
 #pragma once
 #include "include/cef_app.h"
+#include <map>
+#include <memory>
 
-class SimpleApp : public CefApp {
+namespace MikoIDE {
+    namespace Sandbox {
+        class ExtensionSandbox;
+    }
+    namespace Utils {
+        class SharedRing;
+    }
+}
+
+class SimpleApp : public CefApp,
+                  public CefBrowserProcessHandler,
+                  public CefRenderProcessHandler {
 public:
     SimpleApp();
+    ~SimpleApp();
+
+    // CefApp methods
+    virtual CefRefPtr<CefBrowserProcessHandler> GetBrowserProcessHandler() override;
+    virtual CefRefPtr<CefRenderProcessHandler> GetRenderProcessHandler() override;
+    virtual void OnRegisterCustomSchemes(CefRawPtr<CefSchemeRegistrar> registrar) override;
+
+    // CefBrowserProcessHandler methods
+    virtual void OnContextInitialized() override;
+    virtual void OnScheduleMessagePumpWork(int64_t delay_ms) override;
+
+    // CefRenderProcessHandler methods
+    virtual void OnBrowserCreated(CefRefPtr<CefBrowser> browser,
+                                  CefRefPtr<CefDictionaryValue> extra_info) override;
+    virtual void OnBrowserDestroyed(CefRefPtr<CefBrowser> browser) override;
+    virtual void OnContextCreated(CefRefPtr<CefBrowser> browser,
+                                  CefRefPtr<CefFrame> frame,
+                                  CefRefPtr<CefV8Context> context) override;
+    virtual void OnContextReleased(CefRefPtr<CefBrowser> browser,
+                                   CefRefPtr<CefFrame> frame,
+                                   CefRefPtr<CefV8Context> context) override;
+    virtual bool OnProcessMessageReceived(CefRefPtr<CefBrowser> browser,
+                                          CefRefPtr<CefFrame> frame,
+                                          CefProcessId source_process,
+                                          CefRefPtr<CefProcessMessage> message) override;
 
 private:
+    // Render process only, keyed by browser id
+    std::map<int, CefRefPtr<CefDictionaryValue>> browser_extra_info_;
+    std::map<int, std::unique_ptr<MikoIDE::Sandbox::ExtensionSandbox>> sandboxes_;
+    // Stream rings live as long as the browser in this process, across
+    // same-process navigations
+    std::map<int, std::unique_ptr<MikoIDE::Utils::SharedRing>> stream_rings_;
+
+    void DrainStream(CefRefPtr<CefBrowser> browser);
+
     IMPLEMENT_REFCOUNTING(SimpleApp);
-};
\ No newline at end of file
+};
@@ -1,11 +1,16 @@
 #include "client.hpp"
 #include "config.hpp"
 #include "logger.hpp"
+#include "sdl-bridge.hpp"
+#include "osr-renderer.hpp"
+#include "startup-trace.hpp"
+#include "../sandbox/native-bridge.hpp"
 #include "include/wrapper/cef_helpers.h"
 #include <SDL.h>
 
 // Global variables (declared in main.cpp)
 extern SDL_Window* g_sdl_window;
+extern bool g_running;
 
 // CloseBrowserTask implementation
 CloseBrowserTask::CloseBrowserTask(CefRefPtr<SimpleClient> client, bool force_close)
@@ -17,7 +22,9 @@ void CloseBrowserTask::Execute() {
 }
 
 // SimpleClient implementation
-SimpleClient::SimpleClient() {
+SimpleClient::SimpleClient(OsrRenderer* osr_renderer)
+    : osr_renderer_(osr_renderer),
+      first_paint_seen_(false) {
 }
 
 CefRefPtr<CefDisplayHandler> SimpleClient::GetDisplayHandler() {
@@ -32,6 +39,53 @@ CefRefPtr<CefLoadHandler> SimpleClient::GetLoadHandler() {
     return this;
 }
 
+CefRefPtr<CefRenderHandler> SimpleClient::GetRenderHandler() {
+    // Windowed browsers must not expose a render handler
+    if (!osr_renderer_) {
+        return nullptr;
+    }
+    return this;
+}
+
+bool SimpleClient::OnProcessMessageReceived(CefRefPtr<CefBrowser> browser,
+                                            CefRefPtr<CefFrame> frame,
+                                            CefProcessId source_process,
+                                            CefRefPtr<CefProcessMessage> message) {
+    CEF_REQUIRE_UI_THREAD();
+    return MikoIDE::Sandbox::NativeBridge::GetInstance().OnProcessMessageReceived(browser, frame, message);
+}
+
+void SimpleClient::GetViewRect(CefRefPtr<CefBrowser> browser, CefRect& rect) {
+    CEF_REQUIRE_UI_THREAD();
+    
+    int width = AppConfig::GetWindowWidth();
+    int height = AppConfig::GetWindowHeight();
+    if (osr_renderer_) {
+        osr_renderer_->GetViewSize(width, height);
+    }
+    rect = CefRect(0, 0, width, height);
+}
+
+void SimpleClient::OnPaint(CefRefPtr<CefBrowser> browser,
+                          PaintElementType type,
+                          const RectList& dirtyRects,
+                          const void* buffer,
+                          int width,
+                          int height) {
+    CEF_REQUIRE_UI_THREAD();
+    
+    // Popup widgets (e.g. <select> dropdowns) are not composited yet
+    if (type != PET_VIEW || !osr_renderer_) {
+        return;
+    }
+    
+    if (!first_paint_seen_) {
+        first_paint_seen_ = true;
+        StartupTrace::Mark("host.first_paint");
+    }
+    osr_renderer_->OnPaint(dirtyRects, buffer, width, height);
+}
+
 void SimpleClient::OnTitleChange(CefRefPtr<CefBrowser> browser,
                                 const CefString& title) {
     CEF_REQUIRE_UI_THREAD();
@@ -43,14 +97,36 @@ void SimpleClient::OnTitleChange(CefRefPtr<CefBrowser> browser,
         windowTitle += " [RELEASE]";
     }
     
-    if (g_sdl_window) {
-        SDL_SetWindowTitle(g_sdl_window, windowTitle.c_str());
+    // SDL window calls belong to the SDL thread
+    SdlBridge::GetInstance().RunOnSDLThread([windowTitle]() {
+        if (g_sdl_window) {
+            SDL_SetWindowTitle(g_sdl_window, windowTitle.c_str());
+        }
+    });
+}
+
+bool SimpleClient::OnConsoleMessage(CefRefPtr<CefBrowser> browser,
+                                    cef_log_severity_t level,
+                                    const CefString& message,
+                                    const CefString& source,
+                                    int line) {
+    CEF_REQUIRE_UI_THREAD();
+    
+    // Startup probe reports are consumed here and kept out of the console
+    if (StartupTrace::HandleRendererReport(message.ToString())) {
+        if (AppConfig::ShouldExitAfterFirstPaint() && StartupTrace::HasFirstMeaningfulPaint()) {
+            CloseAllBrowsers(true);
+        }
+        return true;
     }
+    return false;
 }
 
 void SimpleClient::OnAfterCreated(CefRefPtr<CefBrowser> browser) {
     CEF_REQUIRE_UI_THREAD();
+    StartupTrace::Mark("browser.after_created");
     browser_list_.push_back(browser);
+    MikoIDE::Sandbox::NativeBridge::GetInstance().AddBrowser(browser);
     
     std::string mode = AppConfig::IsDebugMode() ? "DEBUG" : "RELEASE";
     std::string url = AppConfig::GetStartupUrl();
@@ -73,11 +149,12 @@ void SimpleClient::OnBeforeClose(CefRefPtr<CefBrowser> browser) {
             break;
         }
     }
+    MikoIDE::Sandbox::NativeBridge::GetInstance().RemoveBrowser(browser);
 
     if (browser_list_.empty()) {
-        extern bool g_running;
-        g_running = false;
-        // Remove this line: CefQuitMessageLoop();
+        SdlBridge::GetInstance().RunOnSDLThread([]() {
+            g_running = false;
+        });
     }
 }
 
@@ -134,36 +211,16 @@ void SimpleClient::OnLoadStart(CefRefPtr<CefBrowser> browser,
     CEF_REQUIRE_UI_THREAD();
     
     if (frame->IsMain()) {
+        StartupTrace::Mark("load.start");
         std::string mode = AppConfig::IsDebugMode() ? "DEBUG" : "RELEASE";
         Logger::LogMessage("Loading page in " + mode + " mode...");
     }
 }
 
 void SimpleClient::OnLoadEnd(CefRefPtr<CefBrowser> browser, CefRefPtr<CefFrame> frame, int httpStatusCode) {
-    if (AppConfig::IsDarkThemeEnabled()) {
-        // Inject dark mode CSS
-        std::string darkModeScript = R"(
-            (function() {
-                const style = document.createElement('style');
-                style.textContent = `
-                    :root {
-                        color-scheme: dark;
-                    }
-                    body {
-                        background-color: #1e1e1e !important;
-                        color: #ffffff !important;
-                    }
-                `;
-                document.head.appendChild(style);
-                
-                // Set prefers-color-scheme to dark
-                if (window.matchMedia) {
-                    window.matchMedia('(prefers-color-scheme: dark)').matches = true;
-                }
-            })();
-        )";
-        
-        frame->ExecuteJavaScript(darkModeScript, frame->GetURL(), 0);
+    if (frame->IsMain() && !StartupTrace::HasFirstMeaningfulPaint()) {
+        StartupTrace::Mark("load.end");
+        frame->ExecuteJavaScript(StartupTrace::GetRendererProbeScript(), frame->GetURL(), 0);
     }
 }
 
@@ -3,10 +3,12 @@
 #include "include/cef_display_handler.h"
 #include "include/cef_life_span_handler.h"
 #include "include/cef_load_handler.h"
+#include "include/cef_render_handler.h"
 #include "include/cef_task.h"
 #include <list>
 
 class SimpleClient;
+class OsrRenderer;
 
 // Task class for CefPostTask compatibility
 class CloseBrowserTask : public CefTask {
@@ -24,18 +26,30 @@ private:
 class SimpleClient : public CefClient,
                     public CefDisplayHandler,
                     public CefLifeSpanHandler,
-                    public CefLoadHandler {
+                    public CefLoadHandler,
+                    public CefRenderHandler {
 public:
-    SimpleClient();
+    // |osr_renderer| enables off-screen rendering; nullptr keeps the windowed browser
+    explicit SimpleClient(OsrRenderer* osr_renderer = nullptr);
 
     // CefClient methods
     virtual CefRefPtr<CefDisplayHandler> GetDisplayHandler() override;
     virtual CefRefPtr<CefLifeSpanHandler> GetLifeSpanHandler() override;
     virtual CefRefPtr<CefLoadHandler> GetLoadHandler() override;
+    virtual CefRefPtr<CefRenderHandler> GetRenderHandler() override;
+    virtual bool OnProcessMessageReceived(CefRefPtr<CefBrowser> browser,
+                                          CefRefPtr<CefFrame> frame,
+                                          CefProcessId source_process,
+                                          CefRefPtr<CefProcessMessage> message) override;
 
     // CefDisplayHandler methods
     virtual void OnTitleChange(CefRefPtr<CefBrowser> browser,
                               const CefString& title) override;
+    virtual bool OnConsoleMessage(CefRefPtr<CefBrowser> browser,
+                                 cef_log_severity_t level,
+                                 const CefString& message,
+                                 const CefString& source,
+                                 int line) override;
 
     // CefLifeSpanHandler methods
     virtual void OnAfterCreated(CefRefPtr<CefBrowser> browser) override;
@@ -55,6 +69,15 @@ public:
                           CefRefPtr<CefFrame> frame,
                           int httpStatusCode) override;
 
+    // CefRenderHandler methods
+    virtual void GetViewRect(CefRefPtr<CefBrowser> browser, CefRect& rect) override;
+    virtual void OnPaint(CefRefPtr<CefBrowser> browser,
+                        PaintElementType type,
+                        const RectList& dirtyRects,
+                        const void* buffer,
+                        int width,
+                        int height) override;
+
     // Browser management
     void CloseAllBrowsers(bool force_close);
     void DoCloseAllBrowsers(bool force_close);
@@ -64,6 +87,8 @@ public:
 private:
     typedef std::list<CefRefPtr<CefBrowser>> BrowserList;
     BrowserList browser_list_;
+    OsrRenderer* osr_renderer_;
+    bool first_paint_seen_;
 
     IMPLEMENT_REFCOUNTING(SimpleClient);
 };
\ No newline at end of file
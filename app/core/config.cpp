@@ -1,4 +1,74 @@
 #include "config.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+
+namespace {
+    // Returns true and fills |value| if |token| is "<name>=<value>"
+    bool ReadSwitchValue(const std::string& token, const std::string& name, std::string& value) {
+        if (token.compare(0, name.size(), name) != 0 || token.size() <= name.size() ||
+            token[name.size()] != '=') {
+            return false;
+        }
+        value = token.substr(name.size() + 1);
+        return true;
+    }
+}
+
+MessageLoopMode AppConfig::message_loop_mode_ = MessageLoopMode::ExternalPump;
+bool AppConfig::headless_ = false;
+std::string AppConfig::startup_report_path_ = "startup-trace.log";
+int AppConfig::startup_benchmark_runs_ = 0;
+bool AppConfig::exit_after_first_paint_ = false;
+std::string AppConfig::cache_path_;
+std::string AppConfig::resource_pack_path_ = "resources/app.pak";
+size_t AppConfig::scrollback_memory_mb_ = 256;
+size_t AppConfig::scrollback_disk_mb_ = 4096;
+bool AppConfig::terminal_sessions_ = false;
+
+// Only Windows can embed the browser as a child window
+#ifdef _WIN32
+bool AppConfig::offscreen_rendering_ = false;
+#else
+bool AppConfig::offscreen_rendering_ = true;
+#endif
+
+void AppConfig::ParseCommandLine(const std::string& commandLine) {
+    std::istringstream stream(commandLine);
+    std::string token;
+    std::string value;
+    
+    while (stream >> token) {
+        if (token == "--message-loop=polling") {
+            message_loop_mode_ = MessageLoopMode::Polling;
+        } else if (token == "--message-loop=external-pump") {
+            message_loop_mode_ = MessageLoopMode::ExternalPump;
+        } else if (token == "--message-loop=multi-threaded") {
+            message_loop_mode_ = MessageLoopMode::MultiThreaded;
+        } else if (token == "--osr") {
+            offscreen_rendering_ = true;
+        } else if (token == "--headless") {
+            offscreen_rendering_ = true;
+            headless_ = true;
+        } else if (token == "--exit-after-first-paint") {
+            exit_after_first_paint_ = true;
+        } else if (token == "--terminal-sessions") {
+            terminal_sessions_ = true;
+        } else if (ReadSwitchValue(token, "--startup-report", value)) {
+            startup_report_path_ = value;
+        } else if (ReadSwitchValue(token, "--startup-benchmark", value)) {
+            startup_benchmark_runs_ = std::max(std::atoi(value.c_str()), 0);
+        } else if (ReadSwitchValue(token, "--cache-path", value)) {
+            cache_path_ = value;
+        } else if (ReadSwitchValue(token, "--resource-pack", value)) {
+            resource_pack_path_ = value;
+        } else if (ReadSwitchValue(token, "--scrollback-memory", value)) {
+            scrollback_memory_mb_ = static_cast<size_t>(std::max(std::atoi(value.c_str()), 1));
+        } else if (ReadSwitchValue(token, "--scrollback-disk", value)) {
+            scrollback_disk_mb_ = static_cast<size_t>(std::max(std::atoi(value.c_str()), 0));
+        }
+    }
+}
 
 bool AppConfig::IsDebugMode() {
     return DEBUG_MODE;
@@ -8,10 +78,58 @@ std::string AppConfig::GetStartupUrl() {
     return IsDebugMode() ? DEVELOPMENT_URL : PRODUCTION_URL;
 }
 
+std::string AppConfig::GetResourcePackPath() {
+    return resource_pack_path_;
+}
+
 bool AppConfig::IsDarkThemeEnabled() {
     return DARK_THEME_ENABLED;
 }
 
+MessageLoopMode AppConfig::GetMessageLoopMode() {
+    return message_loop_mode_;
+}
+
+bool AppConfig::IsOffscreenRenderingEnabled() {
+    return offscreen_rendering_;
+}
+
+bool AppConfig::IsHeadless() {
+    return headless_;
+}
+
+std::string AppConfig::GetStartupReportPath() {
+    return startup_report_path_;
+}
+
+int AppConfig::GetStartupBenchmarkRuns() {
+    return startup_benchmark_runs_;
+}
+
+bool AppConfig::ShouldExitAfterFirstPaint() {
+    return exit_after_first_paint_;
+}
+
+std::string AppConfig::GetCachePath() {
+    return cache_path_;
+}
+
+size_t AppConfig::GetScrollbackMemoryLimit() {
+    return scrollback_memory_mb_ * 1024 * 1024;
+}
+
+size_t AppConfig::GetScrollbackDiskLimit() {
+    return scrollback_disk_mb_ * 1024 * 1024;
+}
+
+bool AppConfig::IsTerminalSessionsEnabled() {
+#ifdef _WIN32
+    return false;
+#else
+    return terminal_sessions_;
+#endif
+}
+
 int AppConfig::GetWindowWidth() {
     return DEFAULT_WIDTH;
 }
@@ -22,4 +140,4 @@ int AppConfig::GetWindowHeight() {
 
 int AppConfig::GetRemoteDebuggingPort() {
     return DEBUG_PORT;
-}
\ No newline at end of file
+}
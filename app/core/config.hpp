@@ -1,17 +1,61 @@
 #pragma once
+#include <cstddef>
 #include <string>
 
+// How the host drives CEF's browser-process message loop
+enum class MessageLoopMode {
+    Polling,        // CefDoMessageLoopWork() + SDL_Delay(1) every iteration
+    ExternalPump,   // CEF schedules work via OnScheduleMessagePumpWork()
+    MultiThreaded   // CEF runs its UI thread separately from the SDL thread
+};
+
 class AppConfig {
 public:
+    // Parses host switches (e.g. --message-loop=multi-threaded) from the command line
+    static void ParseCommandLine(const std::string& commandLine);
+    
     // Returns true if the application is running in debug mode
     static bool IsDebugMode();
     
     // Returns the startup URL for the CEF browser
     static std::string GetStartupUrl();
     
+    // Returns the pack served on miko://app/ (--resource-pack=<path>)
+    static std::string GetResourcePackPath();
+    
     // Returns true if dark theme should be enabled
     static bool IsDarkThemeEnabled();
     
+    // Returns the message loop strategy used by the main loop
+    static MessageLoopMode GetMessageLoopMode();
+    
+    // Returns true if the browser renders off-screen into an SDL texture
+    static bool IsOffscreenRenderingEnabled();
+    
+    // Returns true if no window should be created (implies off-screen rendering)
+    static bool IsHeadless();
+    
+    // Where the startup timeline is written (--startup-report=<path>)
+    static std::string GetStartupReportPath();
+    
+    // Number of launches for --startup-benchmark=<runs>; 0 when not benchmarking
+    static int GetStartupBenchmarkRuns();
+    
+    // Returns true if the app should quit once the first meaningful paint happened
+    static bool ShouldExitAfterFirstPaint();
+    
+    // CEF cache directory (--cache-path=<dir>); empty keeps CEF's default
+    static std::string GetCachePath();
+    
+    // Terminal scrollback budget shared by all terminals, in bytes
+    // (--scrollback-memory=<MB>, --scrollback-disk=<MB>)
+    static size_t GetScrollbackMemoryLimit();
+    static size_t GetScrollbackDiskLimit();
+    
+    // Returns true if terminals run in miko-sessiond and survive a restart
+    // (--terminal-sessions); POSIX only
+    static bool IsTerminalSessionsEnabled();
+    
     // Additional configuration methods can be added here
     static int GetWindowWidth();
     static int GetWindowHeight();
@@ -35,5 +79,18 @@ private:
     
     // URLs
     static constexpr const char* DEVELOPMENT_URL = "http://localhost:5173";
-    static constexpr const char* PRODUCTION_URL = "file:///resources/app.pak/index.html";
-};
\ No newline at end of file
+    static constexpr const char* PRODUCTION_URL = "miko://app/index.html";
+    
+    // Values that can be overridden from the command line
+    static MessageLoopMode message_loop_mode_;
+    static bool offscreen_rendering_;
+    static bool headless_;
+    static std::string startup_report_path_;
+    static int startup_benchmark_runs_;
+    static bool exit_after_first_paint_;
+    static std::string cache_path_;
+    static std::string resource_pack_path_;
+    static size_t scrollback_memory_mb_;
+    static size_t scrollback_disk_mb_;
+    static bool terminal_sessions_;
+};
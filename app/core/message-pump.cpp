@@ -0,0 +1,118 @@
+#include "message-pump.hpp"
+#include "logger.hpp"
+#include "include/cef_app.h"
+#include <algorithm>
+#include <limits>
+
+namespace {
+    // Upper bound between two CefDoMessageLoopWork() calls, matching cefclient.
+    // CEF relies on being pumped periodically even if it never asked for it.
+    constexpr int64_t kMaxTimerDelayMs = 1000 / 30;
+    
+    // Sentinel meaning "no work scheduled"
+    constexpr Uint64 kNoDeadline = std::numeric_limits<Uint64>::max();
+    
+    uint64_t CounterToMicroseconds(Uint64 ticks) {
+        return ticks * 1000000ULL / SDL_GetPerformanceFrequency();
+    }
+}
+
+void MessagePump::LatencyStats::Add(uint64_t us) {
+    ++count;
+    total_us += us;
+    max_us = std::max(max_us, us);
+}
+
+MessagePump& MessagePump::GetInstance() {
+    static MessagePump instance;
+    return instance;
+}
+
+MessagePump::MessagePump()
+    : wakeup_event_(static_cast<Uint32>(-1)),
+      work_deadline_(kNoDeadline),
+      pending_request_since_(0),
+      work_calls_(0) {
+}
+
+bool MessagePump::Initialize() {
+    wakeup_event_ = SDL_RegisterEvents(1);
+    if (wakeup_event_ == static_cast<Uint32>(-1)) {
+        Logger::LogMessage("Could not register message pump event! SDL_Error: " + std::string(SDL_GetError()));
+        return false;
+    }
+    return true;
+}
+
+void MessagePump::ScheduleWork(int64_t delay_ms) {
+    if (delay_ms <= 0) {
+        Uint64 expected = 0;
+        pending_request_since_.compare_exchange_strong(expected, SDL_GetPerformanceCounter());
+    }
+    
+    SDL_Event event;
+    SDL_zero(event);
+    event.type = wakeup_event_;
+    event.user.code = static_cast<Sint32>(std::min(delay_ms, kMaxTimerDelayMs));
+    SDL_PushEvent(&event);
+}
+
+bool MessagePump::HandleEvent(const SDL_Event& event) {
+    if (event.type != wakeup_event_) {
+        return false;
+    }
+    
+    // A new request replaces the previous deadline, as CEF expects
+    Uint64 now = SDL_GetTicks64();
+    work_deadline_ = event.user.code <= 0 ? now : now + event.user.code;
+    return true;
+}
+
+int MessagePump::GetWaitTimeout() const {
+    if (work_deadline_ == kNoDeadline) {
+        return static_cast<int>(kMaxTimerDelayMs);
+    }
+    
+    Uint64 now = SDL_GetTicks64();
+    return work_deadline_ > now ? static_cast<int>(work_deadline_ - now) : 0;
+}
+
+void MessagePump::DoWorkIfDue() {
+    Uint64 now = SDL_GetTicks64();
+    if (work_deadline_ != kNoDeadline && work_deadline_ > now) {
+        return;
+    }
+    
+    Uint64 requested = pending_request_since_.exchange(0);
+    if (requested != 0) {
+        wakeup_latency_.Add(CounterToMicroseconds(SDL_GetPerformanceCounter() - requested));
+    }
+    
+    // Fall back to the periodic timer; any request made during the work
+    // arrives as a new wakeup event and overrides this deadline
+    work_deadline_ = now + kMaxTimerDelayMs;
+    ++work_calls_;
+    CefDoMessageLoopWork();
+}
+
+void MessagePump::RecordEventDispatch(const SDL_Event& event) {
+    // SDL stamps events with SDL_GetTicks() when they are queued
+    Uint32 now = SDL_GetTicks();
+    if (event.common.timestamp != 0 && now >= event.common.timestamp) {
+        event_latency_.Add(static_cast<uint64_t>(now - event.common.timestamp) * 1000ULL);
+    }
+}
+
+void MessagePump::LogStats() const {
+    auto average = [](const LatencyStats& stats) {
+        return stats.count ? stats.total_us / stats.count : 0;
+    };
+    
+    Logger::LogMessage("Message pump: " + std::to_string(work_calls_) + " CEF work calls, " +
+                       std::to_string(wakeup_latency_.count) + " immediate wakeups");
+    Logger::LogMessage("CEF wakeup latency: avg " + std::to_string(average(wakeup_latency_)) +
+                       "us, max " + std::to_string(wakeup_latency_.max_us) + "us");
+    Logger::LogMessage("SDL event dispatch latency: avg " + std::to_string(average(event_latency_)) +
+                       "us, max " + std::to_string(event_latency_.max_us) + "us over " +
+                       std::to_string(event_latency_.count) + " events");
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <SDL.h>
+#include <atomic>
+#include <cstdint>
+
+// Drives CefDoMessageLoopWork() from the SDL event loop when CEF runs with
+// an external message pump. CEF requests work from arbitrary threads through
+// OnScheduleMessagePumpWork(); each request becomes an SDL user event so the
+// main thread can block in a single SDL_WaitEventTimeout() until either SDL
+// or CEF actually has something to do.
+class MessagePump {
+public:
+    static MessagePump& GetInstance();
+    
+    // Registers the wakeup event type. Must be called after SDL_Init().
+    bool Initialize();
+    
+    // Thread-safe. Called by CEF whenever it wants the pump to run.
+    void ScheduleWork(int64_t delay_ms);
+    
+    // Returns true if |event| was a pump wakeup and has been consumed
+    bool HandleEvent(const SDL_Event& event);
+    
+    // Timeout for SDL_WaitEventTimeout() until the next scheduled work
+    int GetWaitTimeout() const;
+    
+    // Runs CefDoMessageLoopWork() once the scheduled deadline has passed
+    void DoWorkIfDue();
+    
+    // Records how long an SDL event waited before it was dispatched
+    void RecordEventDispatch(const SDL_Event& event);
+    
+    void LogStats() const;
+    
+private:
+    struct LatencyStats {
+        uint64_t count = 0;
+        uint64_t total_us = 0;
+        uint64_t max_us = 0;
+        
+        void Add(uint64_t us);
+    };
+    
+    MessagePump();
+    
+    Uint32 wakeup_event_;
+    Uint64 work_deadline_;
+    
+    // Performance counter value of the oldest immediate-work request that has
+    // not been serviced yet (0 when none is pending)
+    std::atomic<Uint64> pending_request_since_;
+    
+    LatencyStats wakeup_latency_;
+    LatencyStats event_latency_;
+    uint64_t work_calls_;
+};
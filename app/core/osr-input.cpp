@@ -0,0 +1,195 @@
+#include "osr-input.hpp"
+
+namespace {
+    // Windows virtual-key codes expected by CefKeyEvent::windows_key_code
+    constexpr int VKEY_BACK = 0x08;
+    constexpr int VKEY_TAB = 0x09;
+    constexpr int VKEY_RETURN = 0x0D;
+    constexpr int VKEY_SHIFT = 0x10;
+    constexpr int VKEY_CONTROL = 0x11;
+    constexpr int VKEY_MENU = 0x12;
+    constexpr int VKEY_ESCAPE = 0x1B;
+    constexpr int VKEY_SPACE = 0x20;
+    constexpr int VKEY_PRIOR = 0x21;
+    constexpr int VKEY_NEXT = 0x22;
+    constexpr int VKEY_END = 0x23;
+    constexpr int VKEY_HOME = 0x24;
+    constexpr int VKEY_LEFT = 0x25;
+    constexpr int VKEY_UP = 0x26;
+    constexpr int VKEY_RIGHT = 0x27;
+    constexpr int VKEY_DOWN = 0x28;
+    constexpr int VKEY_INSERT = 0x2D;
+    constexpr int VKEY_DELETE = 0x2E;
+    constexpr int VKEY_F1 = 0x70;
+    
+    // WHEEL_DELTA: one notch of a standard mouse wheel
+    constexpr int kWheelDelta = 120;
+}
+
+uint32_t OsrInput::GetModifiers(const SdlInputState& state) {
+    uint32_t modifiers = 0;
+    SDL_Keymod mod = state.mod;
+    
+    if (mod & KMOD_SHIFT) modifiers |= EVENTFLAG_SHIFT_DOWN;
+    if (mod & KMOD_CTRL) modifiers |= EVENTFLAG_CONTROL_DOWN;
+    if (mod & KMOD_ALT) modifiers |= EVENTFLAG_ALT_DOWN;
+    if (mod & KMOD_GUI) modifiers |= EVENTFLAG_COMMAND_DOWN;
+    if (mod & KMOD_CAPS) modifiers |= EVENTFLAG_CAPS_LOCK_ON;
+    if (mod & KMOD_NUM) modifiers |= EVENTFLAG_NUM_LOCK_ON;
+    
+    Uint32 buttons = state.buttons;
+    if (buttons & SDL_BUTTON_LMASK) modifiers |= EVENTFLAG_LEFT_MOUSE_BUTTON;
+    if (buttons & SDL_BUTTON_MMASK) modifiers |= EVENTFLAG_MIDDLE_MOUSE_BUTTON;
+    if (buttons & SDL_BUTTON_RMASK) modifiers |= EVENTFLAG_RIGHT_MOUSE_BUTTON;
+    
+    return modifiers;
+}
+
+int OsrInput::ToWindowsKeyCode(SDL_Keycode key) {
+    if (key >= SDLK_a && key <= SDLK_z) {
+        return 'A' + (key - SDLK_a);
+    }
+    if (key >= SDLK_0 && key <= SDLK_9) {
+        return '0' + (key - SDLK_0);
+    }
+    if (key >= SDLK_F1 && key <= SDLK_F12) {
+        return VKEY_F1 + (key - SDLK_F1);
+    }
+    
+    switch (key) {
+        case SDLK_BACKSPACE: return VKEY_BACK;
+        case SDLK_TAB: return VKEY_TAB;
+        case SDLK_RETURN:
+        case SDLK_KP_ENTER: return VKEY_RETURN;
+        case SDLK_LSHIFT:
+        case SDLK_RSHIFT: return VKEY_SHIFT;
+        case SDLK_LCTRL:
+        case SDLK_RCTRL: return VKEY_CONTROL;
+        case SDLK_LALT:
+        case SDLK_RALT: return VKEY_MENU;
+        case SDLK_ESCAPE: return VKEY_ESCAPE;
+        case SDLK_SPACE: return VKEY_SPACE;
+        case SDLK_PAGEUP: return VKEY_PRIOR;
+        case SDLK_PAGEDOWN: return VKEY_NEXT;
+        case SDLK_END: return VKEY_END;
+        case SDLK_HOME: return VKEY_HOME;
+        case SDLK_LEFT: return VKEY_LEFT;
+        case SDLK_UP: return VKEY_UP;
+        case SDLK_RIGHT: return VKEY_RIGHT;
+        case SDLK_DOWN: return VKEY_DOWN;
+        case SDLK_INSERT: return VKEY_INSERT;
+        case SDLK_DELETE: return VKEY_DELETE;
+        case SDLK_SEMICOLON: return 0xBA;
+        case SDLK_EQUALS: return 0xBB;
+        case SDLK_COMMA: return 0xBC;
+        case SDLK_MINUS: return 0xBD;
+        case SDLK_PERIOD: return 0xBE;
+        case SDLK_SLASH: return 0xBF;
+        case SDLK_BACKQUOTE: return 0xC0;
+        case SDLK_LEFTBRACKET: return 0xDB;
+        case SDLK_BACKSLASH: return 0xDC;
+        case SDLK_RIGHTBRACKET: return 0xDD;
+        case SDLK_QUOTE: return 0xDE;
+        default: return 0;
+    }
+}
+
+void OsrInput::SendKey(CefRefPtr<CefBrowserHost> host, const SDL_KeyboardEvent& key, uint32_t modifiers) {
+    int key_code = ToWindowsKeyCode(key.keysym.sym);
+    if (key_code == 0) {
+        return;
+    }
+    
+    CefKeyEvent key_event;
+    key_event.windows_key_code = key_code;
+    key_event.native_key_code = key.keysym.scancode;
+    key_event.modifiers = modifiers;
+    key_event.is_system_key = (key.keysym.mod & KMOD_ALT) != 0;
+    key_event.type = key.type == SDL_KEYDOWN ? KEYEVENT_RAWKEYDOWN : KEYEVENT_KEYUP;
+    host->SendKeyEvent(key_event);
+    
+    // SDL_TEXTINPUT never carries Enter, but Blink needs the character event
+    if (key.type == SDL_KEYDOWN && key_code == VKEY_RETURN) {
+        key_event.type = KEYEVENT_CHAR;
+        key_event.character = key_event.unmodified_character = '\r';
+        host->SendKeyEvent(key_event);
+    }
+}
+
+void OsrInput::SendText(CefRefPtr<CefBrowserHost> host, const char* text, uint32_t modifiers) {
+    std::u16string characters = CefString(text).ToString16();
+    
+    CefKeyEvent key_event;
+    key_event.type = KEYEVENT_CHAR;
+    key_event.modifiers = modifiers;
+    for (char16_t ch : characters) {
+        key_event.windows_key_code = ch;
+        key_event.character = key_event.unmodified_character = ch;
+        host->SendKeyEvent(key_event);
+    }
+}
+
+bool OsrInput::ForwardEvent(CefRefPtr<CefBrowserHost> host, const SDL_Event& event, const SdlInputState& state) {
+    if (!host) {
+        return false;
+    }
+    
+    CefMouseEvent mouse_event;
+    mouse_event.modifiers = GetModifiers(state);
+    
+    switch (event.type) {
+        case SDL_MOUSEMOTION:
+            mouse_event.x = event.motion.x;
+            mouse_event.y = event.motion.y;
+            host->SendMouseMoveEvent(mouse_event, false);
+            return true;
+            
+        case SDL_MOUSEBUTTONDOWN:
+        case SDL_MOUSEBUTTONUP: {
+            CefBrowserHost::MouseButtonType button;
+            switch (event.button.button) {
+                case SDL_BUTTON_LEFT: button = MBT_LEFT; break;
+                case SDL_BUTTON_MIDDLE: button = MBT_MIDDLE; break;
+                case SDL_BUTTON_RIGHT: button = MBT_RIGHT; break;
+                default: return false;
+            }
+            mouse_event.x = event.button.x;
+            mouse_event.y = event.button.y;
+            host->SendMouseClickEvent(mouse_event, button, event.type == SDL_MOUSEBUTTONUP,
+                                      event.button.clicks);
+            return true;
+        }
+            
+        case SDL_MOUSEWHEEL:
+            mouse_event.x = state.mouse_x;
+            mouse_event.y = state.mouse_y;
+            host->SendMouseWheelEvent(mouse_event, event.wheel.x * kWheelDelta,
+                                      event.wheel.y * kWheelDelta);
+            return true;
+            
+        case SDL_KEYDOWN:
+        case SDL_KEYUP:
+            SendKey(host, event.key, mouse_event.modifiers);
+            return true;
+            
+        case SDL_TEXTINPUT:
+            SendText(host, event.text.text, mouse_event.modifiers);
+            return true;
+            
+        case SDL_WINDOWEVENT:
+            if (event.window.event == SDL_WINDOWEVENT_LEAVE) {
+                mouse_event.x = state.mouse_x;
+                mouse_event.y = state.mouse_y;
+                host->SendMouseMoveEvent(mouse_event, true);
+                return true;
+            }
+            if (event.window.event == SDL_WINDOWEVENT_FOCUS_GAINED ||
+                event.window.event == SDL_WINDOWEVENT_FOCUS_LOST) {
+                host->SetFocus(event.window.event == SDL_WINDOWEVENT_FOCUS_GAINED);
+                return true;
+            }
+            return false;
+    }
+    
+    return false;
+}
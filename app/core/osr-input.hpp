@@ -0,0 +1,19 @@
+#pragma once
+#include "include/cef_browser.h"
+#include "sdl-bridge.hpp"
+#include <SDL.h>
+
+// Translates SDL input events into CefBrowserHost input calls for
+// off-screen rendered browsers. Must run on the CEF UI thread; modifier and
+// mouse state come from the SdlInputState captured with the event.
+class OsrInput {
+public:
+    // Returns true if |event| was an input event and was forwarded
+    static bool ForwardEvent(CefRefPtr<CefBrowserHost> host, const SDL_Event& event, const SdlInputState& state);
+    
+private:
+    static uint32_t GetModifiers(const SdlInputState& state);
+    static int ToWindowsKeyCode(SDL_Keycode key);
+    static void SendKey(CefRefPtr<CefBrowserHost> host, const SDL_KeyboardEvent& key, uint32_t modifiers);
+    static void SendText(CefRefPtr<CefBrowserHost> host, const char* text, uint32_t modifiers);
+};
@@ -0,0 +1,227 @@
+#include "osr-renderer.hpp"
+#include "logger.hpp"
+#include "sdl-bridge.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    constexpr int kBytesPerPixel = 4;
+    constexpr int kDefaultRefreshRate = 60;
+    
+    // Clips |rect| to a width x height surface; returns false if nothing is left
+    bool ClipRect(const CefRect& rect, int width, int height, SDL_Rect& out) {
+        int x0 = std::max(rect.x, 0);
+        int y0 = std::max(rect.y, 0);
+        int x1 = std::min(rect.x + rect.width, width);
+        int y1 = std::min(rect.y + rect.height, height);
+        if (x1 <= x0 || y1 <= y0) {
+            return false;
+        }
+        out = SDL_Rect{x0, y0, x1 - x0, y1 - y0};
+        return true;
+    }
+}
+
+OsrRenderer::OsrRenderer()
+    : window_(nullptr),
+      renderer_(nullptr),
+      texture_(nullptr),
+      texture_width_(0),
+      texture_height_(0),
+      frame_dirty_(false),
+      view_width_(0),
+      view_height_(0),
+      staging_width_(0),
+      staging_height_(0),
+      upload_pending_(false),
+      paint_count_(0),
+      uploaded_bytes_(0),
+      present_count_(0) {
+}
+
+OsrRenderer::~OsrRenderer() {
+    Cleanup();
+}
+
+bool OsrRenderer::Initialize(SDL_Window* window, int width, int height) {
+    window_ = window;
+    view_width_ = width;
+    view_height_ = height;
+    
+    if (!window_) {
+        Logger::LogMessage("Off-screen rendering running headless");
+        return true;
+    }
+    
+    renderer_ = SDL_CreateRenderer(window_, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+    if (!renderer_) {
+        Logger::LogMessage("Renderer could not be created! SDL_Error: " + std::string(SDL_GetError()));
+        return false;
+    }
+    
+    return EnsureTexture(width, height);
+}
+
+void OsrRenderer::Cleanup() {
+    if (texture_) {
+        SDL_DestroyTexture(texture_);
+        texture_ = nullptr;
+    }
+    if (renderer_) {
+        SDL_DestroyRenderer(renderer_);
+        renderer_ = nullptr;
+    }
+    texture_width_ = 0;
+    texture_height_ = 0;
+}
+
+void OsrRenderer::GetViewSize(int& width, int& height) const {
+    width = std::max(view_width_.load(), 1);
+    height = std::max(view_height_.load(), 1);
+}
+
+void OsrRenderer::SetViewSize(int width, int height) {
+    view_width_ = width;
+    view_height_ = height;
+}
+
+int OsrRenderer::GetRefreshRate() const {
+    SDL_DisplayMode mode;
+    if (window_ && SDL_GetWindowDisplayMode(window_, &mode) == 0 && mode.refresh_rate > 0) {
+        return mode.refresh_rate;
+    }
+    return kDefaultRefreshRate;
+}
+
+bool OsrRenderer::EnsureTexture(int width, int height) {
+    if (texture_ && texture_width_ == width && texture_height_ == height) {
+        return true;
+    }
+    
+    if (texture_) {
+        SDL_DestroyTexture(texture_);
+    }
+    
+    // CEF paints BGRA, which is ARGB8888 in SDL's packed little-endian notation
+    texture_ = SDL_CreateTexture(renderer_, SDL_PIXELFORMAT_ARGB8888,
+                                 SDL_TEXTUREACCESS_STREAMING, width, height);
+    if (!texture_) {
+        Logger::LogMessage("Texture could not be created! SDL_Error: " + std::string(SDL_GetError()));
+        texture_width_ = 0;
+        texture_height_ = 0;
+        return false;
+    }
+    
+    texture_width_ = width;
+    texture_height_ = height;
+    return true;
+}
+
+void OsrRenderer::OnPaint(const CefRenderHandler::RectList& dirtyRects,
+                          const void* buffer, int width, int height) {
+    ++paint_count_;
+    if (IsHeadless()) {
+        return;
+    }
+    
+    const uint8_t* pixels = static_cast<const uint8_t*>(buffer);
+    
+    if (!SdlBridge::GetInstance().IsMultiThreaded()) {
+        // The UI thread is the SDL thread: upload straight from CEF's buffer
+        UploadRects(dirtyRects, pixels, width, height);
+        return;
+    }
+    
+    // CEF's buffer is only valid during this call, so copy the dirty rows
+    // into the staging surface and let the SDL thread upload them later
+    bool schedule = false;
+    {
+        std::lock_guard<std::mutex> lock(staging_mutex_);
+        if (staging_width_ != width || staging_height_ != height) {
+            staging_pixels_.assign(static_cast<size_t>(width) * height * kBytesPerPixel, 0);
+            staging_width_ = width;
+            staging_height_ = height;
+            staging_rects_.clear();
+        }
+        
+        const size_t pitch = static_cast<size_t>(width) * kBytesPerPixel;
+        for (const CefRect& dirty : dirtyRects) {
+            SDL_Rect rect;
+            if (!ClipRect(dirty, width, height, rect)) {
+                continue;
+            }
+            const size_t row_bytes = static_cast<size_t>(rect.w) * kBytesPerPixel;
+            for (int y = rect.y; y < rect.y + rect.h; ++y) {
+                const size_t offset = y * pitch + static_cast<size_t>(rect.x) * kBytesPerPixel;
+                memcpy(staging_pixels_.data() + offset, pixels + offset, row_bytes);
+            }
+            staging_rects_.push_back(dirty);
+        }
+        
+        schedule = !upload_pending_;
+        upload_pending_ = true;
+    }
+    
+    if (schedule) {
+        SdlBridge::GetInstance().RunOnSDLThread([this]() {
+            FlushStaging();
+        });
+    }
+}
+
+void OsrRenderer::FlushStaging() {
+    std::lock_guard<std::mutex> lock(staging_mutex_);
+    UploadRects(staging_rects_, staging_pixels_.data(), staging_width_, staging_height_);
+    staging_rects_.clear();
+    upload_pending_ = false;
+}
+
+void OsrRenderer::UploadRects(const CefRenderHandler::RectList& rects,
+                              const uint8_t* pixels, int width, int height) {
+    bool resized = texture_width_ != width || texture_height_ != height;
+    if (!EnsureTexture(width, height)) {
+        return;
+    }
+    
+    const int pitch = width * kBytesPerPixel;
+    if (resized) {
+        // A new texture has no previous contents to keep
+        SDL_UpdateTexture(texture_, nullptr, pixels, pitch);
+        uploaded_bytes_ += static_cast<uint64_t>(pitch) * height;
+        frame_dirty_ = true;
+        return;
+    }
+    
+    for (const CefRect& dirty : rects) {
+        SDL_Rect rect;
+        if (!ClipRect(dirty, width, height, rect)) {
+            continue;
+        }
+        const uint8_t* origin = pixels + static_cast<size_t>(rect.y) * pitch +
+                                static_cast<size_t>(rect.x) * kBytesPerPixel;
+        SDL_UpdateTexture(texture_, &rect, origin, pitch);
+        uploaded_bytes_ += static_cast<uint64_t>(rect.w) * rect.h * kBytesPerPixel;
+        frame_dirty_ = true;
+    }
+}
+
+void OsrRenderer::PresentIfDirty() {
+    if (!renderer_ || !texture_ || !frame_dirty_) {
+        return;
+    }
+    
+    SDL_Rect target{0, 0, texture_width_, texture_height_};
+    SDL_RenderClear(renderer_);
+    SDL_RenderCopy(renderer_, texture_, nullptr, &target);
+    
+    // Blocks until the next vblank, which paces presentation to the display
+    SDL_RenderPresent(renderer_);
+    frame_dirty_ = false;
+    ++present_count_;
+}
+
+void OsrRenderer::LogStats() const {
+    Logger::LogMessage("OSR: " + std::to_string(paint_count_.load()) + " paints, " +
+                       std::to_string(present_count_) + " presents, " +
+                       std::to_string(uploaded_bytes_.load() / 1024) + " KB uploaded");
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include "include/cef_render_handler.h"
+#include <SDL.h>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Presents an off-screen rendered browser through an SDL streaming texture.
+// Only the dirty rectangles reported by CefRenderHandler::OnPaint are
+// uploaded, and frames are presented with vsync so pacing follows the
+// display refresh rate. Without a window the renderer runs headless and
+// just accounts for the frames CEF produces.
+class OsrRenderer {
+public:
+    OsrRenderer();
+    ~OsrRenderer();
+    
+    // SDL thread. |window| may be nullptr for headless operation.
+    bool Initialize(SDL_Window* window, int width, int height);
+    void Cleanup();
+    
+    bool IsHeadless() const { return renderer_ == nullptr; }
+    
+    // CEF UI thread: size reported to CefRenderHandler::GetViewRect
+    void GetViewSize(int& width, int& height) const;
+    
+    // CEF UI thread: uploads (or stages, with a multi-threaded loop) the dirty regions
+    void OnPaint(const CefRenderHandler::RectList& dirtyRects,
+                 const void* buffer, int width, int height);
+    
+    // SDL thread
+    void SetViewSize(int width, int height);
+    void PresentIfDirty();
+    int GetRefreshRate() const;
+    
+    void LogStats() const;
+    
+private:
+    bool EnsureTexture(int width, int height);
+    void UploadRects(const CefRenderHandler::RectList& rects,
+                     const uint8_t* pixels, int width, int height);
+    void FlushStaging();
+    
+    SDL_Window* window_;
+    SDL_Renderer* renderer_;
+    SDL_Texture* texture_;
+    int texture_width_;
+    int texture_height_;
+    bool frame_dirty_;
+    
+    std::atomic<int> view_width_;
+    std::atomic<int> view_height_;
+    
+    // Dirty regions copied from CEF's UI thread, waiting for the SDL thread
+    std::mutex staging_mutex_;
+    std::vector<uint8_t> staging_pixels_;
+    int staging_width_;
+    int staging_height_;
+    CefRenderHandler::RectList staging_rects_;
+    bool upload_pending_;
+    
+    std::atomic<uint64_t> paint_count_;
+    std::atomic<uint64_t> uploaded_bytes_;
+    uint64_t present_count_;
+};
@@ -0,0 +1,184 @@
+#include "sdl-bridge.hpp"
+#include "logger.hpp"
+#include "include/cef_task.h"
+#include <memory>
+
+namespace {
+    // Drains every SDL event queued for the UI thread in one task
+    class DrainCefQueueTask : public CefTask {
+    public:
+        void Execute() override {
+            SdlBridge::GetInstance().DrainCefQueue();
+        }
+        
+    private:
+        IMPLEMENT_REFCOUNTING(DrainCefQueueTask);
+    };
+}
+
+SdlInputState SdlInputState::Capture(const SDL_Event& event) {
+    SdlInputState state;
+    state.mod = SDL_GetModState();
+    state.buttons = SDL_GetMouseState(&state.mouse_x, &state.mouse_y);
+    
+    // SDL's global state may already reflect events still queued behind this one
+    switch (event.type) {
+        case SDL_KEYDOWN:
+        case SDL_KEYUP:
+            state.mod = static_cast<SDL_Keymod>(event.key.keysym.mod);
+            break;
+        case SDL_MOUSEMOTION:
+            state.buttons = event.motion.state;
+            state.mouse_x = event.motion.x;
+            state.mouse_y = event.motion.y;
+            break;
+    }
+    return state;
+}
+
+SdlBridge& SdlBridge::GetInstance() {
+    static SdlBridge instance;
+    return instance;
+}
+
+SdlBridge::SdlBridge()
+    : multi_threaded_(false),
+      wakeup_event_(static_cast<Uint32>(-1)),
+      cef_drain_pending_(false),
+      overflowing_(false),
+      sdl_wakeup_pending_(false) {
+}
+
+bool SdlBridge::Initialize(bool multi_threaded) {
+    multi_threaded_ = multi_threaded;
+    if (!multi_threaded_) {
+        return true;
+    }
+    
+    wakeup_event_ = SDL_RegisterEvents(1);
+    if (wakeup_event_ == static_cast<Uint32>(-1)) {
+        Logger::LogMessage("Could not register SDL bridge event! SDL_Error: " + std::string(SDL_GetError()));
+        return false;
+    }
+    return true;
+}
+
+void SdlBridge::SetCefEventHandler(EventHandler handler) {
+    cef_event_handler_ = handler;
+}
+
+void SdlBridge::PostToCef(const SDL_Event& event) {
+    const QueuedEvent queued = {event, SdlInputState::Capture(event)};
+    if (!multi_threaded_) {
+        if (cef_event_handler_) {
+            cef_event_handler_(queued.event, queued.state);
+        }
+        return;
+    }
+    
+    if (overflowing_.load() || !cef_queue_.TryPush(queued)) {
+        PushOverflow(queued);
+    }
+    
+    if (!cef_drain_pending_.exchange(true)) {
+        CefPostTask(TID_UI, new DrainCefQueueTask());
+    }
+}
+
+void SdlBridge::PushOverflow(const QueuedEvent& queued) {
+    std::lock_guard<std::mutex> lock(overflow_mutex_);
+    if (!overflow_.empty() && overflow_.back().event.type == queued.event.type) {
+        // Only the latest pointer position matters, and wheel deltas add up
+        QueuedEvent& last = overflow_.back();
+        if (queued.event.type == SDL_MOUSEMOTION) {
+            const Sint32 xrel = last.event.motion.xrel + queued.event.motion.xrel;
+            const Sint32 yrel = last.event.motion.yrel + queued.event.motion.yrel;
+            last = queued;
+            last.event.motion.xrel = xrel;
+            last.event.motion.yrel = yrel;
+            return;
+        }
+        if (queued.event.type == SDL_MOUSEWHEEL && last.event.wheel.direction == queued.event.wheel.direction) {
+            last.event.wheel.x += queued.event.wheel.x;
+            last.event.wheel.y += queued.event.wheel.y;
+            last.state = queued.state;
+            return;
+        }
+    }
+    overflow_.push_back(queued);
+    overflowing_.store(true);
+}
+
+void SdlBridge::DrainCefQueue() {
+    // Clear the flag first so events pushed while draining schedule a new task
+    cef_drain_pending_.store(false);
+    
+    QueuedEvent queued;
+    while (cef_queue_.TryPop(queued)) {
+        if (cef_event_handler_) {
+            cef_event_handler_(queued.event, queued.state);
+        }
+    }
+    
+    // Everything in the overflow was posted after what the queue held, and
+    // nothing enters the queue until it has been taken
+    if (!overflowing_.load()) {
+        return;
+    }
+    std::vector<QueuedEvent> overflow;
+    {
+        std::lock_guard<std::mutex> lock(overflow_mutex_);
+        overflow.swap(overflow_);
+        overflowing_.store(false);
+    }
+    for (const QueuedEvent& event : overflow) {
+        if (cef_event_handler_) {
+            cef_event_handler_(event.event, event.state);
+        }
+    }
+}
+
+void SdlBridge::RunOnSDLThread(std::function<void()> task) {
+    if (!multi_threaded_) {
+        task();
+        return;
+    }
+    
+    SDL_Event event;
+    SDL_zero(event);
+    event.type = wakeup_event_;
+    
+    if (!sdl_queue_.TryPush(task)) {
+        // Queue overflow: carry the task in the event itself
+        event.user.data1 = new std::function<void()>(std::move(task));
+        SDL_PushEvent(&event);
+        return;
+    }
+    
+    if (!sdl_wakeup_pending_.exchange(true)) {
+        SDL_PushEvent(&event);
+    }
+}
+
+bool SdlBridge::HandleEvent(const SDL_Event& event) {
+    if (!multi_threaded_ || event.type != wakeup_event_) {
+        return false;
+    }
+    
+    if (event.user.data1) {
+        std::unique_ptr<std::function<void()>> task(static_cast<std::function<void()>*>(event.user.data1));
+        (*task)();
+    } else {
+        DrainSDLQueue();
+    }
+    return true;
+}
+
+void SdlBridge::DrainSDLQueue() {
+    sdl_wakeup_pending_.store(false);
+    
+    std::function<void()> task;
+    while (sdl_queue_.TryPop(task)) {
+        task();
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <SDL.h>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include "../utils/spsc-queue.hpp"
+
+// Keyboard and mouse state that goes with an SDL event. SDL_GetModState()
+// and SDL_GetMouseState() belong to the SDL thread, so the state is read
+// there, as the event is dispatched, and travels with it.
+struct SdlInputState {
+    SDL_Keymod mod = KMOD_NONE;
+    Uint32 buttons = 0;
+    int mouse_x = 0;
+    int mouse_y = 0;
+    
+    // SDL thread; key and motion events carry their own exact state
+    static SdlInputState Capture(const SDL_Event& event);
+};
+
+// Marshals work between the SDL thread and CEF's UI thread when CEF runs its
+// own multi-threaded message loop. SDL events travel to the UI thread over a
+// lock-free queue drained by a single posted CefTask; SimpleClient callbacks
+// travel back over a second queue and wake SDL_WaitEvent() with a user event.
+// In the single-threaded modes both threads are the same and work runs inline.
+//
+// If the UI thread falls so far behind that the event queue fills, further
+// events wait in an overflow list, with consecutive mouse motion and wheel
+// events coalesced, and are dispatched after the queue, in order.
+class SdlBridge {
+public:
+    static SdlBridge& GetInstance();
+    
+    // Registers the wakeup event type. Must be called on the SDL thread after SDL_Init().
+    bool Initialize(bool multi_threaded);
+    
+    bool IsMultiThreaded() const { return multi_threaded_; }
+    
+    using EventHandler = std::function<void(const SDL_Event&, const SdlInputState&)>;
+    
+    // Handler invoked on the CEF UI thread for every forwarded SDL event
+    void SetCefEventHandler(EventHandler handler);
+    
+    // SDL thread: hand |event| to the CEF UI thread without blocking
+    void PostToCef(const SDL_Event& event);
+    
+    // CEF UI thread: run |task| on the SDL thread (inline in single-threaded modes)
+    void RunOnSDLThread(std::function<void()> task);
+    
+    // SDL thread: returns true if |event| was a bridge wakeup and has been consumed
+    bool HandleEvent(const SDL_Event& event);
+    
+    // CEF UI thread: dispatches every queued SDL event
+    void DrainCefQueue();
+    
+private:
+    SdlBridge();
+    
+    struct QueuedEvent {
+        SDL_Event event;
+        SdlInputState state;
+    };
+    
+    void DrainSDLQueue();
+    void PushOverflow(const QueuedEvent& queued);
+    
+    static constexpr size_t kQueueCapacity = 1024;
+    
+    bool multi_threaded_;
+    Uint32 wakeup_event_;
+    EventHandler cef_event_handler_;
+    
+    // SDL thread -> CEF UI thread. While overflow_ holds events, new ones
+    // join it instead of the queue; only the SDL thread sets overflowing_.
+    MikoIDE::Utils::SpscQueue<QueuedEvent, kQueueCapacity> cef_queue_;
+    std::atomic<bool> cef_drain_pending_;
+    std::vector<QueuedEvent> overflow_;
+    std::atomic<bool> overflowing_;
+    std::mutex overflow_mutex_;
+    
+    // CEF UI thread -> SDL thread
+    MikoIDE::Utils::SpscQueue<std::function<void()>, kQueueCapacity> sdl_queue_;
+    std::atomic<bool> sdl_wakeup_pending_;
+};
@@ -0,0 +1,206 @@
+#include "startup-benchmark.hpp"
+#include "config.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+extern char** environ;
+#endif
+
+#ifdef _WIN32
+namespace {
+    // Quotes |arg| so that CommandLineToArgvW (and the CRT) give it back
+    // unchanged: backslashes only escape when they precede a quote, so those
+    // runs, and a run at the end before the closing quote, are doubled
+    void AppendQuotedArgument(std::string& commandLine, const std::string& arg) {
+        if (!arg.empty() && arg.find_first_of(" \t\n\v\"") == std::string::npos) {
+            commandLine += arg;
+            return;
+        }
+        commandLine += '"';
+        for (size_t i = 0;; ++i) {
+            size_t backslashes = 0;
+            while (i < arg.size() && arg[i] == '\\') {
+                ++backslashes;
+                ++i;
+            }
+            if (i == arg.size()) {
+                commandLine.append(backslashes * 2, '\\');
+                break;
+            }
+            if (arg[i] == '"') {
+                commandLine.append(backslashes * 2 + 1, '\\');
+            } else {
+                commandLine.append(backslashes, '\\');
+            }
+            commandLine += arg[i];
+        }
+        commandLine += '"';
+    }
+}
+#endif
+
+int StartupBenchmark::Run(int runs) {
+    std::filesystem::path scratch = std::filesystem::temp_directory_path() / "mikoide-startup-benchmark";
+    std::error_code ec;
+    std::filesystem::remove_all(scratch, ec);
+    std::filesystem::create_directories(scratch, ec);
+    
+    std::string report = (scratch / "report.log").string();
+    std::vector<double> cold;
+    std::vector<double> warm;
+    
+    for (int i = 0; i < runs; ++i) {
+        std::string cache = (scratch / ("cold-" + std::to_string(i))).string();
+        double ms = LaunchOnce(cache, report);
+        if (ms >= 0) {
+            cold.push_back(ms);
+        }
+        std::filesystem::remove_all(cache, ec);
+    }
+    
+    // Prime the shared cache; the first warm launch is not counted
+    std::string warmCache = (scratch / "warm").string();
+    LaunchOnce(warmCache, report);
+    for (int i = 0; i < runs; ++i) {
+        double ms = LaunchOnce(warmCache, report);
+        if (ms >= 0) {
+            warm.push_back(ms);
+        }
+    }
+    
+    Report("cold", cold);
+    Report("warm", warm);
+    
+    std::filesystem::remove_all(scratch, ec);
+    return cold.empty() && warm.empty() ? 1 : 0;
+}
+
+double StartupBenchmark::LaunchOnce(const std::string& cachePath, const std::string& reportPath) {
+    std::error_code ec;
+    std::filesystem::remove(reportPath, ec);
+    
+    std::vector<std::string> args = {
+        "--exit-after-first-paint",
+        "--startup-report=" + reportPath,
+        "--cache-path=" + cachePath,
+    };
+    if (AppConfig::IsHeadless()) {
+        args.push_back("--headless");
+    } else if (AppConfig::IsOffscreenRenderingEnabled()) {
+        args.push_back("--osr");
+    }
+    
+    if (SpawnAndWait(GetExecutablePath(), args) != 0) {
+        Logger::LogMessage("Startup benchmark: launch failed");
+        return -1.0;
+    }
+    
+    std::ifstream report(reportPath);
+    std::string line;
+    while (std::getline(report, line)) {
+        std::istringstream fields(line);
+        std::string name;
+        double ms = 0.0;
+        if (std::getline(fields, name, '\t') && fields >> ms && name == "first_meaningful_paint") {
+            return ms;
+        }
+    }
+    
+    Logger::LogMessage("Startup benchmark: launch exited without a first paint");
+    return -1.0;
+}
+
+void StartupBenchmark::Report(const std::string& label, std::vector<double> samples) {
+    if (samples.empty()) {
+        Logger::LogMessage("Startup benchmark (" + label + "): no successful runs");
+        return;
+    }
+    
+    std::sort(samples.begin(), samples.end());
+    
+    // Nearest-rank percentile
+    auto percentile = [&samples](double p) {
+        size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * samples.size()));
+        return samples[std::min(std::max<size_t>(rank, 1), samples.size()) - 1];
+    };
+    double mean = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+    
+    char summary[256];
+    snprintf(summary, sizeof(summary),
+             "Startup benchmark (%s, %zu runs): min %.1fms  p50 %.1fms  p90 %.1fms  p99 %.1fms  max %.1fms  mean %.1fms",
+             label.c_str(), samples.size(), samples.front(), percentile(50), percentile(90),
+             percentile(99), samples.back(), mean);
+    
+    Logger::LogMessage(summary);
+    std::cout << summary << std::endl;
+}
+
+std::string StartupBenchmark::GetExecutablePath() {
+#ifdef _WIN32
+    char path[MAX_PATH];
+    DWORD length = GetModuleFileNameA(nullptr, path, MAX_PATH);
+    return std::string(path, length);
+#else
+    std::error_code ec;
+    return std::filesystem::read_symlink("/proc/self/exe", ec).string();
+#endif
+}
+
+int StartupBenchmark::SpawnAndWait(const std::string& executable, const std::vector<std::string>& args) {
+#ifdef _WIN32
+    // The program name takes no escapes; a path cannot contain quotes
+    std::string commandLine = "\"" + executable + "\"";
+    for (const auto& arg : args) {
+        commandLine += ' ';
+        AppendQuotedArgument(commandLine, arg);
+    }
+    
+    STARTUPINFOA si;
+    PROCESS_INFORMATION pi;
+    ZeroMemory(&si, sizeof(si));
+    si.cb = sizeof(si);
+    ZeroMemory(&pi, sizeof(pi));
+    
+    if (!CreateProcessA(NULL, const_cast<char*>(commandLine.c_str()), NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi)) {
+        return -1;
+    }
+    
+    WaitForSingleObject(pi.hProcess, INFINITE);
+    DWORD exitCode = 1;
+    GetExitCodeProcess(pi.hProcess, &exitCode);
+    CloseHandle(pi.hProcess);
+    CloseHandle(pi.hThread);
+    return static_cast<int>(exitCode);
+#else
+    std::vector<char*> argv;
+    argv.push_back(const_cast<char*>(executable.c_str()));
+    for (const auto& arg : args) {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+    
+    pid_t pid;
+    if (posix_spawn(&pid, executable.c_str(), nullptr, nullptr, argv.data(), environ) != 0) {
+        return -1;
+    }
+    
+    int status = 0;
+    if (waitpid(pid, &status, 0) == -1 || !WIFEXITED(status)) {
+        return -1;
+    }
+    return WEXITSTATUS(status);
+#endif
+}
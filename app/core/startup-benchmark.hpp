@@ -0,0 +1,21 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// Repeatedly launches the host with --exit-after-first-paint and reports
+// time-to-first-meaningful-paint percentiles. Cold runs start every launch
+// with an empty CEF cache directory; warm runs share a cache primed by one
+// discarded launch. (The OS page cache is not flushed in either case.)
+class StartupBenchmark {
+public:
+    // Runs |runs| cold and |runs| warm launches. Returns the process exit code.
+    static int Run(int runs);
+    
+private:
+    // Launches one child and returns its first-meaningful-paint time, or a negative value
+    static double LaunchOnce(const std::string& cachePath, const std::string& reportPath);
+    
+    static void Report(const std::string& label, std::vector<double> samples);
+    static std::string GetExecutablePath();
+    static int SpawnAndWait(const std::string& executable, const std::vector<std::string>& args);
+};
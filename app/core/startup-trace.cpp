@@ -0,0 +1,154 @@
+#include "startup-trace.hpp"
+#include "config.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace {
+    // Captured during static initialization, before main()/WinMain() runs
+    const std::chrono::steady_clock::time_point kProcessEntry = std::chrono::steady_clock::now();
+    const std::chrono::system_clock::time_point kProcessEntryWall = std::chrono::system_clock::now();
+    
+    constexpr const char* kRendererPrefix = "__mikoStartup:";
+    
+    double MillisecondsSinceEntry() {
+        return std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - kProcessEntry).count();
+    }
+}
+
+std::mutex StartupTrace::mutex_;
+std::vector<StartupTrace::Phase> StartupTrace::phases_;
+
+bool StartupTrace::HasPhase(const std::string& name) {
+    return std::any_of(phases_.begin(), phases_.end(),
+                       [&name](const Phase& phase) { return phase.name == name; });
+}
+
+void StartupTrace::Mark(const std::string& name) {
+    double ms = MillisecondsSinceEntry();
+    
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!HasPhase(name)) {
+        phases_.push_back(Phase{name, ms});
+    }
+}
+
+void StartupTrace::MarkFromEpoch(const std::string& name, double epochMs) {
+    double entryEpochMs = std::chrono::duration<double, std::milli>(
+        kProcessEntryWall.time_since_epoch()).count();
+    
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!HasPhase(name)) {
+        phases_.push_back(Phase{name, epochMs - entryEpochMs});
+    }
+}
+
+std::string StartupTrace::GetRendererProbeScript() {
+    // Buffered observers also deliver entries recorded before injection
+    return R"(
+        (function() {
+            const report = (name, offset) => {
+                if (offset > 0) {
+                    console.log('__mikoStartup:' + name + '=' + (performance.timeOrigin + offset));
+                }
+            };
+            console.log('__mikoStartup:renderer.navigation_start=' + performance.timeOrigin);
+            
+            const nav = performance.getEntriesByType('navigation')[0];
+            if (nav) {
+                report('renderer.dom_content_loaded', nav.domContentLoadedEventEnd);
+                report('renderer.load', nav.loadEventEnd);
+            }
+            
+            new PerformanceObserver((list, observer) => {
+                for (const entry of list.getEntries()) {
+                    if (entry.name === 'first-paint') {
+                        report('renderer.first_paint', entry.startTime);
+                    } else if (entry.name === 'first-contentful-paint') {
+                        report('renderer.first_contentful_paint', entry.startTime);
+                        observer.disconnect();
+                    }
+                }
+            }).observe({ type: 'paint', buffered: true });
+        })();
+    )";
+}
+
+bool StartupTrace::HandleRendererReport(const std::string& message) {
+    if (message.compare(0, strlen(kRendererPrefix), kRendererPrefix) != 0) {
+        return false;
+    }
+    
+    std::string report = message.substr(strlen(kRendererPrefix));
+    size_t separator = report.find('=');
+    if (separator == std::string::npos) {
+        return true;
+    }
+    
+    std::string name = report.substr(0, separator);
+    double epochMs = std::strtod(report.c_str() + separator + 1, nullptr);
+    MarkFromEpoch(name, epochMs);
+    
+    if (name == "renderer.first_contentful_paint") {
+        MarkFirstMeaningfulPaint();
+    }
+    return true;
+}
+
+bool StartupTrace::MarkFirstMeaningfulPaint() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (HasPhase("first_meaningful_paint")) {
+            return false;
+        }
+    }
+    
+    Mark("first_meaningful_paint");
+    WriteReport(AppConfig::GetStartupReportPath());
+    return true;
+}
+
+bool StartupTrace::HasFirstMeaningfulPaint() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return HasPhase("first_meaningful_paint");
+}
+
+std::vector<StartupTrace::Phase> StartupTrace::GetPhases() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<Phase> phases = phases_;
+    std::stable_sort(phases.begin(), phases.end(),
+                     [](const Phase& a, const Phase& b) { return a.ms < b.ms; });
+    return phases;
+}
+
+void StartupTrace::WriteReport(const std::string& path) {
+    std::vector<Phase> phases = GetPhases();
+    
+    std::ofstream report(path, std::ios::trunc);
+    if (!report.is_open()) {
+        Logger::LogMessage("Failed to write startup report: " + path);
+        return;
+    }
+    
+    // One "<phase>\t<ms since entry>\t<ms since previous phase>" line per phase
+    double previous = 0.0;
+    char line[256];
+    for (const Phase& phase : phases) {
+        snprintf(line, sizeof(line), "%s\t%.3f\t%.3f", phase.name.c_str(), phase.ms, phase.ms - previous);
+        report << line << "\n";
+        previous = phase.ms;
+    }
+    
+    for (const Phase& phase : phases) {
+        if (phase.name == "first_meaningful_paint") {
+            Logger::LogMessage("Startup: first meaningful paint after " +
+                               std::to_string(static_cast<int>(phase.ms)) +
+                               "ms, report written to " + path);
+        }
+    }
+}
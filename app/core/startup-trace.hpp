@@ -0,0 +1,42 @@
+#pragma once
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Monotonic timeline of startup phases, measured from process entry.
+// Host phases are marked directly; renderer milestones arrive as wall-clock
+// timestamps and are converted onto the same timeline. The report is written
+// once the first meaningful paint has been observed.
+class StartupTrace {
+public:
+    struct Phase {
+        std::string name;
+        double ms;  // milliseconds since process entry
+    };
+    
+    // Records |name| at the current time. Thread-safe; repeated marks are ignored.
+    static void Mark(const std::string& name);
+    
+    // Records a renderer milestone given as milliseconds since the Unix epoch
+    static void MarkFromEpoch(const std::string& name, double epochMs);
+    
+    // Handles "__mikoStartup:" console messages; returns false for any other message
+    static bool HandleRendererReport(const std::string& message);
+    
+    // Script that reports navigation and paint timings back through the console
+    static std::string GetRendererProbeScript();
+    
+    // Marks first_meaningful_paint and writes the report. Returns true the first time.
+    static bool MarkFirstMeaningfulPaint();
+    static bool HasFirstMeaningfulPaint();
+    
+    static std::vector<Phase> GetPhases();
+    static void WriteReport(const std::string& path);
+    
+private:
+    static bool HasPhase(const std::string& name);
+    
+    static std::mutex mutex_;
+    static std::vector<Phase> phases_;
+};
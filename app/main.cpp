@@ -1,3 +1,4 @@
+#ifdef _WIN32
 // Remove the manual defines since CEF already defines them on command line
 // #define WIN32_LEAN_AND_MEAN
 // #define NOMINMAX
@@ -16,6 +17,7 @@
 #ifdef GetParent
 #undef GetParent
 #endif
+#endif
 
 #include <SDL.h>
 #include <SDL_syswm.h>
@@ -29,96 +31,249 @@
 #include "core/logger.hpp"
 #include "core/client.hpp"
 #include "core/app.hpp"
+#include "core/message-pump.hpp"
+#include "core/sdl-bridge.hpp"
+#include "core/osr-renderer.hpp"
+#include "core/osr-input.hpp"
+#include "core/startup-trace.hpp"
+#include "core/startup-benchmark.hpp"
+#include "sandbox/preload.hpp"
+#include "sandbox/native-bridge.hpp"
+#include "utils/scrollback.hpp"
+#include "utils/session-client.hpp"
+#include "utils/spawn-helper.hpp"
+#include "utils/terminal.hpp"
 
 // Global variables
 CefRefPtr<SimpleClient> g_client;
 SDL_Window* g_sdl_window = nullptr;
+#ifdef _WIN32
 HWND g_hwnd = nullptr;
+#endif
+OsrRenderer* g_osr_renderer = nullptr;
 bool g_running = true;
 
-// Handle SDL events
+// Handle a single SDL event. Runs on the CEF UI thread, which is the SDL
+// thread itself unless the multi-threaded message loop is enabled; |state|
+// was captured on the SDL thread with the event.
+void HandleSDLEvent(const SDL_Event& event, const SdlInputState& state) {
+    CefRefPtr<CefBrowser> browser;
+    if (g_client && g_client->HasBrowsers()) {
+        browser = g_client->GetFirstBrowser();
+    }
+    
+    if (g_osr_renderer && browser && OsrInput::ForwardEvent(browser->GetHost(), event, state)) {
+        return;
+    }
+    
+    switch (event.type) {
+        case SDL_QUIT:
+            // The loop stops from OnBeforeClose once the last browser is gone
+            if (browser) {
+                g_client->CloseAllBrowsers(false);
+            } else {
+                SdlBridge::GetInstance().RunOnSDLThread([]() {
+                    g_running = false;
+                });
+            }
+            break;
+            
+        case SDL_WINDOWEVENT:
+            if (event.window.event == SDL_WINDOWEVENT_RESIZED && browser) {
+                int width = event.window.data1;
+                int height = event.window.data2;
+                
+                if (g_osr_renderer) {
+                    g_osr_renderer->SetViewSize(width, height);
+                    browser->GetHost()->WasResized();
+                }
+#ifdef _WIN32
+                else {
+                    HWND cef_hwnd = browser->GetHost()->GetWindowHandle();
+                    if (cef_hwnd) {
+                        SetWindowPos(cef_hwnd, nullptr, 0, 0, width, height,
+                                   SWP_NOZORDER | SWP_NOACTIVATE);
+                    }
+                }
+#endif
+            }
+            break;
+    }
+}
+
+// Handle all pending SDL events
 void HandleSDLEvents() {
     SDL_Event event;
     while (SDL_PollEvent(&event)) {
-        switch (event.type) {
-            case SDL_QUIT:
-                g_running = false;
-                if (g_client) {
-                    g_client->CloseAllBrowsers(false);
-                }
-                break;
-                
-            case SDL_WINDOWEVENT:
-                if (event.window.event == SDL_WINDOWEVENT_RESIZED) {
-                    if (g_client && g_client->HasBrowsers()) {
-                        CefRefPtr<CefBrowser> browser = g_client->GetFirstBrowser();
-                        if (browser) {
-                            HWND cef_hwnd = browser->GetHost()->GetWindowHandle();
-                            if (cef_hwnd) {
-                                int width = event.window.data1;
-                                int height = event.window.data2;
-                                SetWindowPos(cef_hwnd, nullptr, 0, 0, width, height,
-                                           SWP_NOZORDER | SWP_NOACTIVATE);
-                            }
-                        }
-                    }
+        HandleSDLEvent(event, SdlInputState::Capture(event));
+    }
+}
+
+// Present the off-screen rendered frame, if any region changed
+void PresentFrame() {
+    if (g_osr_renderer) {
+        g_osr_renderer->PresentIfDirty();
+    }
+}
+
+// Sleep until SDL delivers an event or CEF's scheduled work is due
+void RunExternalPumpLoop() {
+    MessagePump& pump = MessagePump::GetInstance();
+    
+    while (g_running) {
+        SDL_Event event;
+        if (SDL_WaitEventTimeout(&event, pump.GetWaitTimeout())) {
+            do {
+                if (!pump.HandleEvent(event)) {
+                    pump.RecordEventDispatch(event);
+                    HandleSDLEvent(event, SdlInputState::Capture(event));
                 }
-                break;
+            } while (g_running && SDL_PollEvent(&event));
         }
+        pump.DoWorkIfDue();
+        PresentFrame();
     }
+    
+    pump.LogStats();
 }
 
-// Use WinMain instead of main for Windows applications without console
-int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow) {
-    // Initialize SDL
-    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
-        Logger::LogMessage("SDL could not initialize! SDL_Error: " + std::string(SDL_GetError()));
-        return 1;
+// SDL owns this thread; CEF's UI thread runs separately and the two only
+// exchange work through the SdlBridge queues
+void RunMultiThreadedLoop() {
+    SdlBridge& bridge = SdlBridge::GetInstance();
+    bridge.SetCefEventHandler(HandleSDLEvent);
+    
+    while (g_running) {
+        SDL_Event event;
+        if (SDL_WaitEvent(&event)) {
+            if (!bridge.HandleEvent(event)) {
+                bridge.PostToCef(event);
+            }
+        }
+        PresentFrame();
     }
+}
 
+int RunApplication(const CefMainArgs& main_args) {
     void* sandbox_info = nullptr;
-    CefMainArgs main_args(GetModuleHandle(nullptr));
+    StartupTrace::Mark("process.main");
+
+    // Sub-processes need the app too, e.g. to register the miko:// scheme
+    CefRefPtr<SimpleApp> app(new SimpleApp);
 
     // CEF sub-process check
-    int exit_code = CefExecuteProcess(main_args, nullptr, sandbox_info);
+    int exit_code = CefExecuteProcess(main_args, app.get(), sandbox_info);
     if (exit_code >= 0) {
         return exit_code;
     }
+    StartupTrace::Mark("cef.execute_process");
 
-    // Create SDL window
-    std::string windowTitle = AppConfig::IsDebugMode() ? 
-        "SwipeIDE - Development Mode" : "SwipeIDE - Release Mode";
-    
-    g_sdl_window = SDL_CreateWindow(
-        windowTitle.c_str(),
-        SDL_WINDOWPOS_CENTERED,
-        SDL_WINDOWPOS_CENTERED,
-        1200, 800,
-        SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE
-    );
-
-    if (!g_sdl_window) {
-        Logger::LogMessage("Window could not be created! SDL_Error: " + std::string(SDL_GetError()));
-        SDL_Quit();
+    // Benchmark driver: relaunches this executable and never starts CEF itself
+    if (AppConfig::GetStartupBenchmarkRuns() > 0) {
+        return StartupBenchmark::Run(AppConfig::GetStartupBenchmarkRuns());
+    }
+
+#ifndef _WIN32
+    // Forked while this process is still small and single-threaded, before
+    // CefInitialize; terminal processes are started from it
+    MikoIDE::Utils::SpawnHelper::GetInstance().Start();
+    StartupTrace::Mark("spawn_helper.start");
+
+    // Terminals fall back to the spawn helper if the daemon can't be reached
+    if (AppConfig::IsTerminalSessionsEnabled()) {
+        MikoIDE::Utils::SessionClient::GetInstance().Start(MikoIDE::Utils::SessionClient::GetDefaultDaemonPath());
+        StartupTrace::Mark("session_client.start");
+    }
+#endif
+
+    bool offscreen = AppConfig::IsOffscreenRenderingEnabled();
+    bool headless = AppConfig::IsHeadless();
+
+    // Initialize SDL; a headless host only needs the event queue
+    if (SDL_Init(headless ? SDL_INIT_EVENTS : SDL_INIT_VIDEO) < 0) {
+        Logger::LogMessage("SDL could not initialize! SDL_Error: " + std::string(SDL_GetError()));
         return 1;
     }
+    StartupTrace::Mark("sdl.init");
 
-    // Get the native window handle
-    SDL_SysWMinfo wmInfo;
-    SDL_VERSION(&wmInfo.version);
-    if (SDL_GetWindowWMInfo(g_sdl_window, &wmInfo)) {
-        g_hwnd = wmInfo.info.win.window;
-    } else {
-        Logger::LogMessage("Could not get window handle!");
-        SDL_DestroyWindow(g_sdl_window);
+    MessageLoopMode loop_mode = AppConfig::GetMessageLoopMode();
+    bool use_external_pump = loop_mode == MessageLoopMode::ExternalPump;
+    bool use_multi_threaded_loop = loop_mode == MessageLoopMode::MultiThreaded;
+    
+    if (use_external_pump && !MessagePump::GetInstance().Initialize()) {
+        SDL_Quit();
+        return 1;
+    }
+    
+    if (!SdlBridge::GetInstance().Initialize(use_multi_threaded_loop)) {
         SDL_Quit();
         return 1;
     }
 
+    int width = AppConfig::GetWindowWidth();
+    int height = AppConfig::GetWindowHeight();
+
+    // Create SDL window
+    if (!headless) {
+        std::string windowTitle = AppConfig::IsDebugMode() ? 
+            "SwipeIDE - Development Mode" : "SwipeIDE - Release Mode";
+        
+        g_sdl_window = SDL_CreateWindow(
+            windowTitle.c_str(),
+            SDL_WINDOWPOS_CENTERED,
+            SDL_WINDOWPOS_CENTERED,
+            width, height,
+            SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE
+        );
+
+        if (!g_sdl_window) {
+            Logger::LogMessage("Window could not be created! SDL_Error: " + std::string(SDL_GetError()));
+            SDL_Quit();
+            return 1;
+        }
+        
+        SDL_GetWindowSize(g_sdl_window, &width, &height);
+        StartupTrace::Mark("sdl.create_window");
+    }
+
+#ifdef _WIN32
+    // Get the native window handle for the embedded child browser
+    if (!offscreen) {
+        SDL_SysWMinfo wmInfo;
+        SDL_VERSION(&wmInfo.version);
+        if (SDL_GetWindowWMInfo(g_sdl_window, &wmInfo)) {
+            g_hwnd = wmInfo.info.win.window;
+        } else {
+            Logger::LogMessage("Could not get window handle!");
+            SDL_DestroyWindow(g_sdl_window);
+            SDL_Quit();
+            return 1;
+        }
+    }
+#endif
+
+    OsrRenderer osr_renderer;
+    if (offscreen) {
+        if (!osr_renderer.Initialize(g_sdl_window, width, height)) {
+            if (g_sdl_window) {
+                SDL_DestroyWindow(g_sdl_window);
+            }
+            SDL_Quit();
+            return 1;
+        }
+        g_osr_renderer = &osr_renderer;
+        
+        if (g_sdl_window) {
+            SDL_StartTextInput();
+        }
+    }
+
     // CEF settings
     CefSettings settings;
     settings.no_sandbox = true;
-    settings.multi_threaded_message_loop = false;
+    settings.multi_threaded_message_loop = use_multi_threaded_loop;
+    settings.external_message_pump = use_external_pump;
+    settings.windowless_rendering_enabled = offscreen;
     
     // Enable dark theme support
     if (AppConfig::IsDarkThemeEnabled()) {
@@ -126,39 +281,70 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         // Remove the chrome_runtime line as it's not available in this CEF version
     }
     
+    if (!AppConfig::GetCachePath().empty()) {
+        CefString(&settings.root_cache_path).FromString(AppConfig::GetCachePath());
+        CefString(&settings.cache_path).FromString(AppConfig::GetCachePath());
+    }
+    
     if (AppConfig::IsDebugMode()) {
         settings.remote_debugging_port = 9222;
         settings.log_severity = LOGSEVERITY_INFO;
     }
 
-    CefRefPtr<SimpleApp> app(new SimpleApp);
     CefInitialize(main_args, settings, app.get(), sandbox_info);
+    StartupTrace::Mark("cef.initialize");
 
     // Create CEF browser
     CefWindowInfo window_info;
-    int width, height;
-    SDL_GetWindowSize(g_sdl_window, &width, &height);
-    
-    CefRect cef_rect(0, 0, width, height);
-    window_info.SetAsChild(g_hwnd, cef_rect);
-
     CefBrowserSettings browser_settings;
     
+    if (offscreen) {
+        window_info.SetAsWindowless(kNullWindowHandle);
+        // Produce frames no faster than the display can show them
+        browser_settings.windowless_frame_rate = osr_renderer.GetRefreshRate();
+    }
+#ifdef _WIN32
+    else {
+        CefRect cef_rect(0, 0, width, height);
+        window_info.SetAsChild(g_hwnd, cef_rect);
+    }
+#endif
+    
     // Configure dark theme in browser settings
     if (AppConfig::IsDarkThemeEnabled()) {
         // Enable dark mode CSS media queries
         browser_settings.background_color = 0xFF1E1E1E; // Dark background
     }
     
-    g_client = new SimpleClient();
+    g_client = new SimpleClient(g_osr_renderer);
     std::string startupUrl = AppConfig::GetStartupUrl();
     
-    CefBrowserHost::CreateBrowser(window_info, g_client, startupUrl, browser_settings, nullptr, nullptr);
+    // Host APIs run on the bridge's workers; the renderer installs a
+    // Promise-returning stub for each name
+    MikoIDE::Sandbox::NativeBridge& native_bridge = MikoIDE::Sandbox::NativeBridge::GetInstance();
+    native_bridge.Initialize();
+    MikoIDE::Utils::ScrollbackBudget::GetInstance().SetLimits(AppConfig::GetScrollbackMemoryLimit(),
+                                                             AppConfig::GetScrollbackDiskLimit());
+    // Sessions left by the previous instance, under their old terminal ids
+    MikoIDE::Utils::Terminal::GetInstance().RestoreSessions();
+    
+    // The renderer applies these in OnContextCreated, before the page runs
+    MikoIDE::Sandbox::PreloadOptions preload_options;
+    preload_options.dark_theme = AppConfig::IsDarkThemeEnabled();
+    preload_options.async_functions = native_bridge.GetFunctionNames();
+    preload_options.batch_modes = native_bridge.GetBatchModes();
+    
+    CefBrowserHost::CreateBrowser(window_info, g_client, startupUrl, browser_settings,
+                                  preload_options.ToDictionary(), nullptr);
+    StartupTrace::Mark("browser.create");
 
     // Log startup information
     Logger::LogMessage("=== SwipeIDE CEF + SDL Application ===");
     Logger::LogMessage("Mode: " + std::string(AppConfig::IsDebugMode() ? "DEBUG" : "RELEASE"));
     Logger::LogMessage("URL: " + startupUrl);
+    Logger::LogMessage("Message loop: " + std::string(use_multi_threaded_loop ? "multi-threaded" :
+                                                      (use_external_pump ? "external pump" : "polling")));
+    Logger::LogMessage("Rendering: " + std::string(headless ? "headless" : (offscreen ? "off-screen" : "windowed")));
     if (AppConfig::IsDebugMode()) {
         Logger::LogMessage("Remote debugging: http://localhost:9222");
         Logger::LogMessage("Make sure React dev server is running: cd renderer && bun run dev");
@@ -166,16 +352,54 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
     Logger::LogMessage("======================================");
 
     // Main loop
-    while (g_running) {
-        HandleSDLEvents();
-        CefDoMessageLoopWork();
-        SDL_Delay(1); // Small delay to prevent 100% CPU usage
+    if (use_multi_threaded_loop) {
+        RunMultiThreadedLoop();
+    } else if (use_external_pump) {
+        RunExternalPumpLoop();
+    } else {
+        while (g_running) {
+            HandleSDLEvents();
+            CefDoMessageLoopWork();
+            PresentFrame();
+            SDL_Delay(1); // Small delay to prevent 100% CPU usage
+        }
     }
 
     // Cleanup
+    native_bridge.Shutdown();
     CefShutdown();
-    SDL_DestroyWindow(g_sdl_window);
+    g_client = nullptr;
+    
+    if (g_osr_renderer) {
+        osr_renderer.LogStats();
+        osr_renderer.Cleanup();
+        g_osr_renderer = nullptr;
+    }
+    if (g_sdl_window) {
+        SDL_DestroyWindow(g_sdl_window);
+    }
     SDL_Quit();
 
     return 0;
-}
\ No newline at end of file
+}
+
+#ifdef _WIN32
+// Use WinMain instead of main for Windows applications without console
+int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow) {
+    AppConfig::ParseCommandLine(lpCmdLine ? lpCmdLine : "");
+    
+    CefMainArgs main_args(GetModuleHandle(nullptr));
+    return RunApplication(main_args);
+}
+#else
+int main(int argc, char* argv[]) {
+    std::string commandLine;
+    for (int i = 1; i < argc; ++i) {
+        commandLine += std::string(argv[i]) + " ";
+    }
+    AppConfig::ParseCommandLine(commandLine);
+    
+    CefMainArgs main_args(argc, argv);
+    return RunApplication(main_args);
+}
+#endif
@@ -0,0 +1,97 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace MikoIDE {
+    namespace Resources {
+        
+        // On-disk layout of an app.pak (all integers little-endian):
+        //
+        //   PackHeader
+        //   uint32_t displacement[bucket_count]   perfect-hash displacement table
+        //   PackEntry[entry_count]                ordered by perfect-hash slot
+        //   string table                          paths, MIME types, ETags
+        //   payloads                              each aligned to kPackPageSize
+        //
+        // A path is looked up with one hash of the key and one probe:
+        //   h    = PackHash(path, hash_seed)
+        //   slot = PackSlot(h, displacement[h % bucket_count]) % entry_count
+        // and confirmed by comparing the stored path. Payloads are served
+        // straight out of the mapping.
+        constexpr char kPackMagic[4] = {'M', 'K', 'P', 'K'};
+        constexpr uint32_t kPackVersion = 2;
+        constexpr uint32_t kPackPageSize = 4096;
+        
+        // Entry flags
+        constexpr uint32_t kPackEntryImmutable = 1u << 0;  // content-hashed file name
+        
+        // Stored encodings of one resource; identity is always present
+        enum PackEncoding : uint32_t {
+            kPackEncodingIdentity = 0,
+            kPackEncodingGzip = 1,
+            kPackEncodingBrotli = 2,
+            kPackEncodingCount = 3
+        };
+        
+#pragma pack(push, 1)
+        struct PackHeader {
+            char magic[4];
+            uint32_t version;
+            uint32_t entry_count;
+            uint32_t bucket_count;
+            uint64_t hash_seed;
+            uint64_t buckets_offset;
+            uint64_t entries_offset;
+            uint64_t reserved;
+        };
+        
+        struct PackVariant {
+            uint64_t offset;
+            uint64_t length;    // 0 when the encoding is not stored
+        };
+        
+        struct PackEntry {
+            uint32_t path_offset;
+            uint32_t path_length;
+            uint32_t mime_offset;
+            uint32_t mime_length;
+            uint32_t etag_offset;
+            uint32_t etag_length;
+            uint32_t flags;
+            uint32_t reserved;
+            PackVariant variants[kPackEncodingCount];
+        };
+#pragma pack(pop)
+        
+        // FNV-1a with a splitmix64 finalizer; also used for content ETags
+        inline uint64_t PackMix(uint64_t h) {
+            h ^= h >> 30;
+            h *= 0xbf58476d1ce4e5b9ULL;
+            h ^= h >> 27;
+            h *= 0x94d049bb133111ebULL;
+            h ^= h >> 31;
+            return h;
+        }
+        
+        inline uint64_t PackHash(const void* data, size_t size, uint64_t seed) {
+            const unsigned char* bytes = static_cast<const unsigned char*>(data);
+            uint64_t h = 0xcbf29ce484222325ULL ^ seed;
+            for (size_t i = 0; i < size; ++i) {
+                h ^= bytes[i];
+                h *= 0x100000001b3ULL;
+            }
+            return PackMix(h);
+        }
+        
+        inline uint64_t PackHash(std::string_view key, uint64_t seed) {
+            return PackHash(key.data(), key.size(), seed);
+        }
+        
+        // Second-level hash selecting the slot inside the entry table
+        inline uint64_t PackSlot(uint64_t hash, uint32_t displacement) {
+            return PackMix(hash ^ (static_cast<uint64_t>(displacement) * 0x9e3779b97f4a7c15ULL));
+        }
+        
+    }
+}
@@ -0,0 +1,278 @@
+#include "pack-writer.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace MikoIDE {
+    namespace Resources {
+        
+        namespace {
+            // Give up on a seed if one bucket cannot be placed after this many tries
+            constexpr uint32_t kMaxDisplacement = 1u << 20;
+            constexpr int kMaxSeeds = 64;
+            
+            uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+                return (value + alignment - 1) / alignment * alignment;
+            }
+            
+            std::string ToLower(std::string value) {
+                std::transform(value.begin(), value.end(), value.begin(),
+                               [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+                return value;
+            }
+        }
+        
+        PackWriter::PackWriter() {
+        }
+        
+        std::string PackWriter::GetMimeType(const std::string& path) {
+            static const std::map<std::string, std::string> kMimeTypes = {
+                {".html", "text/html"},
+                {".js", "text/javascript"},
+                {".mjs", "text/javascript"},
+                {".css", "text/css"},
+                {".json", "application/json"},
+                {".map", "application/json"},
+                {".svg", "image/svg+xml"},
+                {".png", "image/png"},
+                {".jpg", "image/jpeg"},
+                {".jpeg", "image/jpeg"},
+                {".gif", "image/gif"},
+                {".webp", "image/webp"},
+                {".ico", "image/x-icon"},
+                {".woff", "font/woff"},
+                {".woff2", "font/woff2"},
+                {".ttf", "font/ttf"},
+                {".wasm", "application/wasm"},
+                {".txt", "text/plain"},
+            };
+            
+            size_t dot = path.rfind('.');
+            if (dot != std::string::npos && path.find('/', dot) == std::string::npos) {
+                auto it = kMimeTypes.find(ToLower(path.substr(dot)));
+                if (it != kMimeTypes.end()) {
+                    return it->second;
+                }
+            }
+            return "application/octet-stream";
+        }
+        
+        bool PackWriter::IsCompressible(const std::string& mimeType) {
+            return mimeType.compare(0, 5, "text/") == 0 ||
+                   mimeType == "application/json" ||
+                   mimeType == "image/svg+xml" ||
+                   mimeType == "application/wasm";
+        }
+        
+        bool PackWriter::IsContentHashedName(const std::string& path) {
+            size_t slash = path.rfind('/');
+            std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+            
+            size_t dot = name.rfind('.');
+            size_t dash = name.rfind('-', dot);
+            if (dot == std::string::npos || dash == std::string::npos || dot - dash - 1 < 8) {
+                return false;
+            }
+            
+            for (size_t i = dash + 1; i < dot; ++i) {
+                unsigned char c = static_cast<unsigned char>(name[i]);
+                if (!std::isalnum(c) && c != '_' && c != '-') {
+                    return false;
+                }
+            }
+            return true;
+        }
+        
+        void PackWriter::AddFile(const std::string& path, std::vector<uint8_t> data) {
+            File& file = files_[path];
+            file.mime_type = GetMimeType(path);
+            file.flags = IsContentHashedName(path) ? kPackEntryImmutable : 0;
+            
+            char etag[32];
+            snprintf(etag, sizeof(etag), "\"%016llx\"",
+                     static_cast<unsigned long long>(PackHash(data.data(), data.size(), 0)));
+            file.etag = etag;
+            file.variants[kPackEncodingIdentity] = std::move(data);
+        }
+        
+        bool PackWriter::AddVariant(const std::string& path, PackEncoding encoding, std::vector<uint8_t> data) {
+            auto it = files_.find(path);
+            if (it == files_.end() || encoding == kPackEncodingIdentity || encoding >= kPackEncodingCount) {
+                return false;
+            }
+            it->second.variants[encoding] = std::move(data);
+            return true;
+        }
+        
+        bool PackWriter::HasFile(const std::string& path) const {
+            return files_.count(path) != 0;
+        }
+        
+        bool PackWriter::BuildIndex(uint64_t seed, uint32_t bucketCount,
+                                    std::vector<uint32_t>& displacements,
+                                    std::vector<const std::string*>& slots) const {
+            const size_t count = files_.size();
+            
+            std::vector<std::vector<std::pair<const std::string*, uint64_t>>> buckets(bucketCount);
+            for (const auto& file : files_) {
+                uint64_t hash = PackHash(file.first, seed);
+                buckets[hash % bucketCount].emplace_back(&file.first, hash);
+            }
+            
+            // Place the most crowded buckets first, while most slots are free
+            std::vector<uint32_t> order(bucketCount);
+            for (uint32_t i = 0; i < bucketCount; ++i) {
+                order[i] = i;
+            }
+            std::stable_sort(order.begin(), order.end(), [&buckets](uint32_t a, uint32_t b) {
+                return buckets[a].size() > buckets[b].size();
+            });
+            
+            displacements.assign(bucketCount, 0);
+            slots.assign(count, nullptr);
+            std::vector<size_t> candidate;
+            
+            for (uint32_t bucket : order) {
+                const auto& keys = buckets[bucket];
+                if (keys.empty()) {
+                    break;
+                }
+                
+                bool placed = false;
+                for (uint32_t displacement = 0; displacement < kMaxDisplacement && !placed; ++displacement) {
+                    candidate.clear();
+                    placed = true;
+                    for (const auto& key : keys) {
+                        size_t slot = PackSlot(key.second, displacement) % count;
+                        if (slots[slot] || std::find(candidate.begin(), candidate.end(), slot) != candidate.end()) {
+                            placed = false;
+                            break;
+                        }
+                        candidate.push_back(slot);
+                    }
+                    
+                    if (placed) {
+                        displacements[bucket] = displacement;
+                        for (size_t i = 0; i < keys.size(); ++i) {
+                            slots[candidate[i]] = keys[i].first;
+                        }
+                    }
+                }
+                
+                if (!placed) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        
+        bool PackWriter::Write(const std::string& outputPath, std::string& error) const {
+            const uint32_t count = static_cast<uint32_t>(files_.size());
+            const uint32_t bucketCount = std::max<uint32_t>(1, (count + 1) / 2);
+            
+            std::vector<uint32_t> displacements;
+            std::vector<const std::string*> slots;
+            uint64_t seed = 0;
+            bool indexed = count == 0;
+            for (int attempt = 0; attempt < kMaxSeeds && !indexed; ++attempt) {
+                seed = PackMix(0x4d4b504bULL + attempt);
+                indexed = BuildIndex(seed, bucketCount, displacements, slots);
+            }
+            if (!indexed) {
+                error = "could not build a perfect hash for " + std::to_string(count) + " paths";
+                return false;
+            }
+            
+            PackHeader header;
+            memset(&header, 0, sizeof(header));
+            memcpy(header.magic, kPackMagic, sizeof(kPackMagic));
+            header.version = kPackVersion;
+            header.entry_count = count;
+            header.bucket_count = count == 0 ? 0 : bucketCount;
+            header.hash_seed = seed;
+            header.buckets_offset = sizeof(PackHeader);
+            header.entries_offset = AlignUp(header.buckets_offset + header.bucket_count * sizeof(uint32_t), 8);
+            
+            // String table right after the index, then page-aligned payloads
+            std::vector<PackEntry> entries(count);
+            std::string strings;
+            uint64_t stringsOffset = header.entries_offset + static_cast<uint64_t>(count) * sizeof(PackEntry);
+            auto placeString = [&strings, stringsOffset](const std::string& value, uint32_t& offset, uint32_t& length) {
+                offset = static_cast<uint32_t>(stringsOffset + strings.size());
+                length = static_cast<uint32_t>(value.size());
+                strings += value;
+            };
+            
+            uint64_t dataOffset = AlignUp(stringsOffset, kPackPageSize);
+            std::vector<std::pair<uint64_t, const std::vector<uint8_t>*>> payloads;
+            
+            for (uint32_t slot = 0; slot < count; ++slot) {
+                const std::string& path = *slots[slot];
+                const File& file = files_.at(path);
+                PackEntry& entry = entries[slot];
+                memset(&entry, 0, sizeof(entry));
+                
+                placeString(path, entry.path_offset, entry.path_length);
+                placeString(file.mime_type, entry.mime_offset, entry.mime_length);
+                placeString(file.etag, entry.etag_offset, entry.etag_length);
+                entry.flags = file.flags;
+                
+                for (uint32_t encoding = 0; encoding < kPackEncodingCount; ++encoding) {
+                    const std::vector<uint8_t>& data = file.variants[encoding];
+                    if (data.empty() && encoding != kPackEncodingIdentity) {
+                        continue;
+                    }
+                    entry.variants[encoding].offset = dataOffset;
+                    entry.variants[encoding].length = data.size();
+                    payloads.emplace_back(dataOffset, &data);
+                    dataOffset = AlignUp(dataOffset + data.size(), kPackPageSize);
+                }
+            }
+            
+            if (stringsOffset + strings.size() > UINT32_MAX) {
+                error = "string table too large";
+                return false;
+            }
+            
+            std::ofstream out(outputPath, std::ios::binary | std::ios::trunc);
+            if (!out.is_open()) {
+                error = "cannot write " + outputPath;
+                return false;
+            }
+            
+            std::vector<char> padding(kPackPageSize, 0);
+            auto padTo = [&out, &padding](uint64_t offset) {
+                uint64_t position = static_cast<uint64_t>(out.tellp());
+                while (position < offset) {
+                    uint64_t chunk = std::min<uint64_t>(offset - position, padding.size());
+                    out.write(padding.data(), static_cast<std::streamsize>(chunk));
+                    position += chunk;
+                }
+            };
+            
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char*>(displacements.data()),
+                      static_cast<std::streamsize>(header.bucket_count * sizeof(uint32_t)));
+            padTo(header.entries_offset);
+            out.write(reinterpret_cast<const char*>(entries.data()),
+                      static_cast<std::streamsize>(entries.size() * sizeof(PackEntry)));
+            out.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+            
+            for (const auto& payload : payloads) {
+                padTo(payload.first);
+                out.write(reinterpret_cast<const char*>(payload.second->data()),
+                          static_cast<std::streamsize>(payload.second->size()));
+            }
+            padTo(dataOffset);
+            
+            if (!out.good()) {
+                error = "write failed for " + outputPath;
+                return false;
+            }
+            return true;
+        }
+        
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "pack-format.hpp"
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace MikoIDE {
+    namespace Resources {
+        
+        // Builds an app.pak: assigns every path a perfect-hash slot, computes
+        // MIME types, immutability and content-hash ETags, and lays payloads
+        // out on page boundaries.
+        class PackWriter {
+        public:
+            PackWriter();
+            
+            // Adds the identity encoding of |path| (forward slashes, no leading slash)
+            void AddFile(const std::string& path, std::vector<uint8_t> data);
+            
+            // Adds a precompressed variant; |path| must already have been added
+            bool AddVariant(const std::string& path, PackEncoding encoding, std::vector<uint8_t> data);
+            
+            bool HasFile(const std::string& path) const;
+            size_t GetFileCount() const { return files_.size(); }
+            
+            bool Write(const std::string& outputPath, std::string& error) const;
+            
+            static std::string GetMimeType(const std::string& path);
+            static bool IsCompressible(const std::string& mimeType);
+            
+            // Vite emits content-hashed names such as assets/index-BX2k3jd9.js
+            static bool IsContentHashedName(const std::string& path);
+            
+        private:
+            struct File {
+                std::string mime_type;
+                std::string etag;
+                uint32_t flags = 0;
+                std::vector<uint8_t> variants[kPackEncodingCount];
+            };
+            
+            // Perfect-hash layout: |slots| maps slot -> path, |displacements| per bucket
+            bool BuildIndex(uint64_t seed, uint32_t bucketCount,
+                            std::vector<uint32_t>& displacements,
+                            std::vector<const std::string*>& slots) const;
+            
+            std::map<std::string, File> files_;
+        };
+        
+    }
+}
@@ -0,0 +1,186 @@
+#include "resource-pack.hpp"
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace MikoIDE {
+    namespace Resources {
+        
+        ResourcePack::ResourcePack()
+            : base_(nullptr), size_(0), header_(nullptr), buckets_(nullptr),
+              entries_(nullptr), entry_count_(0)
+#ifdef _WIN32
+            , file_handle_(INVALID_HANDLE_VALUE)
+            , mapping_handle_(nullptr)
+#else
+            , fd_(-1)
+#endif
+        {
+        }
+        
+        ResourcePack::~ResourcePack() {
+            Close();
+        }
+        
+        bool ResourcePack::Fail(const std::string& error) {
+            Close();
+            last_error_ = error;
+            return false;
+        }
+        
+        bool ResourcePack::Open(const std::string& path) {
+            Close();
+            last_error_.clear();
+            
+#ifdef _WIN32
+            file_handle_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                       OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file_handle_ == INVALID_HANDLE_VALUE) {
+                return Fail("cannot open " + path);
+            }
+            
+            LARGE_INTEGER file_size;
+            if (!GetFileSizeEx(file_handle_, &file_size) || file_size.QuadPart == 0) {
+                return Fail("empty pack " + path);
+            }
+            size_ = static_cast<size_t>(file_size.QuadPart);
+            
+            mapping_handle_ = CreateFileMappingA(file_handle_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping_handle_) {
+                base_ = static_cast<const uint8_t*>(MapViewOfFile(mapping_handle_, FILE_MAP_READ, 0, 0, 0));
+            }
+#else
+            fd_ = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd_ == -1) {
+                return Fail("cannot open " + path);
+            }
+            
+            struct stat st;
+            if (fstat(fd_, &st) == -1 || st.st_size == 0) {
+                return Fail("empty pack " + path);
+            }
+            size_ = static_cast<size_t>(st.st_size);
+            
+            void* mapping = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd_, 0);
+            base_ = mapping == MAP_FAILED ? nullptr : static_cast<const uint8_t*>(mapping);
+#endif
+            
+            if (!base_) {
+                return Fail("cannot map " + path);
+            }
+            return Validate();
+        }
+        
+        void ResourcePack::Close() {
+#ifdef _WIN32
+            if (base_) {
+                UnmapViewOfFile(base_);
+            }
+            if (mapping_handle_) {
+                CloseHandle(mapping_handle_);
+                mapping_handle_ = nullptr;
+            }
+            if (file_handle_ != INVALID_HANDLE_VALUE) {
+                CloseHandle(file_handle_);
+                file_handle_ = INVALID_HANDLE_VALUE;
+            }
+#else
+            if (base_) {
+                munmap(const_cast<uint8_t*>(base_), size_);
+            }
+            if (fd_ != -1) {
+                close(fd_);
+                fd_ = -1;
+            }
+#endif
+            base_ = nullptr;
+            size_ = 0;
+            header_ = nullptr;
+            buckets_ = nullptr;
+            entries_ = nullptr;
+            entry_count_ = 0;
+        }
+        
+        bool ResourcePack::Validate() {
+            if (size_ < sizeof(PackHeader)) {
+                return Fail("truncated header");
+            }
+            
+            const PackHeader* header = reinterpret_cast<const PackHeader*>(base_);
+            if (memcmp(header->magic, kPackMagic, sizeof(kPackMagic)) != 0) {
+                return Fail("not a resource pack");
+            }
+            if (header->version != kPackVersion) {
+                return Fail("unsupported pack version " + std::to_string(header->version));
+            }
+            if (header->entry_count > 0 && header->bucket_count == 0) {
+                return Fail("missing hash buckets");
+            }
+            
+            uint64_t buckets_end = header->buckets_offset + static_cast<uint64_t>(header->bucket_count) * sizeof(uint32_t);
+            uint64_t entries_end = header->entries_offset + static_cast<uint64_t>(header->entry_count) * sizeof(PackEntry);
+            if (buckets_end > size_ || entries_end > size_ ||
+                header->buckets_offset % alignof(uint32_t) != 0) {
+                return Fail("index out of bounds");
+            }
+            
+            // Reject entries pointing outside the file once, so lookups need no checks
+            const PackEntry* entries = reinterpret_cast<const PackEntry*>(base_ + header->entries_offset);
+            for (uint32_t i = 0; i < header->entry_count; ++i) {
+                const PackEntry& entry = entries[i];
+                if (static_cast<uint64_t>(entry.path_offset) + entry.path_length > size_ ||
+                    static_cast<uint64_t>(entry.mime_offset) + entry.mime_length > size_ ||
+                    static_cast<uint64_t>(entry.etag_offset) + entry.etag_length > size_) {
+                    return Fail("string out of bounds");
+                }
+                for (const PackVariant& variant : entry.variants) {
+                    if (variant.offset > size_ || variant.length > size_ - variant.offset) {
+                        return Fail("payload out of bounds");
+                    }
+                }
+            }
+            
+            header_ = header;
+            buckets_ = reinterpret_cast<const uint32_t*>(base_ + header->buckets_offset);
+            entries_ = entries;
+            entry_count_ = header->entry_count;
+            return true;
+        }
+        
+        std::string_view ResourcePack::GetString(uint32_t offset, uint32_t length) const {
+            return std::string_view(reinterpret_cast<const char*>(base_ + offset), length);
+        }
+        
+        bool ResourcePack::Find(std::string_view path, PackResource& resource) const {
+            if (!base_ || entry_count_ == 0) {
+                return false;
+            }
+            
+            uint64_t hash = PackHash(path, header_->hash_seed);
+            uint32_t displacement = buckets_[hash % header_->bucket_count];
+            const PackEntry& entry = entries_[PackSlot(hash, displacement) % entry_count_];
+            
+            // Every key maps to some slot; only a stored match is a hit
+            if (GetString(entry.path_offset, entry.path_length) != path) {
+                return false;
+            }
+            
+            for (uint32_t i = 0; i < kPackEncodingCount; ++i) {
+                resource.variants[i].data = base_ + entry.variants[i].offset;
+                resource.variants[i].size = static_cast<size_t>(entry.variants[i].length);
+            }
+            resource.mime_type = GetString(entry.mime_offset, entry.mime_length);
+            resource.etag = GetString(entry.etag_offset, entry.etag_length);
+            resource.immutable = (entry.flags & kPackEntryImmutable) != 0;
+            return true;
+        }
+        
+    }
+}
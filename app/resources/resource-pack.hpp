@@ -0,0 +1,69 @@
+#pragma once
+#include "pack-format.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace MikoIDE {
+    namespace Resources {
+        
+        // A resource inside a mapped pack; valid while the pack stays open
+        struct PackResource {
+            struct Variant {
+                const uint8_t* data = nullptr;
+                size_t size = 0;
+            };
+            
+            // Indexed by PackEncoding; size 0 means the encoding is not stored
+            Variant variants[kPackEncodingCount];
+            std::string_view mime_type;
+            std::string_view etag;
+            bool immutable = false;
+            
+            const uint8_t* data() const { return variants[kPackEncodingIdentity].data; }
+            size_t size() const { return variants[kPackEncodingIdentity].size; }
+        };
+        
+        // Read-only, memory-mapped view of an app.pak
+        class ResourcePack {
+        public:
+            ResourcePack();
+            ~ResourcePack();
+            
+            ResourcePack(const ResourcePack&) = delete;
+            ResourcePack& operator=(const ResourcePack&) = delete;
+            
+            bool Open(const std::string& path);
+            void Close();
+            bool IsOpen() const { return base_ != nullptr; }
+            
+            // Looks up |path| (no leading slash); returns false if it is not packed
+            bool Find(std::string_view path, PackResource& resource) const;
+            
+            size_t GetEntryCount() const { return entry_count_; }
+            const std::string& GetLastError() const { return last_error_; }
+            
+        private:
+            bool Validate();
+            bool Fail(const std::string& error);
+            std::string_view GetString(uint32_t offset, uint32_t length) const;
+            
+            const uint8_t* base_;
+            size_t size_;
+            const PackHeader* header_;
+            const uint32_t* buckets_;
+            const PackEntry* entries_;
+            uint32_t entry_count_;
+            std::string last_error_;
+            
+#ifdef _WIN32
+            void* file_handle_;
+            void* mapping_handle_;
+#else
+            int fd_;
+#endif
+        };
+        
+    }
+}
@@ -0,0 +1,335 @@
+#include "scheme-handler.hpp"
+#include "../core/logger.hpp"
+#include "include/cef_parser.h"
+#include "include/wrapper/cef_helpers.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace MikoIDE {
+    namespace Resources {
+        
+        namespace {
+            // Content-hashed bundle files never change under the same URL
+            constexpr const char* kImmutableCacheControl = "public, max-age=31536000, immutable";
+            // Everything else (index.html) is revalidated against its ETag
+            constexpr const char* kRevalidateCacheControl = "no-cache";
+            
+            int HexValue(char c) {
+                if (c >= '0' && c <= '9') {
+                    return c - '0';
+                }
+                if (c >= 'a' && c <= 'f') {
+                    return c - 'a' + 10;
+                }
+                if (c >= 'A' && c <= 'F') {
+                    return c - 'A' + 10;
+                }
+                return -1;
+            }
+            
+            // Pack entries are stored under their decoded names, so
+            // "my%20file.svg" finds "my file.svg". False on a malformed escape.
+            bool PercentDecode(const std::string& text, std::string& decoded) {
+                decoded.clear();
+                decoded.reserve(text.size());
+                for (size_t i = 0; i < text.size(); ++i) {
+                    if (text[i] != '%') {
+                        decoded.push_back(text[i]);
+                        continue;
+                    }
+                    const int high = i + 2 < text.size() ? HexValue(text[i + 1]) : -1;
+                    const int low = high >= 0 ? HexValue(text[i + 2]) : -1;
+                    if (low < 0 || (high == 0 && low == 0)) {
+                        return false;
+                    }
+                    decoded.push_back(static_cast<char>(high * 16 + low));
+                    i += 2;
+                }
+                return true;
+            }
+            
+            std::string GetRequestPath(const CefString& url) {
+                CefURLParts parts;
+                if (!CefParseURL(url, parts)) {
+                    return "";
+                }
+                
+                std::string path;
+                if (!PercentDecode(CefString(&parts.path).ToString(), path)) {
+                    return "";
+                }
+                path.erase(0, path.find_first_not_of('/'));
+                return path.empty() ? "index.html" : path;
+            }
+            
+            // If-None-Match is "*" or a list of entity tags, each possibly
+            // weak (W/"..."); it uses the weak comparison, so W/ is ignored
+            bool MatchesETag(const std::string& header, std::string_view etag) {
+                size_t i = 0;
+                while (i < header.size()) {
+                    while (i < header.size() && (header[i] == ' ' || header[i] == '\t' || header[i] == ',')) {
+                        ++i;
+                    }
+                    if (i == header.size()) {
+                        break;
+                    }
+                    if (header[i] == '*') {
+                        return true;
+                    }
+                    if (header.compare(i, 2, "W/") == 0) {
+                        i += 2;
+                    }
+                    // Commas may appear inside the quotes
+                    size_t end = header[i] == '"' ? header.find('"', i + 1) : header.find(',', i);
+                    if (end == std::string::npos) {
+                        end = header.size();
+                    } else if (header[i] == '"') {
+                        ++end;
+                    }
+                    if (std::string_view(header).substr(i, end - i) == etag) {
+                        return true;
+                    }
+                    i = end;
+                }
+                return false;
+            }
+            
+            const char* GetEncodingName(PackEncoding encoding) {
+                switch (encoding) {
+                    case kPackEncodingGzip:
+                        return "gzip";
+                    case kPackEncodingBrotli:
+                        return "br";
+                    default:
+                        return "identity";
+                }
+            }
+            
+            // Token match on a comma separated header; q=0 explicitly refuses an encoding
+            bool AcceptsEncoding(const std::string& header, const std::string& name) {
+                size_t start = 0;
+                while (start < header.size()) {
+                    size_t end = header.find(',', start);
+                    if (end == std::string::npos) {
+                        end = header.size();
+                    }
+                    
+                    std::string token = header.substr(start, end - start);
+                    size_t first = token.find_first_not_of(' ');
+                    size_t semicolon = token.find(';');
+                    std::string coding = first == std::string::npos ? "" : token.substr(first, semicolon - first);
+                    coding.erase(coding.find_last_not_of(' ') + 1);
+                    
+                    if (coding == name || coding == "*") {
+                        size_t q = token.find("q=", semicolon == std::string::npos ? token.size() : semicolon);
+                        return q == std::string::npos || std::strtod(token.c_str() + q + 2, nullptr) > 0.0;
+                    }
+                    start = end + 1;
+                }
+                return false;
+            }
+        }
+        
+        // PackResourceHandler implementation
+        PackResourceHandler::PackResourceHandler(std::shared_ptr<const ResourcePack> pack)
+            : pack_(pack), encoding_(kPackEncodingIdentity), status_(404), offset_(0), end_(0) {
+        }
+        
+        bool PackResourceHandler::Open(CefRefPtr<CefRequest> request,
+                                       bool& handle_request,
+                                       CefRefPtr<CefCallback> callback) {
+            // Everything is answered synchronously from the mapping
+            handle_request = true;
+            
+            if (!pack_->Find(GetRequestPath(request->GetURL()), resource_)) {
+                status_ = 404;
+                return true;
+            }
+            
+            std::string if_none_match = request->GetHeaderByName("If-None-Match").ToString();
+            if (!if_none_match.empty() && MatchesETag(if_none_match, resource_.etag)) {
+                status_ = 304;
+                return true;
+            }
+            
+            offset_ = 0;
+            end_ = resource_.size();
+            status_ = 200;
+            encoding_ = kPackEncodingIdentity;
+            
+            std::string range = request->GetHeaderByName("Range").ToString();
+            if (range.empty()) {
+                // Ranges always address the identity bytes, so only full
+                // responses may switch to a compressed variant
+                encoding_ = SelectEncoding(request->GetHeaderByName("Accept-Encoding").ToString());
+                end_ = resource_.variants[encoding_].size;
+            } else {
+                size_t first = 0;
+                size_t last = 0;
+                if (!ParseRange(range, resource_.size(), first, last)) {
+                    status_ = 416;
+                    return true;
+                }
+                offset_ = first;
+                end_ = last + 1;
+                status_ = 206;
+            }
+            return true;
+        }
+        
+        PackEncoding PackResourceHandler::SelectEncoding(const std::string& acceptEncoding) const {
+            PackEncoding selected = kPackEncodingIdentity;
+            if (acceptEncoding.empty()) {
+                return selected;
+            }
+            
+            for (PackEncoding encoding : {kPackEncodingBrotli, kPackEncodingGzip}) {
+                const PackResource::Variant& variant = resource_.variants[encoding];
+                if (variant.size > 0 && variant.size < resource_.variants[selected].size &&
+                    AcceptsEncoding(acceptEncoding, GetEncodingName(encoding))) {
+                    selected = encoding;
+                }
+            }
+            return selected;
+        }
+        
+        bool PackResourceHandler::ParseRange(const std::string& header, size_t size,
+                                             size_t& first, size_t& last) const {
+            const std::string prefix = "bytes=";
+            if (header.compare(0, prefix.size(), prefix) != 0 || size == 0 ||
+                header.find(',') != std::string::npos) {
+                return false;
+            }
+            
+            std::string spec = header.substr(prefix.size());
+            size_t dash = spec.find('-');
+            if (dash == std::string::npos) {
+                return false;
+            }
+            
+            std::string start = spec.substr(0, dash);
+            std::string stop = spec.substr(dash + 1);
+            
+            if (start.empty()) {
+                // Suffix range: the last N bytes
+                size_t suffix = static_cast<size_t>(std::strtoull(stop.c_str(), nullptr, 10));
+                if (suffix == 0) {
+                    return false;
+                }
+                first = size - std::min(suffix, size);
+                last = size - 1;
+                return true;
+            }
+            
+            first = static_cast<size_t>(std::strtoull(start.c_str(), nullptr, 10));
+            last = stop.empty() ? size - 1 : static_cast<size_t>(std::strtoull(stop.c_str(), nullptr, 10));
+            last = std::min(last, size - 1);
+            return first <= last;
+        }
+        
+        void PackResourceHandler::GetResponseHeaders(CefRefPtr<CefResponse> response,
+                                                     int64_t& response_length,
+                                                     CefString& redirectUrl) {
+            response->SetStatus(status_);
+            
+            CefResponse::HeaderMap headers;
+            switch (status_) {
+                case 404:
+                    response->SetStatusText("Not Found");
+                    response_length = 0;
+                    return;
+                case 416:
+                    response->SetStatusText("Range Not Satisfiable");
+                    headers.insert(std::make_pair("Content-Range", "bytes */" + std::to_string(resource_.size())));
+                    response->SetHeaderMap(headers);
+                    response_length = 0;
+                    return;
+                case 304:
+                    response->SetStatusText("Not Modified");
+                    response_length = 0;
+                    break;
+                case 206:
+                    response->SetStatusText("Partial Content");
+                    headers.insert(std::make_pair("Content-Range", "bytes " + std::to_string(offset_) + "-" +
+                                                  std::to_string(end_ - 1) + "/" + std::to_string(resource_.size())));
+                    response_length = static_cast<int64_t>(end_ - offset_);
+                    break;
+                default:
+                    response->SetStatusText("OK");
+                    response_length = static_cast<int64_t>(end_);
+                    break;
+            }
+            
+            response->SetMimeType(std::string(resource_.mime_type));
+            headers.insert(std::make_pair("ETag", std::string(resource_.etag)));
+            headers.insert(std::make_pair("Cache-Control",
+                                          resource_.immutable ? kImmutableCacheControl : kRevalidateCacheControl));
+            headers.insert(std::make_pair("Accept-Ranges", "bytes"));
+            headers.insert(std::make_pair("Vary", "Accept-Encoding"));
+            if (status_ == 200 && encoding_ != kPackEncodingIdentity) {
+                headers.insert(std::make_pair("Content-Encoding", GetEncodingName(encoding_)));
+            }
+            response->SetHeaderMap(headers);
+        }
+        
+        bool PackResourceHandler::Skip(int64_t bytes_to_skip,
+                                       int64_t& bytes_skipped,
+                                       CefRefPtr<CefResourceSkipCallback> callback) {
+            size_t skip = std::min(static_cast<size_t>(bytes_to_skip), end_ - offset_);
+            offset_ += skip;
+            bytes_skipped = static_cast<int64_t>(skip);
+            return skip > 0;
+        }
+        
+        bool PackResourceHandler::Read(void* data_out,
+                                       int bytes_to_read,
+                                       int& bytes_read,
+                                       CefRefPtr<CefResourceReadCallback> callback) {
+            bytes_read = 0;
+            if (status_ != 200 && status_ != 206) {
+                return false;
+            }
+            
+            size_t count = std::min(static_cast<size_t>(bytes_to_read), end_ - offset_);
+            if (count == 0) {
+                return false;
+            }
+            
+            memcpy(data_out, resource_.variants[encoding_].data + offset_, count);
+            offset_ += count;
+            bytes_read = static_cast<int>(count);
+            return true;
+        }
+        
+        void PackResourceHandler::Cancel() {
+            offset_ = end_;
+        }
+        
+        // PackSchemeHandlerFactory implementation
+        PackSchemeHandlerFactory::PackSchemeHandlerFactory(std::shared_ptr<const ResourcePack> pack)
+            : pack_(pack) {
+        }
+        
+        CefRefPtr<CefResourceHandler> PackSchemeHandlerFactory::Create(CefRefPtr<CefBrowser> browser,
+                                                                       CefRefPtr<CefFrame> frame,
+                                                                       const CefString& scheme_name,
+                                                                       CefRefPtr<CefRequest> request) {
+            return new PackResourceHandler(pack_);
+        }
+        
+        bool PackSchemeHandlerFactory::Register(const std::string& packPath) {
+            CEF_REQUIRE_UI_THREAD();
+            
+            auto pack = std::make_shared<ResourcePack>();
+            if (!pack->Open(packPath)) {
+                Logger::LogMessage("Resource pack error: " + pack->GetLastError());
+                return false;
+            }
+            
+            return CefRegisterSchemeHandlerFactory(kAppScheme, kAppHost,
+                                                   new PackSchemeHandlerFactory(pack));
+        }
+        
+    }
+}
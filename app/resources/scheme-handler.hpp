@@ -0,0 +1,73 @@
+#pragma once
+#include "include/cef_resource_handler.h"
+#include "include/cef_scheme.h"
+#include "resource-pack.hpp"
+#include <memory>
+
+namespace MikoIDE {
+    namespace Resources {
+        
+        // Custom scheme the UI bundle is served from, e.g. miko://app/index.html
+        constexpr const char* kAppScheme = "miko";
+        constexpr const char* kAppHost = "app";
+        
+        // Serves a single packed resource. Reads copy straight from the mapped
+        // pack into CEF's buffer; conditional (If-None-Match) and single-range
+        // (Range: bytes=...) requests are answered without touching the payload.
+        // Precompressed br/gzip variants are served when Accept-Encoding allows.
+        class PackResourceHandler : public CefResourceHandler {
+        public:
+            explicit PackResourceHandler(std::shared_ptr<const ResourcePack> pack);
+            
+            bool Open(CefRefPtr<CefRequest> request,
+                      bool& handle_request,
+                      CefRefPtr<CefCallback> callback) override;
+            void GetResponseHeaders(CefRefPtr<CefResponse> response,
+                                    int64_t& response_length,
+                                    CefString& redirectUrl) override;
+            bool Skip(int64_t bytes_to_skip,
+                      int64_t& bytes_skipped,
+                      CefRefPtr<CefResourceSkipCallback> callback) override;
+            bool Read(void* data_out,
+                      int bytes_to_read,
+                      int& bytes_read,
+                      CefRefPtr<CefResourceReadCallback> callback) override;
+            void Cancel() override;
+            
+        private:
+            // Parses a single "bytes=first-last" range; returns false if unsatisfiable
+            bool ParseRange(const std::string& header, size_t size, size_t& first, size_t& last) const;
+            
+            // Picks the smallest stored encoding the client accepts
+            PackEncoding SelectEncoding(const std::string& acceptEncoding) const;
+            
+            std::shared_ptr<const ResourcePack> pack_;
+            PackResource resource_;
+            PackEncoding encoding_;
+            int status_;
+            size_t offset_;
+            size_t end_;
+            
+            IMPLEMENT_REFCOUNTING(PackResourceHandler);
+        };
+        
+        class PackSchemeHandlerFactory : public CefSchemeHandlerFactory {
+        public:
+            explicit PackSchemeHandlerFactory(std::shared_ptr<const ResourcePack> pack);
+            
+            CefRefPtr<CefResourceHandler> Create(CefRefPtr<CefBrowser> browser,
+                                                 CefRefPtr<CefFrame> frame,
+                                                 const CefString& scheme_name,
+                                                 CefRefPtr<CefRequest> request) override;
+            
+            // Maps |packPath| and registers the factory for miko://app/.
+            // Must be called on the browser process UI thread.
+            static bool Register(const std::string& packPath);
+            
+        private:
+            std::shared_ptr<const ResourcePack> pack_;
+            IMPLEMENT_REFCOUNTING(PackSchemeHandlerFactory);
+        };
+        
+    }
+}
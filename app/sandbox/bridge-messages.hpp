@@ -0,0 +1,82 @@
+#pragma once
+#include <cstdint>
+
+namespace MikoIDE {
+    namespace Sandbox {
+        
+        // Process messages exchanged between ExtensionSandbox (renderer) and
+        // NativeBridge (browser). Argument lists are CefListValues encoded by
+        // ValueCodec.
+        
+        // renderer -> browser: [request id, function id, args...]
+        // where the function id indexes NativeBridge::GetFunctionNames()
+        constexpr const char* kNativeCallMessage = "MikoIDE.Call";
+        
+        // browser -> renderer: [request id, succeeded, result | error string]
+        constexpr const char* kNativeResultMessage = "MikoIDE.Result";
+        
+        // renderer -> browser: [request id, [[function id, [args...]], ...]]
+        // Calls run in order; the kNativeResultMessage value is a list of
+        // [succeeded, result | error string], one per call.
+        constexpr const char* kNativeBatchMessage = "MikoIDE.Batch";
+        
+        // How the preload queues calls to a function before sending them as
+        // one kNativeBatchMessage. A microtask flush also takes any queued
+        // AnimationFrame calls, and a plain call flushes the queue before it is
+        // sent, so order across functions is preserved.
+        enum class BatchMode {
+            None = 0,           // one message per call
+            Microtask = 1,      // flushed when the current task's microtasks run
+            AnimationFrame = 2  // flushed before the next frame
+        };
+        
+        // Bulk streams (see StreamChannel): only these small notifications
+        // cross IPC, the bytes travel through a shared-memory ring.
+        
+        // renderer -> browser: [] this render process has no ring for the
+        // browser yet: the first page, or a new process after a crash or a
+        // cross-process navigation. The browser replaces the browser's ring.
+        constexpr const char* kStreamRequestMessage = "MikoIDE.StreamRequest";
+        
+        // browser -> renderer: [ring name]
+        constexpr const char* kStreamOpenMessage = "MikoIDE.StreamOpen";
+        
+        // browser -> renderer: [] new records are in the ring
+        constexpr const char* kStreamDoorbellMessage = "MikoIDE.StreamDoorbell";
+        
+        // renderer -> browser: [] a full ring was drained; resume writing
+        constexpr const char* kStreamDrainedMessage = "MikoIDE.StreamDrained";
+        
+        // Stream ids below this are reserved; NativeBridge::AllocateStreamId()
+        // hands out the rest
+        constexpr uint32_t kTerminalOutputStream = 0;
+        
+        // kTerminalOutputStream records, dispatched to window.onTerminalOutput:
+        // [uint8 type][uint8 id length][terminal id][data], where exit records
+        // carry the int32 exit code as their data and screen records a
+        // Utils::VtScreen diff. Diagnostics records carry [uint32 count], then
+        // per Utils::Diagnostic [uint8 severity][uint32 line][uint32 column]
+        // and the file, code and message, each as [uint32 length][UTF-8].
+        // Resources records carry [uint32 CPU per mille of one core][uint32
+        // RSS KiB][uint32 threads][uint32 processes] for the terminal's
+        // process tree (see TerminalResourceMonitor).
+        constexpr uint8_t kTerminalRecordOutput = 0;
+        constexpr uint8_t kTerminalRecordError = 1;
+        constexpr uint8_t kTerminalRecordExit = 2;
+        constexpr uint8_t kTerminalRecordScreen = 3;
+        constexpr uint8_t kTerminalRecordDiagnostics = 4;
+        constexpr uint8_t kTerminalRecordResources = 5;
+        
+        // Terminal search results, on the stream id "searchTerminals" returned
+        // and so through window.onNativeStream:
+        //   matches: [uint8 0][uint8 id length][terminal id][uint32 count], then
+        //            per match [float64 line][uint32 column][uint32 length]
+        //            [uint32 text length][line text]; columns and lengths are
+        //            byte offsets into the line's UTF-8 text
+        //   done:    [uint8 1][uint32 match count][uint8 flags], the last record
+        constexpr uint8_t kSearchRecordMatches = 0;
+        constexpr uint8_t kSearchRecordDone = 1;
+        constexpr uint8_t kSearchFlagCancelled = 1;
+        constexpr uint8_t kSearchFlagTruncated = 2;
+    }
+}
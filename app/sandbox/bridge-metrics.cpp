@@ -0,0 +1,59 @@
+#include "bridge-metrics.hpp"
+
+namespace MikoIDE {
+    namespace Sandbox {
+        
+        namespace {
+            double ToMicroseconds(uint64_t nanoseconds) {
+                return static_cast<double>(nanoseconds) / 1000.0;
+            }
+        }
+        
+        BridgeMetrics& BridgeMetrics::GetInstance() {
+            static BridgeMetrics instance;
+            return instance;
+        }
+        
+        void BridgeMetrics::Record(const std::string& name, Clock::duration elapsed,
+                                   size_t argumentBytes, bool threw) {
+            const int64_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+            
+            std::lock_guard<std::mutex> lock(mutex_);
+            FunctionMetrics& metrics = functions_[name];
+            metrics.latency.Record(nanoseconds > 0 ? static_cast<uint64_t>(nanoseconds) : 0);
+            metrics.argument_bytes += argumentBytes;
+            if (threw) {
+                ++metrics.exceptions;
+            }
+        }
+        
+        CefRefPtr<CefValue> BridgeMetrics::Snapshot() {
+            CefRefPtr<CefDictionaryValue> snapshot = CefDictionaryValue::Create();
+            
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (const auto& entry : functions_) {
+                const FunctionMetrics& metrics = entry.second;
+                CefRefPtr<CefDictionaryValue> function = CefDictionaryValue::Create();
+                // Counters go out as doubles; int would overflow in long sessions
+                function->SetDouble("calls", static_cast<double>(metrics.latency.GetCount()));
+                function->SetDouble("exceptions", static_cast<double>(metrics.exceptions));
+                function->SetDouble("argumentBytes", static_cast<double>(metrics.argument_bytes));
+                function->SetDouble("meanUs", metrics.latency.GetMean() / 1000.0);
+                function->SetDouble("p50Us", ToMicroseconds(metrics.latency.GetPercentile(50.0)));
+                function->SetDouble("p99Us", ToMicroseconds(metrics.latency.GetPercentile(99.0)));
+                function->SetDouble("maxUs", ToMicroseconds(metrics.latency.GetMax()));
+                snapshot->SetDictionary(entry.first, function);
+            }
+            
+            CefRefPtr<CefValue> result = CefValue::Create();
+            result->SetDictionary(snapshot);
+            return result;
+        }
+        
+        void BridgeMetrics::Reset() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            functions_.clear();
+        }
+        
+    }
+}
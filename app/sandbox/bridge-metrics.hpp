@@ -0,0 +1,45 @@
+#pragma once
+#include "include/cef_values.h"
+#include "../utils/latency-histogram.hpp"
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace MikoIDE {
+    namespace Sandbox {
+        
+        // Renderer-process counters for every bridge entry point, keyed by the
+        // JS-visible name. Sync functions are timed around the native call,
+        // async ones from the call until their Promise settles, and scripts
+        // run through V8ContextManager::ExecuteScript under "executeScript".
+        // Lives for the whole process, so numbers survive navigations.
+        class BridgeMetrics {
+        public:
+            using Clock = std::chrono::steady_clock;
+            
+            static BridgeMetrics& GetInstance();
+            
+            void Record(const std::string& name, Clock::duration elapsed,
+                        size_t argumentBytes, bool threw);
+            
+            // {name: {calls, exceptions, argumentBytes, meanUs, p50Us, p99Us, maxUs}},
+            // returned to JS by getBridgeMetrics()
+            CefRefPtr<CefValue> Snapshot();
+            void Reset();
+            
+        private:
+            struct FunctionMetrics {
+                uint64_t exceptions = 0;
+                uint64_t argument_bytes = 0;
+                Utils::LatencyHistogram latency;
+            };
+            
+            BridgeMetrics() = default;
+            
+            std::map<std::string, FunctionMetrics> functions_;
+            std::mutex mutex_;
+        };
+        
+    }
+}
@@ -1,14 +1,27 @@
 #include "extension-sandbox.hpp"
+#include "bridge-messages.hpp"
+#include "bridge-metrics.hpp"
 #include "../core/logger.hpp"
-#include "../utils/terminal.hpp"
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <sstream>
 
 namespace MikoIDE {
     namespace Sandbox {
         
-        ExtensionSandbox::ExtensionSandbox() : initialized_(false) {
-            extension_manager_ = std::make_unique<ExtensionManager>();
+        namespace {
+            // Stream buffers point into the shared ring, which outlives them
+            class RingBufferReleaseCallback : public CefV8ArrayBufferReleaseCallback {
+            public:
+                void ReleaseBuffer(void* buffer) override {}
+                
+            private:
+                IMPLEMENT_REFCOUNTING(RingBufferReleaseCallback);
+            };
+        }
+        
+        ExtensionSandbox::ExtensionSandbox() : initialized_(false), next_request_id_(1) {
             v8_manager_ = std::make_unique<V8ContextManager>();
         }
         
@@ -16,30 +29,21 @@ namespace MikoIDE {
             Cleanup();
         }
         
-        bool ExtensionSandbox::Initialize() {
+        bool ExtensionSandbox::Initialize(CefRefPtr<CefV8Context> context) {
             if (initialized_) {
                 return true;
             }
             
             try {
-                // Initialize extension manager
-                if (!extension_manager_->Initialize()) {
-                    Logger::LogMessage("Failed to initialize extension manager");
-                    return false;
-                }
-                
                 // Initialize V8 context manager
-                if (!v8_manager_->Initialize()) {
+                if (!v8_manager_->Initialize(context)) {
                     Logger::LogMessage("Failed to initialize V8 context manager");
                     return false;
                 }
                 
                 v8_manager_->CreateSandboxGlobals();
-                RegisterExtensionAPIs();
-                RegisterTerminalAPIs();
                 
                 initialized_ = true;
-                Logger::LogMessage("Extension sandbox initialized successfully");
                 return true;
             } catch (const std::exception& e) {
                 Logger::LogMessage("Failed to initialize sandbox: " + std::string(e.what()));
@@ -74,141 +78,239 @@ namespace MikoIDE {
             return v8_manager_->ExecuteScript(script);
         }
         
-        void ExtensionSandbox::RegisterNativeFunction(const std::string& name, 
-                                                     std::function<void(const std::vector<std::string>&)> callback) {
-            native_functions_[name] = callback;
+        void ExtensionSandbox::RegisterNativeFunction(const std::string& name, NativeFunction callback) {
+            size_t index = native_functions_.size();
+            auto it = std::find(native_function_names_.begin(), native_function_names_.end(), name);
+            if (it != native_function_names_.end()) {
+                index = it - native_function_names_.begin();
+                native_functions_[index] = callback;
+            } else {
+                native_function_names_.push_back(name);
+                native_functions_.push_back(callback);
+            }
             
             if (v8_manager_ && v8_manager_->IsInitialized()) {
-                CefRefPtr<NativeFunctionHandler> handler = new NativeFunctionHandler(this);
+                CefRefPtr<NativeFunctionHandler> handler =
+                    new NativeFunctionHandler(this, index, NativeFunctionHandler::Kind::Sync);
                 v8_manager_->RegisterFunction(name, handler);
             }
         }
         
-        void ExtensionSandbox::Cleanup() {
-            if (v8_manager_) {
-                v8_manager_->Cleanup();
+        void ExtensionSandbox::RegisterAsyncFunction(const std::string& name) {
+            size_t index = async_functions_.size();
+            async_functions_.push_back(name);
+            
+            if (v8_manager_ && v8_manager_->IsInitialized()) {
+                CefRefPtr<NativeFunctionHandler> handler =
+                    new NativeFunctionHandler(this, index, NativeFunctionHandler::Kind::Async);
+                v8_manager_->RegisterFunction(name, handler);
             }
-            native_functions_.clear();
-            initialized_ = false;
         }
         
-        // Extension management methods
-        bool ExtensionSandbox::InstallExtensionFromVSIX(const std::string& vsixPath) {
-            if (!initialized_ || !extension_manager_) {
-                return false;
+        CefRefPtr<CefV8Value> ExtensionSandbox::CallAsync(size_t functionId,
+                                                          const CefV8ValueList& arguments,
+                                                          CefString& exception) {
+            CefRefPtr<CefV8Context> context = v8_manager_->GetContext();
+            if (functionId >= async_functions_.size() || !context || !context->IsValid()) {
+                exception = "native call after the sandbox context was released";
+                return nullptr;
             }
-            return extension_manager_->InstallExtension(vsixPath);
+            
+            CefRefPtr<CefProcessMessage> message = CefProcessMessage::Create(kNativeCallMessage);
+            CefRefPtr<CefListValue> args = message->GetArgumentList();
+            int requestId = next_request_id_++;
+            args->SetInt(0, requestId);
+            args->SetInt(1, static_cast<int>(functionId));
+            
+            const std::string& name = async_functions_[functionId];
+            
+            // Arguments that cannot be marshaled throw synchronously, before anything is sent
+            std::string error;
+            if (!ValueCodec::ArgumentsToList(arguments, args, 2, error)) {
+                BridgeMetrics::GetInstance().Record(name, BridgeMetrics::Clock::duration::zero(), 0, true);
+                exception = name + ": " + error;
+                return nullptr;
+            }
+            
+            return SendCall(context, message, requestId, name);
         }
         
-        bool ExtensionSandbox::UninstallExtension(const std::string& extensionId) {
-            if (!initialized_ || !extension_manager_) {
-                return false;
-            }
-            return extension_manager_->UninstallExtension(extensionId);
+        CefRefPtr<CefV8Value> ExtensionSandbox::SendCall(CefRefPtr<CefV8Context> context,
+                                                         CefRefPtr<CefProcessMessage> message,
+                                                         int requestId,
+                                                         const std::string& name) {
+            PendingCall call;
+            call.promise = CefV8Value::CreatePromise();
+            call.name = name;
+            call.argument_bytes = ValueCodec::GetByteSize(message->GetArgumentList());
+            call.started = BridgeMetrics::Clock::now();
+            pending_calls_[requestId] = call;
+            
+            context->GetFrame()->SendProcessMessage(PID_BROWSER, message);
+            return call.promise;
         }
         
-        std::vector<ExtensionInfo> ExtensionSandbox::GetInstalledExtensions() const {
-            if (!extension_manager_) {
-                return {};
+        void ExtensionSandbox::RegisterBatchFunction() {
+            if (v8_manager_ && v8_manager_->IsInitialized()) {
+                CefRefPtr<NativeFunctionHandler> handler =
+                    new NativeFunctionHandler(this, 0, NativeFunctionHandler::Kind::Batch);
+                v8_manager_->RegisterFunction("__mikoBatch", handler);
             }
-            return extension_manager_->GetInstalledExtensions();
         }
         
-        bool ExtensionSandbox::EnableExtension(const std::string& extensionId) {
-            if (!extension_manager_) {
-                return false;
+        CefRefPtr<CefV8Value> ExtensionSandbox::CallBatch(const CefV8ValueList& arguments,
+                                                          CefString& exception) {
+            CefRefPtr<CefV8Context> context = v8_manager_->GetContext();
+            if (!context || !context->IsValid()) {
+                exception = "native call after the sandbox context was released";
+                return nullptr;
+            }
+            if (arguments.empty() || !arguments[0]->IsArray()) {
+                exception = "__mikoBatch: expected an array of calls";
+                return nullptr;
+            }
+            
+            // The whole batch is marshaled before sending, so a bad argument
+            // anywhere throws and nothing runs
+            std::string error;
+            CefRefPtr<CefValue> calls = ValueCodec::FromV8(arguments[0], error);
+            if (!calls) {
+                BridgeMetrics::GetInstance().Record("__mikoBatch", BridgeMetrics::Clock::duration::zero(), 0, true);
+                exception = "__mikoBatch: " + error;
+                return nullptr;
             }
-            return extension_manager_->SetExtensionActive(extensionId, true);
+            
+            CefRefPtr<CefProcessMessage> message = CefProcessMessage::Create(kNativeBatchMessage);
+            CefRefPtr<CefListValue> args = message->GetArgumentList();
+            int requestId = next_request_id_++;
+            args->SetInt(0, requestId);
+            args->SetValue(1, calls);
+            
+            return SendCall(context, message, requestId, "__mikoBatch");
         }
         
-        bool ExtensionSandbox::DisableExtension(const std::string& extensionId) {
-            if (!extension_manager_) {
-                return false;
+        bool ExtensionSandbox::OnProcessMessageReceived(CefRefPtr<CefProcessMessage> message) {
+            std::string name = message->GetName().ToString();
+            if (name == kNativeResultMessage) {
+                ResolveCall(message->GetArgumentList());
+                return true;
             }
-            return extension_manager_->SetExtensionActive(extensionId, false);
+            return false;
         }
         
-        void ExtensionSandbox::RegisterExtensionAPIs() {
-            // Register extension management functions for JavaScript
-            RegisterNativeFunction("installExtension", [this](const std::vector<std::string>& args) {
-                if (!args.empty()) {
-                    bool success = InstallExtensionFromVSIX(args[0]);
-                    Logger::LogMessage(std::string("Extension installation ") + (success ? "succeeded" : "failed"));
-                }
-            });
+        void ExtensionSandbox::ResolveCall(CefRefPtr<CefListValue> args) {
+            auto it = pending_calls_.find(args->GetInt(0));
+            if (it == pending_calls_.end()) {
+                return;
+            }
+            PendingCall call = it->second;
+            pending_calls_.erase(it);
             
-            RegisterNativeFunction("uninstallExtension", [this](const std::vector<std::string>& args) {
-                if (!args.empty()) {
-                    bool success = UninstallExtension(args[0]);
-                    Logger::LogMessage(std::string("Extension uninstallation ") + (success ? "succeeded" : "failed"));
-                }
-            });
+            bool succeeded = args->GetBool(1);
+            BridgeMetrics::GetInstance().Record(call.name, BridgeMetrics::Clock::now() - call.started,
+                                                call.argument_bytes, !succeeded);
             
-            RegisterNativeFunction("listExtensions", [this](const std::vector<std::string>& args) {
-                auto extensions = GetInstalledExtensions();
-                Logger::LogMessage(std::string("Found ") + std::to_string(extensions.size()) + std::string(" installed extensions"));
-                for (const auto& ext : extensions) {
-                    Logger::LogMessage("- " + ext.name + " (" + ext.id + ") - " + (ext.isActive ? "Active" : "Inactive"));
-                }
-            });
+            CefRefPtr<CefV8Context> context = v8_manager_->GetContext();
+            if (!context || !context->IsValid() || !context->Enter()) {
+                return;
+            }
+            
+            if (succeeded) {
+                call.promise->ResolvePromise(ValueCodec::ToV8(args->GetValue(2)));
+            } else {
+                call.promise->RejectPromise(args->GetString(2));
+            }
+            context->Exit();
         }
         
-        void ExtensionSandbox::RegisterTerminalAPIs() {
-            // Terminal management functions
-            RegisterNativeFunction("createTerminal", [this](const std::vector<std::string>& args) {
-                std::string command = args.size() > 0 ? args[0] : "";
-                std::string workingDir = args.size() > 1 ? args[1] : "";
-                
-                std::string terminalId = Utils::Terminal::GetInstance().CreateTerminal(command, workingDir);
-                Logger::LogMessage("Created terminal: " + terminalId);
-            });
-            
-            RegisterNativeFunction("sendTerminalInput", [this](const std::vector<std::string>& args) {
-                if (args.size() >= 2) {
-                    bool success = Utils::Terminal::GetInstance().SendInput(args[0], args[1]);
-                    Logger::LogMessage(std::string("Terminal input sent: ") + (success ? "success" : "failed"));
-                }
-            });
+        void ExtensionSandbox::DispatchStream(Utils::SharedRing& ring) {
+            CefRefPtr<CefV8Context> context = v8_manager_->GetContext();
+            bool entered = context && context->IsValid() && context->Enter();
             
-            RegisterNativeFunction("sendTerminalCommand", [this](const std::vector<std::string>& args) {
-                if (args.size() >= 2) {
-                    bool success = Utils::Terminal::GetInstance().SendCommand(args[0], args[1]);
-                    Logger::LogMessage(std::string("Terminal command sent: ") + (success ? "success" : "failed"));
-                }
-            });
+            CefRefPtr<CefV8Value> handler;
+            CefRefPtr<CefV8Value> terminalHandler;
+            if (entered) {
+                handler = context->GetGlobal()->GetValue("onNativeStream");
+                terminalHandler = context->GetGlobal()->GetValue("onTerminalOutput");
+            }
             
-            RegisterNativeFunction("closeTerminal", [this](const std::vector<std::string>& args) {
-                if (!args.empty()) {
-                    bool success = Utils::Terminal::GetInstance().CloseTerminal(args[0]);
-                    Logger::LogMessage(std::string("Terminal closed: ") + (success ? "success" : "failed"));
-                }
-            });
-            
-            RegisterNativeFunction("resizeTerminal", [this](const std::vector<std::string>& args) {
-                if (args.size() >= 3) {
-                    std::string terminalId = args[0];
-                    int cols = std::stoi(args[1]);
-                    int rows = std::stoi(args[2]);
-                    bool success = Utils::Terminal::GetInstance().ResizeTerminal(terminalId, cols, rows);
-                    Logger::LogMessage(std::string("Terminal resized: ") + (success ? "success" : "failed"));
-                }
-            });
-            
-            // Set up terminal output callback to send to frontend
-            Utils::Terminal::GetInstance().SetGlobalOutputCallback(
-                [this](const std::string& terminalId, const Utils::TerminalMessage& msg) {
-                    // Forward terminal output to frontend via CEF
-                    if (v8_manager_ && v8_manager_->IsInitialized()) {
-                        // Create JavaScript event for terminal output
-                        std::string script = "if (window.onTerminalOutput) { window.onTerminalOutput('" + 
-                            terminalId + "', '" + 
-                            (msg.type == Utils::TerminalMessage::OUTPUT ? "output" : 
-                             (msg.type == Utils::TerminalMessage::ERROR ? "error" : "exit")) + "', '" +
-                            msg.data + "', " + std::to_string(msg.exitCode) + "); }";
-                        v8_manager_->ExecuteScript(script);
+            // Records are released even without a handler so the producer never stalls
+            CefRefPtr<CefV8ArrayBufferReleaseCallback> releaser = new RingBufferReleaseCallback();
+            Utils::SharedRing::Record record;
+            while (ring.Peek(record)) {
+                if (record.stream == kTerminalOutputStream) {
+                    if (terminalHandler && terminalHandler->IsFunction()) {
+                        DispatchTerminalRecord(terminalHandler, record, releaser);
                     }
+                } else if (handler && handler->IsFunction()) {
+                    CefRefPtr<CefV8Value> buffer = CefV8Value::CreateArrayBuffer(
+                        const_cast<uint8_t*>(record.data), record.size, releaser);
+                    
+                    CefV8ValueList args;
+                    args.push_back(CefV8Value::CreateUInt(record.stream));
+                    args.push_back(buffer);
+                    handler->ExecuteFunction(nullptr, args);
+                    buffer->NeuterArrayBuffer();
                 }
-            );
+                ring.Release(record);
+            }
+            
+            if (entered) {
+                context->Exit();
+            }
+        }
+        
+        void ExtensionSandbox::DispatchTerminalRecord(CefRefPtr<CefV8Value> handler,
+                                                      const Utils::SharedRing::Record& record,
+                                                      CefRefPtr<CefV8ArrayBufferReleaseCallback> releaser) {
+            if (record.size < 2 || record.size < 2u + record.data[1]) {
+                return;
+            }
+            
+            const uint8_t type = record.data[0];
+            const size_t idLength = record.data[1];
+            const uint8_t* data = record.data + 2 + idLength;
+            const size_t size = record.size - 2 - idLength;
+            
+            // window.onTerminalOutput(id, type, data: ArrayBuffer | null, exitCode)
+            CefV8ValueList args;
+            args.push_back(CefV8Value::CreateString(
+                std::string(reinterpret_cast<const char*>(record.data + 2), idLength)));
+            
+            CefRefPtr<CefV8Value> buffer;
+            if (type == kTerminalRecordExit) {
+                int32_t exitCode = 0;
+                memcpy(&exitCode, data, std::min(size, sizeof(exitCode)));
+                args.push_back(CefV8Value::CreateString("exit"));
+                args.push_back(CefV8Value::CreateNull());
+                args.push_back(CefV8Value::CreateInt(exitCode));
+            } else {
+                buffer = CefV8Value::CreateArrayBuffer(const_cast<uint8_t*>(data), size, releaser);
+                const char* name = type == kTerminalRecordError ? "error" :
+                                   type == kTerminalRecordScreen ? "screen" :
+                                   type == kTerminalRecordDiagnostics ? "diagnostics" :
+                                   type == kTerminalRecordResources ? "resources" : "output";
+                args.push_back(CefV8Value::CreateString(name));
+                args.push_back(buffer);
+                args.push_back(CefV8Value::CreateInt(0));
+            }
+            
+            handler->ExecuteFunction(nullptr, args);
+            if (buffer) {
+                buffer->NeuterArrayBuffer();
+            }
+        }
+        
+        void ExtensionSandbox::Cleanup() {
+            // Promises die with their context; late results are dropped in ResolveCall
+            pending_calls_.clear();
+            if (v8_manager_) {
+                v8_manager_->Cleanup();
+            }
+            native_functions_.clear();
+            native_function_names_.clear();
+            async_functions_.clear();
+            initialized_ = false;
         }
     }
-}
\ No newline at end of file
+}
@@ -1,52 +1,95 @@
 #pragma once
 #include <string>
 #include <vector>
+#include <map>
 #include <memory>
 #include <functional>
+#include <chrono>
 #include "include/cef_v8.h"
 #include "include/cef_browser.h"
-#include "vsix/manager.hpp"
+#include "include/cef_process_message.h"
+#include "include/cef_values.h"
 #include "v8-context-manager.hpp"
 #include "native-function-handler.hpp"
+#include "value-codec.hpp"
+#include "../utils/shared-ring.hpp"
 
 namespace MikoIDE {
     namespace Sandbox {
         
+        // Renderer-side sandbox bound to one frame's V8 context. Synchronous
+        // native functions run inline in the renderer; async functions are
+        // served by NativeBridge in the browser process and return a Promise.
         class ExtensionSandbox {
         public:
             ExtensionSandbox();
             ~ExtensionSandbox();
             
-            // Core functionality
-            bool Initialize();
+            // Core functionality; |context| is the frame context from OnContextCreated
+            bool Initialize(CefRefPtr<CefV8Context> context = nullptr);
             bool LoadExtension(const std::string& extensionPath);
             bool ExecuteScript(const std::string& script);
             void Cleanup();
             
-            // Extension management
-            bool InstallExtensionFromVSIX(const std::string& vsixPath);
-            bool UninstallExtension(const std::string& extensionId);
-            std::vector<ExtensionInfo> GetInstalledExtensions() const;
-            bool EnableExtension(const std::string& extensionId);
-            bool DisableExtension(const std::string& extensionId);
-            
             // Native function registration
-            void RegisterNativeFunction(const std::string& name, 
-                                      std::function<void(const std::vector<std::string>&)> callback);
+            void RegisterNativeFunction(const std::string& name, NativeFunction callback);
+            
+            // Installs |name| as a JS function returning a Promise settled by the
+            // browser process. Must be called in NativeBridge::GetFunctionNames()
+            // order, since calls are sent by index.
+            void RegisterAsyncFunction(const std::string& name);
+            
+            // Sends call |functionId| to the browser process; returns the pending Promise
+            CefRefPtr<CefV8Value> CallAsync(size_t functionId,
+                                            const CefV8ValueList& arguments,
+                                            CefString& exception);
+            
+            // Installs __mikoBatch([[functionId, [args...]], ...]), which the
+            // preload uses to flush queued calls; see BatchMode
+            void RegisterBatchFunction();
+            CefRefPtr<CefV8Value> CallBatch(const CefV8ValueList& arguments, CefString& exception);
+            
+            // Results and events from NativeBridge; returns true if handled
+            bool OnProcessMessageReceived(CefRefPtr<CefProcessMessage> message);
+            
+            // Drains |ring| into window.onNativeStream(streamId, ArrayBuffer), and
+            // terminal records into window.onTerminalOutput. Each buffer aliases
+            // the ring and is detached once the handler returns, so handlers
+            // that keep data must copy it (e.g. buffer.slice()).
+            void DispatchStream(Utils::SharedRing& ring);
             
             // Getters for internal access
-            const std::map<std::string, std::function<void(const std::vector<std::string>&)>>& GetNativeFunctions() const {
-                return native_functions_;
+            const NativeFunction* GetNativeFunction(size_t index) const {
+                return index < native_functions_.size() ? &native_functions_[index] : nullptr;
             }
+            size_t GetPendingCallCount() const { return pending_calls_.size(); }
             
         private:
             bool initialized_;
-            std::unique_ptr<ExtensionManager> extension_manager_;
             std::unique_ptr<V8ContextManager> v8_manager_;
-            std::map<std::string, std::function<void(const std::vector<std::string>&)>> native_functions_;
+            std::vector<NativeFunction> native_functions_;
+            std::vector<std::string> native_function_names_;
+            std::vector<std::string> async_functions_;
+            
+            // Completion table: request id -> Promise awaiting kNativeResultMessage
+            struct PendingCall {
+                CefRefPtr<CefV8Value> promise;
+                std::string name;
+                size_t argument_bytes = 0;
+                std::chrono::steady_clock::time_point started;
+            };
+            std::map<int, PendingCall> pending_calls_;
+            int next_request_id_;
+            
+            CefRefPtr<CefV8Value> SendCall(CefRefPtr<CefV8Context> context,
+                                           CefRefPtr<CefProcessMessage> message,
+                                           int requestId,
+                                           const std::string& name);
             
-            void RegisterExtensionAPIs();
-            void RegisterTerminalAPIs();
+            void ResolveCall(CefRefPtr<CefListValue> args);
+            void DispatchTerminalRecord(CefRefPtr<CefV8Value> handler,
+                                        const Utils::SharedRing::Record& record,
+                                        CefRefPtr<CefV8ArrayBufferReleaseCallback> releaser);
         };
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,282 @@
+#pragma once
+#include "value-codec.hpp"
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace MikoIDE {
+    namespace Sandbox {
+        
+        // Compile-time marshaling for native functions. Bind<&Class::Method>(instance)
+        // deduces the parameter and return types of |Method| and generates a
+        // NativeFunction that reads each argument straight out of the CefListValue
+        // and converts the result, e.g.
+        //
+        //   bridge.Bind<&Utils::TerminalManager::ResizeTerminal>("resizeTerminal", &terminals);
+        //
+        // Unsupported parameter or return types fail to compile. At runtime a
+        // mismatched argument throws (and so rejects the JS call); a missing or
+        // null trailing argument is passed as a default-constructed value, the
+        // way JS treats omitted parameters.
+        
+        // Argument conversion; specialize for additional parameter types
+        template<typename T, typename Enable = void>
+        struct NativeArg {
+            static_assert(sizeof(T) == 0, "unsupported native function parameter type");
+        };
+        
+        // Result conversion; specialize for additional return types
+        template<typename T, typename Enable = void>
+        struct NativeResult {
+            static_assert(sizeof(T) == 0, "unsupported native function return type");
+        };
+        
+        namespace Binding {
+            inline bool IsMissing(const CefRefPtr<CefListValue>& args, size_t index) {
+                return index >= args->GetSize() || args->GetType(index) == VTYPE_NULL;
+            }
+            
+            [[noreturn]] inline void ThrowTypeError(size_t index, const char* expected) {
+                throw std::invalid_argument("argument " + std::to_string(index) + " must be " + expected);
+            }
+            
+            [[noreturn]] inline void ThrowRangeError(size_t index) {
+                throw std::out_of_range("argument " + std::to_string(index) + " is out of range");
+            }
+            
+            // JS numbers arrive as int32 or double. Only values |T| holds
+            // exactly are accepted; a cast would be undefined or wrap.
+            template<typename T>
+            T ToNumber(double value, size_t index) {
+                if (!std::isfinite(value)) {
+                    ThrowTypeError(index, "a finite number");
+                }
+                if constexpr (std::is_integral_v<T>) {
+                    if (std::trunc(value) != value) {
+                        ThrowTypeError(index, "an integer");
+                    }
+                    // Both bounds are powers of two, so exact as doubles
+                    if (value < static_cast<double>(std::numeric_limits<T>::min()) ||
+                        value >= std::ldexp(1.0, std::numeric_limits<T>::digits)) {
+                        ThrowRangeError(index);
+                    }
+                } else if (std::fabs(value) > static_cast<double>(std::numeric_limits<T>::max())) {
+                    ThrowRangeError(index);
+                }
+                return static_cast<T>(value);
+            }
+        }
+        
+        template<>
+        struct NativeArg<bool> {
+            static bool Read(const CefRefPtr<CefListValue>& args, size_t index) {
+                if (Binding::IsMissing(args, index)) {
+                    return false;
+                }
+                if (args->GetType(index) != VTYPE_BOOL) {
+                    Binding::ThrowTypeError(index, "a boolean");
+                }
+                return args->GetBool(index);
+            }
+        };
+        
+        template<typename T>
+        struct NativeArg<T, std::enable_if_t<std::is_arithmetic_v<T> && !std::is_same_v<T, bool>>> {
+            static T Read(const CefRefPtr<CefListValue>& args, size_t index) {
+                if (Binding::IsMissing(args, index)) {
+                    return T();
+                }
+                switch (args->GetType(index)) {
+                    case VTYPE_INT:
+                        return Binding::ToNumber<T>(args->GetInt(index), index);
+                    case VTYPE_DOUBLE:
+                        return Binding::ToNumber<T>(args->GetDouble(index), index);
+                    default:
+                        Binding::ThrowTypeError(index, "a number");
+                }
+            }
+        };
+        
+        // Strings also accept an ArrayBuffer, taken as raw bytes
+        template<>
+        struct NativeArg<std::string> {
+            static std::string Read(const CefRefPtr<CefListValue>& args, size_t index) {
+                if (Binding::IsMissing(args, index)) {
+                    return std::string();
+                }
+                switch (args->GetType(index)) {
+                    case VTYPE_STRING:
+                        return args->GetString(index).ToString();
+                    case VTYPE_BINARY: {
+                        CefRefPtr<CefBinaryValue> binary = args->GetBinary(index);
+                        return std::string(static_cast<const char*>(binary->GetRawData()), binary->GetSize());
+                    }
+                    default:
+                        Binding::ThrowTypeError(index, "a string or ArrayBuffer");
+                }
+            }
+        };
+        
+        template<>
+        struct NativeArg<std::vector<uint8_t>> {
+            static std::vector<uint8_t> Read(const CefRefPtr<CefListValue>& args, size_t index) {
+                if (Binding::IsMissing(args, index)) {
+                    return std::vector<uint8_t>();
+                }
+                if (args->GetType(index) != VTYPE_BINARY) {
+                    Binding::ThrowTypeError(index, "an ArrayBuffer");
+                }
+                CefRefPtr<CefBinaryValue> binary = args->GetBinary(index);
+                const uint8_t* data = static_cast<const uint8_t*>(binary->GetRawData());
+                return std::vector<uint8_t>(data, data + binary->GetSize());
+            }
+        };
+        
+        template<>
+        struct NativeArg<CefRefPtr<CefValue>> {
+            static CefRefPtr<CefValue> Read(const CefRefPtr<CefListValue>& args, size_t index) {
+                return index < args->GetSize() ? args->GetValue(index) : ValueCodec::Null();
+            }
+        };
+        
+        template<>
+        struct NativeArg<CefRefPtr<CefDictionaryValue>> {
+            static CefRefPtr<CefDictionaryValue> Read(const CefRefPtr<CefListValue>& args, size_t index) {
+                if (Binding::IsMissing(args, index)) {
+                    return CefDictionaryValue::Create();
+                }
+                if (args->GetType(index) != VTYPE_DICTIONARY) {
+                    Binding::ThrowTypeError(index, "an object");
+                }
+                return args->GetDictionary(index);
+            }
+        };
+        
+        template<>
+        struct NativeResult<bool> {
+            static CefRefPtr<CefValue> ToValue(bool value) { return ValueCodec::Bool(value); }
+        };
+        
+        template<typename T>
+        struct NativeResult<T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>>> {
+            // Integers outside the int32 range become doubles, as in JS
+            static CefRefPtr<CefValue> ToValue(T value) {
+                if (static_cast<int64_t>(value) >= INT32_MIN && static_cast<int64_t>(value) <= INT32_MAX) {
+                    return ValueCodec::Int(static_cast<int>(value));
+                }
+                return ValueCodec::Double(static_cast<double>(value));
+            }
+        };
+        
+        template<typename T>
+        struct NativeResult<T, std::enable_if_t<std::is_floating_point_v<T>>> {
+            static CefRefPtr<CefValue> ToValue(T value) { return ValueCodec::Double(static_cast<double>(value)); }
+        };
+        
+        template<>
+        struct NativeResult<std::string> {
+            static CefRefPtr<CefValue> ToValue(const std::string& value) { return ValueCodec::String(value); }
+        };
+        
+        template<>
+        struct NativeResult<std::vector<uint8_t>> {
+            static CefRefPtr<CefValue> ToValue(const std::vector<uint8_t>& value) {
+                return ValueCodec::Binary(value.data(), value.size());
+            }
+        };
+        
+        template<>
+        struct NativeResult<CefRefPtr<CefValue>> {
+            static CefRefPtr<CefValue> ToValue(CefRefPtr<CefValue> value) { return value; }
+        };
+        
+        template<typename T>
+        struct NativeResult<std::vector<T>, std::enable_if_t<!std::is_same_v<T, uint8_t>>> {
+            static CefRefPtr<CefValue> ToValue(const std::vector<T>& values) {
+                CefRefPtr<CefListValue> list = CefListValue::Create();
+                list->SetSize(values.size());
+                for (size_t i = 0; i < values.size(); ++i) {
+                    list->SetValue(i, NativeResult<T>::ToValue(values[i]));
+                }
+                CefRefPtr<CefValue> result = CefValue::Create();
+                result->SetList(list);
+                return result;
+            }
+        };
+        
+        namespace Binding {
+            template<typename T>
+            using Decay = std::remove_cv_t<std::remove_reference_t<T>>;
+            
+            template<typename R, typename Call, typename... Args, size_t... I>
+            CefRefPtr<CefValue> Invoke(const Call& call, const CefRefPtr<CefListValue>& args, std::index_sequence<I...>) {
+                // Braced init keeps argument reads in order
+                std::tuple<Decay<Args>...> values{NativeArg<Decay<Args>>::Read(args, I)...};
+                if constexpr (std::is_void_v<R>) {
+                    std::apply(call, std::move(values));
+                    return nullptr;
+                } else {
+                    return NativeResult<Decay<R>>::ToValue(std::apply(call, std::move(values)));
+                }
+            }
+            
+            template<auto Function>
+            struct Traits;
+            
+            template<typename R, typename... Args, R (*Function)(Args...)>
+            struct Traits<Function> {
+                static NativeFunction Make() {
+                    return [](CefRefPtr<CefListValue> args) {
+                        return Invoke<R, decltype(Function), Args...>(Function, args, std::index_sequence_for<Args...>());
+                    };
+                }
+            };
+            
+            template<typename C, typename R, typename... Args, R (C::*Method)(Args...)>
+            struct Traits<Method> {
+                using Class = C;
+                
+                static NativeFunction Make(C* instance) {
+                    return [instance](CefRefPtr<CefListValue> args) {
+                        auto call = [instance](Decay<Args>... values) -> R {
+                            return (instance->*Method)(std::move(values)...);
+                        };
+                        return Invoke<R, decltype(call), Args...>(call, args, std::index_sequence_for<Args...>());
+                    };
+                }
+            };
+            
+            template<typename C, typename R, typename... Args, R (C::*Method)(Args...) const>
+            struct Traits<Method> {
+                using Class = C;
+                
+                static NativeFunction Make(const C* instance) {
+                    return [instance](CefRefPtr<CefListValue> args) {
+                        auto call = [instance](Decay<Args>... values) -> R {
+                            return (instance->*Method)(std::move(values)...);
+                        };
+                        return Invoke<R, decltype(call), Args...>(call, args, std::index_sequence_for<Args...>());
+                    };
+                }
+            };
+        }
+        
+        // Free function: Bind<&Function>()
+        template<auto Function>
+        NativeFunction Bind() {
+            return Binding::Traits<Function>::Make();
+        }
+        
+        // Member function: Bind<&Class::Method>(instance); |instance| must outlive the binding
+        template<auto Method, typename C>
+        NativeFunction Bind(C* instance) {
+            return Binding::Traits<Method>::Make(instance);
+        }
+    }
+}
@@ -0,0 +1,456 @@
+#include "native-bridge.hpp"
+#include "bridge-messages.hpp"
+#include "../core/logger.hpp"
+#include "../utils/terminal.hpp"
+#include "include/cef_task.h"
+#include "include/wrapper/cef_helpers.h"
+#include <algorithm>
+
+namespace MikoIDE {
+    namespace Sandbox {
+        
+        // listExtensions returns [{id, name, version, active}]
+        template<>
+        struct NativeResult<ExtensionInfo> {
+            static CefRefPtr<CefValue> ToValue(const ExtensionInfo& extension) {
+                CefRefPtr<CefDictionaryValue> info = CefDictionaryValue::Create();
+                info->SetString("id", extension.id);
+                info->SetString("name", extension.name);
+                info->SetString("version", extension.version);
+                info->SetBool("active", extension.isActive);
+                
+                CefRefPtr<CefValue> result = CefValue::Create();
+                result->SetDictionary(info);
+                return result;
+            }
+        };
+        
+        namespace {
+            // Tasks handed to RunAfterResult by the native call running on this thread
+            thread_local std::vector<std::function<void()>>* t_after_result = nullptr;
+            
+            // CefFrame::SendProcessMessage is used from the UI thread only
+            class SendResultTask : public CefTask {
+            public:
+                SendResultTask(CefRefPtr<CefFrame> frame, CefRefPtr<CefProcessMessage> message,
+                               std::vector<std::function<void()>> afterResult = {})
+                    : frame_(frame), message_(message), after_result_(std::move(afterResult)) {}
+                
+                void Execute() override {
+                    if (frame_->IsValid()) {
+                        frame_->SendProcessMessage(PID_RENDERER, message_);
+                    }
+                    for (auto& task : after_result_) {
+                        task();
+                    }
+                }
+                
+            private:
+                CefRefPtr<CefFrame> frame_;
+                CefRefPtr<CefProcessMessage> message_;
+                std::vector<std::function<void()>> after_result_;
+                IMPLEMENT_REFCOUNTING(SendResultTask);
+            };
+            
+            class BroadcastTask : public CefTask {
+            public:
+                explicit BroadcastTask(CefRefPtr<CefProcessMessage> message) : message_(message) {}
+                
+                void Execute() override {
+                    NativeBridge::GetInstance().DoBroadcast(message_);
+                }
+                
+            private:
+                CefRefPtr<CefProcessMessage> message_;
+                IMPLEMENT_REFCOUNTING(BroadcastTask);
+            };
+            
+            CefRefPtr<CefProcessMessage> CreateResult(int requestId, bool succeeded, CefRefPtr<CefValue> value) {
+                CefRefPtr<CefProcessMessage> message = CefProcessMessage::Create(kNativeResultMessage);
+                CefRefPtr<CefListValue> args = message->GetArgumentList();
+                args->SetInt(0, requestId);
+                args->SetBool(1, succeeded);
+                args->SetValue(2, value ? value : ValueCodec::Null());
+                return message;
+            }
+        }
+        
+        NativeBridge& NativeBridge::GetInstance() {
+            static NativeBridge instance;
+            return instance;
+        }
+        
+        namespace {
+            // Per-browser ring; a full ring spills into StreamChannel's backlog
+            constexpr size_t kStreamRingCapacity = 4 << 20;
+        }
+        
+        NativeBridge::NativeBridge() : batch_running_(false), next_stream_id_(1), initialized_(false) {
+        }
+        
+        void NativeBridge::Initialize(size_t workerCount) {
+            if (initialized_) {
+                return;
+            }
+            
+            extension_manager_ = std::make_unique<ExtensionManager>();
+            if (!extension_manager_->Initialize()) {
+                Logger::LogMessage("Failed to initialize extension manager");
+            }
+            
+            RegisterExtensionAPIs();
+            RegisterTerminalAPIs();
+            
+            pool_ = std::make_unique<Utils::ThreadPool>(workerCount);
+            terminal_resources_.Start();
+            initialized_ = true;
+            Logger::LogMessage("Native bridge started with " + std::to_string(pool_->GetThreadCount()) + " workers");
+        }
+        
+        void NativeBridge::Shutdown() {
+            if (!initialized_) {
+                return;
+            }
+            
+            Utils::Terminal::GetInstance().SetGlobalOutputCallback(nullptr);
+            terminal_search_.Shutdown();
+            terminal_resources_.Stop();
+            pool_->Shutdown();
+            pool_.reset();
+            {
+                std::lock_guard<std::mutex> lock(batch_mutex_);
+                batch_queue_.clear();
+                batch_running_ = false;
+            }
+            browsers_.clear();
+            {
+                std::lock_guard<std::mutex> lock(streams_mutex_);
+                streams_.clear();
+            }
+            initialized_ = false;
+        }
+        
+        void NativeBridge::RegisterFunction(const std::string& name, NativeFunction function,
+                                            BatchMode batchMode, CallOrder order) {
+            // The table is read by workers without locking, so it is frozen once running
+            if (initialized_) {
+                Logger::LogMessage("Native function registered after startup ignored: " + name);
+                return;
+            }
+            
+            auto it = std::find(function_names_.begin(), function_names_.end(), name);
+            if (it != function_names_.end()) {
+                functions_[it - function_names_.begin()] = function;
+                batch_modes_[it - function_names_.begin()] = batchMode;
+                call_orders_[it - function_names_.begin()] = order;
+                return;
+            }
+            function_names_.push_back(name);
+            functions_.push_back(function);
+            batch_modes_.push_back(batchMode);
+            call_orders_.push_back(order);
+        }
+        
+        bool NativeBridge::OnProcessMessageReceived(CefRefPtr<CefBrowser> browser,
+                                                    CefRefPtr<CefFrame> frame,
+                                                    CefRefPtr<CefProcessMessage> message) {
+            CEF_REQUIRE_UI_THREAD();
+            
+            if (message->GetName() == kStreamRequestMessage) {
+                OpenStream(browser);
+                return true;
+            }
+            
+            if (message->GetName() == kStreamDrainedMessage) {
+                {
+                    std::lock_guard<std::mutex> lock(streams_mutex_);
+                    auto it = streams_.find(browser->GetIdentifier());
+                    if (it != streams_.end()) {
+                        it->second->OnDrained();
+                    }
+                }
+                terminal_forwarder_.OnStreamDrained();
+                return true;
+            }
+            
+            if (message->GetName() == kNativeBatchMessage) {
+                OnBatchReceived(frame, message->GetArgumentList());
+                return true;
+            }
+            
+            if (message->GetName() != kNativeCallMessage) {
+                return false;
+            }
+            
+            CefRefPtr<CefListValue> request = message->GetArgumentList();
+            int requestId = request->GetInt(0);
+            int functionId = request->GetInt(1);
+            
+            if (!initialized_ || functionId < 0 || static_cast<size_t>(functionId) >= functions_.size()) {
+                frame->SendProcessMessage(PID_RENDERER,
+                                          CreateResult(requestId, false,
+                                                       ValueCodec::String("Unknown native function id " + std::to_string(functionId))));
+                return true;
+            }
+            
+            // Arguments follow the request id and name
+            CefRefPtr<CefListValue> args = CefListValue::Create();
+            args->SetSize(request->GetSize() - 2);
+            for (size_t i = 2; i < request->GetSize(); ++i) {
+                args->SetValue(i - 2, request->GetValue(i));
+            }
+            
+            const NativeFunction& function = functions_[functionId];
+            auto job = [&function, args, requestId, frame]() {
+                std::vector<std::function<void()>> afterResult;
+                t_after_result = &afterResult;
+                CefRefPtr<CefProcessMessage> result;
+                try {
+                    result = CreateResult(requestId, true, function(args));
+                } catch (const std::exception& e) {
+                    result = CreateResult(requestId, false, ValueCodec::String(e.what()));
+                }
+                t_after_result = nullptr;
+                CefPostTask(TID_UI, new SendResultTask(frame, result, std::move(afterResult)));
+            };
+            
+            // A command must not overtake the createTerminal before it or run
+            // after the closeTerminal behind it, so only reads skip the queue
+            if (call_orders_[functionId] == CallOrder::Unordered) {
+                pool_->Post(job);
+            } else {
+                PostBatch(job);
+            }
+            return true;
+        }
+        
+        void NativeBridge::OnBatchReceived(CefRefPtr<CefFrame> frame, CefRefPtr<CefListValue> request) {
+            int requestId = request->GetInt(0);
+            if (!initialized_ || request->GetType(1) != VTYPE_LIST) {
+                frame->SendProcessMessage(PID_RENDERER,
+                                          CreateResult(requestId, false, ValueCodec::String("Malformed native call batch")));
+                return;
+            }
+            
+            CefRefPtr<CefListValue> calls = request->GetList(1);
+            PostBatch([this, calls, requestId, frame]() {
+                CefRefPtr<CefListValue> results = CefListValue::Create();
+                results->SetSize(calls->GetSize());
+                std::vector<std::function<void()>> afterResult;
+                t_after_result = &afterResult;
+                
+                // One failing call does not stop the ones after it
+                for (size_t i = 0; i < calls->GetSize(); ++i) {
+                    CefRefPtr<CefListValue> outcome = CefListValue::Create();
+                    CefRefPtr<CefListValue> call = calls->GetType(i) == VTYPE_LIST ? calls->GetList(i) : nullptr;
+                    int functionId = call ? call->GetInt(0) : -1;
+                    
+                    if (functionId < 0 || static_cast<size_t>(functionId) >= functions_.size() ||
+                        call->GetType(1) != VTYPE_LIST) {
+                        outcome->SetBool(0, false);
+                        outcome->SetString(1, "Unknown native function id " + std::to_string(functionId));
+                    } else {
+                        try {
+                            CefRefPtr<CefValue> value = functions_[functionId](call->GetList(1));
+                            outcome->SetBool(0, true);
+                            outcome->SetValue(1, value ? value : ValueCodec::Null());
+                        } catch (const std::exception& e) {
+                            outcome->SetBool(0, false);
+                            outcome->SetString(1, e.what());
+                        }
+                    }
+                    results->SetList(i, outcome);
+                }
+                
+                t_after_result = nullptr;
+                
+                CefRefPtr<CefValue> value = CefValue::Create();
+                value->SetList(results);
+                CefPostTask(TID_UI, new SendResultTask(frame, CreateResult(requestId, true, value), std::move(afterResult)));
+            });
+        }
+        
+        void NativeBridge::RunAfterResult(std::function<void()> task) {
+            if (t_after_result) {
+                t_after_result->push_back(std::move(task));
+            } else {
+                task();
+            }
+        }
+        
+        void NativeBridge::PostBatch(std::function<void()> job) {
+            std::lock_guard<std::mutex> lock(batch_mutex_);
+            batch_queue_.push_back(std::move(job));
+            if (!batch_running_) {
+                batch_running_ = true;
+                pool_->Post([this]() { RunBatches(); });
+            }
+        }
+        
+        void NativeBridge::RunBatches() {
+            // Keystrokes from consecutive flushes must reach the PTY in order and
+            // ahead of later commands, so the queue is drained by a single
+            // worker at a time
+            while (true) {
+                std::function<void()> job;
+                {
+                    std::lock_guard<std::mutex> lock(batch_mutex_);
+                    if (batch_queue_.empty()) {
+                        batch_running_ = false;
+                        return;
+                    }
+                    job = std::move(batch_queue_.front());
+                    batch_queue_.pop_front();
+                }
+                job();
+            }
+        }
+        
+        void NativeBridge::AddBrowser(CefRefPtr<CefBrowser> browser) {
+            CEF_REQUIRE_UI_THREAD();
+            browsers_.push_back(browser);
+            // The stream channel waits for kStreamRequestMessage from the renderer
+        }
+        
+        void NativeBridge::OpenStream(CefRefPtr<CefBrowser> browser) {
+            CEF_REQUIRE_UI_THREAD();
+            
+            // The old ring's consumer is gone, along with whatever it had not
+            // drained, so its backlog is dropped with it
+            auto channel = std::make_unique<StreamChannel>(browser);
+            if (!channel->Open(kStreamRingCapacity)) {
+                channel.reset();
+            }
+            {
+                std::lock_guard<std::mutex> lock(streams_mutex_);
+                if (channel) {
+                    streams_[browser->GetIdentifier()].swap(channel);
+                } else {
+                    streams_.erase(browser->GetIdentifier());
+                }
+            }
+            
+            // Output held back for the old ring's backlog can flow again
+            terminal_forwarder_.OnStreamDrained();
+        }
+        
+        void NativeBridge::RemoveBrowser(CefRefPtr<CefBrowser> browser) {
+            CEF_REQUIRE_UI_THREAD();
+            browsers_.erase(std::remove_if(browsers_.begin(), browsers_.end(),
+                                           [&browser](const CefRefPtr<CefBrowser>& item) {
+                                               return item->IsSame(browser);
+                                           }),
+                            browsers_.end());
+            
+            std::lock_guard<std::mutex> lock(streams_mutex_);
+            streams_.erase(browser->GetIdentifier());
+        }
+        
+        void NativeBridge::Broadcast(CefRefPtr<CefProcessMessage> message) {
+            if (!CefCurrentlyOn(TID_UI)) {
+                CefPostTask(TID_UI, new BroadcastTask(message));
+                return;
+            }
+            DoBroadcast(message);
+        }
+        
+        void NativeBridge::DoBroadcast(CefRefPtr<CefProcessMessage> message) {
+            CEF_REQUIRE_UI_THREAD();
+            for (const auto& browser : browsers_) {
+                // A message can only be sent once, so each frame gets a copy
+                browser->GetMainFrame()->SendProcessMessage(PID_RENDERER, message->Copy());
+            }
+        }
+        
+        void NativeBridge::WriteStream(int browserId, uint32_t streamId, const void* data, size_t size) {
+            std::lock_guard<std::mutex> lock(streams_mutex_);
+            auto it = streams_.find(browserId);
+            if (it != streams_.end()) {
+                it->second->Write(streamId, data, size);
+            }
+        }
+        
+        void NativeBridge::BroadcastStream(uint32_t streamId, const void* data, size_t size) {
+            std::lock_guard<std::mutex> lock(streams_mutex_);
+            for (auto& stream : streams_) {
+                stream.second->Write(streamId, data, size);
+            }
+        }
+        
+        size_t NativeBridge::GetStreamBacklog() {
+            std::lock_guard<std::mutex> lock(streams_mutex_);
+            size_t backlog = 0;
+            for (const auto& stream : streams_) {
+                backlog += stream.second->GetPendingBytes();
+            }
+            return backlog;
+        }
+        
+        bool NativeBridge::InstallExtension(const std::string& vsixPath) {
+            std::lock_guard<std::mutex> lock(extension_mutex_);
+            bool success = extension_manager_->InstallExtension(vsixPath);
+            Logger::LogMessage(std::string("Extension installation ") + (success ? "succeeded" : "failed"));
+            return success;
+        }
+        
+        bool NativeBridge::UninstallExtension(const std::string& extensionId) {
+            std::lock_guard<std::mutex> lock(extension_mutex_);
+            bool success = extension_manager_->UninstallExtension(extensionId);
+            Logger::LogMessage(std::string("Extension uninstallation ") + (success ? "succeeded" : "failed"));
+            return success;
+        }
+        
+        bool NativeBridge::SetExtensionActive(const std::string& extensionId, bool active) {
+            std::lock_guard<std::mutex> lock(extension_mutex_);
+            return extension_manager_->SetExtensionActive(extensionId, active);
+        }
+        
+        std::vector<ExtensionInfo> NativeBridge::ListExtensions() {
+            std::lock_guard<std::mutex> lock(extension_mutex_);
+            return extension_manager_->GetInstalledExtensions();
+        }
+        
+        void NativeBridge::RegisterExtensionAPIs() {
+            Bind<&NativeBridge::InstallExtension>("installExtension", this);
+            Bind<&NativeBridge::UninstallExtension>("uninstallExtension", this);
+            Bind<&NativeBridge::SetExtensionActive>("setExtensionActive", this);
+            Bind<&NativeBridge::ListExtensions>("listExtensions", this, BatchMode::None, CallOrder::Unordered);
+        }
+        
+        void NativeBridge::RegisterTerminalAPIs() {
+            Utils::TerminalManager* terminals = &Utils::Terminal::GetInstance();
+            
+            // String parameters also take an ArrayBuffer, so raw input bytes pass through.
+            // Per-keystroke input and drag resizes are batched by the preload.
+            Bind<&Utils::TerminalManager::CreateTerminal>("createTerminal", terminals);
+            Bind<&Utils::TerminalManager::SendInput>("sendTerminalInput", terminals, BatchMode::Microtask);
+            Bind<&Utils::TerminalManager::SendCommand>("sendTerminalCommand", terminals);
+            Bind<&Utils::TerminalManager::CloseTerminal>("closeTerminal", terminals);
+            Bind<&Utils::TerminalManager::ResizeTerminal>("resizeTerminal", terminals, BatchMode::AnimationFrame);
+            Bind<&Utils::TerminalManager::EnableScreen>("enableTerminalScreen", terminals);
+            
+            // Reads; a long scrollback fetch or search need not hold up input
+            Bind<&Utils::TerminalManager::GetActiveTerminals>("listTerminals", terminals,
+                                                              BatchMode::None, CallOrder::Unordered);
+            Bind<&Utils::TerminalManager::GetScrollbackRange>("getTerminalScrollbackRange", terminals,
+                                                              BatchMode::None, CallOrder::Unordered);
+            Bind<&Utils::TerminalManager::GetScrollback>("getTerminalScrollback", terminals,
+                                                         BatchMode::None, CallOrder::Unordered);
+            
+            // Matches stream back on the returned id, see kSearchRecordMatches
+            Bind<&TerminalSearchService::Start>("searchTerminals", &terminal_search_,
+                                                BatchMode::None, CallOrder::Unordered);
+            Bind<&TerminalSearchService::Cancel>("cancelTerminalSearch", &terminal_search_,
+                                                 BatchMode::None, CallOrder::Unordered);
+            
+            // Output is coalesced per terminal and streamed to every renderer,
+            // where the sandbox calls window.onTerminalOutput
+            Utils::Terminal::GetInstance().SetGlobalOutputCallback(
+                [this](const std::string& terminalId, const Utils::TerminalMessage& msg) {
+                    terminal_forwarder_.OnOutput(terminalId, msg);
+                }
+            );
+        }
+        
+    }
+}
@@ -0,0 +1,138 @@
+#pragma once
+#include "include/cef_browser.h"
+#include "include/cef_process_message.h"
+#include "../utils/thread-pool.hpp"
+#include "vsix/manager.hpp"
+#include "bridge-messages.hpp"
+#include "native-binding.hpp"
+#include "stream-channel.hpp"
+#include "terminal-forwarder.hpp"
+#include "terminal-resource-monitor.hpp"
+#include "terminal-search-service.hpp"
+#include "value-codec.hpp"
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace MikoIDE {
+    namespace Sandbox {
+        
+        // Whether plain calls to a function must keep their arrival order.
+        // Serial calls share the batch queue, so they run one at a time in the
+        // order they and any batches arrived; Unordered calls only read state
+        // and run on whichever worker is free.
+        enum class CallOrder {
+            Serial,
+            Unordered
+        };
+        
+        // Browser-process side of asynchronous native calls. The renderer
+        // returns a Promise right away and sends kNativeCallMessage; the call
+        // runs here on a worker pool and its result (or exception) is sent back
+        // as kNativeResultMessage, keyed by the renderer's request id.
+        class NativeBridge {
+        public:
+            static NativeBridge& GetInstance();
+            
+            // Registers the host APIs and starts the workers; call before the
+            // first browser is created so GetFunctionNames() is complete
+            void Initialize(size_t workerCount = 4);
+            void Shutdown();
+            
+            // Functions run on a worker thread and must be thread-safe. Chatty
+            // functions can opt into batching, see BatchMode; functions whose
+            // calls may be reordered opt out of the serial queue, see CallOrder.
+            void RegisterFunction(const std::string& name, NativeFunction function,
+                                  BatchMode batchMode = BatchMode::None,
+                                  CallOrder order = CallOrder::Serial);
+            
+            // Typed registration, e.g. Bind<&TerminalManager::ResizeTerminal>("resizeTerminal", &terminals)
+            template<auto Method, typename C>
+            void Bind(const std::string& name, C* instance, BatchMode batchMode = BatchMode::None,
+                      CallOrder order = CallOrder::Serial) {
+                RegisterFunction(name, Sandbox::Bind<Method>(instance), batchMode, order);
+            }
+            
+            // Function names in id order; calls address functions by index in this list
+            const std::vector<std::string>& GetFunctionNames() const { return function_names_; }
+            const std::vector<BatchMode>& GetBatchModes() const { return batch_modes_; }
+            
+            // UI thread; returns true if |message| was a native call or stream notification
+            bool OnProcessMessageReceived(CefRefPtr<CefBrowser> browser,
+                                          CefRefPtr<CefFrame> frame,
+                                          CefRefPtr<CefProcessMessage> message);
+            
+            // Browsers receiving broadcast events; UI thread
+            void AddBrowser(CefRefPtr<CefBrowser> browser);
+            void RemoveBrowser(CefRefPtr<CefBrowser> browser);
+            
+            // Sends |message| to every main frame; any thread
+            void Broadcast(CefRefPtr<CefProcessMessage> message);
+            void DoBroadcast(CefRefPtr<CefProcessMessage> message);
+            
+            // Bulk data for window.onNativeStream(streamId, ArrayBuffer). Stream
+            // ids are only meaningful to the producer and its page script. Any thread.
+            uint32_t AllocateStreamId() { return next_stream_id_++; }
+            void WriteStream(int browserId, uint32_t streamId, const void* data, size_t size);
+            void BroadcastStream(uint32_t streamId, const void* data, size_t size);
+            
+            // Called from a native function: runs |task| on the UI thread right
+            // after the call's result has been sent, so stream records the call
+            // starts cannot reach the page before the promise resolves. Outside
+            // a native call |task| runs at once.
+            void RunAfterResult(std::function<void()> task);
+            
+            // Bytes waiting for a full ring to drain, across all browsers
+            size_t GetStreamBacklog();
+            
+        private:
+            NativeBridge();
+            
+            void RegisterExtensionAPIs();
+            void RegisterTerminalAPIs();
+            
+            // Extension management entry points, serialized on extension_mutex_
+            bool InstallExtension(const std::string& vsixPath);
+            bool UninstallExtension(const std::string& extensionId);
+            bool SetExtensionActive(const std::string& extensionId, bool active);
+            std::vector<ExtensionInfo> ListExtensions();
+            
+            void OnBatchReceived(CefRefPtr<CefFrame> frame, CefRefPtr<CefListValue> request);
+            void PostBatch(std::function<void()> job);
+            void RunBatches();
+            
+            // kStreamRequestMessage: gives |browser| a new stream channel; UI thread
+            void OpenStream(CefRefPtr<CefBrowser> browser);
+            
+            std::vector<NativeFunction> functions_;
+            std::vector<std::string> function_names_;
+            std::vector<BatchMode> batch_modes_;
+            std::vector<CallOrder> call_orders_;
+            
+            // Batches and Serial calls run one at a time, in arrival order, on
+            // the worker pool
+            std::deque<std::function<void()>> batch_queue_;
+            std::mutex batch_mutex_;
+            bool batch_running_;
+            std::unique_ptr<Utils::ThreadPool> pool_;
+            std::unique_ptr<ExtensionManager> extension_manager_;
+            std::mutex extension_mutex_;
+            std::vector<CefRefPtr<CefBrowser>> browsers_;
+            TerminalForwarder terminal_forwarder_;
+            TerminalSearchService terminal_search_;
+            TerminalResourceMonitor terminal_resources_;
+            
+            // Keyed by browser id; created and removed on the UI thread
+            std::map<int, std::unique_ptr<StreamChannel>> streams_;
+            std::mutex streams_mutex_;
+            std::atomic<uint32_t> next_stream_id_;
+            bool initialized_;
+        };
+        
+    }
+}
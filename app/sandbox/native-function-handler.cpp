@@ -1,11 +1,13 @@
 #include "native-function-handler.hpp"
+#include "bridge-metrics.hpp"
 #include "extension-sandbox.hpp"
+#include "value-codec.hpp"
 
 namespace MikoIDE {
     namespace Sandbox {
         
-        NativeFunctionHandler::NativeFunctionHandler(ExtensionSandbox* sandbox) 
-            : sandbox_(sandbox) {
+        NativeFunctionHandler::NativeFunctionHandler(ExtensionSandbox* sandbox, size_t index, Kind kind) 
+            : sandbox_(sandbox), index_(index), kind_(kind) {
         }
         
         bool NativeFunctionHandler::Execute(const CefString& name,
@@ -14,28 +16,43 @@ namespace MikoIDE {
                                            CefRefPtr<CefV8Value>& retval,
                                            CefString& exception) {
             
-            std::string funcName = name.ToString();
-            auto it = sandbox_->GetNativeFunctions().find(funcName);
+            if (kind_ == Kind::Batch) {
+                retval = sandbox_->CallBatch(arguments, exception);
+                return true;
+            }
+            
+            if (kind_ == Kind::Async) {
+                retval = sandbox_->CallAsync(index_, arguments, exception);
+                return true;
+            }
             
-            if (it != sandbox_->GetNativeFunctions().end()) {
-                std::vector<std::string> args;
-                for (const auto& arg : arguments) {
-                    if (arg->IsString()) {
-                        args.push_back(arg->GetStringValue().ToString());
-                    }
-                }
-                
-                try {
-                    it->second(args);
-                    retval = CefV8Value::CreateUndefined();
-                    return true;
-                } catch (const std::exception& e) {
-                    exception = CefString(e.what());
-                    return false;
-                }
+            const NativeFunction* function = sandbox_->GetNativeFunction(index_);
+            if (!function) {
+                return false;
             }
             
-            return false;
+            // Async calls are timed by the sandbox until their Promise settles
+            const BridgeMetrics::Clock::time_point started = BridgeMetrics::Clock::now();
+            const std::string functionName = name.ToString();
+            
+            std::string error;
+            CefRefPtr<CefListValue> args = CefListValue::Create();
+            if (!ValueCodec::ArgumentsToList(arguments, args, 0, error)) {
+                BridgeMetrics::GetInstance().Record(functionName, BridgeMetrics::Clock::now() - started, 0, true);
+                exception = functionName + ": " + error;
+                return true;
+            }
+            
+            bool threw = false;
+            try {
+                retval = ValueCodec::ToV8((*function)(args));
+            } catch (const std::exception& e) {
+                exception = functionName + ": " + e.what();
+                threw = true;
+            }
+            BridgeMetrics::GetInstance().Record(functionName, BridgeMetrics::Clock::now() - started,
+                                                ValueCodec::GetByteSize(args), threw);
+            return true;
         }
     }
-}
\ No newline at end of file
+}
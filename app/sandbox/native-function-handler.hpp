@@ -9,9 +9,17 @@ namespace MikoIDE {
         
         class ExtensionSandbox; // Forward declaration
         
+        // One handler per installed JS function; it carries the function's
+        // index so calls dispatch without a name lookup
         class NativeFunctionHandler : public CefV8Handler {
         public:
-            NativeFunctionHandler(ExtensionSandbox* sandbox);
+            enum class Kind {
+                Sync,   // runs inline on the renderer thread
+                Async,  // forwarded to NativeBridge, returns a Promise
+                Batch   // __mikoBatch: many queued async calls in one message
+            };
+            
+            NativeFunctionHandler(ExtensionSandbox* sandbox, size_t index, Kind kind);
             
             bool Execute(const CefString& name,
                         CefRefPtr<CefV8Value> object,
@@ -21,7 +29,9 @@ namespace MikoIDE {
                         
         private:
             ExtensionSandbox* sandbox_;
+            size_t index_;
+            Kind kind_;
             IMPLEMENT_REFCOUNTING(NativeFunctionHandler);
         };
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,153 @@
+#include "preload.hpp"
+
+namespace MikoIDE {
+    namespace Sandbox {
+        
+        namespace {
+            const char kDarkThemeKey[] = "darkTheme";
+            const char kAsyncFunctionsKey[] = "asyncFunctions";
+            const char kBatchModesKey[] = "batchModes";
+            
+            // Adopted stylesheets apply before the first style recalc and need
+            // no <head>, so the page never renders with the light defaults
+            const char kDarkThemeScript[] = R"(
+                (function() {
+                    const sheet = new CSSStyleSheet();
+                    sheet.replaceSync(`
+                        :root {
+                            color-scheme: dark;
+                        }
+                        body {
+                            background-color: #1e1e1e !important;
+                            color: #ffffff !important;
+                        }
+                    `);
+                    document.adoptedStyleSheets = [...document.adoptedStyleSheets, sheet];
+                })();
+            )";
+            
+            // Replaces batched functions with stubs that queue the call and
+            // settle its Promise from the per-call results of __mikoBatch, and
+            // wraps the plain ones to flush the queue before they are sent.
+            // Called with {name: [function id, BatchMode]} and [plain name, ...].
+            const char kBatchingScript[] = R"(
+                (function(batched, plain) {
+                    const send = window.__mikoBatch;
+                    const queue = [];
+                    let microtaskPending = false;
+                    let framePending = false;
+                    
+                    function flush() {
+                        microtaskPending = false;
+                        framePending = false;
+                        if (queue.length === 0) {
+                            return;
+                        }
+                        const calls = queue.splice(0);
+                        const rejectAll = (error) => calls.forEach((call) => call[3](error));
+                        try {
+                            send(calls.map((call) => [call[0], call[1]])).then((results) => {
+                                results.forEach((result, i) => {
+                                    if (result[0]) {
+                                        calls[i][2](result[1]);
+                                    } else {
+                                        calls[i][3](new Error(result[1]));
+                                    }
+                                });
+                            }, rejectAll);
+                        } catch (error) {
+                            rejectAll(error);
+                        }
+                    }
+                    
+                    Object.keys(batched).forEach((name) => {
+                        const [id, mode] = batched[name];
+                        window[name] = (...args) => new Promise((resolve, reject) => {
+                            queue.push([id, args, resolve, reject]);
+                            if (mode === 1 && !microtaskPending) {
+                                microtaskPending = true;
+                                queueMicrotask(flush);
+                            } else if (mode === 2 && !framePending) {
+                                framePending = true;
+                                requestAnimationFrame(flush);
+                            }
+                        });
+                    });
+                    
+                    // A plain call must not overtake batched calls made before it
+                    plain.forEach((name) => {
+                        const call = window[name];
+                        window[name] = (...args) => {
+                            flush();
+                            return call(...args);
+                        };
+                    });
+                })
+            )";
+        }
+        
+        CefRefPtr<CefDictionaryValue> PreloadOptions::ToDictionary() const {
+            CefRefPtr<CefDictionaryValue> dictionary = CefDictionaryValue::Create();
+            dictionary->SetBool(kDarkThemeKey, dark_theme);
+            
+            CefRefPtr<CefListValue> functions = CefListValue::Create();
+            functions->SetSize(async_functions.size());
+            for (size_t i = 0; i < async_functions.size(); ++i) {
+                functions->SetString(i, async_functions[i]);
+            }
+            dictionary->SetList(kAsyncFunctionsKey, functions);
+            
+            CefRefPtr<CefListValue> modes = CefListValue::Create();
+            modes->SetSize(batch_modes.size());
+            for (size_t i = 0; i < batch_modes.size(); ++i) {
+                modes->SetInt(i, static_cast<int>(batch_modes[i]));
+            }
+            dictionary->SetList(kBatchModesKey, modes);
+            return dictionary;
+        }
+        
+        PreloadOptions PreloadOptions::FromDictionary(CefRefPtr<CefDictionaryValue> dictionary) {
+            PreloadOptions options;
+            if (dictionary && dictionary->HasKey(kDarkThemeKey)) {
+                options.dark_theme = dictionary->GetBool(kDarkThemeKey);
+            }
+            if (dictionary && dictionary->GetType(kAsyncFunctionsKey) == VTYPE_LIST) {
+                CefRefPtr<CefListValue> functions = dictionary->GetList(kAsyncFunctionsKey);
+                for (size_t i = 0; i < functions->GetSize(); ++i) {
+                    options.async_functions.push_back(functions->GetString(i).ToString());
+                }
+            }
+            if (dictionary && dictionary->GetType(kBatchModesKey) == VTYPE_LIST) {
+                CefRefPtr<CefListValue> modes = dictionary->GetList(kBatchModesKey);
+                for (size_t i = 0; i < modes->GetSize(); ++i) {
+                    options.batch_modes.push_back(static_cast<BatchMode>(modes->GetInt(i)));
+                }
+            }
+            return options;
+        }
+        
+        std::string Preload::BuildScript(const PreloadOptions& options) {
+            std::string script;
+            if (options.dark_theme) {
+                script += kDarkThemeScript;
+            }
+            
+            std::string batched;
+            std::string plain;
+            for (size_t i = 0; i < options.async_functions.size() && i < options.batch_modes.size(); ++i) {
+                if (options.batch_modes[i] == BatchMode::None) {
+                    plain += (plain.empty() ? "\"" : ", \"") + options.async_functions[i] + "\"";
+                    continue;
+                }
+                batched += (batched.empty() ? "" : ", ") + std::string("\"") + options.async_functions[i] +
+                           "\": [" + std::to_string(i) + ", " +
+                           std::to_string(static_cast<int>(options.batch_modes[i])) + "]";
+            }
+            if (!batched.empty()) {
+                script += kBatchingScript;
+                script += "({" + batched + "}, [" + plain + "]);\n";
+            }
+            return script;
+        }
+    }
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include "include/cef_values.h"
+#include "bridge-messages.hpp"
+#include <string>
+#include <vector>
+
+namespace MikoIDE {
+    namespace Sandbox {
+        
+        // Per-browser options handed from the browser process to the renderer
+        // through the CreateBrowser extra_info dictionary
+        struct PreloadOptions {
+            bool dark_theme = false;
+            
+            // Functions served asynchronously by NativeBridge, and how the
+            // preload batches calls to each (parallel to async_functions)
+            std::vector<std::string> async_functions;
+            std::vector<BatchMode> batch_modes;
+            
+            CefRefPtr<CefDictionaryValue> ToDictionary() const;
+            static PreloadOptions FromDictionary(CefRefPtr<CefDictionaryValue> dictionary);
+        };
+        
+        // Script evaluated in OnContextCreated, before any page script runs.
+        // It must not assume <head> or <body> exist yet.
+        class Preload {
+        public:
+            static std::string BuildScript(const PreloadOptions& options);
+        };
+    }
+}
@@ -0,0 +1,136 @@
+#include "stream-channel.hpp"
+#include "bridge-messages.hpp"
+#include "../core/logger.hpp"
+#include "include/cef_process_message.h"
+#include "include/cef_task.h"
+#include <algorithm>
+#include <atomic>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace MikoIDE {
+    namespace Sandbox {
+        
+        namespace {
+            constexpr size_t kMaxPendingBytes = 64 << 20;
+            
+            // A browser gets a new ring for each render process, and the old
+            // region can still be mapped while the next one is created
+            std::atomic<uint32_t> g_next_ring(0);
+            
+            class SendStreamMessageTask : public CefTask {
+            public:
+                SendStreamMessageTask(CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> message)
+                    : browser_(browser), message_(message) {}
+                
+                void Execute() override {
+                    CefRefPtr<CefFrame> frame = browser_->GetMainFrame();
+                    if (frame && frame->IsValid()) {
+                        frame->SendProcessMessage(PID_RENDERER, message_);
+                    }
+                }
+                
+            private:
+                CefRefPtr<CefBrowser> browser_;
+                CefRefPtr<CefProcessMessage> message_;
+                IMPLEMENT_REFCOUNTING(SendStreamMessageTask);
+            };
+            
+            unsigned long CurrentProcessId() {
+#ifdef _WIN32
+                return GetCurrentProcessId();
+#else
+                return static_cast<unsigned long>(getpid());
+#endif
+            }
+            
+            void SendToRenderer(CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> message) {
+                CefPostTask(TID_UI, new SendStreamMessageTask(browser, message));
+            }
+        }
+        
+        StreamChannel::StreamChannel(CefRefPtr<CefBrowser> browser)
+            : browser_(browser), pending_bytes_(0) {
+        }
+        
+        bool StreamChannel::Open(size_t capacity) {
+            std::string name = "miko-" + std::to_string(CurrentProcessId()) + "-" +
+                               std::to_string(browser_->GetIdentifier()) + "-" + std::to_string(g_next_ring++);
+            if (!ring_.Create(name, capacity)) {
+                Logger::LogMessage("Stream channel unavailable: " + ring_.GetLastError());
+                return false;
+            }
+            
+            CefRefPtr<CefProcessMessage> message = CefProcessMessage::Create(kStreamOpenMessage);
+            message->GetArgumentList()->SetString(0, ring_.GetName());
+            SendToRenderer(browser_, message);
+            return true;
+        }
+        
+        void StreamChannel::Write(uint32_t stream, const void* data, size_t size) {
+            if (!ring_.IsOpen()) {
+                return;
+            }
+            
+            // Keep stream order: nothing bypasses bytes already waiting
+            const uint8_t* bytes = static_cast<const uint8_t*>(data);
+            size_t written = 0;
+            bool complete = false;
+            if (pending_.empty()) {
+                complete = WriteRecords(stream, bytes, size, written);
+                RingDoorbell();
+            }
+            if (complete) {
+                return;
+            }
+            
+            // A renderer that stopped draining (hung or crashed) must not grow this without bound
+            if (pending_bytes_ + size - written > kMaxPendingBytes) {
+                Logger::LogMessage("Stream channel backlog full, dropping " + std::to_string(size - written) +
+                                   " bytes for stream " + std::to_string(stream));
+                return;
+            }
+            pending_.push_back({stream, std::vector<uint8_t>(bytes + written, bytes + size)});
+            pending_bytes_ += size - written;
+        }
+        
+        void StreamChannel::OnDrained() {
+            while (!pending_.empty()) {
+                Chunk& chunk = pending_.front();
+                size_t written = 0;
+                bool complete = WriteRecords(chunk.stream, chunk.data.data(), chunk.data.size(), written);
+                pending_bytes_ -= written;
+                if (!complete) {
+                    chunk.data.erase(chunk.data.begin(), chunk.data.begin() + written);
+                    break;
+                }
+                pending_.pop_front();
+            }
+            RingDoorbell();
+        }
+        
+        bool StreamChannel::WriteRecords(uint32_t stream, const uint8_t* data, size_t size, size_t& written) {
+            // An empty write is still delivered, e.g. as an end-of-stream marker
+            const size_t maxRecord = ring_.GetMaxRecordSize();
+            do {
+                size_t length = std::min<size_t>(size - written, maxRecord);
+                if (!ring_.Write(stream, data + written, length)) {
+                    return false;
+                }
+                written += length;
+            } while (written < size);
+            return true;
+        }
+        
+        void StreamChannel::RingDoorbell() {
+            if (ring_.TakeDoorbell()) {
+                SendToRenderer(browser_, CefProcessMessage::Create(kStreamDoorbellMessage));
+            }
+        }
+        
+    }
+}
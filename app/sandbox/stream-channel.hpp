@@ -0,0 +1,48 @@
+#pragma once
+#include "include/cef_browser.h"
+#include "../utils/shared-ring.hpp"
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace MikoIDE {
+    namespace Sandbox {
+        
+        // Browser-process end of a bulk data stream to one browser's renderer.
+        // Bytes go through a SharedRing that the renderer maps after receiving
+        // kStreamOpenMessage; only a kStreamDoorbellMessage crosses IPC, and only
+        // when the renderer is idle. Not thread-safe: NativeBridge serializes use.
+        class StreamChannel {
+        public:
+            explicit StreamChannel(CefRefPtr<CefBrowser> browser);
+            
+            // Creates the ring and tells the renderer to map it
+            bool Open(size_t capacity);
+            
+            // Queues |size| bytes for |stream|. Payloads larger than a record are
+            // split; if the ring is full the rest waits until the renderer drains.
+            void Write(uint32_t stream, const void* data, size_t size);
+            
+            // kStreamDrainedMessage: the renderer made room after a failed write
+            void OnDrained();
+            
+            size_t GetPendingBytes() const { return pending_bytes_; }
+            
+        private:
+            struct Chunk {
+                uint32_t stream;
+                std::vector<uint8_t> data;
+            };
+            
+            bool WriteRecords(uint32_t stream, const uint8_t* data, size_t size, size_t& written);
+            void RingDoorbell();
+            
+            CefRefPtr<CefBrowser> browser_;
+            Utils::SharedRing ring_;
+            std::deque<Chunk> pending_;
+            size_t pending_bytes_;
+        };
+        
+    }
+}
@@ -0,0 +1,275 @@
+#include "terminal-forwarder.hpp"
+#include "bridge-messages.hpp"
+#include "native-bridge.hpp"
+#include "include/cef_task.h"
+#include <algorithm>
+#include <cstring>
+
+namespace MikoIDE {
+    namespace Sandbox {
+        
+        namespace {
+            // Keeps each record well under the ring's maximum record size
+            constexpr size_t kMaxRecordPayload = 256 * 1024;
+            
+            // Stream backlog beyond which acknowledgements are held back
+            constexpr size_t kMaxStreamBacklog = 256 * 1024;
+            
+            class FlushTerminalOutputTask : public CefTask {
+            public:
+                explicit FlushTerminalOutputTask(TerminalForwarder* forwarder) : forwarder_(forwarder) {}
+                
+                void Execute() override {
+                    forwarder_->Flush();
+                }
+                
+            private:
+                TerminalForwarder* forwarder_;
+                IMPLEMENT_REFCOUNTING(FlushTerminalOutputTask);
+            };
+            
+            uint8_t ToRecordType(Utils::TerminalMessage::Type type) {
+                switch (type) {
+                    case Utils::TerminalMessage::TERMINAL_ERROR:
+                        return kTerminalRecordError;
+                    case Utils::TerminalMessage::EXIT:
+                        return kTerminalRecordExit;
+                    case Utils::TerminalMessage::SCREEN:
+                        return kTerminalRecordScreen;
+                    case Utils::TerminalMessage::DIAGNOSTICS:
+                        return kTerminalRecordDiagnostics;
+                    default:
+                        return kTerminalRecordOutput;
+                }
+            }
+            
+            void AppendU32(std::string& out, uint32_t value) {
+                out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+            }
+            
+            void AppendString(std::string& out, const std::string& value) {
+                AppendU32(out, static_cast<uint32_t>(value.size()));
+                out += value;
+            }
+        }
+        
+        TerminalForwarder::TerminalForwarder() : pending_bytes_(0), flush_scheduled_(false) {
+        }
+        
+        void TerminalForwarder::OnOutput(const std::string& terminalId, const Utils::TerminalMessage& message) {
+            if (message.type == Utils::TerminalMessage::INPUT) {
+                return;
+            }
+            
+            Acks acks;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                uint8_t type = ToRecordType(message.type);
+                
+                // The exit record carries the code; it is sent at once, after the
+                // output still buffered for that terminal
+                if (type == kTerminalRecordExit) {
+                    auto it = pending_.find(terminalId);
+                    if (it != pending_.end()) {
+                        pending_bytes_ -= FlushTerminal(it->first, it->second);
+                        pending_.erase(it);
+                    }
+                    held_acks_.erase(terminalId);
+                    if (dirty_screens_.erase(terminalId) > 0) {
+                        WriteScreen(terminalId);
+                    }
+                    if (pending_diagnostics_.erase(terminalId) > 0) {
+                        WriteDiagnostics(terminalId);
+                    }
+                    int32_t exitCode = message.exitCode;
+                    WriteRecord(terminalId, type, reinterpret_cast<const char*>(&exitCode), sizeof(exitCode));
+                    return;
+                }
+                
+                if (type == kTerminalRecordScreen) {
+                    dirty_screens_.insert(terminalId);
+                    ScheduleFlushLocked();
+                    return;
+                }
+                
+                if (type == kTerminalRecordDiagnostics) {
+                    pending_diagnostics_.insert(terminalId);
+                    ScheduleFlushLocked();
+                    return;
+                }
+                
+                Append(terminalId, type, message.GetData(), message.GetSize(), acks);
+            }
+            
+            // Terminal locks are taken outside mutex_: the reactor may be
+            // blocked in this forwarder while another thread closes a terminal
+            SendAcks(acks);
+        }
+        
+        void TerminalForwarder::Append(const std::string& terminalId, uint8_t type,
+                                       const char* data, size_t size, Acks& acks) {
+            std::vector<Chunk>& chunks = pending_[terminalId];
+            if (!chunks.empty() && chunks.back().type == type) {
+                chunks.back().data.append(data, size);
+            } else {
+                chunks.push_back({type, std::string(data, size)});
+            }
+            pending_bytes_ += size;
+            
+            if (pending_bytes_ >= kFlushThreshold) {
+                FlushLocked(acks);
+            } else {
+                ScheduleFlushLocked();
+            }
+        }
+        
+        void TerminalForwarder::ScheduleFlushLocked() {
+            if (!flush_scheduled_) {
+                flush_scheduled_ = true;
+                CefPostDelayedTask(TID_UI, new FlushTerminalOutputTask(this), kFrameIntervalMs);
+            }
+        }
+        
+        void TerminalForwarder::Flush() {
+            Acks acks;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                flush_scheduled_ = false;
+                FlushLocked(acks);
+            }
+            SendAcks(acks);
+        }
+        
+        void TerminalForwarder::OnStreamDrained() {
+            Acks acks;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (NativeBridge::GetInstance().GetStreamBacklog() > kMaxStreamBacklog) {
+                    return;
+                }
+                acks.swap(held_acks_);
+                if (!dirty_screens_.empty()) {
+                    ScheduleFlushLocked();
+                }
+            }
+            SendAcks(acks);
+        }
+        
+        void TerminalForwarder::FlushLocked(Acks& acks) {
+            // Writing under mutex_ keeps records in read order across the
+            // threshold flushes on reader threads and the frame tick
+            for (auto& terminal : pending_) {
+                QueueAck(terminal.first, FlushTerminal(terminal.first, terminal.second), acks);
+            }
+            pending_.clear();
+            pending_bytes_ = 0;
+            
+            // A slow renderer gets one diff covering several frames once it
+            // catches up, rather than every intermediate frame
+            if (!dirty_screens_.empty() &&
+                NativeBridge::GetInstance().GetStreamBacklog() <= kMaxStreamBacklog) {
+                for (const std::string& terminalId : dirty_screens_) {
+                    WriteScreen(terminalId);
+                }
+                dirty_screens_.clear();
+            }
+            
+            // Small and rare, so not held back for a slow renderer
+            for (const std::string& terminalId : pending_diagnostics_) {
+                WriteDiagnostics(terminalId);
+            }
+            pending_diagnostics_.clear();
+        }
+        
+        void TerminalForwarder::WriteScreen(const std::string& terminalId) {
+            std::vector<std::string> records;
+            if (Utils::Terminal::GetInstance().TakeScreenDiff(terminalId, records, kMaxRecordPayload)) {
+                for (const std::string& record : records) {
+                    WriteRecord(terminalId, kTerminalRecordScreen, record.data(), record.size());
+                }
+            }
+        }
+        
+        void TerminalForwarder::WriteDiagnostics(const std::string& terminalId) {
+            std::vector<Utils::Diagnostic> diagnostics;
+            if (!Utils::Terminal::GetInstance().TakeDiagnostics(terminalId, diagnostics)) {
+                return;
+            }
+            
+            std::string record;
+            AppendU32(record, 0);
+            uint32_t count = 0;
+            auto send = [&]() {
+                memcpy(&record[0], &count, sizeof(count));
+                WriteRecord(terminalId, kTerminalRecordDiagnostics, record.data(), record.size());
+                record.resize(sizeof(uint32_t));
+                count = 0;
+            };
+            
+            for (const Utils::Diagnostic& diagnostic : diagnostics) {
+                record.push_back(static_cast<char>(diagnostic.severity));
+                AppendU32(record, diagnostic.line);
+                AppendU32(record, diagnostic.column);
+                AppendString(record, diagnostic.file);
+                AppendString(record, diagnostic.code);
+                AppendString(record, diagnostic.message);
+                ++count;
+                if (record.size() >= kMaxRecordPayload) {
+                    send();
+                }
+            }
+            if (count > 0) {
+                send();
+            }
+        }
+        
+        size_t TerminalForwarder::FlushTerminal(const std::string& terminalId, std::vector<Chunk>& chunks) {
+            size_t flushed = 0;
+            for (const Chunk& chunk : chunks) {
+                for (size_t offset = 0; offset < chunk.data.size(); offset += kMaxRecordPayload) {
+                    size_t size = std::min(kMaxRecordPayload, chunk.data.size() - offset);
+                    WriteRecord(terminalId, chunk.type, chunk.data.data() + offset, size);
+                }
+                flushed += chunk.data.size();
+            }
+            chunks.clear();
+            return flushed;
+        }
+        
+        void TerminalForwarder::QueueAck(const std::string& terminalId, size_t bytes, Acks& acks) {
+            if (NativeBridge::GetInstance().GetStreamBacklog() > kMaxStreamBacklog) {
+                held_acks_[terminalId] += bytes;
+                return;
+            }
+            
+            // Earlier held bytes go out with these once the renderer has caught up
+            auto held = held_acks_.find(terminalId);
+            if (held != held_acks_.end()) {
+                bytes += held->second;
+                held_acks_.erase(held);
+            }
+            acks[terminalId] += bytes;
+        }
+        
+        void TerminalForwarder::SendAcks(const Acks& acks) {
+            Utils::TerminalManager& terminals = Utils::Terminal::GetInstance();
+            for (const auto& ack : acks) {
+                terminals.AcknowledgeOutput(ack.first, ack.second);
+            }
+        }
+        
+        void TerminalForwarder::WriteRecord(const std::string& terminalId, uint8_t type,
+                                            const char* data, size_t size) {
+            const size_t idLength = std::min<size_t>(terminalId.size(), 255);
+            record_.resize(2 + idLength + size);
+            record_[0] = type;
+            record_[1] = static_cast<uint8_t>(idLength);
+            memcpy(record_.data() + 2, terminalId.data(), idLength);
+            if (size > 0) {
+                memcpy(record_.data() + 2 + idLength, data, size);
+            }
+            NativeBridge::GetInstance().BroadcastStream(kTerminalOutputStream, record_.data(), record_.size());
+        }
+        
+    }
+}
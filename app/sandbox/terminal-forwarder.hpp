@@ -0,0 +1,77 @@
+#pragma once
+#include "../utils/terminal.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace MikoIDE {
+    namespace Sandbox {
+        
+        // Coalesces PTY output per terminal and forwards it to every renderer
+        // on the kTerminalOutputStream stream channel. Reads are buffered and
+        // flushed at most once per frame, or as soon as a terminal has
+        // kFlushThreshold bytes waiting, so a build spewing output costs one
+        // stream record per terminal per frame instead of one IPC per read.
+        //
+        // Output is acknowledged to the terminal (see
+        // TerminalProcess::AcknowledgeOutput) once it is in a stream ring. While
+        // a renderer is too slow to drain its ring, acknowledgements are held
+        // back until it catches up, so the PTY reads pause instead of the
+        // stream backlog growing.
+        //
+        // Terminals with a native screen (TerminalProcess::EnableScreen) send
+        // kTerminalRecordScreen diffs instead, taken once per frame, so output
+        // that is overwritten within a frame never crosses to the renderer.
+        //
+        // Compiler diagnostics found in a terminal's output go out as
+        // kTerminalRecordDiagnostics records, batched per frame like screens.
+        class TerminalForwarder {
+        public:
+            static constexpr size_t kFlushThreshold = 64 * 1024;
+            static constexpr int kFrameIntervalMs = 16;
+            
+            TerminalForwarder();
+            
+            // TerminalManager global output callback; reader threads
+            void OnOutput(const std::string& terminalId, const Utils::TerminalMessage& message);
+            
+            // Frame tick; UI thread
+            void Flush();
+            
+            // A stream channel's backlog drained; releases held acknowledgements
+            void OnStreamDrained();
+            
+        private:
+            struct Chunk {
+                uint8_t type;
+                std::string data;
+            };
+            
+            using Acks = std::map<std::string, size_t>;
+            
+            void Append(const std::string& terminalId, uint8_t type, const char* data, size_t size, Acks& acks);
+            void ScheduleFlushLocked();
+            void FlushLocked(Acks& acks);
+            size_t FlushTerminal(const std::string& terminalId, std::vector<Chunk>& chunks);
+            void WriteScreen(const std::string& terminalId);
+            void WriteDiagnostics(const std::string& terminalId);
+            void QueueAck(const std::string& terminalId, size_t bytes, Acks& acks);
+            static void SendAcks(const Acks& acks);
+            void WriteRecord(const std::string& terminalId, uint8_t type, const char* data, size_t size);
+            
+            std::map<std::string, std::vector<Chunk>> pending_;
+            std::set<std::string> dirty_screens_;
+            std::set<std::string> pending_diagnostics_;
+            size_t pending_bytes_;
+            Acks held_acks_;
+            bool flush_scheduled_;
+            std::vector<uint8_t> record_;
+            std::mutex mutex_;
+        };
+        
+    }
+}
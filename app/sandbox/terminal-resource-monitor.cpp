@@ -0,0 +1,134 @@
+#include "terminal-resource-monitor.hpp"
+#include "bridge-messages.hpp"
+#include "native-bridge.hpp"
+#include "../utils/terminal.hpp"
+#include <algorithm>
+#include <vector>
+
+namespace MikoIDE {
+    namespace Sandbox {
+        
+        namespace {
+            // Smaller changes are not worth a record
+            constexpr uint32_t kCpuThresholdPermille = 5;
+            constexpr uint32_t kRssThresholdKib = 256;
+            
+            uint32_t Distance(uint32_t a, uint32_t b) {
+                return a > b ? a - b : b - a;
+            }
+        }
+        
+        TerminalResourceMonitor::TerminalResourceMonitor() : stopping_(false) {
+        }
+        
+        TerminalResourceMonitor::~TerminalResourceMonitor() {
+            Stop();
+        }
+        
+        void TerminalResourceMonitor::Start() {
+            if (thread_.joinable() || !Utils::ProcessSampler::IsSupported()) {
+                return;
+            }
+            stopping_ = false;
+            thread_ = std::thread(&TerminalResourceMonitor::Run, this);
+        }
+        
+        void TerminalResourceMonitor::Stop() {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stopping_ = true;
+            }
+            wake_.notify_all();
+            if (thread_.joinable()) {
+                thread_.join();
+            }
+        }
+        
+        void TerminalResourceMonitor::Run() {
+            Utils::ProcessSampler sampler;
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (!wake_.wait_for(lock, std::chrono::milliseconds(kIntervalMs), [this] { return stopping_; })) {
+                lock.unlock();
+                SampleTerminals(sampler);
+                lock.lock();
+            }
+        }
+        
+        void TerminalResourceMonitor::SampleTerminals(Utils::ProcessSampler& sampler) {
+            Utils::TerminalManager& manager = Utils::Terminal::GetInstance();
+            std::vector<std::string> ids;
+            std::vector<int> pids;
+            for (const std::string& terminalId : manager.GetActiveTerminals()) {
+                auto terminal = manager.GetTerminal(terminalId);
+                if (terminal && terminal->GetProcessId() > 0) {
+                    ids.push_back(terminalId);
+                    pids.push_back(terminal->GetProcessId());
+                }
+            }
+            
+            // Closed terminals are forgotten
+            for (auto it = terminals_.begin(); it != terminals_.end();) {
+                if (std::find(ids.begin(), ids.end(), it->first) == ids.end()) {
+                    it = terminals_.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            if (ids.empty()) {
+                return;
+            }
+            
+            std::vector<Utils::ProcessTreeUsage> usage;
+            if (!sampler.Sample(pids, usage)) {
+                return;
+            }
+            const auto now = std::chrono::steady_clock::now();
+            
+            for (size_t i = 0; i < ids.size(); ++i) {
+                const Utils::ProcessTreeUsage& tree = usage[i];
+                if (tree.processes == 0) {
+                    continue;
+                }
+                
+                // CPU is a rate, so a terminal's first sample only sets the baseline
+                TerminalState& state = terminals_[ids[i]];
+                const bool first = state.pid != pids[i];
+                uint32_t cpuPermille = 0;
+                if (!first) {
+                    const auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(now - state.sampled_at).count();
+                    if (elapsedMs > 0 && tree.cpu_time_ms > state.cpu_time_ms) {
+                        cpuPermille = static_cast<uint32_t>((tree.cpu_time_ms - state.cpu_time_ms) * 1000 /
+                                                            static_cast<uint64_t>(elapsedMs));
+                    }
+                }
+                state.pid = pids[i];
+                state.cpu_time_ms = tree.cpu_time_ms;
+                state.sampled_at = now;
+                
+                const uint32_t rssKib = static_cast<uint32_t>(std::min<uint64_t>(tree.rss_bytes / 1024, UINT32_MAX));
+                if (first || (state.published && Distance(cpuPermille, state.cpu_permille) < kCpuThresholdPermille &&
+                              Distance(rssKib, state.rss_kib) < kRssThresholdKib && tree.threads == state.threads &&
+                              tree.processes == state.processes)) {
+                    continue;
+                }
+                state.published = true;
+                state.cpu_permille = cpuPermille;
+                state.rss_kib = rssKib;
+                state.threads = tree.threads;
+                state.processes = tree.processes;
+                Publish(ids[i], state);
+            }
+        }
+        
+        void TerminalResourceMonitor::Publish(const std::string& terminalId, const TerminalState& state) {
+            const uint32_t values[] = {state.cpu_permille, state.rss_kib, state.threads, state.processes};
+            const size_t idLength = std::min<size_t>(terminalId.size(), 255);
+            record_.assign(1, static_cast<char>(kTerminalRecordResources));
+            record_.push_back(static_cast<char>(idLength));
+            record_.append(terminalId, 0, idLength);
+            record_.append(reinterpret_cast<const char*>(values), sizeof(values));
+            NativeBridge::GetInstance().BroadcastStream(kTerminalOutputStream, record_.data(), record_.size());
+        }
+        
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "../utils/process-sampler.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace MikoIDE {
+    namespace Sandbox {
+        
+        // Samples the process tree of every running terminal once per
+        // kIntervalMs on one thread of its own (see Utils::ProcessSampler) and
+        // streams kTerminalRecordResources records for the terminals whose
+        // usage changed noticeably since the last record, so an idle terminal
+        // costs nothing on the stream. Does nothing where sampling is not
+        // supported.
+        class TerminalResourceMonitor {
+        public:
+            static constexpr int kIntervalMs = 1000;
+            
+            TerminalResourceMonitor();
+            ~TerminalResourceMonitor();
+            
+            void Start();
+            void Stop();
+        
+        private:
+            struct TerminalState {
+                int pid = -1;
+                uint64_t cpu_time_ms = 0;
+                std::chrono::steady_clock::time_point sampled_at;
+                bool published = false;
+                uint32_t cpu_permille = 0;
+                uint32_t rss_kib = 0;
+                uint32_t threads = 0;
+                uint32_t processes = 0;
+            };
+            
+            void Run();
+            void SampleTerminals(Utils::ProcessSampler& sampler);
+            void Publish(const std::string& terminalId, const TerminalState& state);
+            
+            std::map<std::string, TerminalState> terminals_;   // monitor thread
+            std::string record_;
+            std::thread thread_;
+            std::mutex mutex_;
+            std::condition_variable wake_;
+            bool stopping_;
+        };
+        
+    }
+}
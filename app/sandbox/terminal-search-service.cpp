@@ -0,0 +1,180 @@
+#include "terminal-search-service.hpp"
+#include "bridge-messages.hpp"
+#include "native-bridge.hpp"
+#include "../utils/terminal.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+namespace MikoIDE {
+    namespace Sandbox {
+        
+        namespace {
+            // Keeps each record well under the ring's maximum record size
+            constexpr size_t kMaxRecordPayload = 256 * 1024;
+            
+            void AppendBytes(std::string& out, const void* data, size_t size) {
+                out.append(static_cast<const char*>(data), size);
+            }
+            
+            void AppendU32(std::string& out, uint32_t value) {
+                AppendBytes(out, &value, sizeof(value));
+            }
+            
+            std::string BeginMatchRecord(const std::string& terminalId) {
+                std::string record;
+                record.push_back(static_cast<char>(kSearchRecordMatches));
+                record.push_back(static_cast<char>(terminalId.size()));
+                record += terminalId;
+                AppendU32(record, 0);
+                return record;
+            }
+        }
+        
+        TerminalSearchService::TerminalSearchService() {
+        }
+        
+        uint32_t TerminalSearchService::Start(const std::string& query, CefRefPtr<CefDictionaryValue> options) {
+            Utils::TerminalSearchOptions searchOptions;
+            if (options->HasKey("regex")) {
+                searchOptions.regex = options->GetBool("regex");
+            }
+            if (options->HasKey("caseSensitive")) {
+                searchOptions.case_sensitive = options->GetBool("caseSensitive");
+            }
+            if (options->HasKey("terminalId")) {
+                searchOptions.terminal_id = options->GetString("terminalId");
+            }
+            if (options->HasKey("maxMatches") && options->GetInt("maxMatches") > 0) {
+                searchOptions.max_matches = static_cast<size_t>(options->GetInt("maxMatches"));
+            }
+            
+            const uint32_t searchId = NativeBridge::GetInstance().AllocateStreamId();
+            std::string error;
+            auto search = Utils::TerminalSearch::Create(
+                query, searchOptions,
+                [this, searchId](const std::string& terminalId, const std::vector<Utils::TerminalSearchMatch>& matches) {
+                    OnMatches(searchId, terminalId, matches);
+                },
+                [this, searchId](size_t matchCount, bool cancelled, bool truncated) {
+                    OnDone(searchId, matchCount, cancelled, truncated);
+                },
+                error);
+            if (!search) {
+                throw std::invalid_argument(error);
+            }
+            
+            // Registered before it starts, since it may finish (and unregister)
+            // before Start returns
+            Utils::ThreadPool* pool;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!pool_) {
+                    pool_ = std::make_unique<Utils::ThreadPool>(std::max(2u, std::thread::hardware_concurrency() / 2));
+                }
+                pool = pool_.get();
+                searches_[searchId] = search;
+                held_[searchId];
+            }
+            NativeBridge::GetInstance().RunAfterResult([this, searchId]() { Release(searchId); });
+            search->Start(Utils::Terminal::GetInstance(), *pool);
+            return searchId;
+        }
+        
+        bool TerminalSearchService::Cancel(uint32_t searchId) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = searches_.find(searchId);
+            if (it == searches_.end()) {
+                return false;
+            }
+            it->second->Cancel();
+            return true;
+        }
+        
+        void TerminalSearchService::Shutdown() {
+            Utils::ThreadPool* pool;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                for (auto& search : searches_) {
+                    search.second->Cancel();
+                }
+                pool = pool_.get();
+            }
+            // The done callbacks take mutex_, so join outside it. The pool is
+            // kept; searches started after this find it stopped and end at once.
+            if (pool) {
+                pool->Shutdown();
+            }
+        }
+        
+        void TerminalSearchService::OnMatches(uint32_t searchId, const std::string& terminalId,
+                                              const std::vector<Utils::TerminalSearchMatch>& matches) {
+            std::string record = BeginMatchRecord(terminalId);
+            const size_t countOffset = record.size() - sizeof(uint32_t);
+            uint32_t count = 0;
+            
+            auto send = [&]() {
+                memcpy(&record[countOffset], &count, sizeof(count));
+                Send(searchId, record);
+                record.resize(countOffset + sizeof(uint32_t));
+                count = 0;
+            };
+            
+            for (const Utils::TerminalSearchMatch& match : matches) {
+                const double line = static_cast<double>(match.line);
+                AppendBytes(record, &line, sizeof(line));
+                AppendU32(record, match.column);
+                AppendU32(record, match.length);
+                AppendU32(record, static_cast<uint32_t>(match.text.size()));
+                record += match.text;
+                ++count;
+                if (record.size() >= kMaxRecordPayload) {
+                    send();
+                }
+            }
+            if (count > 0) {
+                send();
+            }
+        }
+        
+        void TerminalSearchService::OnDone(uint32_t searchId, size_t matchCount, bool cancelled, bool truncated) {
+            std::string record;
+            record.push_back(static_cast<char>(kSearchRecordDone));
+            AppendU32(record, static_cast<uint32_t>(matchCount));
+            record.push_back(static_cast<char>((cancelled ? kSearchFlagCancelled : 0) |
+                                               (truncated ? kSearchFlagTruncated : 0)));
+            Send(searchId, std::move(record));
+            
+            std::lock_guard<std::mutex> lock(mutex_);
+            searches_.erase(searchId);
+        }
+        
+        void TerminalSearchService::Send(uint32_t searchId, std::string record) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto it = held_.find(searchId);
+                if (it != held_.end()) {
+                    it->second.push_back(std::move(record));
+                    return;
+                }
+            }
+            NativeBridge::GetInstance().BroadcastStream(searchId, record.data(), record.size());
+        }
+        
+        void TerminalSearchService::Release(uint32_t searchId) {
+            // Flushed under the lock, so a record sent meanwhile waits and
+            // goes out after the held ones
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = held_.find(searchId);
+            if (it == held_.end()) {
+                return;
+            }
+            for (const std::string& record : it->second) {
+                NativeBridge::GetInstance().BroadcastStream(searchId, record.data(), record.size());
+            }
+            held_.erase(it);
+        }
+        
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "include/cef_values.h"
+#include "../utils/terminal-search.hpp"
+#include "../utils/thread-pool.hpp"
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace MikoIDE {
+    namespace Sandbox {
+        
+        // Backs the "searchTerminals" and "cancelTerminalSearch" native
+        // functions. Each search gets a stream id, returned to the caller, and
+        // its matches are written to that stream as they are found (records in
+        // bridge-messages.hpp), ending with a done record. Searches run on a
+        // pool of their own so a long scan never holds up native calls. Records
+        // are held back until the call's result has been sent, so the page
+        // always knows the id before its first record arrives.
+        class TerminalSearchService {
+        public:
+            TerminalSearchService();
+            
+            // |options|: {regex, caseSensitive, terminalId, maxMatches}, all
+            // optional. Returns the search's stream id; throws on a bad query.
+            uint32_t Start(const std::string& query, CefRefPtr<CefDictionaryValue> options);
+            
+            // False if the search already finished
+            bool Cancel(uint32_t searchId);
+            
+            // Cancels every search and waits for the workers
+            void Shutdown();
+        
+        private:
+            void OnMatches(uint32_t searchId, const std::string& terminalId,
+                           const std::vector<Utils::TerminalSearchMatch>& matches);
+            void OnDone(uint32_t searchId, size_t matchCount, bool cancelled, bool truncated);
+            void Send(uint32_t searchId, std::string record);
+            // UI thread, once "searchTerminals" has returned |searchId|
+            void Release(uint32_t searchId);
+            
+            std::unique_ptr<Utils::ThreadPool> pool_;   // created by the first search, never reset
+            std::map<uint32_t, std::shared_ptr<Utils::TerminalSearch>> searches_;
+            std::map<uint32_t, std::vector<std::string>> held_;     // records of unreleased searches
+            std::mutex mutex_;
+        };
+        
+    }
+}
@@ -1,4 +1,5 @@
 #include "v8-context-manager.hpp"
+#include "bridge-metrics.hpp"
 #include "../core/logger.hpp"
 #include "native-function-handler.hpp"
 
@@ -12,9 +13,9 @@ namespace MikoIDE {
             Cleanup();
         }
         
-        bool V8ContextManager::Initialize() {
+        bool V8ContextManager::Initialize(CefRefPtr<CefV8Context> context) {
             try {
-                SetupV8Context();
+                SetupV8Context(context);
                 return v8_context_ != nullptr;
             } catch (const std::exception& e) {
                 Logger::LogMessage("Failed to initialize V8 context: " + std::string(e.what()));
@@ -36,7 +37,10 @@ namespace MikoIDE {
             CefRefPtr<CefV8Value> retval;
             CefRefPtr<CefV8Exception> exception;
             
+            const BridgeMetrics::Clock::time_point started = BridgeMetrics::Clock::now();
             bool success = v8_context_->Eval(script, CefString(), 0, retval, exception);
+            BridgeMetrics::GetInstance().Record("executeScript", BridgeMetrics::Clock::now() - started,
+                                                script.size(), !success);
             
             if (!success && exception) {
                 Logger::LogMessage("Script execution failed: " + exception->GetMessage().ToString());
@@ -46,10 +50,11 @@ namespace MikoIDE {
             return success;
         }
         
-        void V8ContextManager::SetupV8Context() {
-            // This would typically be called from a CEF render process
-            // For now, we'll set up a basic context
-            if (CefV8Context::InContext()) {
+        void V8ContextManager::SetupV8Context(CefRefPtr<CefV8Context> context) {
+            // The render process handler passes the context from OnContextCreated
+            if (context && context->IsValid()) {
+                v8_context_ = context;
+            } else if (CefV8Context::InContext()) {
                 v8_context_ = CefV8Context::GetCurrentContext();
             }
         }
@@ -61,9 +66,11 @@ namespace MikoIDE {
             
             CefRefPtr<CefV8Value> global = v8_context_->GetGlobal();
             
-            // Create console object
-            CefRefPtr<CefV8Value> console = CefV8Value::CreateObject(nullptr, nullptr);
-            global->SetValue("console", console, V8_PROPERTY_ATTRIBUTE_NONE);
+            // Globals are created before page scripts run, so keep the page's console
+            if (!global->HasValue("console")) {
+                CefRefPtr<CefV8Value> console = CefV8Value::CreateObject(nullptr, nullptr);
+                global->SetValue("console", console, V8_PROPERTY_ATTRIBUTE_NONE);
+            }
         }
         
         void V8ContextManager::RegisterFunction(const std::string& name, CefRefPtr<CefV8Handler> handler) {
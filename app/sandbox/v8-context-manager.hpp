@@ -12,7 +12,8 @@ namespace MikoIDE {
             V8ContextManager();
             ~V8ContextManager();
             
-            bool Initialize();
+            // Binds to |context|, or to the current context when none is given
+            bool Initialize(CefRefPtr<CefV8Context> context = nullptr);
             void Cleanup();
             
             bool ExecuteScript(const std::string& script);
@@ -26,7 +27,7 @@ namespace MikoIDE {
             CefRefPtr<CefV8Context> v8_context_;
             CefRefPtr<CefBrowser> browser_;
             
-            void SetupV8Context();
+            void SetupV8Context(CefRefPtr<CefV8Context> context);
         };
     }
 }
\ No newline at end of file
@@ -0,0 +1,344 @@
+#include "value-codec.hpp"
+#include <climits>
+#include <cmath>
+#include <vector>
+
+namespace MikoIDE {
+    namespace Sandbox {
+        
+        namespace {
+            bool IsInt(double number) {
+                return std::isfinite(number) && std::trunc(number) == number && number >= INT_MIN && number <= INT_MAX;
+            }
+            
+            // Typed arrays and DataViews have no CefV8Value type of their own
+            // and would otherwise marshal as objects keyed by index. Returns
+            // the view's ArrayBuffer, or nullptr if |value| is not a view.
+            // ArrayBuffer.isView runs first, so "buffer" is never read (and a
+            // getter by that name never runs) on a plain object.
+            CefRefPtr<CefV8Value> GetViewBuffer(CefRefPtr<CefV8Value> value) {
+                CefRefPtr<CefV8Context> context = CefV8Context::GetCurrentContext();
+                CefRefPtr<CefV8Value> arrayBuffer = context ? context->GetGlobal()->GetValue("ArrayBuffer") : nullptr;
+                CefRefPtr<CefV8Value> isView = arrayBuffer ? arrayBuffer->GetValue("isView") : nullptr;
+                if (!isView || !isView->IsFunction()) {
+                    return nullptr;
+                }
+                CefRefPtr<CefV8Value> result = isView->ExecuteFunction(arrayBuffer, {value});
+                if (!result || !result->IsBool() || !result->GetBoolValue()) {
+                    return nullptr;
+                }
+                CefRefPtr<CefV8Value> buffer = value->GetValue("buffer");
+                return buffer && buffer->IsArrayBuffer() ? buffer : nullptr;
+            }
+        }
+        
+        CefRefPtr<CefValue> ValueCodec::FromV8(CefRefPtr<CefV8Value> value, std::string& error) {
+            Walk walk;
+            return FromV8(value, walk, error);
+        }
+        
+        CefRefPtr<CefValue> ValueCodec::FromV8(CefRefPtr<CefV8Value> value, Walk& walk, std::string& error) {
+            // Shared references are walked again wherever they appear, so
+            // without a total a small DAG can expand exponentially
+            if (++walk.values > kMaxValues) {
+                error = "value is too large";
+                return nullptr;
+            }
+            if (walk.path.size() > static_cast<size_t>(kMaxDepth)) {
+                error = "value is nested too deeply";
+                return nullptr;
+            }
+            if (value && value->IsObject()) {
+                for (const auto& ancestor : walk.path) {
+                    if (ancestor->IsSame(value)) {
+                        error = "value is cyclic";
+                        return nullptr;
+                    }
+                }
+            }
+            
+            CefRefPtr<CefValue> result = CefValue::Create();
+            CefRefPtr<CefV8Value> viewBuffer;
+            if (!value || value->IsUndefined() || value->IsNull()) {
+                result->SetNull();
+            } else if (value->IsBool()) {
+                result->SetBool(value->GetBoolValue());
+            } else if (value->IsInt()) {
+                result->SetInt(value->GetIntValue());
+            } else if (value->IsUInt() || value->IsDouble()) {
+                // Keeps integral doubles as ints on the native side when they fit
+                double number = value->GetDoubleValue();
+                if (IsInt(number)) {
+                    result->SetInt(static_cast<int>(number));
+                } else {
+                    result->SetDouble(number);
+                }
+            } else if (value->IsString()) {
+                result->SetString(value->GetStringValue());
+            } else if (value->IsArrayBuffer()) {
+                // CefBinaryValue cannot be empty; empty buffers arrive as null
+                size_t size = value->GetArrayBufferByteLength();
+                if (size > 0) {
+                    result->SetBinary(CefBinaryValue::Create(value->GetArrayBufferData(), size));
+                } else {
+                    result->SetNull();
+                }
+            } else if (value->IsObject() && !value->IsArray() && (viewBuffer = GetViewBuffer(value))) {
+                // Only the view's bytes, not the whole buffer behind it
+                CefRefPtr<CefV8Value> offsetValue = value->GetValue("byteOffset");
+                CefRefPtr<CefV8Value> lengthValue = value->GetValue("byteLength");
+                const size_t offset = offsetValue && offsetValue->IsUInt() ? offsetValue->GetUIntValue() : 0;
+                const size_t size = lengthValue && lengthValue->IsUInt() ? lengthValue->GetUIntValue() : 0;
+                const void* data = viewBuffer->GetArrayBufferData();
+                const size_t bufferSize = viewBuffer->GetArrayBufferByteLength();
+                if (offset > bufferSize || size > bufferSize - offset || (size > 0 && !data)) {
+                    error = "unsupported value type";
+                    return nullptr;
+                }
+                if (size > 0) {
+                    result->SetBinary(CefBinaryValue::Create(static_cast<const char*>(data) + offset, size));
+                } else {
+                    result->SetNull();
+                }
+            } else if (value->IsArray()) {
+                CefRefPtr<CefListValue> list = CefListValue::Create();
+                int length = value->GetArrayLength();
+                list->SetSize(length);
+                walk.path.push_back(value);
+                for (int i = 0; i < length; ++i) {
+                    CefRefPtr<CefValue> item = FromV8(value->GetValue(i), walk, error);
+                    if (!item) {
+                        return nullptr;
+                    }
+                    list->SetValue(i, item);
+                }
+                walk.path.pop_back();
+                result->SetList(list);
+            } else if (value->IsFunction()) {
+                error = "functions cannot be passed to native code";
+                return nullptr;
+            } else if (value->IsObject()) {
+                CefRefPtr<CefDictionaryValue> dictionary = CefDictionaryValue::Create();
+                std::vector<CefString> keys;
+                value->GetKeys(keys);
+                walk.path.push_back(value);
+                for (const CefString& key : keys) {
+                    CefRefPtr<CefV8Value> member = value->GetValue(key);
+                    if (member && member->IsFunction()) {
+                        continue;  // methods are not data
+                    }
+                    CefRefPtr<CefValue> item = FromV8(member, walk, error);
+                    if (!item) {
+                        return nullptr;
+                    }
+                    dictionary->SetValue(key, item);
+                }
+                walk.path.pop_back();
+                result->SetDictionary(dictionary);
+            } else {
+                error = "unsupported value type";
+                return nullptr;
+            }
+            
+            return result;
+        }
+        
+        CefRefPtr<CefV8Value> ValueCodec::ToV8(CefRefPtr<CefValue> value) {
+            return ToV8(value, 0);
+        }
+        
+        CefRefPtr<CefV8Value> ValueCodec::ToV8(CefRefPtr<CefValue> value, int depth) {
+            if (!value || depth > kMaxDepth) {
+                return CefV8Value::CreateUndefined();
+            }
+            
+            switch (value->GetType()) {
+                case VTYPE_BOOL:
+                    return CefV8Value::CreateBool(value->GetBool());
+                case VTYPE_INT:
+                    return CefV8Value::CreateInt(value->GetInt());
+                case VTYPE_DOUBLE:
+                    return CefV8Value::CreateDouble(value->GetDouble());
+                case VTYPE_STRING:
+                    return CefV8Value::CreateString(value->GetString());
+                case VTYPE_BINARY: {
+                    CefRefPtr<CefBinaryValue> binary = value->GetBinary();
+                    return CefV8Value::CreateArrayBufferWithCopy(const_cast<void*>(binary->GetRawData()),
+                                                                 binary->GetSize());
+                }
+                case VTYPE_LIST: {
+                    CefRefPtr<CefListValue> list = value->GetList();
+                    CefRefPtr<CefV8Value> array = CefV8Value::CreateArray(static_cast<int>(list->GetSize()));
+                    for (size_t i = 0; i < list->GetSize(); ++i) {
+                        array->SetValue(static_cast<int>(i), ToV8(list->GetValue(i), depth + 1));
+                    }
+                    return array;
+                }
+                case VTYPE_DICTIONARY: {
+                    CefRefPtr<CefDictionaryValue> dictionary = value->GetDictionary();
+                    CefRefPtr<CefV8Value> object = CefV8Value::CreateObject(nullptr, nullptr);
+                    CefDictionaryValue::KeyList keys;
+                    dictionary->GetKeys(keys);
+                    for (const CefString& key : keys) {
+                        object->SetValue(key, ToV8(dictionary->GetValue(key), depth + 1),
+                                         V8_PROPERTY_ATTRIBUTE_NONE);
+                    }
+                    return object;
+                }
+                case VTYPE_NULL:
+                    return CefV8Value::CreateNull();
+                default:
+                    return CefV8Value::CreateUndefined();
+            }
+        }
+        
+        bool ValueCodec::ArgumentsToList(const CefV8ValueList& arguments,
+                                         CefRefPtr<CefListValue> list,
+                                         size_t offset,
+                                         std::string& error) {
+            list->SetSize(offset + arguments.size());
+            Walk walk;
+            for (size_t i = 0; i < arguments.size(); ++i) {
+                CefRefPtr<CefValue> value = FromV8(arguments[i], walk, error);
+                if (!value) {
+                    error = "argument " + std::to_string(i) + ": " + error;
+                    return false;
+                }
+                list->SetValue(offset + i, value);
+            }
+            return true;
+        }
+        
+        CefV8ValueList ValueCodec::ListToArguments(CefRefPtr<CefListValue> list, size_t offset) {
+            CefV8ValueList arguments;
+            for (size_t i = offset; list && i < list->GetSize(); ++i) {
+                arguments.push_back(ToV8(list->GetValue(i), 0));
+            }
+            return arguments;
+        }
+        
+        size_t ValueCodec::GetByteSize(CefRefPtr<CefValue> value) {
+            if (!value) {
+                return 0;
+            }
+            
+            switch (value->GetType()) {
+                case VTYPE_BOOL:
+                    return 1;
+                case VTYPE_INT:
+                    return sizeof(int);
+                case VTYPE_DOUBLE:
+                    return sizeof(double);
+                case VTYPE_STRING:
+                    return value->GetString().length();
+                case VTYPE_BINARY:
+                    return value->GetBinary()->GetSize();
+                case VTYPE_LIST:
+                    return GetByteSize(value->GetList());
+                case VTYPE_DICTIONARY: {
+                    CefRefPtr<CefDictionaryValue> dictionary = value->GetDictionary();
+                    CefDictionaryValue::KeyList keys;
+                    dictionary->GetKeys(keys);
+                    size_t size = 0;
+                    for (const auto& key : keys) {
+                        size += key.length() + GetByteSize(dictionary->GetValue(key));
+                    }
+                    return size;
+                }
+                default:
+                    return 0;
+            }
+        }
+        
+        size_t ValueCodec::GetByteSize(CefRefPtr<CefListValue> list) {
+            size_t size = 0;
+            for (size_t i = 0; list && i < list->GetSize(); ++i) {
+                size += GetByteSize(list->GetValue(i));
+            }
+            return size;
+        }
+        
+        std::string ValueCodec::GetString(CefRefPtr<CefListValue> args, size_t index, const std::string& fallback) {
+            if (!args || index >= args->GetSize() || args->GetType(index) != VTYPE_STRING) {
+                return fallback;
+            }
+            return args->GetString(index).ToString();
+        }
+        
+        int ValueCodec::GetInt(CefRefPtr<CefListValue> args, size_t index, int fallback) {
+            if (!args || index >= args->GetSize()) {
+                return fallback;
+            }
+            switch (args->GetType(index)) {
+                case VTYPE_INT:
+                    return args->GetInt(index);
+                case VTYPE_DOUBLE:
+                    // A fraction or a value int cannot hold is not an int
+                    return IsInt(args->GetDouble(index)) ? static_cast<int>(args->GetDouble(index)) : fallback;
+                default:
+                    return fallback;
+            }
+        }
+        
+        double ValueCodec::GetDouble(CefRefPtr<CefListValue> args, size_t index, double fallback) {
+            if (!args || index >= args->GetSize()) {
+                return fallback;
+            }
+            switch (args->GetType(index)) {
+                case VTYPE_INT:
+                    return args->GetInt(index);
+                case VTYPE_DOUBLE:
+                    return args->GetDouble(index);
+                default:
+                    return fallback;
+            }
+        }
+        
+        bool ValueCodec::GetBool(CefRefPtr<CefListValue> args, size_t index, bool fallback) {
+            if (!args || index >= args->GetSize() || args->GetType(index) != VTYPE_BOOL) {
+                return fallback;
+            }
+            return args->GetBool(index);
+        }
+        
+        CefRefPtr<CefValue> ValueCodec::Null() {
+            CefRefPtr<CefValue> value = CefValue::Create();
+            value->SetNull();
+            return value;
+        }
+        
+        CefRefPtr<CefValue> ValueCodec::Bool(bool value) {
+            CefRefPtr<CefValue> result = CefValue::Create();
+            result->SetBool(value);
+            return result;
+        }
+        
+        CefRefPtr<CefValue> ValueCodec::Int(int value) {
+            CefRefPtr<CefValue> result = CefValue::Create();
+            result->SetInt(value);
+            return result;
+        }
+        
+        CefRefPtr<CefValue> ValueCodec::Double(double value) {
+            CefRefPtr<CefValue> result = CefValue::Create();
+            result->SetDouble(value);
+            return result;
+        }
+        
+        CefRefPtr<CefValue> ValueCodec::String(const std::string& value) {
+            CefRefPtr<CefValue> result = CefValue::Create();
+            result->SetString(value);
+            return result;
+        }
+        
+        CefRefPtr<CefValue> ValueCodec::Binary(const void* data, size_t size) {
+            CefRefPtr<CefValue> result = CefValue::Create();
+            if (size > 0) {
+                result->SetBinary(CefBinaryValue::Create(data, size));
+            } else {
+                result->SetNull();
+            }
+            return result;
+        }
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include "include/cef_v8.h"
+#include "include/cef_values.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace MikoIDE {
+    namespace Sandbox {
+        
+        // Native functions receive their arguments already marshaled by
+        // ValueCodec and return a value for JS (nullptr means undefined).
+        // Throwing std::exception surfaces as a JS exception.
+        using NativeFunction = std::function<CefRefPtr<CefValue>(CefRefPtr<CefListValue> args)>;
+        
+        // Converts between V8 values and CefValue trees, the representation
+        // native functions and CefProcessMessage arguments use.
+        //
+        //   undefined/null -> VTYPE_NULL        bool   -> VTYPE_BOOL
+        //   int32          -> VTYPE_INT         number -> VTYPE_DOUBLE
+        //   string         -> VTYPE_STRING      array  -> VTYPE_LIST
+        //   ArrayBuffer    -> VTYPE_BINARY      object -> VTYPE_DICTIONARY
+        //   typed array, DataView -> VTYPE_BINARY
+        //
+        // ArrayBuffers are copied byte-for-byte into CefBinaryValue and back,
+        // so file contents and terminal data never pass through UTF-16 strings.
+        // A view contributes only the bytes it covers and comes back as an
+        // ArrayBuffer. Functions and other host objects cannot be marshaled.
+        class ValueCodec {
+        public:
+            // Objects nested deeper than kMaxDepth, cyclic values, and values
+            // of more than kMaxValues nodes are rejected. An object reached
+            // twice through shared references counts twice.
+            static constexpr int kMaxDepth = 64;
+            static constexpr size_t kMaxValues = 1 << 20;
+            
+            // Must be called with the owning V8 context entered
+            static CefRefPtr<CefValue> FromV8(CefRefPtr<CefV8Value> value, std::string& error);
+            static CefRefPtr<CefV8Value> ToV8(CefRefPtr<CefValue> value);
+            
+            // Marshals call arguments into |list| starting at |offset|, e.g. after
+            // a request id in a process message argument list
+            static bool ArgumentsToList(const CefV8ValueList& arguments,
+                                        CefRefPtr<CefListValue> list,
+                                        size_t offset,
+                                        std::string& error);
+            static CefV8ValueList ListToArguments(CefRefPtr<CefListValue> list, size_t offset);
+            
+            // Approximate payload size of a marshaled value: string and binary
+            // lengths plus fixed sizes for scalars, summed through containers
+            static size_t GetByteSize(CefRefPtr<CefValue> value);
+            static size_t GetByteSize(CefRefPtr<CefListValue> list);
+            
+            // Convenience accessors for native functions; numbers are accepted
+            // as either int or double, and GetInt only takes a double that is
+            // an int
+            static std::string GetString(CefRefPtr<CefListValue> args, size_t index,
+                                         const std::string& fallback = "");
+            static int GetInt(CefRefPtr<CefListValue> args, size_t index, int fallback = 0);
+            static double GetDouble(CefRefPtr<CefListValue> args, size_t index, double fallback = 0.0);
+            static bool GetBool(CefRefPtr<CefListValue> args, size_t index, bool fallback = false);
+            
+            // Convenience constructors for native function results
+            static CefRefPtr<CefValue> Null();
+            static CefRefPtr<CefValue> Bool(bool value);
+            static CefRefPtr<CefValue> Int(int value);
+            static CefRefPtr<CefValue> Double(double value);
+            static CefRefPtr<CefValue> String(const std::string& value);
+            static CefRefPtr<CefValue> Binary(const void* data, size_t size);
+            
+        private:
+            // Objects and arrays from the root to the value being marshaled,
+            // and the number of values marshaled so far
+            struct Walk {
+                std::vector<CefRefPtr<CefV8Value>> path;
+                size_t values = 0;
+            };
+            
+            static CefRefPtr<CefValue> FromV8(CefRefPtr<CefV8Value> value, Walk& walk, std::string& error);
+            static CefRefPtr<CefV8Value> ToV8(CefRefPtr<CefValue> value, int depth);
+        };
+    }
+}
@@ -1,9 +1,8 @@
 #include "manager.hpp"
-#include "../core/logger.hpp"
+#include "../../core/logger.hpp"
 #include <fstream>
 #include <sstream>
 #include <filesystem>
-#include <json/json.h> // You may need to add JSON library
 
 namespace MikoIDE {
     namespace Sandbox {
@@ -0,0 +1,155 @@
+#include "byte-buffer.hpp"
+#include <new>
+
+namespace MikoIDE {
+    namespace Utils {
+        
+        struct ByteBuffer::Slot {
+            std::atomic<uint32_t> references;
+            uint32_t size;
+            ByteBufferPool* pool;
+            Slot* next_free;
+            
+            char* GetData() { return reinterpret_cast<char*>(this + 1); }
+        };
+        
+        ByteBuffer::ByteBuffer(const ByteBuffer& other) : slot_(other.slot_) {
+            if (slot_) {
+                slot_->references.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        
+        ByteBuffer& ByteBuffer::operator=(const ByteBuffer& other) {
+            if (slot_ != other.slot_) {
+                Reset();
+                slot_ = other.slot_;
+                if (slot_) {
+                    slot_->references.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+            return *this;
+        }
+        
+        ByteBuffer& ByteBuffer::operator=(ByteBuffer&& other) noexcept {
+            if (this != &other) {
+                Reset();
+                slot_ = other.slot_;
+                other.slot_ = nullptr;
+            }
+            return *this;
+        }
+        
+        char* ByteBuffer::GetData() {
+            return slot_ ? slot_->GetData() : nullptr;
+        }
+        
+        const char* ByteBuffer::GetData() const {
+            return slot_ ? slot_->GetData() : nullptr;
+        }
+        
+        size_t ByteBuffer::GetSize() const {
+            return slot_ ? slot_->size : 0;
+        }
+        
+        size_t ByteBuffer::GetCapacity() const {
+            return slot_ ? ByteBufferPool::kBufferSize : 0;
+        }
+        
+        void ByteBuffer::SetSize(size_t size) {
+            if (slot_) {
+                slot_->size = static_cast<uint32_t>(size < ByteBufferPool::kBufferSize ? size : ByteBufferPool::kBufferSize);
+            }
+        }
+        
+        void ByteBuffer::Reset() {
+            if (slot_ && slot_->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                slot_->pool->Release(slot_);
+            }
+            slot_ = nullptr;
+        }
+        
+        ByteBufferPool& ByteBufferPool::GetInstance() {
+            // Never destroyed: terminal reader threads may still hold buffers
+            // while other statics are torn down
+            static ByteBufferPool* instance = new ByteBufferPool();
+            return *instance;
+        }
+        
+        ByteBufferPool::ByteBufferPool() : free_(nullptr), free_count_(0) {
+        }
+        
+        ByteBufferPool::~ByteBufferPool() {
+        }
+        
+        ByteBuffer ByteBufferPool::Acquire() {
+            // Slot header plus data, keeping every header 16-byte aligned
+            constexpr size_t kSlotStride = (sizeof(ByteBuffer::Slot) + kBufferSize + 15) & ~size_t(15);
+            
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!free_) {
+                slabs_.emplace_back(new char[kSlotStride * kBuffersPerSlab + 15]);
+                char* base = reinterpret_cast<char*>(
+                    (reinterpret_cast<uintptr_t>(slabs_.back().get()) + 15) & ~uintptr_t(15));
+                for (size_t i = kBuffersPerSlab; i-- > 0;) {
+                    ByteBuffer::Slot* slot = new (base + i * kSlotStride) ByteBuffer::Slot;
+                    slot->pool = this;
+                    slot->next_free = free_;
+                    free_ = slot;
+                }
+                free_count_ += kBuffersPerSlab;
+            }
+            
+            ByteBuffer::Slot* slot = free_;
+            free_ = slot->next_free;
+            --free_count_;
+            slot->references.store(1, std::memory_order_relaxed);
+            slot->size = 0;
+            return ByteBuffer(slot);
+        }
+        
+        void ByteBufferPool::Release(ByteBuffer::Slot* slot) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            slot->next_free = free_;
+            free_ = slot;
+            ++free_count_;
+        }
+        
+        size_t ByteBufferPool::GetSlabCount() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return slabs_.size();
+        }
+        
+        size_t ByteBufferPool::GetFreeCount() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return free_count_;
+        }
+        
+        size_t Utf8CompleteLength(const char* data, size_t size) {
+            // Find the last lead byte within the final four bytes
+            size_t lead = size;
+            for (size_t back = 1; back <= 4 && back <= size; ++back) {
+                const uint8_t byte = static_cast<uint8_t>(data[size - back]);
+                if ((byte & 0xc0) != 0x80) {
+                    lead = size - back;
+                    break;
+                }
+            }
+            if (lead == size) {
+                // No lead byte nearby: plain ASCII tail or stray continuations
+                return size;
+            }
+            
+            const uint8_t byte = static_cast<uint8_t>(data[lead]);
+            size_t length = 1;
+            if ((byte & 0xe0) == 0xc0) {
+                length = 2;
+            } else if ((byte & 0xf0) == 0xe0) {
+                length = 3;
+            } else if ((byte & 0xf8) == 0xf0) {
+                length = 4;
+            }
+            return size - lead < length ? lead : size;
+        }
+        
+    }
+}
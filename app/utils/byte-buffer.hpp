@@ -0,0 +1,85 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace MikoIDE {
+    namespace Utils {
+        
+        class ByteBufferPool;
+        
+        // Handle to a fixed-capacity byte buffer from ByteBufferPool. Copies
+        // share the buffer through an atomic reference count, and the last
+        // handle returns it to the pool, so passing output between threads
+        // and callbacks never allocates. A buffer is written by whoever
+        // acquired it and treated as immutable once shared.
+        class ByteBuffer {
+        public:
+            ByteBuffer() : slot_(nullptr) {}
+            ByteBuffer(const ByteBuffer& other);
+            ByteBuffer(ByteBuffer&& other) noexcept : slot_(other.slot_) { other.slot_ = nullptr; }
+            ByteBuffer& operator=(const ByteBuffer& other);
+            ByteBuffer& operator=(ByteBuffer&& other) noexcept;
+            ~ByteBuffer() { Reset(); }
+            
+            char* GetData();
+            const char* GetData() const;
+            size_t GetSize() const;
+            size_t GetCapacity() const;
+            void SetSize(size_t size);
+            
+            void Reset();
+            explicit operator bool() const { return slot_ != nullptr; }
+        
+        private:
+            friend class ByteBufferPool;
+            struct Slot;
+            
+            explicit ByteBuffer(Slot* slot) : slot_(slot) {}
+            
+            Slot* slot_;
+        };
+        
+        // Buffers of kBufferSize carved from 1 MB slabs and recycled through a
+        // free list. Slabs are kept once allocated; flow control bounds how
+        // many buffers are in flight. Thread-safe.
+        class ByteBufferPool {
+        public:
+            static constexpr size_t kBufferSize = 16 * 1024;
+            static constexpr size_t kBuffersPerSlab = 64;
+            
+            static ByteBufferPool& GetInstance();
+            
+            ByteBufferPool();
+            ~ByteBufferPool();
+            
+            ByteBufferPool(const ByteBufferPool&) = delete;
+            ByteBufferPool& operator=(const ByteBufferPool&) = delete;
+            
+            // An empty buffer of kBufferSize capacity
+            ByteBuffer Acquire();
+            
+            size_t GetSlabCount();
+            size_t GetFreeCount();
+        
+        private:
+            friend class ByteBuffer;
+            
+            void Release(ByteBuffer::Slot* slot);
+            
+            std::vector<std::unique_ptr<char[]>> slabs_;
+            ByteBuffer::Slot* free_;
+            size_t free_count_;
+            std::mutex mutex_;
+        };
+        
+        // Length of the longest prefix of |data| that does not end inside a
+        // UTF-8 sequence; the rest (at most 3 bytes) belongs with what follows.
+        // Invalid bytes count as complete, so nothing is held back forever.
+        size_t Utf8CompleteLength(const char* data, size_t size);
+        
+    }
+}
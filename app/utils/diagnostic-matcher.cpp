@@ -0,0 +1,358 @@
+#include "diagnostic-matcher.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace MikoIDE {
+    namespace Utils {
+        
+        namespace {
+            struct SeverityWord {
+                const char* word;
+                size_t length;
+                DiagnosticSeverity severity;
+            };
+            
+            // Also the prefilter needles, in this order
+            const SeverityWord kSeverityWords[] = {
+                {"error", 5, DiagnosticSeverity::Error},
+                {"warning", 7, DiagnosticSeverity::Warning},
+                {"note", 4, DiagnosticSeverity::Note},
+            };
+            constexpr size_t kSeverityWordCount = sizeof(kSeverityWords) / sizeof(kSeverityWords[0]);
+            
+            bool IsDigit(char c) {
+                return c >= '0' && c <= '9';
+            }
+            
+            bool IsAlnum(char c) {
+                return IsDigit(c) || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
+            }
+            
+            // Returns the position after the escape sequence whose ESC is at |p| - 1
+            const char* SkipEscape(const char* p, const char* end) {
+                if (p == end) {
+                    return end;
+                }
+                if (*p == '[') {
+                    // CSI: parameter and intermediate bytes, then the final byte
+                    for (++p; p < end; ++p) {
+                        if (*p >= 0x40 && *p <= 0x7e) {
+                            return p + 1;
+                        }
+                    }
+                    return end;
+                }
+                if (*p == ']' || *p == 'P' || *p == '_' || *p == '^') {
+                    // String sequences (OSC 8 links, titles) end with BEL or ST
+                    for (++p; p < end; ++p) {
+                        if (*p == '\a') {
+                            return p + 1;
+                        }
+                        if (*p == 0x1b && p + 1 < end && p[1] == '\\') {
+                            return p + 2;
+                        }
+                    }
+                    return end;
+                }
+                if (*p == '(' || *p == ')' || *p == '*' || *p == '+') {
+                    return std::min(p + 2, end);
+                }
+                return p + 1;
+            }
+            
+            // The line as it would show: escapes and control characters
+            // removed, and text before a carriage return overwritten
+            void StripLine(const char* begin, const char* end, std::string& text) {
+                text.clear();
+                bool returned = false;
+                for (const char* p = begin; p < end;) {
+                    const char c = *p++;
+                    if (c == 0x1b) {
+                        p = SkipEscape(p, end);
+                    } else if (c == '\r') {
+                        returned = true;
+                    } else if (static_cast<unsigned char>(c) >= 0x20 || c == '\t') {
+                        if (returned) {
+                            text.clear();
+                            returned = false;
+                        }
+                        text.push_back(c);
+                    }
+                }
+            }
+            
+            bool ParseNumber(const std::string& text, size_t begin, size_t end, uint32_t& value) {
+                if (begin >= end || end - begin > 9) {
+                    return false;
+                }
+                value = 0;
+                for (size_t i = begin; i < end; ++i) {
+                    if (!IsDigit(text[i])) {
+                        return false;
+                    }
+                    value = value * 10 + static_cast<uint32_t>(text[i] - '0');
+                }
+                return true;
+            }
+            
+            std::string Trim(const std::string& text, size_t begin) {
+                size_t end = text.size();
+                while (begin < end && (text[begin] == ' ' || text[begin] == '\t')) {
+                    ++begin;
+                }
+                while (end > begin && (text[end - 1] == ' ' || text[end - 1] == '\t')) {
+                    --end;
+                }
+                return text.substr(begin, end - begin);
+            }
+        }
+        
+        DiagnosticMatcher::DiagnosticMatcher()
+            : finders_{LiteralFinder(kSeverityWords[0].word), LiteralFinder(kSeverityWords[1].word),
+                       LiteralFinder(kSeverityWords[2].word)},
+              header_pending_(false) {
+        }
+        
+        void DiagnosticMatcher::Feed(const char* data, size_t size, std::vector<Diagnostic>& out) {
+            if (size == 0) {
+                return;
+            }
+            const char* p = data;
+            const char* end = data + size;
+            
+            if (!partial_.empty()) {
+                const char* newline = static_cast<const char*>(memchr(p, '\n', size));
+                const size_t length = static_cast<size_t>((newline ? newline : end) - p);
+                partial_.append(p, std::min(length, kMaxLineLength - std::min(partial_.size(), kMaxLineLength)));
+                if (!newline) {
+                    return;
+                }
+                MatchLine(partial_.data(), partial_.data() + partial_.size(), out);
+                partial_.clear();
+                p = newline + 1;
+            }
+            
+            const char* last = end;
+            while (last > p && last[-1] != '\n') {
+                --last;
+            }
+            ScanLines(p, last, out);
+            partial_.assign(last, std::min(static_cast<size_t>(end - last), kMaxLineLength));
+        }
+        
+        void DiagnosticMatcher::Finish(std::vector<Diagnostic>& out) {
+            if (!partial_.empty()) {
+                MatchLine(partial_.data(), partial_.data() + partial_.size(), out);
+                partial_.clear();
+            }
+            header_pending_ = false;
+        }
+        
+        void DiagnosticMatcher::ScanLines(const char* begin, const char* end, std::vector<Diagnostic>& out) {
+            // Next occurrence of each severity word, null once there is none
+            const char* next[kSeverityWordCount];
+            for (size_t i = 0; i < kSeverityWordCount; ++i) {
+                next[i] = finders_[i].Find(begin, end);
+            }
+            
+            const char* p = begin;
+            while (p < end) {
+                // A rustc header's location is on the line after it, which
+                // holds no severity word
+                if (header_pending_) {
+                    const char* newline = static_cast<const char*>(memchr(p, '\n', static_cast<size_t>(end - p)));
+                    MatchLine(p, newline, out);
+                    p = newline + 1;
+                    continue;
+                }
+                
+                const char* hit = end;
+                for (size_t i = 0; i < kSeverityWordCount; ++i) {
+                    if (next[i] && next[i] < p) {
+                        next[i] = finders_[i].Find(p, end);
+                    }
+                    if (next[i] && next[i] < hit) {
+                        hit = next[i];
+                    }
+                }
+                if (hit == end) {
+                    break;
+                }
+                
+                const char* lineBegin = hit;
+                while (lineBegin > p && lineBegin[-1] != '\n') {
+                    --lineBegin;
+                }
+                const char* newline = static_cast<const char*>(memchr(hit, '\n', static_cast<size_t>(end - hit)));
+                MatchLine(lineBegin, newline, out);
+                p = newline + 1;
+            }
+        }
+        
+        void DiagnosticMatcher::MatchLine(const char* begin, const char* end, std::vector<Diagnostic>& out) {
+            StripLine(begin, std::min(end, begin + kMaxLineLength), text_);
+            
+            if (header_pending_) {
+                header_pending_ = false;
+                size_t arrow = text_.find_first_not_of(" \t");
+                if (arrow != std::string::npos && text_.compare(arrow, 4, "--> ") == 0 &&
+                    ParseLocation(text_, arrow + 4, text_.size(), header_)) {
+                    out.push_back(std::move(header_));
+                    return;
+                }
+            }
+            
+            Diagnostic diagnostic;
+            switch (ParseLine(text_, diagnostic)) {
+                case LineKind::Diagnostic:
+                    out.push_back(std::move(diagnostic));
+                    break;
+                case LineKind::Header:
+                    header_ = std::move(diagnostic);
+                    header_pending_ = true;
+                    break;
+                case LineKind::None:
+                    break;
+            }
+        }
+        
+        DiagnosticMatcher::LineKind DiagnosticMatcher::ParseLine(const std::string& text, Diagnostic& diagnostic) {
+            const size_t size = text.size();
+            size_t from = 0;
+            while (true) {
+                // Earliest severity word from |from|
+                size_t at = std::string::npos;
+                const SeverityWord* word = nullptr;
+                for (const SeverityWord& candidate : kSeverityWords) {
+                    const size_t found = text.find(candidate.word, from, candidate.length);
+                    if (found < at) {
+                        at = found;
+                        word = &candidate;
+                    }
+                }
+                if (!word) {
+                    return LineKind::None;
+                }
+                from = at + 1;
+                
+                size_t start = at;
+                if (word->severity == DiagnosticSeverity::Error && at >= 6 && text.compare(at - 6, 6, "fatal ") == 0) {
+                    start = at - 6;
+                }
+                
+                // What follows the word: ":" (gcc, rustc), "[CODE]:" (rustc)
+                // or " CODE:" (MSVC, tsc), where a code has a digit
+                const size_t after = at + word->length;
+                if (after >= size) {
+                    continue;
+                }
+                std::string code;
+                size_t messageBegin;
+                bool headerForm = true;
+                if (text[after] == ':') {
+                    messageBegin = after + 1;
+                } else if (text[after] == '[') {
+                    const size_t close = text.find(']', after);
+                    if (close == std::string::npos || close + 1 >= size || text[close + 1] != ':') {
+                        continue;
+                    }
+                    code = text.substr(after + 1, close - after - 1);
+                    messageBegin = close + 2;
+                } else if (text[after] == ' ') {
+                    size_t codeEnd = after + 1;
+                    while (codeEnd < size && IsAlnum(text[codeEnd])) {
+                        ++codeEnd;
+                    }
+                    if (codeEnd >= size || text[codeEnd] != ':' ||
+                        std::none_of(text.begin() + after + 1, text.begin() + codeEnd, IsDigit)) {
+                        continue;
+                    }
+                    code = text.substr(after + 1, codeEnd - after - 1);
+                    messageBegin = codeEnd + 1;
+                    headerForm = false;
+                } else {
+                    continue;
+                }
+                
+                // What precedes it: the location and ": " or " - " (tsc
+                // --pretty), or nothing for a rustc header
+                const bool header = start == 0 && headerForm;
+                if (!header &&
+                    !(start >= 2 && text.compare(start - 2, 2, ": ") == 0 && ParseLocation(text, 0, start - 2, diagnostic)) &&
+                    !(start >= 3 && text.compare(start - 3, 3, " - ") == 0 && ParseLocation(text, 0, start - 3, diagnostic))) {
+                    continue;
+                }
+                
+                diagnostic.severity = word->severity;
+                diagnostic.code = std::move(code);
+                diagnostic.message = Trim(text, messageBegin);
+                return header ? LineKind::Header : LineKind::Diagnostic;
+            }
+        }
+        
+        bool DiagnosticMatcher::ParseLocation(const std::string& text, size_t begin, size_t end,
+                                              Diagnostic& diagnostic) {
+            while (begin < end && (text[begin] == ' ' || text[begin] == '\t')) {
+                ++begin;
+            }
+            while (end > begin && text[end - 1] == ' ') {
+                --end;
+            }
+            if (end == begin) {
+                return false;
+            }
+            
+            uint32_t numbers[2];
+            int count = 0;
+            size_t fileEnd = end;
+            if (text[end - 1] == ')') {
+                // file(line) or file(line,col)
+                const size_t open = text.rfind('(', end - 1);
+                if (open == std::string::npos || open <= begin) {
+                    return false;
+                }
+                const size_t comma = text.find(',', open);
+                if (comma < end - 1) {
+                    if (!ParseNumber(text, open + 1, comma, numbers[1]) || !ParseNumber(text, comma + 1, end - 1, numbers[0])) {
+                        return false;
+                    }
+                    count = 2;
+                } else {
+                    if (!ParseNumber(text, open + 1, end - 1, numbers[0])) {
+                        return false;
+                    }
+                    count = 1;
+                }
+                fileEnd = open;
+            } else {
+                // file:line or file:line:col; a drive letter's colon is not
+                // followed by digits
+                while (count < 2 && fileEnd > begin) {
+                    const size_t colon = text.rfind(':', fileEnd - 1);
+                    uint32_t value;
+                    if (colon == std::string::npos || colon < begin || !ParseNumber(text, colon + 1, fileEnd, value)) {
+                        break;
+                    }
+                    numbers[count++] = value;
+                    fileEnd = colon;
+                }
+            }
+            
+            while (fileEnd > begin && text[fileEnd - 1] == ' ') {
+                --fileEnd;
+            }
+            if (count == 0 || fileEnd == begin) {
+                return false;
+            }
+            const uint32_t line = count == 2 ? numbers[1] : numbers[0];
+            if (line == 0) {
+                return false;
+            }
+            diagnostic.file = text.substr(begin, fileEnd - begin);
+            diagnostic.line = line;
+            diagnostic.column = count == 2 ? numbers[0] : 0;
+            return true;
+        }
+        
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include "text-search.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace MikoIDE {
+    namespace Utils {
+        
+        enum class DiagnosticSeverity : uint8_t {
+            Error = 0,
+            Warning = 1,
+            Note = 2
+        };
+        
+        struct Diagnostic {
+            std::string file;
+            uint32_t line = 0;
+            uint32_t column = 0;        // 0 when the tool gives none
+            DiagnosticSeverity severity = DiagnosticSeverity::Error;
+            std::string code;           // "C2065", "TS2322", "E0308"; may be empty
+            std::string message;
+        };
+        
+        // Picks compiler diagnostics out of a raw output stream, one chunk at a
+        // time, in the forms
+        //
+        //   file:line[:col]: [fatal ]error|warning|note: message       gcc, clang
+        //   file(line[,col]): error|warning CODE: message              MSVC, tsc
+        //   file:line:col - error|warning CODE: message                tsc --pretty
+        //   error[CODE]|warning: message  followed by  --> file:line:col   rustc
+        //
+        // Escape sequences and carriage-return overwrites are removed first, so
+        // colored output from a terminal matches too. Most build output holds
+        // none of the severity words, so only lines where the SIMD
+        // LiteralFinder turns one up are parsed; the rest are skipped without
+        // being split into lines. Not thread-safe.
+        class DiagnosticMatcher {
+        public:
+            // A longer line is only matched on its first kMaxLineLength bytes
+            static constexpr size_t kMaxLineLength = 4096;
+            
+            DiagnosticMatcher();
+            
+            // Appends the diagnostics completed by |data|; a line split across
+            // calls is matched once its end arrives
+            void Feed(const char* data, size_t size, std::vector<Diagnostic>& out);
+            
+            // End of the stream: matches the unterminated last line
+            void Finish(std::vector<Diagnostic>& out);
+        
+        private:
+            enum class LineKind {
+                None,
+                Diagnostic,
+                Header      // rustc form; the location is on the next line
+            };
+            
+            void ScanLines(const char* begin, const char* end, std::vector<Diagnostic>& out);
+            void MatchLine(const char* begin, const char* end, std::vector<Diagnostic>& out);
+            static LineKind ParseLine(const std::string& text, Diagnostic& diagnostic);
+            // "file:line[:col]" or "file(line[,col])" in [begin, end)
+            static bool ParseLocation(const std::string& text, size_t begin, size_t end, Diagnostic& diagnostic);
+            
+            LiteralFinder finders_[3];
+            std::string partial_;       // unterminated line carried to the next Feed
+            std::string text_;          // the line being matched, escapes removed
+            Diagnostic header_;
+            bool header_pending_;
+        };
+        
+    }
+}
@@ -0,0 +1,313 @@
+#ifndef _WIN32
+#include "io-reactor.hpp"
+#include "../core/logger.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#else
+#include <poll.h>
+#endif
+
+namespace MikoIDE {
+    namespace Utils {
+        
+        namespace {
+#ifdef __linux__
+            uint32_t ToEpoll(uint32_t interest) {
+                uint32_t events = EPOLLRDHUP;
+                if (interest & IoReactor::kReadable) {
+                    events |= EPOLLIN;
+                }
+                if (interest & IoReactor::kWritable) {
+                    events |= EPOLLOUT;
+                }
+                return events;
+            }
+            
+            uint32_t FromEpoll(uint32_t events) {
+                uint32_t result = 0;
+                if (events & EPOLLIN) {
+                    result |= IoReactor::kReadable;
+                }
+                if (events & EPOLLOUT) {
+                    result |= IoReactor::kWritable;
+                }
+                if (events & (EPOLLHUP | EPOLLRDHUP | EPOLLERR)) {
+                    result |= IoReactor::kHangup;
+                }
+                return result;
+            }
+#endif
+        }
+        
+        IoReactor::IoReactor()
+            : poll_fd_(-1), wake_read_fd_(-1), wake_write_fd_(-1), stopping_(false), dispatching_fd_(-1) {
+#ifdef __linux__
+            poll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+            wake_read_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            wake_write_fd_ = wake_read_fd_;
+            
+            epoll_event event = {};
+            event.events = EPOLLIN;
+            event.data.fd = wake_read_fd_;
+            if (poll_fd_ < 0 || wake_read_fd_ < 0 ||
+                epoll_ctl(poll_fd_, EPOLL_CTL_ADD, wake_read_fd_, &event) != 0) {
+                Logger::LogMessage("Failed to create I/O reactor: " + std::string(strerror(errno)));
+            }
+#else
+            int fds[2];
+            if (pipe(fds) == 0) {
+                for (int fd : fds) {
+                    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                    fcntl(fd, F_SETFD, FD_CLOEXEC);
+                }
+                wake_read_fd_ = fds[0];
+                wake_write_fd_ = fds[1];
+            } else {
+                Logger::LogMessage("Failed to create I/O reactor: " + std::string(strerror(errno)));
+            }
+#endif
+            thread_ = std::thread(&IoReactor::Run, this);
+        }
+        
+        IoReactor::~IoReactor() {
+            stopping_ = true;
+            Wake();
+            if (thread_.joinable()) {
+                thread_.join();
+            }
+            
+            if (poll_fd_ >= 0) {
+                close(poll_fd_);
+            }
+            if (wake_write_fd_ >= 0 && wake_write_fd_ != wake_read_fd_) {
+                close(wake_write_fd_);
+            }
+            if (wake_read_fd_ >= 0) {
+                close(wake_read_fd_);
+            }
+        }
+        
+        bool IoReactor::Add(int fd, uint32_t interest, Handler handler) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!watches_.emplace(fd, Watch{interest, std::make_shared<Handler>(std::move(handler))}).second) {
+                    return false;
+                }
+            }
+            
+#ifdef __linux__
+            epoll_event event = {};
+            event.events = ToEpoll(interest);
+            event.data.fd = fd;
+            if (epoll_ctl(poll_fd_, EPOLL_CTL_ADD, fd, &event) != 0) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                watches_.erase(fd);
+                return false;
+            }
+#else
+            // poll() picks the new set up on its next pass
+            Wake();
+#endif
+            return true;
+        }
+        
+        bool IoReactor::Modify(int fd, uint32_t interest) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto it = watches_.find(fd);
+                if (it == watches_.end()) {
+                    return false;
+                }
+                if (it->second.interest == interest) {
+                    return true;
+                }
+                it->second.interest = interest;
+            }
+            
+#ifdef __linux__
+            epoll_event event = {};
+            event.events = ToEpoll(interest);
+            event.data.fd = fd;
+            return epoll_ctl(poll_fd_, EPOLL_CTL_MOD, fd, &event) == 0;
+#else
+            if (!IsReactorThread()) {
+                Wake();
+            }
+            return true;
+#endif
+        }
+        
+        void IoReactor::Remove(int fd) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (watches_.erase(fd) == 0) {
+                    return;
+                }
+            }
+            
+#ifdef __linux__
+            epoll_ctl(poll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+#else
+            Wake();
+#endif
+            
+            // A handler that looked the watch up before the erase may still be
+            // running; handlers looked up afterwards will not find it. Other
+            // fds' handlers are not waited for.
+            if (!IsReactorThread()) {
+                std::unique_lock<std::mutex> lock(mutex_);
+                dispatch_done_.wait(lock, [this, fd]() { return dispatching_fd_ != fd; });
+            }
+        }
+        
+        void IoReactor::Post(std::function<void()> task) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                tasks_.push_back(std::move(task));
+            }
+            Wake();
+        }
+        
+        size_t IoReactor::GetWatchCount() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return watches_.size();
+        }
+        
+        void IoReactor::Wake() {
+            if (wake_write_fd_ < 0) {
+                return;
+            }
+#ifdef __linux__
+            uint64_t one = 1;
+            ssize_t result = write(wake_write_fd_, &one, sizeof(one));
+#else
+            char byte = 0;
+            ssize_t result = write(wake_write_fd_, &byte, 1);
+#endif
+            // EAGAIN means a wakeup is already pending
+            (void)result;
+        }
+        
+        void IoReactor::DrainWakeups() {
+#ifdef __linux__
+            uint64_t count;
+            while (read(wake_read_fd_, &count, sizeof(count)) > 0) {
+            }
+#else
+            char buffer[64];
+            while (read(wake_read_fd_, buffer, sizeof(buffer)) > 0) {
+            }
+#endif
+        }
+        
+        void IoReactor::Dispatch(int fd, uint32_t events) {
+            std::shared_ptr<Handler> handler;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto it = watches_.find(fd);
+                if (it == watches_.end()) {
+                    return;
+                }
+                handler = it->second.handler;
+                dispatching_fd_ = fd;
+            }
+            (*handler)(events);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                dispatching_fd_ = -1;
+            }
+            dispatch_done_.notify_all();
+        }
+        
+        void IoReactor::RunPostedTasks() {
+            std::vector<std::function<void()>> tasks;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                tasks.swap(tasks_);
+            }
+            for (auto& task : tasks) {
+                task();
+            }
+        }
+        
+        void IoReactor::Run() {
+#ifdef __linux__
+            epoll_event events[64];
+            while (!stopping_) {
+                int count = epoll_wait(poll_fd_, events, 64, -1);
+                if (count < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    Logger::LogMessage("I/O reactor stopped: " + std::string(strerror(errno)));
+                    return;
+                }
+                
+                for (int i = 0; i < count; ++i) {
+                    if (events[i].data.fd == wake_read_fd_) {
+                        DrainWakeups();
+                    } else {
+                        Dispatch(events[i].data.fd, FromEpoll(events[i].events));
+                    }
+                }
+                RunPostedTasks();
+            }
+#else
+            std::vector<pollfd> fds;
+            while (!stopping_) {
+                fds.clear();
+                fds.push_back({wake_read_fd_, POLLIN, 0});
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    for (const auto& watch : watches_) {
+                        short events = 0;
+                        if (watch.second.interest & kReadable) {
+                            events |= POLLIN;
+                        }
+                        if (watch.second.interest & kWritable) {
+                            events |= POLLOUT;
+                        }
+                        fds.push_back({watch.first, events, 0});
+                    }
+                }
+                
+                if (poll(fds.data(), static_cast<nfds_t>(fds.size()), -1) < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    Logger::LogMessage("I/O reactor stopped: " + std::string(strerror(errno)));
+                    return;
+                }
+                
+                if (fds[0].revents) {
+                    DrainWakeups();
+                }
+                for (size_t i = 1; i < fds.size(); ++i) {
+                    uint32_t events = 0;
+                    if (fds[i].revents & POLLIN) {
+                        events |= kReadable;
+                    }
+                    if (fds[i].revents & POLLOUT) {
+                        events |= kWritable;
+                    }
+                    if (fds[i].revents & (POLLHUP | POLLERR | POLLNVAL)) {
+                        events |= kHangup;
+                    }
+                    if (events) {
+                        Dispatch(fds[i].fd, events);
+                    }
+                }
+                RunPostedTasks();
+            }
+#endif
+        }
+        
+    }
+}
+#endif
@@ -0,0 +1,82 @@
+#pragma once
+#ifndef _WIN32
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace MikoIDE {
+    namespace Utils {
+        
+        // One thread multiplexing many non-blocking file descriptors: epoll
+        // on Linux, poll() elsewhere. Cross-thread work is handed over with
+        // Post() and wakes the loop through an eventfd (a pipe without
+        // eventfd), so the thread only runs when something is ready.
+        //
+        // Handlers run on the reactor thread and must not block.
+        class IoReactor {
+        public:
+            enum Events : uint32_t {
+                kReadable = 1 << 0,
+                kWritable = 1 << 1,
+                kHangup = 1 << 2    // reported regardless of interest
+            };
+            
+            using Handler = std::function<void(uint32_t events)>;
+            
+            IoReactor();
+            ~IoReactor();
+            
+            IoReactor(const IoReactor&) = delete;
+            IoReactor& operator=(const IoReactor&) = delete;
+            
+            // Registers |fd| (already non-blocking) for |interest|
+            bool Add(int fd, uint32_t interest, Handler handler);
+            bool Modify(int fd, uint32_t interest);
+            
+            // Unregisters |fd|. Off the reactor thread this also waits for a
+            // handler already running for it, so the caller may close the fd.
+            void Remove(int fd);
+            
+            // Runs |task| on the reactor thread
+            void Post(std::function<void()> task);
+            
+            bool IsReactorThread() const { return std::this_thread::get_id() == thread_.get_id(); }
+            size_t GetWatchCount();
+            
+        private:
+            struct Watch {
+                uint32_t interest;
+                std::shared_ptr<Handler> handler;
+            };
+            
+            void Run();
+            void Wake();
+            void DrainWakeups();
+            void Dispatch(int fd, uint32_t events);
+            void RunPostedTasks();
+            
+            int poll_fd_;       // epoll instance; -1 with poll()
+            int wake_read_fd_;  // eventfd, or the read end of the wake pipe
+            int wake_write_fd_;
+            std::atomic<bool> stopping_;
+            
+            std::map<int, Watch> watches_;
+            std::vector<std::function<void()>> tasks_;
+            std::mutex mutex_;
+            
+            // fd whose handler is running, or -1, so Remove() can wait out
+            // that one handler; guarded by mutex_
+            int dispatching_fd_;
+            std::condition_variable dispatch_done_;
+            std::thread thread_;
+        };
+        
+    }
+}
+#endif
@@ -0,0 +1,84 @@
+#include "latency-histogram.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace MikoIDE {
+    namespace Utils {
+        
+        namespace {
+            // Values below 2^kSubBucketBits get a bucket each; above that, every
+            // power of two gets 2^(kSubBucketBits - 1) linear sub-buckets
+            constexpr int kSubBucketBits = 6;
+            constexpr uint64_t kSubBucketCount = 1ull << kSubBucketBits;
+            constexpr uint64_t kSubBucketHalf = kSubBucketCount / 2;
+            constexpr int kMaxExponent = 40;
+            constexpr uint64_t kMaxValue = (1ull << (kMaxExponent + 1)) - 1;
+            constexpr size_t kBucketCount = kSubBucketCount + (kMaxExponent - kSubBucketBits + 1) * kSubBucketHalf;
+            
+            int HighestBit(uint64_t value) {
+                int bit = 0;
+                while (value >>= 1) {
+                    ++bit;
+                }
+                return bit;
+            }
+        }
+        
+        LatencyHistogram::LatencyHistogram()
+            : buckets_(kBucketCount, 0), count_(0), sum_(0), max_(0) {
+        }
+        
+        size_t LatencyHistogram::BucketIndex(uint64_t value) {
+            if (value < kSubBucketCount) {
+                return static_cast<size_t>(value);
+            }
+            const int exponent = HighestBit(value);
+            const uint64_t mantissa = value >> (exponent - kSubBucketBits + 1);  // [32, 64)
+            return static_cast<size_t>(kSubBucketCount + (exponent - kSubBucketBits) * kSubBucketHalf +
+                                       (mantissa - kSubBucketHalf));
+        }
+        
+        uint64_t LatencyHistogram::BucketUpperBound(size_t index) {
+            if (index < kSubBucketCount) {
+                return index;
+            }
+            const size_t offset = index - kSubBucketCount;
+            const int shift = static_cast<int>(offset / kSubBucketHalf) + 1;
+            const uint64_t mantissa = kSubBucketHalf + offset % kSubBucketHalf;
+            return ((mantissa + 1) << shift) - 1;
+        }
+        
+        void LatencyHistogram::Record(uint64_t nanoseconds) {
+            const uint64_t value = std::min(nanoseconds, kMaxValue);
+            ++buckets_[BucketIndex(value)];
+            ++count_;
+            sum_ += value;
+            max_ = std::max(max_, value);
+        }
+        
+        void LatencyHistogram::Reset() {
+            std::fill(buckets_.begin(), buckets_.end(), 0);
+            count_ = 0;
+            sum_ = 0;
+            max_ = 0;
+        }
+        
+        uint64_t LatencyHistogram::GetPercentile(double percentile) const {
+            if (count_ == 0) {
+                return 0;
+            }
+            
+            const double clamped = std::min(std::max(percentile, 0.0), 100.0);
+            const uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(clamped / 100.0 * count_)));
+            uint64_t seen = 0;
+            for (size_t i = 0; i < buckets_.size(); ++i) {
+                seen += buckets_[i];
+                if (seen >= target) {
+                    return std::min(BucketUpperBound(i), max_);
+                }
+            }
+            return max_;
+        }
+        
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace MikoIDE {
+    namespace Utils {
+        
+        // HDR-style latency histogram over nanoseconds. Buckets are log-linear:
+        // each power of two is split into 32 sub-buckets, so any reported
+        // percentile is within ~3% of the true value while memory stays fixed
+        // (about 9 KB) regardless of how many samples are recorded.
+        // Not thread-safe.
+        class LatencyHistogram {
+        public:
+            LatencyHistogram();
+            
+            // Values above 2^41 - 1 ns (~36.6 minutes) are clamped
+            void Record(uint64_t nanoseconds);
+            void Reset();
+            
+            uint64_t GetCount() const { return count_; }
+            uint64_t GetMax() const { return max_; }
+            double GetMean() const { return count_ ? static_cast<double>(sum_) / count_ : 0.0; }
+            
+            // Highest value equivalent to the |percentile| (0-100) sample
+            uint64_t GetPercentile(double percentile) const;
+            
+        private:
+            static size_t BucketIndex(uint64_t value);
+            static uint64_t BucketUpperBound(size_t index);
+            
+            std::vector<uint64_t> buckets_;
+            uint64_t count_;
+            uint64_t sum_;
+            uint64_t max_;
+        };
+        
+    }
+}
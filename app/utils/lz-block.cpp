@@ -0,0 +1,168 @@
+#include "lz-block.hpp"
+#include <cstring>
+#include <vector>
+
+namespace MikoIDE {
+    namespace Utils {
+        namespace LzBlock {
+            
+            namespace {
+                constexpr int kHashBits = 14;
+                constexpr size_t kMinMatch = 4;
+                constexpr size_t kMaxOffset = 65535;
+                
+                uint32_t Read32(const uint8_t* p) {
+                    uint32_t value;
+                    memcpy(&value, p, sizeof(value));
+                    return value;
+                }
+                
+                uint32_t Hash(uint32_t value) {
+                    return (value * 2654435761u) >> (32 - kHashBits);
+                }
+                
+                void AppendLength(std::string& out, size_t length) {
+                    while (length >= 255) {
+                        out.push_back(static_cast<char>(255));
+                        length -= 255;
+                    }
+                    out.push_back(static_cast<char>(length));
+                }
+                
+                void AppendSequence(std::string& out, const uint8_t* literals, size_t literalLength,
+                                    size_t offset, size_t matchLength) {
+                    const size_t matchCode = matchLength ? matchLength - kMinMatch : 0;
+                    uint8_t token = static_cast<uint8_t>((literalLength < 15 ? literalLength : 15) << 4 |
+                                                         (matchCode < 15 ? matchCode : 15));
+                    out.push_back(static_cast<char>(token));
+                    if (literalLength >= 15) {
+                        AppendLength(out, literalLength - 15);
+                    }
+                    out.append(reinterpret_cast<const char*>(literals), literalLength);
+                    if (matchLength == 0) {
+                        return;
+                    }
+                    out.push_back(static_cast<char>(offset & 0xff));
+                    out.push_back(static_cast<char>(offset >> 8));
+                    if (matchCode >= 15) {
+                        AppendLength(out, matchCode - 15);
+                    }
+                }
+                
+                bool ReadLength(const uint8_t*& in, const uint8_t* end, size_t& length) {
+                    uint8_t byte;
+                    do {
+                        if (in >= end) {
+                            return false;
+                        }
+                        byte = *in++;
+                        length += byte;
+                    } while (byte == 255);
+                    return true;
+                }
+            }
+            
+            void Compress(const void* data, size_t size, std::string& out) {
+                const uint8_t* src = static_cast<const uint8_t*>(data);
+                const uint8_t* anchor = src;
+                const uint8_t* end = src + size;
+                
+                if (size >= kMinMatch + 1) {
+                    // Positions are stored +1 so zero means empty
+                    std::vector<uint32_t> table(size_t(1) << kHashBits, 0);
+                    const uint8_t* limit = end - kMinMatch;
+                    const uint8_t* ip = src;
+                    
+                    while (ip < limit) {
+                        const uint32_t sequence = Read32(ip);
+                        const uint32_t hash = Hash(sequence);
+                        const uint32_t candidate = table[hash];
+                        table[hash] = static_cast<uint32_t>(ip - src) + 1;
+                        
+                        if (candidate == 0) {
+                            ++ip;
+                            continue;
+                        }
+                        const uint8_t* ref = src + candidate - 1;
+                        if (static_cast<size_t>(ip - ref) > kMaxOffset || Read32(ref) != sequence) {
+                            ++ip;
+                            continue;
+                        }
+                        
+                        size_t matchLength = kMinMatch;
+                        while (ip + matchLength < end && ip[matchLength] == ref[matchLength]) {
+                            ++matchLength;
+                        }
+                        AppendSequence(out, anchor, static_cast<size_t>(ip - anchor),
+                                       static_cast<size_t>(ip - ref), matchLength);
+                        
+                        // Index a position inside the match so runs keep matching
+                        const uint8_t* next = ip + matchLength;
+                        if (next - 2 > ip && next - 2 < limit) {
+                            table[Hash(Read32(next - 2))] = static_cast<uint32_t>(next - 2 - src) + 1;
+                        }
+                        ip = next;
+                        anchor = ip;
+                    }
+                }
+                
+                AppendSequence(out, anchor, static_cast<size_t>(end - anchor), 0, 0);
+            }
+            
+            bool Decompress(const void* data, size_t compressedSize, size_t size, std::string& out) {
+                const uint8_t* in = static_cast<const uint8_t*>(data);
+                const uint8_t* end = in + compressedSize;
+                out.resize(size);
+                uint8_t* dst = reinterpret_cast<uint8_t*>(&out[0]);
+                size_t written = 0;
+                
+                while (in < end) {
+                    const uint8_t token = *in++;
+                    
+                    size_t literalLength = token >> 4;
+                    if (literalLength == 15 && !ReadLength(in, end, literalLength)) {
+                        return false;
+                    }
+                    if (literalLength > static_cast<size_t>(end - in) || literalLength > size - written) {
+                        return false;
+                    }
+                    memcpy(dst + written, in, literalLength);
+                    in += literalLength;
+                    written += literalLength;
+                    
+                    if (in == end) {
+                        break;
+                    }
+                    
+                    if (end - in < 2) {
+                        return false;
+                    }
+                    const size_t offset = in[0] | (in[1] << 8);
+                    in += 2;
+                    size_t matchLength = token & 0x0f;
+                    if (matchLength == 15 && !ReadLength(in, end, matchLength)) {
+                        return false;
+                    }
+                    matchLength += kMinMatch;
+                    if (offset == 0 || offset > written || matchLength > size - written) {
+                        return false;
+                    }
+                    
+                    // Overlapping copies repeat the last |offset| bytes
+                    const uint8_t* ref = dst + written - offset;
+                    if (offset >= matchLength) {
+                        memcpy(dst + written, ref, matchLength);
+                    } else {
+                        for (size_t i = 0; i < matchLength; ++i) {
+                            dst[written + i] = ref[i];
+                        }
+                    }
+                    written += matchLength;
+                }
+                
+                return written == size;
+            }
+            
+        }
+    }
+}
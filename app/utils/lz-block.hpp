@@ -0,0 +1,31 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace MikoIDE {
+    namespace Utils {
+        
+        // Small LZ77 block codec in the spirit of LZ4: greedy single-probe
+        // hash matching with a 64 KB window, byte-aligned sequences and no entropy
+        // stage. Meant for short-lived in-process data such as terminal
+        // scrollback, where decode speed matters more than ratio. The format
+        // is not stable across versions and must not be persisted.
+        //
+        // Sequence: token (literal length << 4 | match length - 4), extra
+        // literal length bytes, literals, u16 offset, extra match length
+        // bytes. Lengths of 15 continue in following bytes while 255. The
+        // last sequence has literals only.
+        namespace LzBlock {
+            
+            // Appends the compressed form of |data| to |out|
+            void Compress(const void* data, size_t size, std::string& out);
+            
+            // Replaces |out| with the decompressed block; |size| must be the
+            // original length. Returns false on corrupt input.
+            bool Decompress(const void* data, size_t compressedSize, size_t size, std::string& out);
+            
+        }
+        
+    }
+}
@@ -0,0 +1,200 @@
+#include "process-sampler.hpp"
+#include <algorithm>
+
+#ifdef __linux__
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <unordered_map>
+#endif
+
+namespace MikoIDE {
+    namespace Utils {
+
+#ifdef __linux__
+        namespace {
+            // /proc/<pid>/stat fields, numbered as in proc(5)
+            constexpr int kFieldPpid = 4;
+            constexpr int kFieldUtime = 14;
+            constexpr int kFieldCstime = 17;
+            constexpr int kFieldThreads = 20;
+            constexpr int kFieldRss = 24;
+            
+            bool IsPid(const char* name) {
+                if (!*name) {
+                    return false;
+                }
+                for (; *name; ++name) {
+                    if (*name < '0' || *name > '9') {
+                        return false;
+                    }
+                }
+                return true;
+            }
+        }
+        
+        ProcessSampler::ProcessSampler() : proc_fd_(open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC)) {
+        }
+        
+        ProcessSampler::~ProcessSampler() {
+            if (proc_fd_ != -1) {
+                close(proc_fd_);
+            }
+        }
+        
+        bool ProcessSampler::IsSupported() {
+            return true;
+        }
+        
+        bool ProcessSampler::ReadStat(const char* pid, ProcessStat& stat) {
+            char path[32];
+            snprintf(path, sizeof(path), "%s/stat", pid);
+            int fd = openat(proc_fd_, path, O_RDONLY | O_CLOEXEC);
+            if (fd == -1) {
+                return false;   // exited since the directory was listed
+            }
+            char buffer[1024];
+            ssize_t size = read(fd, buffer, sizeof(buffer) - 1);
+            close(fd);
+            if (size <= 0) {
+                return false;
+            }
+            buffer[size] = '\0';
+            
+            // The command name may hold spaces and parentheses; fields
+            // resume after the last ')'
+            char* p = static_cast<char*>(memrchr(buffer, ')', static_cast<size_t>(size)));
+            if (!p) {
+                return false;
+            }
+            stat.pid = atoi(pid);
+            stat.cpu_ticks = 0;
+            ++p;
+            for (int field = 3; field <= kFieldRss; ++field) {
+                while (*p == ' ') {
+                    ++p;
+                }
+                if (!*p) {
+                    return false;
+                }
+                char* end;
+                const long long value = strtoll(p, &end, 10);
+                if (field == kFieldPpid) {
+                    stat.ppid = static_cast<int>(value);
+                } else if (field >= kFieldUtime && field <= kFieldCstime) {
+                    stat.cpu_ticks += value > 0 ? static_cast<uint64_t>(value) : 0;
+                } else if (field == kFieldThreads) {
+                    stat.threads = static_cast<uint32_t>(value);
+                } else if (field == kFieldRss) {
+                    stat.rss_pages = value > 0 ? static_cast<uint64_t>(value) : 0;
+                }
+                p = strchr(p, ' ');
+                if (!p) {
+                    return field == kFieldRss;
+                }
+            }
+            return true;
+        }
+        
+        bool ProcessSampler::Sample(const std::vector<int>& roots, std::vector<ProcessTreeUsage>& usage) {
+            usage.assign(roots.size(), ProcessTreeUsage());
+            if (proc_fd_ == -1) {
+                return false;
+            }
+            
+            DIR* dir = opendir("/proc");
+            if (!dir) {
+                return false;
+            }
+            processes_.clear();
+            ProcessStat stat;
+            while (dirent* entry = readdir(dir)) {
+                if (IsPid(entry->d_name) && ReadStat(entry->d_name, stat)) {
+                    processes_.push_back(stat);
+                }
+            }
+            closedir(dir);
+            
+            // /proc lists in pid order, but sort anyway for the parent lookups
+            std::sort(processes_.begin(), processes_.end(),
+                      [](const ProcessStat& a, const ProcessStat& b) { return a.pid < b.pid; });
+            auto find = [this](int pid) -> int {
+                auto it = std::lower_bound(processes_.begin(), processes_.end(), pid,
+                                           [](const ProcessStat& process, int value) { return process.pid < value; });
+                return it != processes_.end() && it->pid == pid ? static_cast<int>(it - processes_.begin()) : -1;
+            };
+            
+            std::unordered_map<int, int> rootIndex;
+            for (size_t i = 0; i < roots.size(); ++i) {
+                if (roots[i] > 1) {
+                    rootIndex.emplace(roots[i], static_cast<int>(i));
+                }
+            }
+            
+            // Walk up from each process to the nearest root, remembering the
+            // answer for every process on the way
+            constexpr int kUnknown = -2;
+            owners_.assign(processes_.size(), kUnknown);
+            std::vector<int> path;
+            for (size_t i = 0; i < processes_.size(); ++i) {
+                int current = static_cast<int>(i);
+                int owner = -1;
+                path.clear();
+                while (owners_[current] == kUnknown && path.size() < processes_.size()) {
+                    auto root = rootIndex.find(processes_[current].pid);
+                    if (root != rootIndex.end()) {
+                        owner = root->second;
+                        owners_[current] = owner;
+                        break;
+                    }
+                    path.push_back(current);
+                    const int parent = processes_[current].ppid > 1 ? find(processes_[current].ppid) : -1;
+                    if (parent == -1) {
+                        break;
+                    }
+                    current = parent;
+                }
+                if (owners_[current] != kUnknown) {
+                    owner = owners_[current];
+                }
+                for (int visited : path) {
+                    owners_[visited] = owner;
+                }
+            }
+            
+            const uint64_t ticksPerSecond = static_cast<uint64_t>(std::max(sysconf(_SC_CLK_TCK), 1L));
+            const uint64_t pageSize = static_cast<uint64_t>(std::max(sysconf(_SC_PAGESIZE), 1L));
+            for (size_t i = 0; i < processes_.size(); ++i) {
+                if (owners_[i] < 0) {
+                    continue;
+                }
+                ProcessTreeUsage& tree = usage[owners_[i]];
+                tree.cpu_time_ms += processes_[i].cpu_ticks * 1000 / ticksPerSecond;
+                tree.rss_bytes += processes_[i].rss_pages * pageSize;
+                tree.threads += processes_[i].threads;
+                ++tree.processes;
+            }
+            return true;
+        }
+#else
+        ProcessSampler::ProcessSampler() : proc_fd_(-1) {
+        }
+        
+        ProcessSampler::~ProcessSampler() {
+        }
+        
+        bool ProcessSampler::IsSupported() {
+            return false;
+        }
+        
+        bool ProcessSampler::Sample(const std::vector<int>& roots, std::vector<ProcessTreeUsage>& usage) {
+            usage.assign(roots.size(), ProcessTreeUsage());
+            return false;
+        }
+#endif
+        
+    }
+}
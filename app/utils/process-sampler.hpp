@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace MikoIDE {
+    namespace Utils {
+        
+        // Resources held by a process and all its descendants
+        struct ProcessTreeUsage {
+            uint64_t cpu_time_ms = 0;   // user + system, including reaped children
+            uint64_t rss_bytes = 0;
+            uint32_t threads = 0;
+            uint32_t processes = 0;     // 0 when the root is gone
+        };
+        
+        // Samples the process trees under a set of root PIDs from /proc. Each
+        // Sample() reads every /proc/<pid>/stat once and attributes each
+        // process to the nearest root above it, so the cost depends on the
+        // number of processes on the machine, not on the number of roots.
+        // Buffers are kept between samples. Linux only; elsewhere Sample()
+        // returns false. Not thread-safe.
+        class ProcessSampler {
+        public:
+            ProcessSampler();
+            ~ProcessSampler();
+            
+            ProcessSampler(const ProcessSampler&) = delete;
+            ProcessSampler& operator=(const ProcessSampler&) = delete;
+            
+            static bool IsSupported();
+            
+            // Fills |usage| with one entry per root, in order
+            bool Sample(const std::vector<int>& roots, std::vector<ProcessTreeUsage>& usage);
+        
+        private:
+            struct ProcessStat {
+                int pid;
+                int ppid;
+                uint64_t cpu_ticks;
+                uint64_t rss_pages;
+                uint32_t threads;
+            };
+            
+            bool ReadStat(const char* pid, ProcessStat& stat);
+            
+            int proc_fd_;
+            std::vector<ProcessStat> processes_;
+            std::vector<int> owners_;       // per process: index of its root, or -1
+        };
+        
+    }
+}
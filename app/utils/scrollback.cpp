@@ -0,0 +1,590 @@
+#include "scrollback.hpp"
+#include "lz-block.hpp"
+#include "../core/logger.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace MikoIDE {
+    namespace Utils {
+        
+        namespace {
+            void AppendU16(std::string& out, uint32_t value) {
+                out.push_back(static_cast<char>(value & 0xff));
+                out.push_back(static_cast<char>((value >> 8) & 0xff));
+            }
+            
+            void AppendU32(std::string& out, uint32_t value) {
+                for (int i = 0; i < 4; ++i) {
+                    out.push_back(static_cast<char>((value >> (i * 8)) & 0xff));
+                }
+            }
+            
+            void StoreU16(std::string& out, size_t offset, uint32_t value) {
+                out[offset] = static_cast<char>(value & 0xff);
+                out[offset + 1] = static_cast<char>((value >> 8) & 0xff);
+            }
+            
+            uint32_t LoadU16(const char* data) {
+                return static_cast<uint8_t>(data[0]) | (static_cast<uint8_t>(data[1]) << 8);
+            }
+            
+            uint32_t LoadU32(const char* data) {
+                uint32_t value;
+                memcpy(&value, data, sizeof(value));
+                return value;
+            }
+            
+            void AppendUtf8(std::string& out, uint32_t codepoint) {
+                if (codepoint < 0x80) {
+                    out.push_back(static_cast<char>(codepoint));
+                } else if (codepoint < 0x800) {
+                    out.push_back(static_cast<char>(0xc0 | (codepoint >> 6)));
+                    out.push_back(static_cast<char>(0x80 | (codepoint & 0x3f)));
+                } else if (codepoint < 0x10000) {
+                    out.push_back(static_cast<char>(0xe0 | (codepoint >> 12)));
+                    out.push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3f)));
+                    out.push_back(static_cast<char>(0x80 | (codepoint & 0x3f)));
+                } else {
+                    out.push_back(static_cast<char>(0xf0 | (codepoint >> 18)));
+                    out.push_back(static_cast<char>(0x80 | ((codepoint >> 12) & 0x3f)));
+                    out.push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3f)));
+                    out.push_back(static_cast<char>(0x80 | (codepoint & 0x3f)));
+                }
+            }
+            
+            // Width is recomputed from the text, so it does not split runs
+            constexpr uint16_t kStoredFlagsMask =
+                static_cast<uint16_t>(~(VtScreen::kWide | VtScreen::kWideContinuation));
+        }
+        
+        // Append-only spill file. Blocks are written with pwrite and read
+        // through lazily mapped fixed-size windows, which never move once
+        // mapped; no block straddles a window. Discarded ranges are punched
+        // out so the file does not keep disk space it no longer needs.
+        class Scrollback::SpillFile {
+        public:
+#ifndef _WIN32
+            static constexpr uint64_t kWindowSize = 8 * 1024 * 1024;
+            
+            SpillFile() : fd_(-1), size_(0) {
+            }
+            
+            ~SpillFile() {
+                for (void* window : windows_) {
+                    if (window) {
+                        munmap(window, kWindowSize);
+                    }
+                }
+                if (fd_ != -1) {
+                    close(fd_);
+                }
+            }
+            
+            bool Write(const std::string& data, uint64_t& offset) {
+                if (data.empty() || data.size() > kWindowSize || !Open()) {
+                    return false;
+                }
+                if (size_ % kWindowSize + data.size() > kWindowSize) {
+                    size_ = (size_ / kWindowSize + 1) * kWindowSize;
+                }
+                
+                size_t written = 0;
+                while (written < data.size()) {
+                    ssize_t result = pwrite(fd_, data.data() + written, data.size() - written,
+                                            static_cast<off_t>(size_ + written));
+                    if (result < 0 && errno == EINTR) {
+                        continue;
+                    }
+                    if (result <= 0) {
+                        Logger::LogMessage("Scrollback spill write failed: " + std::string(strerror(errno)));
+                        return false;
+                    }
+                    written += static_cast<size_t>(result);
+                }
+                offset = size_;
+                size_ += data.size();
+                return true;
+            }
+            
+            const char* Read(uint64_t offset) {
+                const size_t index = static_cast<size_t>(offset / kWindowSize);
+                if (index >= windows_.size()) {
+                    windows_.resize(index + 1, nullptr);
+                }
+                if (!windows_[index]) {
+                    void* window = mmap(nullptr, kWindowSize, PROT_READ, MAP_SHARED, fd_,
+                                        static_cast<off_t>(index * kWindowSize));
+                    if (window == MAP_FAILED) {
+                        Logger::LogMessage("Scrollback spill mmap failed: " + std::string(strerror(errno)));
+                        return nullptr;
+                    }
+                    windows_[index] = window;
+                }
+                return static_cast<const char*>(windows_[index]) + offset % kWindowSize;
+            }
+            
+            void Discard(uint64_t offset, size_t size) {
+#if defined(__linux__) && defined(FALLOC_FL_PUNCH_HOLE)
+                // Only whole pages can be punched out
+                const uint64_t page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+                const uint64_t start = (offset + page - 1) / page * page;
+                const uint64_t end = (offset + size) / page * page;
+                if (end > start) {
+                    fallocate(fd_, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                              static_cast<off_t>(start), static_cast<off_t>(end - start));
+                }
+#else
+                (void)offset;
+                (void)size;
+#endif
+            }
+        
+        private:
+            bool Open() {
+                if (fd_ != -1) {
+                    return true;
+                }
+                const char* tmpdir = getenv("TMPDIR");
+                std::string path = std::string(tmpdir && *tmpdir ? tmpdir : "/tmp") + "/miko-scrollback-XXXXXX";
+                fd_ = mkstemp(&path[0]);
+                if (fd_ == -1) {
+                    Logger::LogMessage("Failed to create scrollback spill file: " + std::string(strerror(errno)));
+                    return false;
+                }
+                // Nothing else needs the name, and the space is freed on exit
+                unlink(path.c_str());
+                fcntl(fd_, F_SETFD, FD_CLOEXEC);
+                return true;
+            }
+            
+            int fd_;
+            uint64_t size_;
+            std::vector<void*> windows_;
+#else
+            // Scrollback over the memory budget is discarded instead
+            bool Write(const std::string&, uint64_t&) { return false; }
+            const char* Read(uint64_t) { return nullptr; }
+            void Discard(uint64_t, size_t) {}
+#endif
+        };
+        
+        // ScrollbackBudget Implementation
+        ScrollbackBudget& ScrollbackBudget::GetInstance() {
+            static ScrollbackBudget instance;
+            return instance;
+        }
+        
+        ScrollbackBudget::ScrollbackBudget()
+            : memory_used_(0)
+            , disk_used_(0)
+            , memory_limit_(kDefaultMemoryLimit)
+            , disk_limit_(kDefaultDiskLimit)
+        {
+        }
+        
+        void ScrollbackBudget::SetLimits(size_t memoryBytes, size_t diskBytes) {
+            memory_limit_ = memoryBytes;
+            disk_limit_ = diskBytes;
+            Enforce();
+        }
+        
+        size_t ScrollbackBudget::GetMemoryUsage() const {
+            return static_cast<size_t>(std::max<int64_t>(memory_used_.load(), 0));
+        }
+        
+        size_t ScrollbackBudget::GetDiskUsage() const {
+            return static_cast<size_t>(std::max<int64_t>(disk_used_.load(), 0));
+        }
+        
+        bool ScrollbackBudget::IsOverBudget() const {
+            return GetMemoryUsage() > memory_limit_.load() || GetDiskUsage() > disk_limit_.load();
+        }
+        
+        void ScrollbackBudget::Register(Scrollback* scrollback) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            scrollbacks_.push_back(scrollback);
+        }
+        
+        void ScrollbackBudget::Unregister(Scrollback* scrollback) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            scrollbacks_.erase(std::remove(scrollbacks_.begin(), scrollbacks_.end(), scrollback),
+                               scrollbacks_.end());
+        }
+        
+        void ScrollbackBudget::Enforce() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            
+            // The biggest holder pays first, so one chatty build log does not
+            // push a quiet terminal's history to disk
+            while (GetMemoryUsage() > memory_limit_.load()) {
+                Scrollback* largest = nullptr;
+                for (Scrollback* scrollback : scrollbacks_) {
+                    if (!largest || scrollback->GetResidentBlockBytes() > largest->GetResidentBlockBytes()) {
+                        largest = scrollback;
+                    }
+                }
+                if (!largest || largest->GetResidentBlockBytes() == 0 ||
+                    largest->SpillOldest(GetMemoryUsage() - memory_limit_.load()) == 0) {
+                    break;
+                }
+            }
+            
+            while (GetDiskUsage() > disk_limit_.load()) {
+                Scrollback* largest = nullptr;
+                size_t largestUsage = 0;
+                for (Scrollback* scrollback : scrollbacks_) {
+                    size_t usage = scrollback->GetDiskUsage();
+                    if (usage > largestUsage) {
+                        largest = scrollback;
+                        largestUsage = usage;
+                    }
+                }
+                if (!largest || largest->DropOldest(GetDiskUsage() - disk_limit_.load()) == 0) {
+                    break;
+                }
+            }
+        }
+        
+        // Scrollback Implementation
+        Scrollback::Scrollback(ScrollbackBudget& budget)
+            : budget_(budget)
+            , spilled_blocks_(0)
+            , spill_(std::make_unique<SpillFile>())
+            , hot_first_line_(0)
+            , first_line_(0)
+            , cache_clock_(0)
+            , memory_bytes_(0)
+            , disk_bytes_(0)
+            , resident_block_bytes_(0)
+        {
+            hot_offsets_.push_back(0);
+            budget_.Register(this);
+        }
+        
+        Scrollback::~Scrollback() {
+            budget_.Unregister(this);
+            budget_.ChargeMemory(-static_cast<int64_t>(memory_bytes_));
+            budget_.ChargeDisk(-static_cast<int64_t>(disk_bytes_));
+        }
+        
+        void Scrollback::EncodeLine(const VtCell* cells, size_t count, std::string& out) {
+            const VtCell blank;
+            while (count > 0 && cells[count - 1] == blank) {
+                --count;
+            }
+            
+            const size_t countOffset = out.size();
+            AppendU16(out, 0);
+            uint32_t runs = 0;
+            
+            size_t start = 0;
+            while (start < count) {
+                const uint16_t flags = cells[start].flags & kStoredFlagsMask;
+                size_t end = start + 1;
+                while (end < count && cells[end].fg == cells[start].fg && cells[end].bg == cells[start].bg &&
+                       (cells[end].flags & kStoredFlagsMask) == flags) {
+                    ++end;
+                }
+                
+                AppendU32(out, cells[start].fg);
+                AppendU32(out, cells[start].bg);
+                AppendU16(out, flags);
+                const size_t lengthOffset = out.size();
+                AppendU16(out, 0);
+                for (size_t i = start; i < end; ++i) {
+                    if (cells[i].codepoint != 0) {
+                        AppendUtf8(out, cells[i].codepoint);
+                    }
+                }
+                // A run is at most one row of 4-byte sequences
+                StoreU16(out, lengthOffset, static_cast<uint32_t>(out.size() - lengthOffset - 2));
+                ++runs;
+                start = end;
+            }
+            StoreU16(out, countOffset, runs);
+        }
+        
+        void Scrollback::AppendLine(const VtCell* cells, size_t count) {
+            bool sealed = false;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                line_.clear();
+                EncodeLine(cells, count, line_);
+                
+                const size_t capacity = hot_.capacity();
+                hot_ += line_;
+                hot_offsets_.push_back(static_cast<uint32_t>(hot_.size()));
+                AdjustMemoryLocked(static_cast<int64_t>(hot_.capacity()) - static_cast<int64_t>(capacity));
+                
+                if (hot_offsets_.size() > kBlockLines || hot_.size() >= kBlockBytes) {
+                    SealLocked();
+                    sealed = true;
+                }
+            }
+            
+            if (sealed && budget_.IsOverBudget()) {
+                budget_.Enforce();
+            }
+        }
+        
+        void Scrollback::SealLocked() {
+            const uint32_t lineCount = static_cast<uint32_t>(hot_offsets_.size() - 1);
+            if (lineCount == 0) {
+                return;
+            }
+            
+            std::string raw;
+            raw.reserve(hot_offsets_.size() * sizeof(uint32_t) + hot_.size());
+            for (uint32_t offset : hot_offsets_) {
+                AppendU32(raw, offset);
+            }
+            raw += hot_;
+            
+            Block block;
+            block.first_line = hot_first_line_;
+            block.line_count = lineCount;
+            block.raw_size = static_cast<uint32_t>(raw.size());
+            LzBlock::Compress(raw.data(), raw.size(), block.compressed);
+            block.compressed.shrink_to_fit();
+            block.compressed_size = static_cast<uint32_t>(block.compressed.size());
+            block.spill_offset = 0;
+            
+            AdjustMemoryLocked(static_cast<int64_t>(block.compressed.capacity()));
+            resident_block_bytes_ += block.compressed_size;
+            blocks_.push_back(std::move(block));
+            
+            // The arena keeps its capacity for the next block
+            hot_.clear();
+            hot_offsets_.clear();
+            hot_offsets_.push_back(0);
+            hot_first_line_ += lineCount;
+        }
+        
+        void Scrollback::Clear() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            while (!blocks_.empty()) {
+                DropFrontLocked();
+            }
+            hot_first_line_ += hot_offsets_.size() - 1;
+            first_line_ = hot_first_line_;
+            hot_.clear();
+            hot_offsets_.clear();
+            hot_offsets_.push_back(0);
+        }
+        
+        uint64_t Scrollback::GetFirstLine() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return first_line_;
+        }
+        
+        uint64_t Scrollback::GetEndLine() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return hot_first_line_ + hot_offsets_.size() - 1;
+        }
+        
+        size_t Scrollback::GetMemoryUsage() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return memory_bytes_;
+        }
+        
+        size_t Scrollback::GetDiskUsage() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return disk_bytes_;
+        }
+        
+        size_t Scrollback::ReadLines(uint64_t first, size_t count, std::string& out) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            const uint64_t end = hot_first_line_ + hot_offsets_.size() - 1;
+            first = std::max(first, first_line_);
+            
+            size_t read = 0;
+            LineCursor cursor;
+            for (uint64_t line = first; line < end && read < count; ++line, ++read) {
+                const char* bytes;
+                uint32_t size;
+                if (!LocateLineLocked(line, cursor, nullptr, bytes, size)) {
+                    break;
+                }
+                AppendU32(out, size);
+                out.append(bytes, size);
+            }
+            return read;
+        }
+        
+        size_t Scrollback::ReadText(uint64_t& first, size_t count, std::string& text, std::vector<uint32_t>& lineEnds) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            const uint64_t end = hot_first_line_ + hot_offsets_.size() - 1;
+            first = std::max(first, first_line_);
+            
+            size_t read = 0;
+            LineCursor cursor;
+            for (uint64_t line = first; line < end && read < count; ++line, ++read) {
+                const char* bytes;
+                uint32_t size;
+                if (!LocateLineLocked(line, cursor, &text_scratch_, bytes, size)) {
+                    break;
+                }
+                
+                const char* p = bytes + sizeof(uint16_t);
+                for (uint32_t runs = LoadU16(bytes); runs > 0; --runs) {
+                    const uint32_t length = LoadU16(p + 10);
+                    text.append(p + 12, length);
+                    p += 12 + length;
+                }
+                lineEnds.push_back(static_cast<uint32_t>(text.size()));
+                text.push_back('\n');
+            }
+            return read;
+        }
+        
+        bool Scrollback::LocateLineLocked(uint64_t line, LineCursor& cursor, std::string* scratch,
+                                          const char*& bytes, uint32_t& size) {
+            uint32_t begin;
+            uint32_t finish;
+            if (line >= hot_first_line_) {
+                const size_t index = static_cast<size_t>(line - hot_first_line_);
+                bytes = hot_.data();
+                begin = hot_offsets_[index];
+                finish = hot_offsets_[index + 1];
+            } else {
+                if (!cursor.raw || line >= blocks_[cursor.block].first_line + blocks_[cursor.block].line_count) {
+                    auto it = std::upper_bound(blocks_.begin(), blocks_.end(), line,
+                        [](uint64_t value, const Block& block) { return value < block.first_line; });
+                    cursor.block = static_cast<size_t>(it - blocks_.begin()) - 1;
+                    cursor.raw = LoadBlockLocked(cursor.block, scratch);
+                    if (!cursor.raw) {
+                        return false;
+                    }
+                }
+                const Block& block = blocks_[cursor.block];
+                const size_t index = static_cast<size_t>(line - block.first_line);
+                const size_t header = (block.line_count + 1) * sizeof(uint32_t);
+                bytes = cursor.raw->data() + header;
+                begin = LoadU32(cursor.raw->data() + index * sizeof(uint32_t));
+                finish = LoadU32(cursor.raw->data() + (index + 1) * sizeof(uint32_t));
+            }
+            bytes += begin;
+            size = finish - begin;
+            return true;
+        }
+        
+        const std::string* Scrollback::LoadBlockLocked(size_t index, std::string* scratch) {
+            const Block& block = blocks_[index];
+            for (CachedBlock& cached : cache_) {
+                if (cached.first_line == block.first_line) {
+                    cached.last_used = ++cache_clock_;
+                    return &cached.raw;
+                }
+            }
+            
+            const char* source = block.compressed.data();
+            if (index < spilled_blocks_) {
+                source = spill_->Read(block.spill_offset);
+                if (!source) {
+                    return nullptr;
+                }
+            }
+            
+            if (scratch) {
+                if (!LzBlock::Decompress(source, block.compressed_size, block.raw_size, *scratch)) {
+                    Logger::LogMessage("Corrupt scrollback block at line " + std::to_string(block.first_line));
+                    return nullptr;
+                }
+                return scratch;
+            }
+            
+            CachedBlock* slot;
+            if (cache_.size() < kCachedBlocks) {
+                cache_.push_back(CachedBlock{0, 0, std::string()});
+                slot = &cache_.back();
+            } else {
+                slot = &*std::min_element(cache_.begin(), cache_.end(),
+                    [](const CachedBlock& a, const CachedBlock& b) { return a.last_used < b.last_used; });
+            }
+            
+            const size_t capacity = slot->raw.capacity();
+            if (!LzBlock::Decompress(source, block.compressed_size, block.raw_size, slot->raw)) {
+                Logger::LogMessage("Corrupt scrollback block at line " + std::to_string(block.first_line));
+                slot->first_line = UINT64_MAX;
+                return nullptr;
+            }
+            AdjustMemoryLocked(static_cast<int64_t>(slot->raw.capacity()) - static_cast<int64_t>(capacity));
+            slot->first_line = block.first_line;
+            slot->last_used = ++cache_clock_;
+            return &slot->raw;
+        }
+        
+        void Scrollback::DropFrontLocked() {
+            Block& block = blocks_.front();
+            if (spilled_blocks_ > 0) {
+                spill_->Discard(block.spill_offset, block.compressed_size);
+                AdjustDiskLocked(-static_cast<int64_t>(block.compressed_size));
+                --spilled_blocks_;
+            } else {
+                AdjustMemoryLocked(-static_cast<int64_t>(block.compressed.capacity()));
+                resident_block_bytes_ -= block.compressed_size;
+            }
+            for (CachedBlock& cached : cache_) {
+                if (cached.first_line == block.first_line) {
+                    cached.first_line = UINT64_MAX;
+                }
+            }
+            blocks_.pop_front();
+            first_line_ = blocks_.empty() ? hot_first_line_ : blocks_.front().first_line;
+        }
+        
+        size_t Scrollback::SpillOldest(size_t bytes) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            size_t released = 0;
+            while (released < bytes && spilled_blocks_ < blocks_.size()) {
+                Block& block = blocks_[spilled_blocks_];
+                const size_t size = block.compressed.capacity();
+                
+                uint64_t offset = 0;
+                if (spill_->Write(block.compressed, offset)) {
+                    block.spill_offset = offset;
+                    std::string().swap(block.compressed);
+                    resident_block_bytes_ -= block.compressed_size;
+                    AdjustMemoryLocked(-static_cast<int64_t>(size));
+                    AdjustDiskLocked(block.compressed_size);
+                    ++spilled_blocks_;
+                    released += size;
+                } else {
+                    // No disk to spill to: the oldest history goes
+                    released += spilled_blocks_ == 0 ? size : 0;
+                    DropFrontLocked();
+                }
+            }
+            return released;
+        }
+        
+        size_t Scrollback::DropOldest(size_t bytes) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            size_t released = 0;
+            while (released < bytes && spilled_blocks_ > 0) {
+                released += blocks_.front().compressed_size;
+                DropFrontLocked();
+            }
+            return released;
+        }
+        
+        void Scrollback::AdjustMemoryLocked(int64_t delta) {
+            memory_bytes_ = static_cast<size_t>(static_cast<int64_t>(memory_bytes_) + delta);
+            budget_.ChargeMemory(delta);
+        }
+        
+        void Scrollback::AdjustDiskLocked(int64_t delta) {
+            disk_bytes_ = static_cast<size_t>(static_cast<int64_t>(disk_bytes_) + delta);
+            budget_.ChargeDisk(delta);
+        }
+        
+    }
+}
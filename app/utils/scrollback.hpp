@@ -0,0 +1,166 @@
+#pragma once
+#include "vt-screen.hpp"
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace MikoIDE {
+    namespace Utils {
+        
+        class Scrollback;
+        
+        // Memory and disk limits shared by every terminal's scrollback. When
+        // scrollback memory exceeds the limit, the terminals holding the most
+        // compressed blocks in memory spill their oldest blocks to disk; past
+        // the disk limit the oldest spilled blocks are discarded.
+        class ScrollbackBudget {
+        public:
+            static constexpr size_t kDefaultMemoryLimit = 256 * 1024 * 1024;
+            static constexpr size_t kDefaultDiskLimit = size_t(4) * 1024 * 1024 * 1024;
+            
+            static ScrollbackBudget& GetInstance();
+            
+            ScrollbackBudget();
+            
+            void SetLimits(size_t memoryBytes, size_t diskBytes);
+            
+            size_t GetMemoryLimit() const { return memory_limit_.load(); }
+            size_t GetDiskLimit() const { return disk_limit_.load(); }
+            size_t GetMemoryUsage() const;
+            size_t GetDiskUsage() const;
+            
+        private:
+            friend class Scrollback;
+            
+            void Register(Scrollback* scrollback);
+            void Unregister(Scrollback* scrollback);
+            void ChargeMemory(int64_t delta) { memory_used_ += delta; }
+            void ChargeDisk(int64_t delta) { disk_used_ += delta; }
+            bool IsOverBudget() const;
+            
+            // Spills and discards until usage is back under the limits. Must
+            // not be called with any Scrollback's mutex held.
+            void Enforce();
+            
+            std::atomic<int64_t> memory_used_;
+            std::atomic<int64_t> disk_used_;
+            std::atomic<size_t> memory_limit_;
+            std::atomic<size_t> disk_limit_;
+            std::vector<Scrollback*> scrollbacks_;
+            std::mutex mutex_;
+        };
+        
+        // Lines scrolled off a terminal's screen, kept in three tiers: the
+        // newest in an uncompressed arena, sealed blocks of lines LzBlock-
+        // compressed in memory, and the oldest spilled to an unlinked temp
+        // file that is read back through mmap. Lines keep absolute numbers
+        // from the start of the terminal, and any line is found with a binary
+        // search over blocks plus one block decompression, which a small
+        // cache amortizes while the frontend scrolls. Thread-safe.
+        //
+        // Encoded line: u16 runCount, then per run u32 fg, u32 bg, u16 flags,
+        // u16 byteLength and the run's text as UTF-8 (see VtCell). Trailing
+        // blank cells are trimmed and wide characters take one codepoint.
+        class Scrollback {
+        public:
+            static constexpr size_t kBlockLines = 1024;
+            static constexpr size_t kBlockBytes = 64 * 1024;
+            static constexpr size_t kCachedBlocks = 4;
+            
+            explicit Scrollback(ScrollbackBudget& budget = ScrollbackBudget::GetInstance());
+            ~Scrollback();
+            
+            Scrollback(const Scrollback&) = delete;
+            Scrollback& operator=(const Scrollback&) = delete;
+            
+            void AppendLine(const VtCell* cells, size_t count);
+            void Clear();
+            
+            // Retained lines are [GetFirstLine(), GetEndLine())
+            uint64_t GetFirstLine() const;
+            uint64_t GetEndLine() const;
+            
+            // Appends up to |count| lines from |first| to |out|, each as a u32
+            // length and the encoded line. Returns the number of lines read.
+            size_t ReadLines(uint64_t first, size_t count, std::string& out);
+            
+            // Appends up to |count| lines from |first| to |text| as plain UTF-8,
+            // each followed by '\n', and the offset of each '\n' to |lineEnds|.
+            // |first| is raised to the first retained line. Blocks read here
+            // bypass the block cache so a full sweep does not evict the
+            // blocks the frontend is viewing.
+            size_t ReadText(uint64_t& first, size_t count, std::string& text, std::vector<uint32_t>& lineEnds);
+            
+            size_t GetMemoryUsage() const;
+            size_t GetDiskUsage() const;
+            
+            static void EncodeLine(const VtCell* cells, size_t count, std::string& out);
+            
+        private:
+            friend class ScrollbackBudget;
+            class SpillFile;
+            
+            // Raw block layout: u32 offsets[lineCount + 1] into the line bytes
+            // that follow them
+            struct Block {
+                uint64_t first_line;
+                uint32_t line_count;
+                uint32_t raw_size;
+                uint32_t compressed_size;
+                std::string compressed;     // empty once spilled
+                uint64_t spill_offset;
+            };
+            
+            struct CachedBlock {
+                uint64_t first_line;
+                uint64_t last_used;
+                std::string raw;
+            };
+            
+            struct LineCursor {
+                const std::string* raw = nullptr;
+                size_t block = 0;
+            };
+            
+            void SealLocked();
+            void DropFrontLocked();
+            // Decompresses into |scratch| instead of the cache when given
+            const std::string* LoadBlockLocked(size_t index, std::string* scratch = nullptr);
+            bool LocateLineLocked(uint64_t line, LineCursor& cursor, std::string* scratch,
+                                  const char*& bytes, uint32_t& size);
+            void AdjustMemoryLocked(int64_t delta);
+            void AdjustDiskLocked(int64_t delta);
+            
+            // Budget callbacks; each returns the bytes released
+            size_t SpillOldest(size_t bytes);
+            size_t DropOldest(size_t bytes);
+            size_t GetResidentBlockBytes() const { return resident_block_bytes_.load(); }
+            
+            ScrollbackBudget& budget_;
+            
+            std::deque<Block> blocks_;
+            size_t spilled_blocks_;         // blocks_ spilled so far form a prefix
+            std::unique_ptr<SpillFile> spill_;
+            
+            std::string hot_;
+            std::vector<uint32_t> hot_offsets_;
+            uint64_t hot_first_line_;
+            uint64_t first_line_;
+            
+            std::vector<CachedBlock> cache_;
+            uint64_t cache_clock_;
+            std::string line_;              // EncodeLine scratch
+            std::string text_scratch_;      // ReadText block scratch
+            
+            size_t memory_bytes_;
+            size_t disk_bytes_;
+            std::atomic<size_t> resident_block_bytes_;
+            mutable std::mutex mutex_;
+        };
+        
+    }
+}
@@ -0,0 +1,275 @@
+#ifndef _WIN32
+#include "session-client.hpp"
+#include "../core/logger.hpp"
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+extern char** environ;
+
+namespace MikoIDE {
+    namespace Utils {
+        
+        using namespace SessionProtocol;
+        
+        namespace {
+            constexpr int kRequestTimeoutSeconds = 2;
+            // How long a freshly launched daemon may take to accept connections
+            constexpr auto kStartTimeout = std::chrono::seconds(2);
+            
+            bool ReadFully(int fd, void* data, size_t size) {
+                char* p = static_cast<char*>(data);
+                while (size > 0) {
+                    ssize_t n = read(fd, p, size);
+                    if (n < 0 && errno == EINTR) {
+                        continue;
+                    }
+                    if (n <= 0) {
+                        return false;
+                    }
+                    p += n;
+                    size -= static_cast<size_t>(n);
+                }
+                return true;
+            }
+            
+            bool SendFully(int fd, const char* data, size_t size) {
+                while (size > 0) {
+                    ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+                    if (n < 0 && errno == EINTR) {
+                        continue;
+                    }
+                    if (n <= 0) {
+                        return false;
+                    }
+                    data += n;
+                    size -= static_cast<size_t>(n);
+                }
+                return true;
+            }
+            
+            void FillInfo(const std::string& id, int32_t pid, uint32_t cols, uint32_t rows, uint32_t flags,
+                          int32_t exitCode, SessionInfo& info) {
+                info.id = id;
+                info.pid = pid;
+                info.cols = static_cast<int>(cols);
+                info.rows = static_cast<int>(rows);
+                info.exited = (flags & kExited) != 0;
+                info.attached = (flags & kAttached) != 0;
+                info.exit_code = exitCode;
+            }
+        }
+        
+        SessionClient& SessionClient::GetInstance() {
+            static SessionClient instance;
+            return instance;
+        }
+        
+        SessionClient::SessionClient()
+            : socket_path_(GetDefaultSocketPath()),
+              enabled_(false) {
+        }
+        
+        std::string SessionClient::GetDefaultDaemonPath() {
+#ifdef __linux__
+            char path[PATH_MAX];
+            ssize_t length = readlink("/proc/self/exe", path, sizeof(path) - 1);
+            if (length > 0) {
+                path[length] = '\0';
+                std::string executable(path);
+                return executable.substr(0, executable.rfind('/') + 1) + "miko-sessiond";
+            }
+#endif
+            return "miko-sessiond";
+        }
+        
+        bool SessionClient::Start(const std::string& daemonPath) {
+            int fd = Connect();
+            if (fd == -1) {
+                // The daemon forks itself away and its first process returns
+                // once it listens, or when another daemon got there first
+                const std::string socketArgument = "--socket=" + socket_path_;
+                char* argv[] = {const_cast<char*>(daemonPath.c_str()), const_cast<char*>(socketArgument.c_str()),
+                                nullptr};
+                pid_t pid;
+                int error = posix_spawnp(&pid, daemonPath.c_str(), nullptr, nullptr, argv, environ);
+                if (error != 0) {
+                    Logger::LogMessage("Failed to start session daemon " + daemonPath + ": " + strerror(error));
+                    return false;
+                }
+                int status;
+                while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+                }
+                
+                // The winner of a race may still be between its lock and listen()
+                const auto deadline = std::chrono::steady_clock::now() + kStartTimeout;
+                while ((fd = Connect()) == -1 && std::chrono::steady_clock::now() < deadline) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                }
+                if (fd == -1) {
+                    Logger::LogMessage("Session daemon is not answering on " + socket_path_);
+                    return false;
+                }
+            }
+            close(fd);
+            
+            enabled_ = true;
+            Logger::LogMessage("Terminal sessions served by " + socket_path_);
+            return true;
+        }
+        
+        int SessionClient::Connect() const {
+            // Only a socket this user created is trusted with keystrokes
+            struct stat info;
+            if (lstat(socket_path_.c_str(), &info) != 0 || !S_ISSOCK(info.st_mode) || info.st_uid != getuid()) {
+                return -1;
+            }
+            
+            sockaddr_un address = {};
+            if (socket_path_.size() >= sizeof(address.sun_path)) {
+                return -1;
+            }
+            address.sun_family = AF_UNIX;
+            memcpy(address.sun_path, socket_path_.c_str(), socket_path_.size() + 1);
+            
+            int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (fd == -1) {
+                return -1;
+            }
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+#ifdef SO_NOSIGPIPE
+            int one = 1;
+            setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+            if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+                close(fd);
+                return -1;
+            }
+            timeval timeout = {kRequestTimeoutSeconds, 0};
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+            return fd;
+        }
+        
+        int SessionClient::Request(RequestType type, const std::string& id, const std::string& command,
+                                   const std::string& directory, int cols, int rows, SessionInfo& info,
+                                   std::string* payload) {
+            int fd = Connect();
+            if (fd == -1) {
+                return -1;
+            }
+            
+            SessionRequest request = {};
+            request.magic = kMagic;
+            request.type = type;
+            request.cols = static_cast<uint32_t>(cols > 0 ? cols : 0);
+            request.rows = static_cast<uint32_t>(rows > 0 ? rows : 0);
+            request.id_size = static_cast<uint32_t>(id.size());
+            request.command_size = static_cast<uint32_t>(command.size());
+            request.directory_size = static_cast<uint32_t>(directory.size());
+            std::string bytes(reinterpret_cast<const char*>(&request), sizeof(request));
+            bytes += id;
+            bytes += command;
+            bytes += directory;
+            
+            SessionReply reply;
+            if (!SendFully(fd, bytes.data(), bytes.size()) || !ReadFully(fd, &reply, sizeof(reply)) ||
+                reply.status != 0 || reply.payload_size > kMaxString) {
+                close(fd);
+                return -1;
+            }
+            std::string received(reply.payload_size, '\0');
+            if (!ReadFully(fd, &received[0], received.size())) {
+                close(fd);
+                return -1;
+            }
+            if (payload) {
+                payload->swap(received);
+            }
+            FillInfo(id, reply.pid, reply.cols, reply.rows, reply.flags, reply.exit_code, info);
+            return fd;
+        }
+        
+        bool SessionClient::Query(RequestType type, const std::string& id, int cols, int rows, SessionInfo& info,
+                                  std::string* payload) {
+            int fd = Request(type, id, std::string(), std::string(), cols, rows, info, payload);
+            if (fd == -1) {
+                return false;
+            }
+            close(fd);
+            return true;
+        }
+        
+        int SessionClient::Create(const std::string& id, const std::string& command, const std::string& workingDir,
+                                  int cols, int rows, SessionInfo& info) {
+            // The daemon's directory is not ours; an empty one means this
+            // process's, as it does for terminals started here
+            std::string directory = workingDir;
+            if (directory.empty()) {
+                char cwd[PATH_MAX];
+                if (getcwd(cwd, sizeof(cwd))) {
+                    directory = cwd;
+                }
+            }
+            return Request(kCreate, id, command, directory, cols, rows, info);
+        }
+        
+        int SessionClient::Attach(const std::string& id, SessionInfo& info) {
+            return Request(kAttach, id, std::string(), std::string(), 0, 0, info);
+        }
+        
+        bool SessionClient::Resize(const std::string& id, int cols, int rows) {
+            SessionInfo info;
+            return Query(kResize, id, cols, rows, info);
+        }
+        
+        bool SessionClient::Close(const std::string& id) {
+            SessionInfo info;
+            return Query(kClose, id, 0, 0, info);
+        }
+        
+        bool SessionClient::GetStatus(const std::string& id, SessionInfo& info) {
+            return Query(kStatus, id, 0, 0, info);
+        }
+        
+        std::vector<SessionInfo> SessionClient::List() {
+            std::vector<SessionInfo> sessions;
+            SessionInfo unused;
+            std::string payload;
+            if (!Query(kList, std::string(), 0, 0, unused, &payload)) {
+                return sessions;
+            }
+            
+            size_t offset = 0;
+            while (offset + sizeof(SessionEntry) <= payload.size()) {
+                SessionEntry entry;
+                memcpy(&entry, payload.data() + offset, sizeof(entry));
+                offset += sizeof(entry);
+                if (entry.id_size > payload.size() - offset) {
+                    break;
+                }
+                SessionInfo info;
+                FillInfo(payload.substr(offset, entry.id_size), entry.pid, entry.cols, entry.rows, entry.flags,
+                         entry.exit_code, info);
+                offset += entry.id_size;
+                sessions.push_back(std::move(info));
+            }
+            return sessions;
+        }
+        
+    }
+}
+#endif
@@ -0,0 +1,68 @@
+#pragma once
+#ifndef _WIN32
+#include "session-protocol.hpp"
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace MikoIDE {
+    namespace Utils {
+        
+        struct SessionInfo {
+            std::string id;
+            int pid = -1;
+            int cols = 0;
+            int rows = 0;
+            bool exited = false;
+            bool attached = false;
+            int exit_code = -1;
+        };
+        
+        // The IDE's side of miko-sessiond (see SessionDaemon). Requests are
+        // synchronous and short; Create and Attach return the session's
+        // stream socket, which stands in for a PTY master: the daemon writes
+        // the terminal's output to it and reads keystrokes from it.
+        // Thread-safe.
+        class SessionClient {
+        public:
+            static SessionClient& GetInstance();
+            
+            SessionClient();
+            
+            // Connects to the daemon on the default socket, launching
+            // |daemonPath| first if none answers. Terminals only go through
+            // the daemon once this succeeded.
+            bool Start(const std::string& daemonPath);
+            bool IsEnabled() const { return enabled_.load(); }
+            
+            // miko-sessiond next to this executable
+            static std::string GetDefaultDaemonPath();
+            
+            // Stream socket of the new or reattached session, or -1
+            int Create(const std::string& id, const std::string& command, const std::string& workingDir,
+                       int cols, int rows, SessionInfo& info);
+            int Attach(const std::string& id, SessionInfo& info);
+            
+            bool Resize(const std::string& id, int cols, int rows);
+            // Ends the session's process if it still runs and drops the session
+            bool Close(const std::string& id);
+            bool GetStatus(const std::string& id, SessionInfo& info);
+            std::vector<SessionInfo> List();
+        
+        private:
+            int Connect() const;
+            // Returns the connection after a successful reply, or -1
+            int Request(SessionProtocol::RequestType type, const std::string& id, const std::string& command,
+                        const std::string& directory, int cols, int rows, SessionInfo& info,
+                        std::string* payload = nullptr);
+            // For requests that end with the reply
+            bool Query(SessionProtocol::RequestType type, const std::string& id, int cols, int rows,
+                       SessionInfo& info, std::string* payload = nullptr);
+            
+            std::string socket_path_;
+            std::atomic<bool> enabled_;
+        };
+        
+    }
+}
+#endif
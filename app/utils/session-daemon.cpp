@@ -0,0 +1,701 @@
+#ifndef _WIN32
+#include "session-daemon.hpp"
+#include "spawn-helper.hpp"
+#include "../core/logger.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/file.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+#include <vector>
+
+#if defined(__APPLE__)
+#include <util.h>
+#elif defined(__FreeBSD__)
+#include <libutil.h>
+#else
+#include <pty.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace MikoIDE {
+    namespace Utils {
+        
+        using namespace SessionProtocol;
+        
+        namespace {
+            constexpr size_t kReadSize = 64 * 1024;
+            constexpr int kRequestTimeoutSeconds = 2;
+            
+            // SIGCHLD wakes the poll loop through this pipe
+            int g_child_pipe = -1;
+            
+            void OnChildSignal(int) {
+                const int saved = errno;
+                const char byte = 0;
+                (void)!write(g_child_pipe, &byte, 1);
+                errno = saved;
+            }
+            
+            void SetCloseOnExec(int fd) {
+                fcntl(fd, F_SETFD, fcntl(fd, F_GETFD) | FD_CLOEXEC);
+            }
+            
+            // Marks |n| more bytes of |buffer| as written. They are dropped
+            // once they make up half of it, so a slow reader does not cost
+            // a copy of the whole buffer per partial write.
+            void Consume(std::string& buffer, size_t& sent, size_t n) {
+                sent += n;
+                if (sent == buffer.size()) {
+                    buffer.clear();
+                    sent = 0;
+                } else if (sent >= buffer.size() / 2) {
+                    buffer.erase(0, sent);
+                    sent = 0;
+                }
+            }
+            
+            void SetNonBlocking(int fd, bool enabled) {
+                const int flags = fcntl(fd, F_GETFL);
+                fcntl(fd, F_SETFL, enabled ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK));
+            }
+            
+            bool SendFully(int fd, const char* data, size_t size) {
+                while (size > 0) {
+                    ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+                    if (n < 0 && errno == EINTR) {
+                        continue;
+                    }
+                    if (n <= 0) {
+                        return false;
+                    }
+                    data += n;
+                    size -= static_cast<size_t>(n);
+                }
+                return true;
+            }
+            
+            int ExitCodeFromStatus(int status) {
+                return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+            }
+            
+            std::string EncodeReply(const SessionReply& reply, const std::string& payload = std::string()) {
+                SessionReply header = reply;
+                header.payload_size = static_cast<uint32_t>(payload.size());
+                std::string bytes(reinterpret_cast<const char*>(&header), sizeof(header));
+                bytes += payload;
+                return bytes;
+            }
+        }
+        
+        SessionDaemon::SessionDaemon(const Options& options)
+            : options_(options),
+              listen_fd_(-1),
+              lock_fd_(-1),
+              child_pipe_{-1, -1},
+              listening_(false) {
+        }
+        
+        SessionDaemon::~SessionDaemon() {
+            for (auto& pair : sessions_) {
+                Session& session = *pair.second;
+                if (!session.exited && session.pid > 0) {
+                    kill(session.pid, SIGHUP);
+                }
+                if (session.master_fd != -1) {
+                    close(session.master_fd);
+                }
+                if (session.client_fd != -1) {
+                    close(session.client_fd);
+                }
+            }
+            for (const auto& request : requests_) {
+                close(request.first);
+            }
+            if (listen_fd_ != -1) {
+                close(listen_fd_);
+            }
+            // Unlinked while the lock is still held, so a new daemon's socket
+            // is never removed by an old one
+            if (listening_) {
+                unlink(options_.socket_path.c_str());
+            }
+            if (lock_fd_ != -1) {
+                close(lock_fd_);
+            }
+            for (int fd : child_pipe_) {
+                if (fd != -1) {
+                    close(fd);
+                }
+            }
+        }
+        
+        bool SessionDaemon::Listen(bool& alreadyRunning) {
+            alreadyRunning = false;
+            const std::string& path = options_.socket_path;
+            sockaddr_un address = {};
+            if (path.size() >= sizeof(address.sun_path)) {
+                Logger::LogMessage("Session daemon: socket path too long: " + path);
+                return false;
+            }
+            
+            // A directory of our own; one someone else created is not used
+            const std::string directory = path.substr(0, path.rfind('/'));
+            struct stat info;
+            if (!directory.empty() && mkdir(directory.c_str(), 0700) != 0 && errno != EEXIST) {
+                Logger::LogMessage("Session daemon: cannot create " + directory + ": " + strerror(errno));
+                return false;
+            }
+            if (!directory.empty() && (lstat(directory.c_str(), &info) != 0 || !S_ISDIR(info.st_mode) ||
+                                       (info.st_uid != getuid() && info.st_uid != 0))) {
+                Logger::LogMessage("Session daemon: " + directory + " is not a directory of this user");
+                return false;
+            }
+            
+            lock_fd_ = open((path + ".lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+            if (lock_fd_ == -1) {
+                Logger::LogMessage("Session daemon: cannot open lock file: " + std::string(strerror(errno)));
+                return false;
+            }
+            if (flock(lock_fd_, LOCK_EX | LOCK_NB) != 0) {
+                alreadyRunning = errno == EWOULDBLOCK;
+                return false;
+            }
+            
+            // Whatever is left at the path belongs to a daemon that is gone
+            unlink(path.c_str());
+            listen_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (listen_fd_ == -1) {
+                return false;
+            }
+            SetCloseOnExec(listen_fd_);
+            address.sun_family = AF_UNIX;
+            memcpy(address.sun_path, path.c_str(), path.size() + 1);
+            const mode_t mask = umask(0077);
+            const bool bound = bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+            umask(mask);
+            if (!bound || listen(listen_fd_, 16) != 0) {
+                Logger::LogMessage("Session daemon: cannot listen on " + path + ": " + strerror(errno));
+                return false;
+            }
+            listening_ = true;
+            SetNonBlocking(listen_fd_, true);
+            
+            if (pipe(child_pipe_) != 0) {
+                return false;
+            }
+            for (int fd : child_pipe_) {
+                SetCloseOnExec(fd);
+                SetNonBlocking(fd, true);
+            }
+            g_child_pipe = child_pipe_[1];
+            struct sigaction action = {};
+            action.sa_handler = OnChildSignal;
+            action.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+            sigaction(SIGCHLD, &action, nullptr);
+            return true;
+        }
+        
+        void SessionDaemon::Run() {
+            enum Kind { kListener, kChildPipe, kMaster, kClient, kRequest };
+            std::vector<pollfd> fds;
+            std::vector<std::pair<Kind, Session*>> targets;
+            std::vector<int> readable;
+            auto idleSince = std::chrono::steady_clock::now();
+            
+            while (true) {
+                fds.clear();
+                targets.clear();
+                fds.push_back({listen_fd_, POLLIN, 0});
+                targets.emplace_back(kListener, nullptr);
+                fds.push_back({child_pipe_[0], POLLIN, 0});
+                targets.emplace_back(kChildPipe, nullptr);
+                for (auto& pair : sessions_) {
+                    Session& session = *pair.second;
+                    if (session.master_fd != -1) {
+                        const size_t unsent = session.to_client.size() - session.to_client_sent;
+                        const bool clientBehind = session.client_fd != -1 && unsent >= kClientHighWatermark;
+                        short events = clientBehind ? 0 : POLLIN;
+                        if (!session.to_pty.empty()) {
+                            events |= POLLOUT;
+                        }
+                        fds.push_back({session.master_fd, events, 0});
+                        targets.emplace_back(kMaster, &session);
+                    }
+                    if (session.client_fd != -1) {
+                        fds.push_back({session.client_fd,
+                                       static_cast<short>(POLLIN | (session.to_client.empty() ? 0 : POLLOUT)), 0});
+                        targets.emplace_back(kClient, &session);
+                    }
+                }
+                for (const auto& request : requests_) {
+                    fds.push_back({request.first, POLLIN, 0});
+                    targets.emplace_back(kRequest, nullptr);
+                }
+                
+                const auto now = std::chrono::steady_clock::now();
+                std::chrono::steady_clock::duration wait = std::chrono::steady_clock::duration::max();
+                if (IsIdle()) {
+                    const auto idle = now - idleSince;
+                    const auto limit = std::chrono::seconds(options_.idle_timeout_seconds);
+                    if (idle >= limit) {
+                        Logger::LogMessage("Session daemon: idle, exiting");
+                        return;
+                    }
+                    wait = limit - idle;
+                }
+                for (const auto& request : requests_) {
+                    wait = std::min(wait, std::max(request.second.deadline - now, std::chrono::steady_clock::duration::zero()));
+                }
+                int timeout = -1;
+                if (wait != std::chrono::steady_clock::duration::max()) {
+                    timeout = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(wait).count()) + 1;
+                }
+                
+                if (poll(fds.data(), fds.size(), timeout) < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    Logger::LogMessage("Session daemon: poll failed: " + std::string(strerror(errno)));
+                    return;
+                }
+                
+                // Sessions are only removed by requests, which come last
+                bool pending = false;
+                readable.clear();
+                for (size_t i = 0; i < fds.size(); ++i) {
+                    const short revents = fds[i].revents;
+                    if (revents == 0) {
+                        continue;
+                    }
+                    Session* session = targets[i].second;
+                    switch (targets[i].first) {
+                        case kListener:
+                            pending = true;
+                            break;
+                        case kChildPipe:
+                            ReapChildren();
+                            break;
+                        case kMaster:
+                            if (revents & POLLOUT) {
+                                WritePty(*session);
+                            }
+                            if (revents & (POLLIN | POLLHUP | POLLERR)) {
+                                ReadPty(*session);
+                            }
+                            break;
+                        case kClient:
+                            if (session->client_fd != fds[i].fd) {
+                                break;  // replaced or closed above
+                            }
+                            if (revents & POLLOUT) {
+                                WriteClient(*session);
+                            }
+                            if (session->client_fd != -1 && (revents & (POLLIN | POLLHUP | POLLERR))) {
+                                ReadClient(*session);
+                            }
+                            break;
+                        case kRequest:
+                            readable.push_back(fds[i].fd);
+                            break;
+                    }
+                }
+                
+                for (int fd : readable) {
+                    ReadRequest(fd);
+                }
+                while (pending) {
+                    int fd = ::accept(listen_fd_, nullptr, nullptr);
+                    if (fd == -1) {
+                        pending = errno == EINTR;
+                        continue;
+                    }
+                    AcceptConnection(fd);
+                }
+                
+                // A connection that has not sent its request in time is dropped
+                const auto expiry = std::chrono::steady_clock::now();
+                for (auto it = requests_.begin(); it != requests_.end();) {
+                    if (it->second.deadline <= expiry) {
+                        close(it->first);
+                        it = requests_.erase(it);
+                    } else {
+                        ++it;
+                    }
+                }
+                
+                if (!IsIdle()) {
+                    idleSince = std::chrono::steady_clock::now();
+                }
+            }
+        }
+        
+        bool SessionDaemon::IsIdle() const {
+            for (const auto& pair : sessions_) {
+                if (!pair.second->exited || pair.second->client_fd != -1) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        
+        bool SessionDaemon::IsSameUser(int fd) const {
+#if defined(__linux__)
+            struct ucred credentials;
+            socklen_t size = sizeof(credentials);
+            return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &size) == 0 &&
+                   credentials.uid == getuid();
+#else
+            uid_t uid;
+            gid_t gid;
+            return getpeereid(fd, &uid, &gid) == 0 && uid == getuid();
+#endif
+        }
+        
+        SessionReply SessionDaemon::MakeReply(const Session& session) const {
+            SessionReply reply = {};
+            reply.pid = session.pid;
+            reply.cols = static_cast<uint32_t>(session.cols);
+            reply.rows = static_cast<uint32_t>(session.rows);
+            reply.flags = (session.exited ? kExited : 0u) | (session.client_fd != -1 ? kAttached : 0u);
+            reply.exit_code = session.exit_code;
+            return reply;
+        }
+        
+        void SessionDaemon::Reply(int fd, const SessionReply& reply, const std::string& payload) {
+            // The socket is non-blocking; a one-shot reply fits its buffer
+            const std::string bytes = EncodeReply(reply, payload);
+            SendFully(fd, bytes.data(), bytes.size());
+        }
+        
+        void SessionDaemon::AcceptConnection(int fd) {
+            SetCloseOnExec(fd);
+            SetNonBlocking(fd, true);
+            if (!IsSameUser(fd)) {
+                close(fd);
+                return;
+            }
+            requests_[fd].deadline = std::chrono::steady_clock::now() + std::chrono::seconds(kRequestTimeoutSeconds);
+            // The request usually arrived with the connection
+            ReadRequest(fd);
+        }
+        
+        void SessionDaemon::ReadRequest(int fd) {
+            auto it = requests_.find(fd);
+            if (it == requests_.end()) {
+                return;
+            }
+            std::string& bytes = it->second.bytes;
+            
+            // Reads no further than the request's end: on Create and Attach,
+            // the terminal stream follows
+            while (true) {
+                SessionRequest request;
+                size_t size = sizeof(request);
+                if (bytes.size() >= sizeof(request)) {
+                    memcpy(&request, bytes.data(), sizeof(request));
+                    if (request.magic != kMagic || request.id_size > kMaxString ||
+                        request.command_size > kMaxString || request.directory_size > kMaxString) {
+                        break;
+                    }
+                    size += request.id_size + request.command_size + request.directory_size;
+                    if (bytes.size() == size) {
+                        const char* p = bytes.data() + sizeof(request);
+                        const std::string id(p, request.id_size);
+                        const std::string command(p + request.id_size, request.command_size);
+                        const std::string directory(p + request.id_size + request.command_size, request.directory_size);
+                        requests_.erase(it);
+                        HandleRequest(fd, request, id, command, directory);
+                        return;
+                    }
+                }
+                
+                const size_t have = bytes.size();
+                bytes.resize(size);
+                const ssize_t n = recv(fd, &bytes[have], size - have, 0);
+                bytes.resize(have + static_cast<size_t>(std::max<ssize_t>(n, 0)));
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    return;
+                }
+                if (n <= 0) {
+                    break;
+                }
+            }
+            close(fd);
+            requests_.erase(it);
+        }
+        
+        void SessionDaemon::HandleRequest(int fd, const SessionRequest& request, const std::string& id,
+                                          const std::string& command, const std::string& directory) {
+            SessionReply reply = {};
+            if (request.type == kList) {
+                std::string payload;
+                for (const auto& pair : sessions_) {
+                    const SessionReply state = MakeReply(*pair.second);
+                    SessionEntry entry = {state.pid, state.cols, state.rows, state.flags, state.exit_code,
+                                          static_cast<uint32_t>(pair.first.size())};
+                    payload.append(reinterpret_cast<const char*>(&entry), sizeof(entry));
+                    payload += pair.first;
+                }
+                Reply(fd, reply, payload);
+                close(fd);
+                return;
+            }
+            
+            auto it = sessions_.find(id);
+            if (request.type == kCreate) {
+                if (it != sessions_.end()) {
+                    reply.status = EEXIST;
+                } else if (CreateSession(id, command, directory, static_cast<int>(request.cols),
+                                         static_cast<int>(request.rows), fd)) {
+                    return;
+                } else {
+                    reply.status = EAGAIN;
+                }
+                Reply(fd, reply);
+                close(fd);
+                return;
+            }
+            
+            if (it == sessions_.end()) {
+                reply.status = ENOENT;
+                Reply(fd, reply);
+                close(fd);
+                return;
+            }
+            
+            Session& session = *it->second;
+            switch (request.type) {
+                case kAttach:
+                    AttachSession(session, fd);
+                    return;
+                case kResize:
+                    if (request.cols > 0 && request.rows > 0) {
+                        session.cols = static_cast<int>(request.cols);
+                        session.rows = static_cast<int>(request.rows);
+                        session.screen->Resize(session.cols, session.rows);
+                        if (session.master_fd != -1) {
+                            struct winsize size = {};
+                            size.ws_col = static_cast<unsigned short>(session.cols);
+                            size.ws_row = static_cast<unsigned short>(session.rows);
+                            ioctl(session.master_fd, TIOCSWINSZ, &size);
+                        }
+                    }
+                    reply = MakeReply(session);
+                    break;
+                case kClose:
+                    reply = MakeReply(session);
+                    CloseSession(id);
+                    break;
+                case kStatus:
+                    reply = MakeReply(session);
+                    break;
+                default:
+                    reply.status = EINVAL;
+                    break;
+            }
+            Reply(fd, reply);
+            close(fd);
+        }
+        
+        bool SessionDaemon::CreateSession(const std::string& id, const std::string& command,
+                                          const std::string& directory, int cols, int rows, int fd) {
+            auto session = std::make_unique<Session>();
+            session->id = id;
+            session->cols = cols > 0 ? cols : 80;
+            session->rows = rows > 0 ? rows : 24;
+            
+            struct winsize size = {};
+            size.ws_col = static_cast<unsigned short>(session->cols);
+            size.ws_row = static_cast<unsigned short>(session->rows);
+            int slave;
+            if (openpty(&session->master_fd, &slave, nullptr, nullptr, &size) == -1) {
+                Logger::LogMessage("Session daemon: failed to create pseudo-terminal");
+                return false;
+            }
+            SetCloseOnExec(session->master_fd);
+            SetCloseOnExec(slave);
+            
+            // Small and single-threaded, the daemon forks its children itself
+            session->pid = SpawnHelper::ForkChild(command, directory, slave);
+            close(slave);
+            if (session->pid < 0) {
+                Logger::LogMessage("Session daemon: failed to start " + command);
+                close(session->master_fd);
+                return false;
+            }
+            SetNonBlocking(session->master_fd, true);
+            
+            session->scrollback = std::make_unique<Scrollback>();
+            session->screen = std::make_unique<VtScreen>(session->cols, session->rows);
+            session->screen->SetScrollback(session->scrollback.get());
+            
+            Session& created = *session;
+            sessions_[id] = std::move(session);
+            created.to_client = EncodeReply(MakeReply(created));
+            created.client_fd = fd;
+            WriteClient(created);
+            return true;
+        }
+        
+        void SessionDaemon::AttachSession(Session& session, int fd) {
+            DetachSession(session);
+            // Queued with the stream, so a slow reader does not hold up the loop
+            session.to_client = EncodeReply(MakeReply(session));
+            session.client_fd = fd;
+            session.screen->EncodeSnapshot(session.to_client, options_.snapshot_lines);
+            WriteClient(session);
+        }
+        
+        void SessionDaemon::DetachSession(Session& session) {
+            if (session.client_fd != -1) {
+                close(session.client_fd);
+                session.client_fd = -1;
+            }
+            session.to_client.clear();
+            session.to_client_sent = 0;
+        }
+        
+        void SessionDaemon::CloseSession(const std::string& id) {
+            auto it = sessions_.find(id);
+            if (it == sessions_.end()) {
+                return;
+            }
+            Session& session = *it->second;
+            // Closing the master hangs up the terminal for the whole session
+            if (!session.exited && session.pid > 0) {
+                kill(session.pid, SIGTERM);
+            }
+            if (session.master_fd != -1) {
+                close(session.master_fd);
+            }
+            DetachSession(session);
+            sessions_.erase(it);
+        }
+        
+        void SessionDaemon::ReadPty(Session& session) {
+            char buffer[kReadSize];
+            ssize_t n = read(session.master_fd, buffer, sizeof(buffer));
+            if (n < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) {
+                return;
+            }
+            if (n <= 0) {
+                // EOF, or EIO once the child's side is closed
+                close(session.master_fd);
+                session.master_fd = -1;
+                session.output_done = true;
+                session.to_pty.clear();
+                session.to_pty_sent = 0;
+                FinishIfDone(session);
+                return;
+            }
+            
+            session.screen->Feed(buffer, static_cast<size_t>(n));
+            std::string responses = session.screen->TakeResponses();
+            if (session.client_fd != -1) {
+                // The attached side answers queries itself
+                session.to_client.append(buffer, static_cast<size_t>(n));
+                WriteClient(session);
+            } else if (!responses.empty()) {
+                session.to_pty += responses;
+                WritePty(session);
+            }
+        }
+        
+        void SessionDaemon::WritePty(Session& session) {
+            while (!session.to_pty.empty() && session.master_fd != -1) {
+                ssize_t n = write(session.master_fd, session.to_pty.data() + session.to_pty_sent,
+                                  session.to_pty.size() - session.to_pty_sent);
+                if (n > 0) {
+                    Consume(session.to_pty, session.to_pty_sent, static_cast<size_t>(n));
+                } else if (n < 0 && errno == EINTR) {
+                    continue;
+                } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    return;
+                } else {
+                    session.to_pty.clear();
+                    session.to_pty_sent = 0;
+                }
+            }
+        }
+        
+        void SessionDaemon::ReadClient(Session& session) {
+            char buffer[kReadSize];
+            ssize_t n = recv(session.client_fd, buffer, sizeof(buffer), 0);
+            if (n < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) {
+                return;
+            }
+            if (n <= 0) {
+                // The IDE went away; the session carries on detached
+                DetachSession(session);
+                return;
+            }
+            if (session.master_fd != -1) {
+                session.to_pty.append(buffer, static_cast<size_t>(n));
+                WritePty(session);
+            }
+        }
+        
+        void SessionDaemon::WriteClient(Session& session) {
+            while (!session.to_client.empty()) {
+                ssize_t n = send(session.client_fd, session.to_client.data() + session.to_client_sent,
+                                 session.to_client.size() - session.to_client_sent, MSG_NOSIGNAL);
+                if (n > 0) {
+                    Consume(session.to_client, session.to_client_sent, static_cast<size_t>(n));
+                } else if (n < 0 && errno == EINTR) {
+                    continue;
+                } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    return;
+                } else {
+                    DetachSession(session);
+                    return;
+                }
+            }
+            FinishIfDone(session);
+        }
+        
+        void SessionDaemon::ReapChildren() {
+            char drain[64];
+            while (read(child_pipe_[0], drain, sizeof(drain)) > 0) {
+            }
+            
+            int status;
+            pid_t pid;
+            while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+                for (auto& pair : sessions_) {
+                    Session& session = *pair.second;
+                    if (session.pid == pid && !session.exited) {
+                        session.exited = true;
+                        session.exit_code = ExitCodeFromStatus(status);
+                        FinishIfDone(session);
+                        break;
+                    }
+                }
+            }
+        }
+        
+        void SessionDaemon::FinishIfDone(Session& session) {
+            if (session.exited && session.output_done && session.client_fd != -1 && session.to_client.empty()) {
+                DetachSession(session);
+            }
+        }
+        
+    }
+}
+#endif
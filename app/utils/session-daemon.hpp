@@ -0,0 +1,116 @@
+#pragma once
+#ifndef _WIN32
+#include "scrollback.hpp"
+#include "session-protocol.hpp"
+#include "vt-screen.hpp"
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <sys/types.h>
+
+namespace MikoIDE {
+    namespace Utils {
+        
+        // miko-sessiond: owns terminal PTYs on behalf of the IDE so that
+        // their processes outlive it. Each session keeps a VtScreen and a
+        // bounded Scrollback fed with everything the child writes, attached
+        // or not, and a reattaching IDE gets them back as a snapshot (see
+        // VtScreen::EncodeSnapshot) before live output resumes. At most one
+        // connection is attached to a session; a new one replaces it.
+        //
+        // Single-threaded: one poll loop serves the listening socket, every
+        // PTY and every attached connection. While a connection is behind,
+        // its PTY is not read, so the child blocks as it would on the IDE's
+        // own flow control; a detached session is read and emulated freely.
+        // A new connection's request is read as it arrives, without blocking
+        // the loop, and served once complete.
+        //
+        // Only connections from the same user are served. The daemon exits
+        // after |idle_timeout_seconds| with no running child and nothing
+        // attached.
+        class SessionDaemon {
+        public:
+            struct Options {
+                std::string socket_path = SessionProtocol::GetDefaultSocketPath();
+                size_t snapshot_lines = 10000;
+                int idle_timeout_seconds = 30;
+            };
+            
+            explicit SessionDaemon(const Options& options);
+            ~SessionDaemon();
+            
+            SessionDaemon(const SessionDaemon&) = delete;
+            SessionDaemon& operator=(const SessionDaemon&) = delete;
+            
+            // Takes the daemon lock and listens. Returns false on failure, with
+            // |alreadyRunning| set when another daemon holds the lock.
+            bool Listen(bool& alreadyRunning);
+            
+            // Serves until idle
+            void Run();
+        
+        private:
+            static constexpr size_t kClientHighWatermark = 1024 * 1024;
+            
+            struct Session {
+                std::string id;
+                pid_t pid = -1;
+                int master_fd = -1;
+                int client_fd = -1;
+                int cols = 80;
+                int rows = 24;
+                std::unique_ptr<Scrollback> scrollback;    // outlives screen, which feeds it
+                std::unique_ptr<VtScreen> screen;
+                std::string to_client;      // output the attached connection has not taken
+                size_t to_client_sent = 0;  // leading to_client bytes already sent
+                std::string to_pty;         // input and replies the PTY has not taken
+                size_t to_pty_sent = 0;     // leading to_pty bytes already written
+                bool output_done = false;   // the PTY hung up
+                bool exited = false;
+                int exit_code = -1;
+            };
+            
+            // A connection whose request has not fully arrived
+            struct PendingRequest {
+                std::string bytes;
+                std::chrono::steady_clock::time_point deadline;
+            };
+            
+            void AcceptConnection(int fd);
+            void ReadRequest(int fd);
+            void HandleRequest(int fd, const SessionProtocol::SessionRequest& request, const std::string& id,
+                               const std::string& command, const std::string& directory);
+            bool IsSameUser(int fd) const;
+            void Reply(int fd, const SessionProtocol::SessionReply& reply, const std::string& payload = std::string());
+            SessionProtocol::SessionReply MakeReply(const Session& session) const;
+            
+            bool CreateSession(const std::string& id, const std::string& command, const std::string& directory,
+                               int cols, int rows, int fd);
+            void AttachSession(Session& session, int fd);
+            void DetachSession(Session& session);
+            void CloseSession(const std::string& id);
+            
+            void ReadPty(Session& session);
+            void WritePty(Session& session);
+            void ReadClient(Session& session);
+            void WriteClient(Session& session);
+            void ReapChildren();
+            // Ends the attached stream once the child is gone and all its
+            // output has been delivered
+            void FinishIfDone(Session& session);
+            
+            bool IsIdle() const;
+            
+            Options options_;
+            int listen_fd_;
+            int lock_fd_;
+            int child_pipe_[2];
+            bool listening_;
+            std::map<std::string, std::unique_ptr<Session>> sessions_;
+            std::map<int, PendingRequest> requests_;    // by fd
+        };
+        
+    }
+}
+#endif
@@ -0,0 +1,83 @@
+#pragma once
+#ifndef _WIN32
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+
+namespace MikoIDE {
+    namespace Utils {
+        
+        // Wire format between the IDE and miko-sessiond over a Unix stream
+        // socket. Both ends are built from one tree for one machine, so the
+        // structs go over as they are.
+        //
+        // Every connection starts with a SessionRequest followed by its id,
+        // command and directory bytes, and gets a SessionReply followed by
+        // payload_size bytes. Create and Attach connections then carry the
+        // session's raw terminal bytes both ways: input to the PTY, and the
+        // screen snapshot followed by live output from it. The daemon ends
+        // the stream once the child has exited and its output is drained, or
+        // when another connection attaches to the session.
+        namespace SessionProtocol {
+            constexpr uint32_t kMagic = 0x4d4b5331;    // "MKS1"
+            constexpr uint32_t kMaxString = 1 << 20;
+            
+            enum RequestType : uint32_t {
+                kCreate = 1,    // id, command, directory, cols, rows
+                kAttach = 2,    // id
+                kResize = 3,    // id, cols, rows
+                kClose = 4,     // id; ends the child and forgets the session
+                kStatus = 5,    // id
+                kList = 6       // payload: SessionEntry and id, per session
+            };
+            
+            enum SessionFlags : uint32_t {
+                kExited = 1 << 0,
+                kAttached = 1 << 1
+            };
+            
+            struct SessionRequest {
+                uint32_t magic;
+                uint32_t type;
+                uint32_t cols;
+                uint32_t rows;
+                uint32_t id_size;
+                uint32_t command_size;
+                uint32_t directory_size;
+            };
+            
+            // status is 0 or an errno value
+            struct SessionReply {
+                int32_t status;
+                int32_t pid;
+                uint32_t cols;
+                uint32_t rows;
+                uint32_t flags;
+                int32_t exit_code;
+                uint32_t payload_size;
+            };
+            
+            struct SessionEntry {
+                int32_t pid;
+                uint32_t cols;
+                uint32_t rows;
+                uint32_t flags;
+                int32_t exit_code;
+                uint32_t id_size;
+            };
+            
+            // $XDG_RUNTIME_DIR/mikoide-sessions.sock, or a private directory
+            // under /tmp that the daemon creates
+            inline std::string GetDefaultSocketPath() {
+                const char* runtimeDir = getenv("XDG_RUNTIME_DIR");
+                if (runtimeDir && *runtimeDir) {
+                    return std::string(runtimeDir) + "/mikoide-sessions.sock";
+                }
+                return "/tmp/mikoide-" + std::to_string(getuid()) + "/sessions.sock";
+            }
+        }
+        
+    }
+}
+#endif
@@ -0,0 +1,264 @@
+#include "shared-ring.hpp"
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace MikoIDE {
+    namespace Utils {
+        
+        namespace {
+            constexpr uint32_t kRingMagic = 0x474e524d;  // "MRNG"
+            constexpr uint32_t kRingVersion = 1;
+            constexpr uint32_t kWrapMarker = 0xffffffffu;
+            
+            size_t AlignRecord(size_t size) {
+                return (size + 7) & ~static_cast<size_t>(7);
+            }
+            
+            size_t RoundUpPowerOfTwo(size_t value) {
+                size_t result = 4096;
+                while (result < value) {
+                    result <<= 1;
+                }
+                return result;
+            }
+        }
+        
+        SharedRing::SharedRing()
+            : header_(nullptr), data_(nullptr), capacity_(0), mapping_size_(0), owner_(false)
+#ifdef _WIN32
+            , mapping_handle_(nullptr)
+#endif
+        {
+        }
+        
+        SharedRing::~SharedRing() {
+            Close();
+        }
+        
+        bool SharedRing::Fail(const std::string& error) {
+            Close();
+            last_error_ = error;
+            return false;
+        }
+        
+        bool SharedRing::Create(const std::string& name, size_t capacity) {
+            Close();
+            capacity_ = RoundUpPowerOfTwo(capacity);
+            if (!Map(name, sizeof(Header) + capacity_, true)) {
+                return false;
+            }
+            
+            header_->magic = kRingMagic;
+            header_->version = kRingVersion;
+            header_->capacity = capacity_;
+            header_->head.store(0, std::memory_order_relaxed);
+            header_->tail.store(0, std::memory_order_relaxed);
+            header_->doorbell.store(0, std::memory_order_relaxed);
+            header_->producer_blocked.store(0, std::memory_order_release);
+            return true;
+        }
+        
+        bool SharedRing::Open(const std::string& name) {
+            Close();
+            if (!Map(name, 0, false)) {
+                return false;
+            }
+            
+            if (header_->magic != kRingMagic || header_->version != kRingVersion ||
+                header_->capacity + sizeof(Header) > mapping_size_) {
+                return Fail("not a stream ring: " + name);
+            }
+            capacity_ = static_cast<size_t>(header_->capacity);
+            return true;
+        }
+        
+        bool SharedRing::Map(const std::string& name, size_t size, bool create) {
+            last_error_.clear();
+            name_ = name;
+            owner_ = create;
+            
+#ifdef _WIN32
+            std::string objectName = "Local\\" + name;
+            if (create) {
+                mapping_handle_ = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                                     static_cast<DWORD>(static_cast<uint64_t>(size) >> 32),
+                                                     static_cast<DWORD>(size), objectName.c_str());
+                if (mapping_handle_ && ::GetLastError() == ERROR_ALREADY_EXISTS) {
+                    return Fail("stream ring already exists: " + name);
+                }
+            } else {
+                mapping_handle_ = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, objectName.c_str());
+            }
+            if (!mapping_handle_) {
+                return Fail("cannot map stream ring " + name);
+            }
+            
+            void* base = MapViewOfFile(mapping_handle_, FILE_MAP_ALL_ACCESS, 0, 0, size);
+            if (!base) {
+                return Fail("cannot map stream ring " + name);
+            }
+            
+            MEMORY_BASIC_INFORMATION info;
+            VirtualQuery(base, &info, sizeof(info));
+            mapping_size_ = size ? size : info.RegionSize;
+#else
+            std::string objectName = "/" + name;
+            int fd = shm_open(objectName.c_str(), create ? (O_CREAT | O_EXCL | O_RDWR) : O_RDWR, 0600);
+            if (fd < 0) {
+                return Fail("cannot open stream ring " + name);
+            }
+            
+            if (create && ftruncate(fd, static_cast<off_t>(size)) != 0) {
+                close(fd);
+                shm_unlink(objectName.c_str());
+                return Fail("cannot size stream ring " + name);
+            }
+            
+            struct stat info;
+            if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(Header)) {
+                close(fd);
+                return Fail("truncated stream ring " + name);
+            }
+            mapping_size_ = static_cast<size_t>(info.st_size);
+            
+            void* base = mmap(nullptr, mapping_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            close(fd);
+            if (base == MAP_FAILED) {
+                if (create) {
+                    shm_unlink(objectName.c_str());
+                }
+                return Fail("cannot map stream ring " + name);
+            }
+#endif
+            
+            header_ = static_cast<Header*>(base);
+            data_ = static_cast<uint8_t*>(base) + sizeof(Header);
+            return true;
+        }
+        
+        void SharedRing::Close() {
+            if (header_) {
+#ifdef _WIN32
+                UnmapViewOfFile(header_);
+#else
+                munmap(header_, mapping_size_);
+                if (owner_) {
+                    shm_unlink(("/" + name_).c_str());
+                }
+#endif
+            }
+#ifdef _WIN32
+            if (mapping_handle_) {
+                CloseHandle(mapping_handle_);
+                mapping_handle_ = nullptr;
+            }
+#endif
+            header_ = nullptr;
+            data_ = nullptr;
+            capacity_ = 0;
+            mapping_size_ = 0;
+            owner_ = false;
+        }
+        
+        bool SharedRing::Write(uint32_t stream, const void* data, size_t size) {
+            if (!header_ || size > GetMaxRecordSize()) {
+                return false;
+            }
+            
+            const size_t need = AlignRecord(kRecordHeaderSize + size);
+            uint64_t head = header_->head.load(std::memory_order_relaxed);
+            const uint64_t tail = header_->tail.load(std::memory_order_acquire);
+            size_t offset = static_cast<size_t>(head & (capacity_ - 1));
+            const size_t contiguous = capacity_ - offset;
+            const size_t total = need + (contiguous < need ? contiguous : 0);
+            
+            if (head + total - tail > capacity_) {
+                // Flag first, then look again: either this sees the consumer's
+                // progress or the consumer sees the flag after draining
+                header_->producer_blocked.store(1, std::memory_order_seq_cst);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (head + total - header_->tail.load(std::memory_order_acquire) > capacity_) {
+                    return false;
+                }
+            }
+            
+            if (contiguous < need) {
+                uint32_t marker = kWrapMarker;
+                memcpy(data_ + offset, &marker, sizeof(marker));
+                head += contiguous;
+                offset = 0;
+            }
+            
+            uint32_t recordHeader[2] = {static_cast<uint32_t>(size), stream};
+            memcpy(data_ + offset, recordHeader, sizeof(recordHeader));
+            if (size > 0) {
+                memcpy(data_ + offset + kRecordHeaderSize, data, size);
+            }
+            header_->head.store(head + need, std::memory_order_release);
+            return true;
+        }
+        
+        bool SharedRing::TakeDoorbell() {
+            return header_ && header_->doorbell.exchange(1, std::memory_order_seq_cst) == 0;
+        }
+        
+        bool SharedRing::Peek(Record& record) {
+            if (!header_) {
+                return false;
+            }
+            
+            uint64_t tail = header_->tail.load(std::memory_order_relaxed);
+            while (true) {
+                const uint64_t head = header_->head.load(std::memory_order_acquire);
+                if (tail == head) {
+                    return false;
+                }
+                
+                const size_t offset = static_cast<size_t>(tail & (capacity_ - 1));
+                uint32_t recordHeader[2];
+                memcpy(recordHeader, data_ + offset, sizeof(recordHeader));
+                
+                if (recordHeader[0] == kWrapMarker) {
+                    tail += capacity_ - offset;
+                    header_->tail.store(tail, std::memory_order_release);
+                    continue;
+                }
+                
+                record.size = recordHeader[0];
+                record.stream = recordHeader[1];
+                record.data = data_ + offset + kRecordHeaderSize;
+                record.end = tail + AlignRecord(kRecordHeaderSize + record.size);
+                return true;
+            }
+        }
+        
+        void SharedRing::Release(const Record& record) {
+            if (header_) {
+                header_->tail.store(record.end, std::memory_order_release);
+            }
+        }
+        
+        void SharedRing::ResetDoorbell() {
+            if (header_) {
+                header_->doorbell.store(0, std::memory_order_seq_cst);
+            }
+        }
+        
+        bool SharedRing::TakeProducerBlocked() {
+            if (!header_) {
+                return false;
+            }
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            return header_->producer_blocked.exchange(0, std::memory_order_seq_cst) != 0;
+        }
+        
+    }
+}
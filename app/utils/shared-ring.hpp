@@ -0,0 +1,93 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace MikoIDE {
+    namespace Utils {
+        
+        // Single-producer/single-consumer byte ring in a named shared-memory
+        // region, used to stream bulk data between the browser and renderer
+        // processes without per-message serialization.
+        //
+        // Records are [uint32 size][uint32 stream][payload], 8-byte aligned and
+        // always contiguous: a record that would straddle the end is preceded by
+        // a wrap marker, so the consumer can hand out payload pointers directly.
+        //
+        // Notification is edge-triggered. After writing, the producer calls
+        // TakeDoorbell() and sends a wakeup only when it returns true; the
+        // consumer calls ResetDoorbell() before draining.
+        class SharedRing {
+        public:
+            struct Record {
+                uint32_t stream = 0;
+                const uint8_t* data = nullptr;
+                uint32_t size = 0;
+                uint64_t end = 0;
+            };
+            
+            SharedRing();
+            ~SharedRing();
+            
+            SharedRing(const SharedRing&) = delete;
+            SharedRing& operator=(const SharedRing&) = delete;
+            
+            // Producer: creates the region; |capacity| is rounded up to a power of two
+            bool Create(const std::string& name, size_t capacity);
+            // Consumer: maps a region created by another process
+            bool Open(const std::string& name);
+            void Close();
+            
+            bool IsOpen() const { return header_ != nullptr; }
+            size_t GetCapacity() const { return capacity_; }
+            // Larger payloads must be split by the caller
+            size_t GetMaxRecordSize() const { return capacity_ / 2 - kRecordHeaderSize; }
+            const std::string& GetName() const { return name_; }
+            const std::string& GetLastError() const { return last_error_; }
+            
+            // Producer side. Returns false if the ring is full; the consumer then
+            // reports TakeProducerBlocked() once it has made room.
+            bool Write(uint32_t stream, const void* data, size_t size);
+            bool TakeDoorbell();
+            
+            // Consumer side. A record's payload stays valid until Release().
+            bool Peek(Record& record);
+            void Release(const Record& record);
+            void ResetDoorbell();
+            bool TakeProducerBlocked();
+            
+            static constexpr size_t kRecordHeaderSize = 8;
+            
+        private:
+            struct Header {
+                uint32_t magic;
+                uint32_t version;
+                uint64_t capacity;
+                alignas(64) std::atomic<uint64_t> head;         // written by the producer
+                alignas(64) std::atomic<uint64_t> tail;         // written by the consumer
+                alignas(64) std::atomic<uint32_t> doorbell;
+                std::atomic<uint32_t> producer_blocked;
+            };
+            
+            static_assert(std::atomic<uint64_t>::is_always_lock_free,
+                          "shared-memory atomics must be lock-free");
+            
+            bool Map(const std::string& name, size_t size, bool create);
+            bool Fail(const std::string& error);
+            
+            Header* header_;
+            uint8_t* data_;
+            size_t capacity_;
+            size_t mapping_size_;
+            bool owner_;
+            std::string name_;
+            std::string last_error_;
+            
+#ifdef _WIN32
+            void* mapping_handle_;
+#endif
+        };
+        
+    }
+}
@@ -0,0 +1,563 @@
+#ifndef _WIN32
+#include "spawn-helper.hpp"
+#include "../core/logger.hpp"
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+extern char** environ;
+
+namespace MikoIDE {
+    namespace Utils {
+        
+        namespace {
+            // Browser -> helper: RequestHeader. A spawn has the PTY slave
+            // attached as SCM_RIGHTS and is followed by the command and working
+            // directory bytes; a kill is the header alone.
+            struct RequestHeader {
+                uint32_t type;
+                uint32_t request;
+                uint32_t command_size;
+                uint32_t directory_size;
+                int32_t pid;        // kill only
+                int32_t signal;
+            };
+            
+            // Helper -> browser. Spawned: a = request, b = pid or -errno.
+            // Exited: a = pid, b = exit code or -1.
+            struct Reply {
+                uint32_t type;
+                int32_t a;
+                int32_t b;
+            };
+            
+            constexpr uint32_t kRequestSpawn = 0;
+            constexpr uint32_t kRequestKill = 1;
+            
+            constexpr uint32_t kReplySpawned = 0;
+            constexpr uint32_t kReplyExited = 1;
+            constexpr uint32_t kMaxRequestString = 1 << 20;
+            
+            // Helper only: SIGCHLD wakes the poll loop through this pipe
+            int g_child_pipe = -1;
+            
+            bool WriteFully(int fd, const void* data, size_t size) {
+                const char* p = static_cast<const char*>(data);
+                while (size > 0) {
+                    ssize_t n = write(fd, p, size);
+                    if (n < 0 && errno == EINTR) {
+                        continue;
+                    }
+                    if (n <= 0) {
+                        return false;
+                    }
+                    p += n;
+                    size -= static_cast<size_t>(n);
+                }
+                return true;
+            }
+            
+            bool ReadFully(int fd, void* data, size_t size) {
+                char* p = static_cast<char*>(data);
+                while (size > 0) {
+                    ssize_t n = read(fd, p, size);
+                    if (n < 0 && errno == EINTR) {
+                        continue;
+                    }
+                    if (n <= 0) {
+                        return false;
+                    }
+                    p += n;
+                    size -= static_cast<size_t>(n);
+                }
+                return true;
+            }
+            
+            int ExitCodeFromStatus(int status) {
+                return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+            }
+            
+            void SetCloseOnExec(int fd) {
+                fcntl(fd, F_SETFD, fcntl(fd, F_GETFD) | FD_CLOEXEC);
+            }
+            
+            void OnChildSignal(int) {
+                const int saved = errno;
+                const char byte = 0;
+                (void)!write(g_child_pipe, &byte, 1);
+                errno = saved;
+            }
+            
+            pid_t SpawnInHelper(const std::string& command, int slaveFd, int& error) {
+#if defined(__linux__) && defined(POSIX_SPAWN_SETSID)
+                char path[256];
+                error = ttyname_r(slaveFd, path, sizeof(path));
+                if (error != 0) {
+                    return -1;
+                }
+                
+                posix_spawnattr_t attributes;
+                posix_spawnattr_init(&attributes);
+                sigset_t all;
+                sigset_t none;
+                sigfillset(&all);
+                sigemptyset(&none);
+                // The helper's SIGCHLD handler and ignored SIGPIPE do not carry over
+                posix_spawnattr_setsigdefault(&attributes, &all);
+                posix_spawnattr_setsigmask(&attributes, &none);
+                posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSID | POSIX_SPAWN_SETSIGDEF |
+                                                      POSIX_SPAWN_SETSIGMASK);
+                
+                // Opened by the new session leader, the slave becomes its
+                // controlling terminal
+                posix_spawn_file_actions_t actions;
+                posix_spawn_file_actions_init(&actions);
+                posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, path, O_RDWR, 0);
+                posix_spawn_file_actions_adddup2(&actions, STDIN_FILENO, STDOUT_FILENO);
+                posix_spawn_file_actions_adddup2(&actions, STDIN_FILENO, STDERR_FILENO);
+                
+                char shell[] = "sh";
+                char flag[] = "-c";
+                char* argv[] = {shell, flag, const_cast<char*>(command.c_str()), nullptr};
+                pid_t pid = -1;
+                error = posix_spawn(&pid, "/bin/sh", &actions, &attributes, argv, environ);
+                
+                posix_spawn_file_actions_destroy(&actions);
+                posix_spawnattr_destroy(&attributes);
+                return error == 0 ? pid : -1;
+#else
+                pid_t pid = SpawnHelper::ForkChild(command, std::string(), slaveFd);
+                error = pid < 0 ? errno : 0;
+                return pid;
+#endif
+            }
+            
+            // Returns false when the browser is gone or misbehaving. |children|
+            // are the helper's unreaped children.
+            bool HandleRequest(int socket, int startDirectory, std::set<pid_t>& children) {
+                RequestHeader header;
+                char control[CMSG_SPACE(sizeof(int))];
+                iovec io = {&header, sizeof(header)};
+                msghdr message = {};
+                message.msg_iov = &io;
+                message.msg_iovlen = 1;
+                message.msg_control = control;
+                message.msg_controllen = sizeof(control);
+                
+                ssize_t received;
+                do {
+                    received = recvmsg(socket, &message, 0);
+                } while (received < 0 && errno == EINTR);
+                if (received <= 0) {
+                    return false;
+                }
+                
+                int slaveFd = -1;
+                for (cmsghdr* cmsg = CMSG_FIRSTHDR(&message); cmsg; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+                    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+                        memcpy(&slaveFd, CMSG_DATA(cmsg), sizeof(int));
+                        SetCloseOnExec(slaveFd);
+                    }
+                }
+                
+                if (static_cast<size_t>(received) < sizeof(header) &&
+                    !ReadFully(socket, reinterpret_cast<char*>(&header) + received, sizeof(header) - received)) {
+                    return false;
+                }
+                if (header.type == kRequestKill) {
+                    if (slaveFd != -1) {
+                        close(slaveFd);
+                    }
+                    // An unreaped child keeps its pid, so this cannot hit a
+                    // recycled one. Children lead their own process group.
+                    if (children.count(header.pid)) {
+                        kill(-header.pid, header.signal);
+                    }
+                    return true;
+                }
+                if (header.command_size > kMaxRequestString || header.directory_size > kMaxRequestString) {
+                    return false;
+                }
+                std::string command(header.command_size, '\0');
+                std::string directory(header.directory_size, '\0');
+                if (!ReadFully(socket, &command[0], command.size()) ||
+                    !ReadFully(socket, &directory[0], directory.size())) {
+                    return false;
+                }
+                
+                Reply reply = {kReplySpawned, static_cast<int32_t>(header.request), -EBADF};
+                if (slaveFd != -1) {
+                    // The helper is single-threaded, so its directory can stand
+                    // in for the child's; a missing one leaves it where it is,
+                    // as the in-process fork does
+                    if (!directory.empty() && chdir(directory.c_str()) != 0) {
+                        directory.clear();
+                    }
+                    int error = 0;
+                    pid_t pid = SpawnInHelper(command, slaveFd, error);
+                    reply.b = pid > 0 ? pid : -error;
+                    if (pid > 0) {
+                        children.insert(pid);
+                    }
+                    if (!directory.empty()) {
+                        (void)!fchdir(startDirectory);
+                    }
+                    close(slaveFd);
+                }
+                return WriteFully(socket, &reply, sizeof(reply));
+            }
+            
+            [[noreturn]] void RunHelper(int socket) {
+                int childPipe[2];
+                if (pipe(childPipe) != 0) {
+                    _exit(1);
+                }
+                for (int fd : childPipe) {
+                    SetCloseOnExec(fd);
+                    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                }
+                g_child_pipe = childPipe[1];
+                
+                struct sigaction action = {};
+                action.sa_handler = OnChildSignal;
+                sigemptyset(&action.sa_mask);
+                action.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+                sigaction(SIGCHLD, &action, nullptr);
+                signal(SIGPIPE, SIG_IGN);
+                
+                sigset_t none;
+                sigemptyset(&none);
+                sigprocmask(SIG_SETMASK, &none, nullptr);
+                
+                const int startDirectory = open(".", O_RDONLY | O_CLOEXEC);
+                std::set<pid_t> children;
+                pollfd fds[2] = {{socket, POLLIN, 0}, {childPipe[0], POLLIN, 0}};
+                while (true) {
+                    if (poll(fds, 2, -1) < 0) {
+                        if (errno == EINTR) {
+                            continue;
+                        }
+                        _exit(1);
+                    }
+                    
+                    if (fds[1].revents) {
+                        char drain[64];
+                        while (read(childPipe[0], drain, sizeof(drain)) > 0) {
+                        }
+                        int status;
+                        pid_t pid;
+                        while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+                            children.erase(pid);
+                            Reply reply = {kReplyExited, pid, ExitCodeFromStatus(status)};
+                            if (!WriteFully(socket, &reply, sizeof(reply))) {
+                                _exit(0);
+                            }
+                        }
+                    }
+                    
+                    if (fds[0].revents && !HandleRequest(socket, startDirectory, children)) {
+                        // The browser exited; its terminals get SIGHUP from their PTYs
+                        _exit(0);
+                    }
+                }
+            }
+        }
+        
+        SpawnHelper& SpawnHelper::GetInstance() {
+            static SpawnHelper instance;
+            return instance;
+        }
+        
+        SpawnHelper::SpawnHelper()
+            : helper_pid_(-1), socket_(-1), next_request_(0), reply_request_(0), reply_pid_(-1), running_(false) {
+        }
+        
+        SpawnHelper::~SpawnHelper() {
+            Stop();
+        }
+        
+        bool SpawnHelper::Start() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (running_) {
+                return true;
+            }
+            
+            int fds[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+                Logger::LogMessage("Failed to create spawn helper socket: " + std::string(strerror(errno)));
+                return false;
+            }
+            SetCloseOnExec(fds[0]);
+            SetCloseOnExec(fds[1]);
+            
+            pid_t pid = fork();
+            if (pid < 0) {
+                Logger::LogMessage("Failed to fork spawn helper: " + std::string(strerror(errno)));
+                close(fds[0]);
+                close(fds[1]);
+                return false;
+            }
+            if (pid == 0) {
+                close(fds[0]);
+                RunHelper(fds[1]);
+            }
+            
+            close(fds[1]);
+            socket_ = fds[0];
+            helper_pid_ = pid;
+            running_ = true;
+            reader_ = std::thread(&SpawnHelper::ReaderLoop, this);
+            Logger::LogMessage("Spawn helper started with PID: " + std::to_string(pid));
+            return true;
+        }
+        
+        void SpawnHelper::Stop() {
+            if (socket_ == -1) {
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                running_ = false;
+            }
+            // The helper sees EOF and exits; the reader then sees EOF too
+            shutdown(socket_, SHUT_RDWR);
+            if (reader_.joinable()) {
+                reader_.join();
+            }
+            close(socket_);
+            socket_ = -1;
+            waitpid(helper_pid_, nullptr, 0);
+            helper_pid_ = -1;
+        }
+        
+        bool SpawnHelper::IsRunning() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return running_;
+        }
+        
+        pid_t SpawnHelper::Spawn(const std::string& command, const std::string& workingDir, int slaveFd) {
+            {
+                std::lock_guard<std::mutex> spawnLock(spawn_mutex_);
+                const uint32_t request = ++next_request_;
+                if (IsRunning()) {
+                    RequestHeader header = {kRequestSpawn, request, static_cast<uint32_t>(command.size()),
+                                            static_cast<uint32_t>(workingDir.size()), 0, 0};
+                    char control[CMSG_SPACE(sizeof(int))] = {};
+                    iovec io = {&header, sizeof(header)};
+                    msghdr message = {};
+                    message.msg_iov = &io;
+                    message.msg_iovlen = 1;
+                    message.msg_control = control;
+                    message.msg_controllen = sizeof(control);
+                    cmsghdr* cmsg = CMSG_FIRSTHDR(&message);
+                    cmsg->cmsg_level = SOL_SOCKET;
+                    cmsg->cmsg_type = SCM_RIGHTS;
+                    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+                    memcpy(CMSG_DATA(cmsg), &slaveFd, sizeof(int));
+                    
+                    ssize_t sent;
+                    do {
+                        sent = sendmsg(socket_, &message, MSG_NOSIGNAL);
+                    } while (sent < 0 && errno == EINTR);
+                    
+                    if (sent == static_cast<ssize_t>(sizeof(header)) &&
+                        WriteFully(socket_, command.data(), command.size()) &&
+                        WriteFully(socket_, workingDir.data(), workingDir.size())) {
+                        std::unique_lock<std::mutex> lock(mutex_);
+                        reply_cv_.wait(lock, [&]() { return reply_request_ == request || !running_; });
+                        if (reply_request_ != request) {
+                            // The helper died with the request in flight, which
+                            // may or may not have started the child
+                            Logger::LogMessage("Spawn helper exited during a spawn");
+                            return -1;
+                        }
+                        if (reply_pid_ < 0) {
+                            Logger::LogMessage("Spawn helper failed: " + std::string(strerror(-reply_pid_)));
+                            return -1;
+                        }
+                        return reply_pid_;
+                    }
+                    Logger::LogMessage("Spawn helper unreachable, forking in-process");
+                }
+            }
+            pid_t pid = ForkChild(command, workingDir, slaveFd);
+            if (pid > 0) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                forked_.insert(pid);
+            }
+            return pid;
+        }
+        
+        void SpawnHelper::Kill(pid_t pid, int signal) {
+            std::lock_guard<std::mutex> spawnLock(spawn_mutex_);
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (forked_.count(pid)) {
+                kill(-pid, signal);
+                return;
+            }
+            if (!running_ || !children_.count(pid)) {
+                return;
+            }
+            // Only the helper knows whether it has reaped the child yet
+            RequestHeader header = {kRequestKill, 0, 0, 0, pid, signal};
+            ssize_t sent;
+            do {
+                sent = send(socket_, &header, sizeof(header), MSG_NOSIGNAL);
+            } while (sent < 0 && errno == EINTR);
+            if (sent != static_cast<ssize_t>(sizeof(header))) {
+                Logger::LogMessage("Spawn helper unreachable, child " + std::to_string(pid) + " not signalled");
+            }
+        }
+        
+        pid_t SpawnHelper::ForkChild(const std::string& command, const std::string& workingDir, int slaveFd) {
+            pid_t pid = fork();
+            if (pid == 0) {
+                setsid();
+                ioctl(slaveFd, TIOCSCTTY, 0);
+                
+                dup2(slaveFd, STDIN_FILENO);
+                dup2(slaveFd, STDOUT_FILENO);
+                dup2(slaveFd, STDERR_FILENO);
+                if (slaveFd > STDERR_FILENO) {
+                    close(slaveFd);
+                }
+                
+                if (!workingDir.empty() && chdir(workingDir.c_str()) != 0) {
+                    // Start in the inherited directory instead
+                }
+                
+                execl("/bin/sh", "sh", "-c", command.c_str(), nullptr);
+                _exit(1);
+            }
+            return pid;
+        }
+        
+        void SpawnHelper::WatchExit(pid_t pid, std::function<void(int exitCode)> callback) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                auto exited = exited_.find(pid);
+                if (exited != exited_.end()) {
+                    const int exitCode = exited->second;
+                    exited_.erase(exited);
+                    lock.unlock();
+                    callback(exitCode);
+                    return;
+                }
+                if (children_.count(pid)) {
+                    if (running_) {
+                        watchers_[pid] = std::move(callback);
+                        return;
+                    }
+                    // Lost with the helper
+                    children_.erase(pid);
+                    lock.unlock();
+                    callback(-1);
+                    return;
+                }
+            }
+            
+            // Forked in-process. The PTY closes before the child is reapable,
+            // so wait for it off the caller's thread unless it already is.
+            int exitCode = -1;
+            if (ReapForked(pid, WNOHANG, exitCode)) {
+                callback(exitCode);
+                return;
+            }
+            std::thread([this, pid, callback]() {
+                int exitCode = -1;
+                ReapForked(pid, 0, exitCode);
+                callback(exitCode);
+            }).detach();
+        }
+        
+        bool SpawnHelper::ReapForked(pid_t pid, int options, int& exitCode) {
+            // Waited for without reaping first: the zombie keeps the pid while
+            // it leaves forked_, so Kill() cannot signal a recycled one
+            siginfo_t info = {};
+            int result;
+            do {
+                result = waitid(P_PID, static_cast<id_t>(pid), &info, WEXITED | WNOWAIT | options);
+            } while (result != 0 && errno == EINTR);
+            if (result == 0 && info.si_pid == 0) {
+                return false;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                forked_.erase(pid);
+            }
+            int status = 0;
+            exitCode = result == 0 && waitpid(pid, &status, 0) == pid ? ExitCodeFromStatus(status) : -1;
+            return true;
+        }
+        
+        void SpawnHelper::ReaderLoop() {
+            Reply reply;
+            while (ReadFully(socket_, &reply, sizeof(reply))) {
+                std::function<void(int)> callback;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (reply.type == kReplySpawned) {
+                        if (reply.b > 0) {
+                            // A reused pid must not inherit an unwatched exit
+                            children_.insert(reply.b);
+                            exited_.erase(reply.b);
+                        }
+                        reply_request_ = static_cast<uint32_t>(reply.a);
+                        reply_pid_ = reply.b;
+                        reply_cv_.notify_all();
+                        continue;
+                    }
+                    
+                    children_.erase(reply.a);
+                    auto watcher = watchers_.find(reply.a);
+                    if (watcher != watchers_.end()) {
+                        callback = std::move(watcher->second);
+                        watchers_.erase(watcher);
+                    } else {
+                        exited_[reply.a] = reply.b;
+                    }
+                }
+                if (callback) {
+                    callback(reply.b);
+                }
+            }
+            OnHelperGone();
+        }
+        
+        void SpawnHelper::OnHelperGone() {
+            std::map<pid_t, std::function<void(int)>> watchers;
+            bool unexpected;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                unexpected = running_;
+                running_ = false;
+                watchers.swap(watchers_);
+                for (const auto& watcher : watchers) {
+                    children_.erase(watcher.first);
+                }
+                reply_cv_.notify_all();
+            }
+            if (unexpected) {
+                Logger::LogMessage("Spawn helper exited; forking terminals in-process");
+            }
+            for (auto& watcher : watchers) {
+                watcher.second(-1);
+            }
+        }
+        
+    }
+}
+#endif
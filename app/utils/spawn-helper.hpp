@@ -0,0 +1,94 @@
+#pragma once
+#ifndef _WIN32
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <sys/types.h>
+#include <thread>
+
+namespace MikoIDE {
+    namespace Utils {
+        
+        // Starts terminal children from a small helper process instead of
+        // forking the browser. fork() from the browser copies the page tables
+        // of a multi-GB, heavily threaded process, and the child then runs
+        // with whatever locks other threads held. The helper is forked once
+        // at startup, while the process is still small and single-threaded.
+        //
+        // Requests carry the PTY slave over a socketpair (SCM_RIGHTS). The
+        // helper starts the child with posix_spawn on Linux, which is
+        // vfork-based: the session and controlling terminal are set up by
+        // POSIX_SPAWN_SETSID and opening the slave. Elsewhere the helper forks
+        // itself, which is cheap at its size. The helper reaps its children
+        // and reports their exit codes back.
+        //
+        // Without a helper (Start() not called or failed, or the helper died)
+        // Spawn() forks in-process as before.
+        class SpawnHelper {
+        public:
+            static SpawnHelper& GetInstance();
+            
+            SpawnHelper();
+            ~SpawnHelper();
+            
+            SpawnHelper(const SpawnHelper&) = delete;
+            SpawnHelper& operator=(const SpawnHelper&) = delete;
+            
+            // Forks the helper. Call early in main(), before any thread starts.
+            bool Start();
+            void Stop();
+            bool IsRunning();
+            
+            // Runs `/bin/sh -c command` in |workingDir| (the helper's startup
+            // directory when empty) as a session leader with |slaveFd| as its
+            // controlling terminal and stdio. The caller keeps |slaveFd|.
+            // Returns the pid, or -1.
+            pid_t Spawn(const std::string& command, const std::string& workingDir, int slaveFd);
+            
+            // The same in this process, with fork()
+            static pid_t ForkChild(const std::string& command, const std::string& workingDir, int slaveFd);
+            
+            // Calls |callback| with the exit code (-1 if killed by a signal or
+            // unknown) once |pid| from Spawn() exits, at once if it already has,
+            // otherwise from another thread
+            void WatchExit(pid_t pid, std::function<void(int exitCode)> callback);
+            
+            // Sends |signal| to the process group of |pid| from Spawn(), but
+            // only while it is unreaped, so a recycled pid is never signalled.
+            // Call WatchExit() as well to have it reaped.
+            void Kill(pid_t pid, int signal);
+            
+        private:
+            void ReaderLoop();
+            void OnHelperGone();
+            // True once an in-process child has exited (blocks unless
+            // |options| has WNOHANG); reaps it and fills |exitCode|
+            bool ReapForked(pid_t pid, int options, int& exitCode);
+            
+            pid_t helper_pid_;
+            int socket_;
+            std::thread reader_;
+            
+            // Spawn requests are serialized; the reader hands back the reply
+            std::mutex spawn_mutex_;
+            uint32_t next_request_;
+            uint32_t reply_request_;
+            pid_t reply_pid_;
+            
+            // Helper children not yet reaped, children whose exit arrived
+            // before anyone watched them, and watchers waiting for an exit
+            std::set<pid_t> children_;
+            std::set<pid_t> forked_;        // Spawn() fell back to ForkChild
+            std::map<pid_t, int> exited_;
+            std::map<pid_t, std::function<void(int)>> watchers_;
+            bool running_;
+            std::mutex mutex_;
+            std::condition_variable reply_cv_;
+        };
+        
+    }
+}
+#endif
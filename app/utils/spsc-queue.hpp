@@ -0,0 +1,59 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+namespace MikoIDE {
+    namespace Utils {
+        
+        // Bounded lock-free single-producer/single-consumer ring buffer.
+        // Exactly one thread may push and exactly one (other) thread may pop.
+        template <typename T, size_t Capacity>
+        class SpscQueue {
+            static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                          "SpscQueue capacity must be a power of two");
+            
+        public:
+            SpscQueue() : head_(0), tail_(0) {}
+            
+            SpscQueue(const SpscQueue&) = delete;
+            SpscQueue& operator=(const SpscQueue&) = delete;
+            
+            // Producer side. Returns false if the queue is full.
+            bool TryPush(T value) {
+                const size_t tail = tail_.load(std::memory_order_relaxed);
+                if (tail - head_.load(std::memory_order_acquire) == Capacity) {
+                    return false;
+                }
+                slots_[tail & (Capacity - 1)] = std::move(value);
+                tail_.store(tail + 1, std::memory_order_release);
+                return true;
+            }
+            
+            // Consumer side. Returns false if the queue is empty.
+            bool TryPop(T& value) {
+                const size_t head = head_.load(std::memory_order_relaxed);
+                if (head == tail_.load(std::memory_order_acquire)) {
+                    return false;
+                }
+                value = std::move(slots_[head & (Capacity - 1)]);
+                slots_[head & (Capacity - 1)] = T();
+                head_.store(head + 1, std::memory_order_release);
+                return true;
+            }
+            
+            bool Empty() const {
+                return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+            }
+            
+        private:
+            // Keep the indices on separate cache lines so the two threads do not
+            // false-share on every operation
+            alignas(64) std::atomic<size_t> head_;
+            alignas(64) std::atomic<size_t> tail_;
+            std::array<T, Capacity> slots_;
+        };
+        
+    }
+}
@@ -0,0 +1,222 @@
+#include "terminal-search.hpp"
+#include "terminal.hpp"
+#include "scrollback.hpp"
+#include <algorithm>
+
+namespace MikoIDE {
+    namespace Utils {
+        
+        std::shared_ptr<TerminalSearch> TerminalSearch::Create(const std::string& query,
+                                                               const TerminalSearchOptions& options,
+                                                               MatchCallback onMatches, DoneCallback onDone,
+                                                               std::string& error) {
+            std::shared_ptr<TerminalSearch> search(new TerminalSearch(options, std::move(onMatches), std::move(onDone)));
+            if (!search->Compile(query, error)) {
+                return nullptr;
+            }
+            return search;
+        }
+        
+        void TerminalSearch::Start(TerminalManager& manager, ThreadPool& pool) {
+            std::vector<std::string> ids;
+            if (options_.terminal_id.empty()) {
+                ids = manager.GetTerminalIds();
+            } else {
+                ids.push_back(options_.terminal_id);
+            }
+            
+            std::vector<Job> jobs;
+            for (const std::string& id : ids) {
+                auto terminal = manager.GetTerminal(id);
+                Scrollback* scrollback = terminal ? terminal->GetScrollback() : nullptr;
+                if (!scrollback) {
+                    continue;
+                }
+                
+                // Newest first: the screen, then history from the end back
+                jobs.push_back(Job{id, terminal, 0, 0, true});
+                const uint64_t first = scrollback->GetFirstLine();
+                for (uint64_t end = scrollback->GetEndLine(); end > first;) {
+                    const uint64_t begin = end - std::min(end - first, kSliceLines);
+                    jobs.push_back(Job{id, terminal, begin, end, false});
+                    end = begin;
+                }
+            }
+            
+            // One extra count keeps onDone from running before every job is posted
+            pending_jobs_ = jobs.size() + 1;
+            auto self = shared_from_this();
+            for (Job& job : jobs) {
+                auto posted = std::make_shared<Job>(std::move(job));
+                if (!pool.Post([self, posted]() {
+                        self->Run(*posted);
+                        self->FinishJob();
+                    })) {
+                    cancelled_ = true;
+                    FinishJob();
+                }
+            }
+            FinishJob();
+        }
+        
+        TerminalSearch::TerminalSearch(const TerminalSearchOptions& options, MatchCallback onMatches,
+                                       DoneCallback onDone)
+            : options_(options), on_matches_(std::move(onMatches)), on_done_(std::move(onDone)),
+              cancelled_(false), truncated_(false), match_count_(0), pending_jobs_(0) {
+        }
+        
+        bool TerminalSearch::Compile(const std::string& query, std::string& error) {
+            if (query.empty()) {
+                error = "Empty search query";
+                return false;
+            }
+            
+            std::string literal = query;
+            if (options_.regex) {
+                auto flags = std::regex::ECMAScript | std::regex::optimize;
+                if (!options_.case_sensitive) {
+                    flags |= std::regex::icase;
+                }
+                try {
+                    regex_ = std::make_unique<std::regex>(query, flags);
+                } catch (const std::regex_error& e) {
+                    error = std::string("Invalid search pattern: ") + e.what();
+                    return false;
+                }
+                literal = ExtractRequiredLiteral(query);
+            }
+            
+            if (!literal.empty()) {
+                if (!options_.case_sensitive) {
+                    AsciiToLower(literal);
+                }
+                finder_ = std::make_unique<LiteralFinder>(std::move(literal));
+            }
+            return true;
+        }
+        
+        void TerminalSearch::Run(const Job& job) {
+            std::string text;
+            std::string folded;
+            std::vector<uint32_t> lineEnds;
+            std::vector<TerminalSearchMatch> matches;
+            
+            auto flush = [&]() {
+                if (!matches.empty()) {
+                    on_matches_(job.terminal_id, matches);
+                    matches.clear();
+                }
+            };
+            
+            if (job.screen) {
+                uint64_t firstLine = 0;
+                if (job.terminal->ReadScreenText(firstLine, text, lineEnds)) {
+                    SearchText(firstLine, text, lineEnds, folded, matches);
+                }
+                flush();
+                return;
+            }
+            
+            Scrollback* scrollback = job.terminal->GetScrollback();
+            uint64_t line = job.first;
+            while (line < job.end && !IsStopped()) {
+                text.clear();
+                lineEnds.clear();
+                uint64_t firstLine = line;
+                const size_t count = static_cast<size_t>(std::min<uint64_t>(job.end - line, kChunkLines));
+                const size_t read = scrollback->ReadText(firstLine, count, text, lineEnds);
+                if (read == 0 || firstLine >= job.end) {
+                    // Discarded since the search started
+                    break;
+                }
+                
+                SearchText(firstLine, text, lineEnds, folded, matches);
+                flush();
+                line = firstLine + read;
+            }
+        }
+        
+        void TerminalSearch::SearchText(uint64_t firstLine, const std::string& text,
+                                        const std::vector<uint32_t>& lineEnds, std::string& folded,
+                                        std::vector<TerminalSearchMatch>& matches) {
+            const std::string* haystack = &text;
+            if (!options_.case_sensitive) {
+                folded = text;
+                AsciiToLower(folded);
+                haystack = &folded;
+            }
+            
+            const char* data = haystack->data();
+            size_t offset = 0;
+            while (offset < text.size() && !IsStopped()) {
+                size_t position = offset;
+                if (finder_) {
+                    const char* hit = finder_->Find(data + offset, data + haystack->size());
+                    if (!hit) {
+                        break;
+                    }
+                    position = static_cast<size_t>(hit - data);
+                }
+                
+                const size_t index = static_cast<size_t>(
+                    std::lower_bound(lineEnds.begin(), lineEnds.end(), position) - lineEnds.begin());
+                if (index >= lineEnds.size()) {
+                    break;
+                }
+                const size_t begin = index == 0 ? 0 : lineEnds[index - 1] + 1;
+                const size_t end = lineEnds[index];
+                MatchLine(firstLine + index, text, *haystack, begin, end, matches);
+                offset = end + 1;
+            }
+        }
+        
+        void TerminalSearch::MatchLine(uint64_t line, const std::string& text, const std::string& haystack,
+                                       size_t begin, size_t end, std::vector<TerminalSearchMatch>& matches) {
+            if (!regex_) {
+                const size_t length = finder_->GetNeedle().size();
+                const char* data = haystack.data();
+                for (const char* hit = finder_->Find(data + begin, data + end); hit;
+                     hit = finder_->Find(hit + length, data + end)) {
+                    if (!AddMatch(line, text, begin, end, static_cast<size_t>(hit - data) - begin, length, matches)) {
+                        return;
+                    }
+                }
+                return;
+            }
+            
+            try {
+                const char* first = text.data() + begin;
+                const char* last = text.data() + end;
+                for (std::cregex_iterator it(first, last, *regex_), done; it != done; ++it) {
+                    // Empty matches (a*, ^) have nothing to highlight
+                    if (it->length(0) > 0 &&
+                        !AddMatch(line, text, begin, end, static_cast<size_t>(it->position(0)),
+                                  static_cast<size_t>(it->length(0)), matches)) {
+                        return;
+                    }
+                }
+            } catch (const std::regex_error&) {
+                // Too complex for this line (error_complexity / error_stack)
+            }
+        }
+        
+        bool TerminalSearch::AddMatch(uint64_t line, const std::string& text, size_t begin, size_t end,
+                                      size_t column, size_t length, std::vector<TerminalSearchMatch>& matches) {
+            if (match_count_.fetch_add(1) >= options_.max_matches) {
+                truncated_ = true;
+                return false;
+            }
+            matches.push_back(TerminalSearchMatch{line, static_cast<uint32_t>(column), static_cast<uint32_t>(length),
+                                                  text.substr(begin, end - begin)});
+            return true;
+        }
+        
+        void TerminalSearch::FinishJob() {
+            if (pending_jobs_.fetch_sub(1) == 1) {
+                const size_t count = std::min(match_count_.load(), options_.max_matches);
+                on_done_(count, cancelled_.load(), truncated_.load());
+            }
+        }
+        
+    }
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include "text-search.hpp"
+#include "thread-pool.hpp"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <regex>
+#include <string>
+#include <vector>
+
+namespace MikoIDE {
+    namespace Utils {
+        
+        class TerminalManager;
+        class TerminalProcess;
+        
+        struct TerminalSearchOptions {
+            bool regex = false;             // ECMAScript syntax, as in the frontend
+            bool case_sensitive = false;    // folding is ASCII-only
+            std::string terminal_id;        // empty searches every terminal
+            size_t max_matches = 10000;
+        };
+        
+        struct TerminalSearchMatch {
+            uint64_t line;                  // absolute, as in Scrollback
+            uint32_t column;                // byte offset into the line's UTF-8 text
+            uint32_t length;                // in bytes
+            std::string text;               // the whole line
+        };
+        
+        // One search over the scrollback and visible screen of terminals.
+        // Each terminal's history is cut into slices of kSliceLines that run
+        // as separate pool jobs, newest first. Slices are read kChunkLines at
+        // a time as plain text; a LiteralFinder skips to lines holding the
+        // query (or the regex's required literal) and only those lines go
+        // through std::regex. Matches are reported per chunk from the pool
+        // threads, so batches for different slices arrive concurrently and
+        // out of line order.
+        class TerminalSearch : public std::enable_shared_from_this<TerminalSearch> {
+        public:
+            static constexpr uint64_t kSliceLines = 16384;
+            static constexpr size_t kChunkLines = 2048;
+            
+            using MatchCallback = std::function<void(const std::string& terminalId,
+                                                     const std::vector<TerminalSearchMatch>& matches)>;
+            using DoneCallback = std::function<void(size_t matchCount, bool cancelled, bool truncated)>;
+            
+            // Returns null with |error| set when the query is empty or the
+            // pattern does not compile
+            static std::shared_ptr<TerminalSearch> Create(const std::string& query,
+                                                          const TerminalSearchOptions& options,
+                                                          MatchCallback onMatches, DoneCallback onDone,
+                                                          std::string& error);
+            
+            // Posts the slices to |pool|. |onDone| runs exactly once, after the
+            // last |onMatches|, possibly before Start returns.
+            void Start(TerminalManager& manager, ThreadPool& pool);
+            
+            // Remaining chunks are skipped; batches already found may still arrive
+            void Cancel() { cancelled_ = true; }
+        
+        private:
+            struct Job {
+                std::string terminal_id;
+                std::shared_ptr<TerminalProcess> terminal;
+                uint64_t first;
+                uint64_t end;
+                bool screen;
+            };
+            
+            TerminalSearch(const TerminalSearchOptions& options, MatchCallback onMatches, DoneCallback onDone);
+            
+            bool Compile(const std::string& query, std::string& error);
+            void Run(const Job& job);
+            void SearchText(uint64_t firstLine, const std::string& text, const std::vector<uint32_t>& lineEnds,
+                            std::string& folded, std::vector<TerminalSearchMatch>& matches);
+            void MatchLine(uint64_t line, const std::string& text, const std::string& haystack,
+                           size_t begin, size_t end, std::vector<TerminalSearchMatch>& matches);
+            bool AddMatch(uint64_t line, const std::string& text, size_t begin, size_t end,
+                          size_t column, size_t length, std::vector<TerminalSearchMatch>& matches);
+            void FinishJob();
+            bool IsStopped() const { return cancelled_.load(std::memory_order_relaxed) || truncated_.load(std::memory_order_relaxed); }
+            
+            TerminalSearchOptions options_;
+            MatchCallback on_matches_;
+            DoneCallback on_done_;
+            
+            std::unique_ptr<LiteralFinder> finder_;     // null when no literal is required
+            std::unique_ptr<std::regex> regex_;         // null for plain text queries
+            
+            std::atomic<bool> cancelled_;
+            std::atomic<bool> truncated_;
+            std::atomic<size_t> match_count_;
+            std::atomic<size_t> pending_jobs_;
+        };
+        
+    }
+}
@@ -4,36 +4,64 @@
 #include <random>
 #include <iomanip>
 #include <chrono>
+#include <cstring>
+#include <algorithm>
+#include <iterator>
 
 #ifdef _WIN32
 #include <processthreadsapi.h>
 #include <handleapi.h>
 #else
+#include "session-client.hpp"
+#include "spawn-helper.hpp"
 #include <signal.h>
-#include <sys/select.h>
+#include <fcntl.h>
 #include <errno.h>
+#include <sys/socket.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
 #endif
 
 namespace MikoIDE {
     namespace Utils {
         
+        namespace {
+#ifndef _WIN32
+            // Reads per readiness event before yielding to other terminals
+            constexpr int kMaxReadsPerEvent = 16;
+#endif
+        }
+        
         // TerminalProcess Implementation
+#ifdef _WIN32
         TerminalProcess::TerminalProcess() 
             : running_(false), should_stop_(false)
-#ifdef _WIN32
             , process_handle_(INVALID_HANDLE_VALUE)
             , thread_handle_(INVALID_HANDLE_VALUE)
             , stdin_write_(INVALID_HANDLE_VALUE)
             , stdout_read_(INVALID_HANDLE_VALUE)
             , stderr_read_(INVALID_HANDLE_VALUE)
             , process_id_(0)
+            , exit_reported_(false)
+        {
+        }
 #else
+        TerminalProcess::TerminalProcess(IoReactor& reactor) 
+            : running_(false), should_stop_(false)
+            , reactor_(reactor)
             , process_id_(-1)
             , master_fd_(-1)
             , slave_fd_(-1)
-#endif
+            , write_interest_(false)
+            , output_paused_(false)
+            , output_outstanding_(0)
+            , utf8_carry_size_(0)
+            , exit_reported_(false)
         {
         }
+#endif
         
         TerminalProcess::~TerminalProcess() {
             if (running_) {
@@ -47,7 +75,7 @@ namespace MikoIDE {
                 Logger::LogMessage("Terminal process already running");
                 return false;
             }
-            
+
 #ifdef _WIN32
             return StartWindows(command.empty() ? "cmd.exe" : command, workingDir);
 #else
@@ -59,11 +87,27 @@ namespace MikoIDE {
             if (!running_) {
                 return false;
             }
-            
+
+#ifdef _WIN32
+            std::lock_guard<std::mutex> lock(input_mutex_);
+            DWORD written = 0;
+            return WriteFile(stdin_write_, input.data(), static_cast<DWORD>(input.size()), &written, NULL) &&
+                   written == input.size();
+#else
             std::lock_guard<std::mutex> lock(input_mutex_);
+            if (master_fd_ == -1) {
+                return false;
+            }
+            
+            // Keystrokes go straight to the PTY from the caller's thread; only
+            // input queued behind a full PTY waits for the reactor
             input_queue_.push(input);
-            input_cv_.notify_one();
+            if (!write_interest_) {
+                WritePendingLocked();
+                UpdateInterestLocked();
+            }
             return true;
+#endif
         }
         
         bool TerminalProcess::SendCommand(const std::string& command) {
@@ -71,42 +115,72 @@ namespace MikoIDE {
         }
         
         bool TerminalProcess::Kill() {
+#ifndef _WIN32
+            if (!session_id_.empty()) {
+                return KillSession();
+            }
+#endif
             if (!running_) {
                 return true;
             }
             
             should_stop_ = true;
-            
+
 #ifdef _WIN32
             if (process_handle_ != INVALID_HANDLE_VALUE) {
                 TerminateProcess(process_handle_, 1);
                 WaitForSingleObject(process_handle_, 5000);
             }
 #else
-            if (process_id_ > 0) {
-                kill(process_id_, SIGTERM);
-                int status;
-                waitpid(process_id_, &status, WNOHANG);
+            if (master_fd_ != -1) {
+                // Waits out a handler in flight, so no output follows the exit
+                reactor_.Remove(master_fd_);
+            }
+            // OnChildExited may have run meanwhile and already watches the exit
+            if (process_id_ > 0 && running_) {
+                SpawnHelper::GetInstance().Kill(process_id_, SIGTERM);
+                // Only reaps it; the exit is reported below
+                SpawnHelper::GetInstance().WatchExit(process_id_, [](int) {});
             }
 #endif
-            
+
+#ifdef _WIN32
             if (output_thread_.joinable()) {
                 output_thread_.join();
             }
             if (error_thread_.joinable()) {
                 error_thread_.join();
             }
+#endif
             
             running_ = false;
             Cleanup();
-            
-            if (output_callback_) {
-                output_callback_(TerminalMessage(TerminalMessage::EXIT, "Process terminated", 1));
-            }
-            
+            ReportExit("Process terminated", 1);
             return true;
         }
         
+        void TerminalProcess::Detach() {
+#ifndef _WIN32
+            if (!session_id_.empty()) {
+                should_stop_ = true;
+                if (master_fd_ != -1) {
+                    reactor_.Remove(master_fd_);
+                }
+                // Closing the stream detaches; the daemon keeps the session
+                running_ = false;
+                Cleanup();
+                return;
+            }
+#endif
+            Kill();
+        }
+        
+        void TerminalProcess::ReportExit(const std::string& message, int exitCode) {
+            if (!exit_reported_.exchange(true) && output_callback_) {
+                output_callback_(TerminalMessage(TerminalMessage::EXIT, message, exitCode));
+            }
+        }
+        
         bool TerminalProcess::IsRunning() const {
             return running_;
         }
@@ -124,6 +198,18 @@ namespace MikoIDE {
         }
         
         bool TerminalProcess::Resize(int cols, int rows) {
+            bool notify = false;
+            {
+                std::lock_guard<std::mutex> lock(screen_mutex_);
+                if (screen_) {
+                    notify = !screen_->HasChanges();
+                    screen_->Resize(cols, rows);
+                }
+            }
+            if (notify && output_callback_) {
+                output_callback_(TerminalMessage(TerminalMessage::SCREEN, ""));
+            }
+
 #ifdef _WIN32
             // Windows console resizing
             if (process_handle_ != INVALID_HANDLE_VALUE) {
@@ -131,6 +217,9 @@ namespace MikoIDE {
                 return true;
             }
 #else
+            if (!session_id_.empty()) {
+                return SessionClient::GetInstance().Resize(session_id_, cols, rows);
+            }
             if (master_fd_ != -1) {
                 struct winsize ws;
                 ws.ws_col = cols;
@@ -143,6 +232,119 @@ namespace MikoIDE {
             return false;
         }
         
+        bool TerminalProcess::EnableScreen(int cols, int rows) {
+            if (cols <= 0 || rows <= 0) {
+                return false;
+            }
+            
+            {
+                std::lock_guard<std::mutex> lock(screen_mutex_);
+                if (screen_) {
+                    screen_->Resize(cols, rows);
+                } else {
+                    scrollback_ = std::make_unique<Scrollback>();
+                    screen_ = std::make_unique<VtScreen>(cols, rows);
+                    screen_->SetScrollback(scrollback_.get());
+                }
+            }
+            Resize(cols, rows);
+            if (output_callback_) {
+                output_callback_(TerminalMessage(TerminalMessage::SCREEN, ""));
+            }
+            return true;
+        }
+        
+        bool TerminalProcess::TakeScreenDiff(std::vector<std::string>& records, size_t maxRecordSize) {
+            std::lock_guard<std::mutex> lock(screen_mutex_);
+            if (!screen_ || !screen_->HasChanges()) {
+                return false;
+            }
+            screen_->EncodeDiff(records, maxRecordSize);
+            return true;
+        }
+        
+        Scrollback* TerminalProcess::GetScrollback() {
+            std::lock_guard<std::mutex> lock(screen_mutex_);
+            return scrollback_.get();
+        }
+        
+        bool TerminalProcess::ReadScreenText(uint64_t& firstLine, std::string& text, std::vector<uint32_t>& lineEnds) {
+            std::lock_guard<std::mutex> lock(screen_mutex_);
+            if (!screen_) {
+                return false;
+            }
+            firstLine = scrollback_->GetEndLine();
+            for (int row = 0; row < screen_->GetRows(); ++row) {
+                screen_->AppendRowText(row, text);
+                lineEnds.push_back(static_cast<uint32_t>(text.size()));
+                text.push_back('\n');
+            }
+            return true;
+        }
+        
+        bool TerminalProcess::FeedScreen(const char* data, size_t size) {
+            std::string responses;
+            bool notify = false;
+            {
+                std::lock_guard<std::mutex> lock(screen_mutex_);
+                if (!screen_) {
+                    return false;
+                }
+                const bool wasChanged = screen_->HasChanges();
+                screen_->Feed(data, size);
+                responses = screen_->TakeResponses();
+                notify = !wasChanged && screen_->HasChanges();
+            }
+            
+            // Device status and attribute queries are answered here, since the
+            // frontend no longer sees the raw stream
+            if (!responses.empty()) {
+                SendInput(responses);
+            }
+            if (notify && output_callback_) {
+                output_callback_(TerminalMessage(TerminalMessage::SCREEN, ""));
+            }
+            return true;
+        }
+        
+        void TerminalProcess::ScanDiagnostics(DiagnosticMatcher& matcher, const char* data, size_t size, bool finish) {
+            std::vector<Diagnostic> found;
+            matcher.Feed(data, size, found);
+            if (finish) {
+                matcher.Finish(found);
+            }
+            if (found.empty()) {
+                return;
+            }
+            
+            bool notify;
+            {
+                std::lock_guard<std::mutex> lock(diagnostics_mutex_);
+                notify = pending_diagnostics_.empty();
+                const size_t room = kMaxPendingDiagnostics - std::min(pending_diagnostics_.size(), kMaxPendingDiagnostics);
+                for (size_t i = 0; i < found.size() && i < room; ++i) {
+                    pending_diagnostics_.push_back(std::move(found[i]));
+                }
+            }
+            if (notify && output_callback_) {
+                output_callback_(TerminalMessage(TerminalMessage::DIAGNOSTICS, ""));
+            }
+        }
+        
+        bool TerminalProcess::TakeDiagnostics(std::vector<Diagnostic>& diagnostics) {
+            std::lock_guard<std::mutex> lock(diagnostics_mutex_);
+            if (pending_diagnostics_.empty()) {
+                return false;
+            }
+            if (diagnostics.empty()) {
+                diagnostics.swap(pending_diagnostics_);
+            } else {
+                std::move(pending_diagnostics_.begin(), pending_diagnostics_.end(), std::back_inserter(diagnostics));
+                pending_diagnostics_.clear();
+            }
+            return true;
+        }
+
 #ifdef _WIN32
         bool TerminalProcess::StartWindows(const std::string& command, const std::string& workingDir) {
             SECURITY_ATTRIBUTES sa;
@@ -211,131 +413,330 @@ namespace MikoIDE {
                 Logger::LogMessage("Failed to create pseudo-terminal");
                 return false;
             }
+            fcntl(master_fd_, F_SETFD, FD_CLOEXEC);
+            fcntl(slave_fd_, F_SETFD, FD_CLOEXEC);
+            
+            // Started by the spawn helper, so this process is never forked
+            process_id_ = SpawnHelper::GetInstance().Spawn(command, workingDir, slave_fd_);
             
-            process_id_ = fork();
+            // Only the child's copy of the slave may keep the PTY open
+            close(slave_fd_);
+            slave_fd_ = -1;
             
             if (process_id_ == -1) {
-                Logger::LogMessage("Failed to fork process");
+                Logger::LogMessage("Failed to start terminal process");
                 close(master_fd_);
-                close(slave_fd_);
+                master_fd_ = -1;
                 return false;
             }
             
-            if (process_id_ == 0) {
-                // Child process
-                close(master_fd_);
-                
-                // Set up terminal
-                setsid();
-                ioctl(slave_fd_, TIOCSCTTY, 0);
-                
-                // Redirect stdin, stdout, stderr
-                dup2(slave_fd_, STDIN_FILENO);
-                dup2(slave_fd_, STDOUT_FILENO);
-                dup2(slave_fd_, STDERR_FILENO);
-                close(slave_fd_);
-                
-                // Change working directory
-                if (!workingDir.empty()) {
-                    chdir(workingDir.c_str());
-                }
-                
-                // Execute command
-                execl("/bin/sh", "sh", "-c", command.c_str(), nullptr);
-                _exit(1);
-            } else {
-                // Parent process
-                close(slave_fd_);
-                slave_fd_ = -1;
-                
-                running_ = true;
-                
-                // Start reader thread
-                output_thread_ = std::thread(&TerminalProcess::OutputReaderThread, this);
-                
-                Logger::LogMessage("Terminal process started with PID: " + std::to_string(process_id_));
-                return true;
+            running_ = true;
+            if (!WatchMaster()) {
+                return false;
             }
+            
+            Logger::LogMessage("Terminal process started with PID: " + std::to_string(process_id_));
+            return true;
         }
-#endif
         
-        void TerminalProcess::OutputReaderThread() {
+        bool TerminalProcess::StartSession(const std::string& sessionId, const std::string& command,
+                                           const std::string& workingDir) {
+            if (running_) {
+                Logger::LogMessage("Terminal process already running");
+                return false;
+            }
+            
+            SessionInfo session;
+            master_fd_ = SessionClient::GetInstance().Create(sessionId, command.empty() ? "/bin/bash" : command,
+                                                             workingDir, 0, 0, session);
+            if (master_fd_ == -1) {
+                Logger::LogMessage("Failed to start terminal session " + sessionId);
+                return false;
+            }
+            session_id_ = sessionId;
+            process_id_ = session.pid;
+            running_ = true;
+            if (!WatchMaster()) {
+                return false;
+            }
+            
+            Logger::LogMessage("Terminal session started with PID: " + std::to_string(process_id_));
+            return true;
+        }
+        
+        bool TerminalProcess::AttachSession(const SessionInfo& session) {
+            if (running_) {
+                Logger::LogMessage("Terminal process already running");
+                return false;
+            }
+            
+            // Before the stream is read, so the snapshot goes to the screen
+            EnableScreen(session.cols, session.rows);
+            
+            SessionInfo attached;
+            master_fd_ = SessionClient::GetInstance().Attach(session.id, attached);
+            if (master_fd_ == -1) {
+                Logger::LogMessage("Failed to attach terminal session " + session.id);
+                return false;
+            }
+            session_id_ = session.id;
+            process_id_ = attached.pid;
+            running_ = true;
+            if (!WatchMaster()) {
+                return false;
+            }
+            
+            Logger::LogMessage("Terminal session reattached, PID: " + std::to_string(process_id_));
+            return true;
+        }
+        
+        bool TerminalProcess::WatchMaster() {
+            fcntl(master_fd_, F_SETFL, fcntl(master_fd_, F_GETFL) | O_NONBLOCK);
+            if (!reactor_.Add(master_fd_, IoReactor::kReadable,
+                              [this](uint32_t events) { OnMasterReady(events); })) {
+                Logger::LogMessage("Failed to watch terminal output");
+                Kill();
+                return false;
+            }
+            return true;
+        }
+        
+        bool TerminalProcess::KillSession() {
+            should_stop_ = true;
+            if (master_fd_ != -1) {
+                reactor_.Remove(master_fd_);
+            }
+            
+            // Also after the process exited, so the daemon forgets the session
+            SessionClient::GetInstance().Close(session_id_);
+            const bool wasRunning = running_.exchange(false);
+            Cleanup();
+            if (wasRunning) {
+                ReportExit("Process terminated", 1);
+            }
+            return true;
+        }
+#endif
+
 #ifdef _WIN32
-            char buffer[4096];
+        void TerminalProcess::OutputReaderThread() {
+            ReadPipe(stdout_read_, TerminalMessage::OUTPUT);
+        }
+        
+        void TerminalProcess::ErrorReaderThread() {
+            ReadPipe(stderr_read_, TerminalMessage::TERMINAL_ERROR);
+        }
+        
+        void TerminalProcess::ReadPipe(HANDLE pipe, TerminalMessage::Type type) {
+            // Reads go straight into pooled buffers; a UTF-8 sequence split by
+            // a read is held back and starts the next buffer
+            char carry[4];
+            size_t carrySize = 0;
+            DiagnosticMatcher matcher;
             DWORD bytesRead;
             
             while (running_ && !should_stop_) {
-                if (ReadFile(stdout_read_, buffer, sizeof(buffer) - 1, &bytesRead, NULL) && bytesRead > 0) {
-                    buffer[bytesRead] = '\0';
+                ByteBuffer buffer = ByteBufferPool::GetInstance().Acquire();
+                memcpy(buffer.GetData(), carry, carrySize);
+                if (!ReadFile(pipe, buffer.GetData() + carrySize, static_cast<DWORD>(buffer.GetCapacity() - carrySize),
+                              &bytesRead, NULL) || bytesRead == 0) {
+                    break;
+                }
+                
+                size_t size = carrySize + bytesRead;
+                carrySize = 0;
+                ScanDiagnostics(matcher, buffer.GetData() + size - bytesRead, bytesRead);
+                if (FeedScreen(buffer.GetData(), size)) {
+                    continue;
+                }
+                
+                size_t complete = Utf8CompleteLength(buffer.GetData(), size);
+                carrySize = size - complete;
+                memcpy(carry, buffer.GetData() + complete, carrySize);
+                if (complete > 0 && output_callback_) {
+                    buffer.SetSize(complete);
+                    output_callback_(TerminalMessage(type, std::move(buffer)));
+                }
+            }
+            
+            ScanDiagnostics(matcher, nullptr, 0, true);
+            if (carrySize > 0 && output_callback_) {
+                ByteBuffer buffer = ByteBufferPool::GetInstance().Acquire();
+                memcpy(buffer.GetData(), carry, carrySize);
+                buffer.SetSize(carrySize);
+                output_callback_(TerminalMessage(type, std::move(buffer)));
+            }
+        }
+        
+        // Blocking pipe reads already stop when nobody consumes the output
+        void TerminalProcess::AcknowledgeOutput(size_t bytes) {
+        }
+        
+        bool TerminalProcess::IsOutputPaused() const {
+            return false;
+        }
+#else
+        void TerminalProcess::OnMasterReady(uint32_t events) {
+            if (events & IoReactor::kWritable) {
+                FlushInput();
+            }
+            if (!(events & (IoReactor::kReadable | IoReactor::kHangup))) {
+                return;
+            }
+            
+            // Output still buffered in the PTY is read before a hangup is acted on.
+            // Reads go straight into pooled buffers that are handed on as is.
+            for (int i = 0; i < kMaxReadsPerEvent; ++i) {
+                ByteBuffer buffer = ByteBufferPool::GetInstance().Acquire();
+                memcpy(buffer.GetData(), utf8_carry_, utf8_carry_size_);
+                ssize_t bytesRead = read(master_fd_, buffer.GetData() + utf8_carry_size_,
+                                         buffer.GetCapacity() - utf8_carry_size_);
+                if (bytesRead > 0) {
+                    size_t size = utf8_carry_size_ + static_cast<size_t>(bytesRead);
+                    utf8_carry_size_ = 0;
+                    ScanDiagnostics(diagnostic_matcher_, buffer.GetData() + size - bytesRead, static_cast<size_t>(bytesRead));
+                    if (FeedScreen(buffer.GetData(), size)) {
+                        continue;
+                    }
+                    
+                    // A UTF-8 sequence split by the read waits for the rest
+                    size_t complete = Utf8CompleteLength(buffer.GetData(), size);
+                    utf8_carry_size_ = size - complete;
+                    memcpy(utf8_carry_, buffer.GetData() + complete, utf8_carry_size_);
+                    if (complete == 0) {
+                        continue;
+                    }
+                    
+                    output_outstanding_ += complete;
                     if (output_callback_) {
-                        output_callback_(TerminalMessage(TerminalMessage::OUTPUT, std::string(buffer)));
+                        buffer.SetSize(complete);
+                        output_callback_(TerminalMessage(TerminalMessage::OUTPUT, std::move(buffer)));
+                    }
+                    
+                    // The consumer is behind: stop reading until it acknowledges
+                    if (output_outstanding_.load() >= kOutputHighWatermark && !(events & IoReactor::kHangup)) {
+                        std::lock_guard<std::mutex> lock(input_mutex_);
+                        UpdateInterestLocked();
+                        return;
                     }
+                } else if (bytesRead < 0 && errno == EINTR) {
+                    continue;
+                } else if (bytesRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    return;
                 } else {
-                    break;
+                    // EOF, or EIO once the last slave descriptor is closed. A
+                    // sequence the child never finished goes out as it is.
+                    if (utf8_carry_size_ > 0 && output_callback_) {
+                        buffer.SetSize(utf8_carry_size_);
+                        output_outstanding_ += utf8_carry_size_;
+                        output_callback_(TerminalMessage(TerminalMessage::OUTPUT, std::move(buffer)));
+                    }
+                    utf8_carry_size_ = 0;
+                    ScanDiagnostics(diagnostic_matcher_, nullptr, 0, true);
+                    OnChildExited();
+                    return;
                 }
             }
-#else
-            char buffer[4096];
-            fd_set readfds;
-            struct timeval timeout;
-            
-            while (running_ && !should_stop_) {
-                FD_ZERO(&readfds);
-                FD_SET(master_fd_, &readfds);
-                
-                timeout.tv_sec = 0;
-                timeout.tv_usec = 100000; // 100ms timeout
-                
-                int result = select(master_fd_ + 1, &readfds, nullptr, nullptr, &timeout);
-                
-                if (result > 0 && FD_ISSET(master_fd_, &readfds)) {
-                    ssize_t bytesRead = read(master_fd_, buffer, sizeof(buffer) - 1);
-                    if (bytesRead > 0) {
-                        buffer[bytesRead] = '\0';
-                        if (output_callback_) {
-                            output_callback_(TerminalMessage(TerminalMessage::OUTPUT, std::string(buffer)));
-                        }
-                    } else if (bytesRead == 0) {
-                        break; // EOF
+        }
+        
+        void TerminalProcess::FlushInput() {
+            std::lock_guard<std::mutex> lock(input_mutex_);
+            if (master_fd_ != -1) {
+                WritePendingLocked();
+                UpdateInterestLocked();
+            }
+        }
+        
+        bool TerminalProcess::WritePendingLocked() {
+            // Returns true once everything queued has been written
+            while (true) {
+                if (input_pending_.empty()) {
+                    if (input_queue_.empty()) {
+                        return true;
                     }
-                } else if (result == -1 && errno != EINTR) {
-                    break; // Error
+                    input_pending_ = std::move(input_queue_.front());
+                    input_queue_.pop();
                 }
                 
-                // Handle input queue
-                std::unique_lock<std::mutex> lock(input_mutex_);
-                if (input_cv_.wait_for(lock, std::chrono::milliseconds(10), [this] { return !input_queue_.empty() || should_stop_; })) {
-                    while (!input_queue_.empty() && !should_stop_) {
-                        std::string input = input_queue_.front();
-                        input_queue_.pop();
-                        lock.unlock();
-                        
-                        write(master_fd_, input.c_str(), input.length());
-                        
-                        lock.lock();
-                    }
+                ssize_t written = WriteMaster(input_pending_.data(), input_pending_.size());
+                if (written > 0) {
+                    input_pending_.erase(0, static_cast<size_t>(written));
+                } else if (written < 0 && errno == EINTR) {
+                    continue;
+                } else if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    return false;
+                } else {
+                    input_pending_.clear();
+                    std::queue<std::string>().swap(input_queue_);
+                    return true;
                 }
             }
-#endif
         }
         
-        void TerminalProcess::ErrorReaderThread() {
-#ifdef _WIN32
-            char buffer[4096];
-            DWORD bytesRead;
+        void TerminalProcess::UpdateInterestLocked() {
+            const bool wantWrite = !input_pending_.empty() || !input_queue_.empty();
+            const bool wantPause = output_outstanding_.load() >= kOutputHighWatermark ||
+                                   (output_paused_ && output_outstanding_.load() > kOutputLowWatermark);
+            if (wantWrite == write_interest_ && wantPause == output_paused_) {
+                return;
+            }
+            
+            write_interest_ = wantWrite;
+            output_paused_ = wantPause;
+            uint32_t interest = (output_paused_ ? 0u : static_cast<uint32_t>(IoReactor::kReadable)) |
+                                (write_interest_ ? static_cast<uint32_t>(IoReactor::kWritable) : 0u);
+            reactor_.Modify(master_fd_, interest);
+        }
+        
+        void TerminalProcess::AcknowledgeOutput(size_t bytes) {
+            size_t outstanding = output_outstanding_.load();
+            while (!output_outstanding_.compare_exchange_weak(outstanding, outstanding - std::min(outstanding, bytes))) {
+            }
             
-            while (running_ && !should_stop_) {
-                if (ReadFile(stderr_read_, buffer, sizeof(buffer) - 1, &bytesRead, NULL) && bytesRead > 0) {
-                    buffer[bytesRead] = '\0';
-                    if (output_callback_) {
-                        output_callback_(TerminalMessage{TerminalMessage::ERROR, std::string(buffer)});
-                    }
+            std::lock_guard<std::mutex> lock(input_mutex_);
+            if (output_paused_ && master_fd_ != -1) {
+                UpdateInterestLocked();
+            }
+        }
+        
+        bool TerminalProcess::IsOutputPaused() const {
+            std::lock_guard<std::mutex> lock(const_cast<std::mutex&>(input_mutex_));
+            return output_paused_;
+        }
+        
+        ssize_t TerminalProcess::WriteMaster(const char* data, size_t size) {
+            // A daemon that went away must not take this process with SIGPIPE
+            if (!session_id_.empty()) {
+                return send(master_fd_, data, size, MSG_NOSIGNAL);
+            }
+            return write(master_fd_, data, size);
+        }
+        
+        void TerminalProcess::OnChildExited() {
+            reactor_.Remove(master_fd_);
+            running_ = false;
+            
+            // The daemon ends the stream once the child exited and everything
+            // it wrote was sent; it also ends it when another instance attaches
+            if (!session_id_.empty()) {
+                SessionInfo session;
+                if (SessionClient::GetInstance().GetStatus(session_id_, session) && session.exited) {
+                    ReportExit("Process exited", session.exit_code);
                 } else {
-                    break;
+                    ReportExit("Session detached", -1);
                 }
+                return;
             }
-#endif
+            
+            // The exit code comes from the spawn helper, which reaps the child
+            std::weak_ptr<TerminalProcess> self = shared_from_this();
+            SpawnHelper::GetInstance().WatchExit(process_id_, [self](int exitCode) {
+                if (auto terminal = self.lock()) {
+                    terminal->ReportExit("Process exited", exitCode);
+                }
+            });
         }
+#endif
         
         void TerminalProcess::Cleanup() {
 #ifdef _WIN32
@@ -360,6 +761,7 @@ namespace MikoIDE {
                 thread_handle_ = INVALID_HANDLE_VALUE;
             }
 #else
+            std::lock_guard<std::mutex> lock(input_mutex_);
             if (master_fd_ != -1) {
                 close(master_fd_);
                 master_fd_ = -1;
@@ -376,17 +778,24 @@ namespace MikoIDE {
         }
         
         TerminalManager::~TerminalManager() {
-            std::lock_guard<std::mutex> lock(terminals_mutex_);
-            for (auto& pair : terminals_) {
-                pair.second->Kill();
+            // As in CloseTerminal, exit callbacks may look terminals up again
+            std::map<std::string, std::shared_ptr<TerminalProcess>> terminals;
+            {
+                std::lock_guard<std::mutex> lock(terminals_mutex_);
+                terminals.swap(terminals_);
+            }
+            // Daemon sessions are left running for the next instance
+            for (auto& pair : terminals) {
+                pair.second->Detach();
             }
-            terminals_.clear();
         }
         
-        std::string TerminalManager::CreateTerminal(const std::string& command, const std::string& workingDir) {
-            std::string terminalId = GenerateTerminalId();
-            
+        std::shared_ptr<TerminalProcess> TerminalManager::MakeTerminal(const std::string& terminalId) {
+#ifdef _WIN32
             auto terminal = std::make_shared<TerminalProcess>();
+#else
+            auto terminal = std::make_shared<TerminalProcess>(reactor_);
+#endif
             
             // Set up callback to forward messages with terminal ID
             terminal->SetOutputCallback([this, terminalId](const TerminalMessage& msg) {
@@ -394,9 +803,34 @@ namespace MikoIDE {
                     global_callback_(terminalId, msg);
                 }
             });
-            
-            if (terminal->Start(command, workingDir)) {
+            return terminal;
+        }
+        
+        std::string TerminalManager::CreateTerminal(const std::string& command, const std::string& workingDir) {
+            // Creates run concurrently on the bridge workers; the id stays
+            // reserved until the terminal is registered or fails to start
+            std::string terminalId;
+            {
                 std::lock_guard<std::mutex> lock(terminals_mutex_);
+                do {
+                    terminalId = GenerateTerminalId();
+                } while (terminals_.count(terminalId) || starting_ids_.count(terminalId));
+                starting_ids_.insert(terminalId);
+            }
+            auto terminal = MakeTerminal(terminalId);
+
+#ifdef _WIN32
+            const bool started = terminal->Start(command, workingDir);
+#else
+            // The session is named after the terminal, so it keeps its id
+            // when a later instance restores it
+            const bool started = SessionClient::GetInstance().IsEnabled() ?
+                                 terminal->StartSession(terminalId, command, workingDir) :
+                                 terminal->Start(command, workingDir);
+#endif
+            std::lock_guard<std::mutex> lock(terminals_mutex_);
+            starting_ids_.erase(terminalId);
+            if (started) {
                 terminals_[terminalId] = terminal;
                 Logger::LogMessage("Created terminal: " + terminalId);
                 return terminalId;
@@ -406,6 +840,31 @@ namespace MikoIDE {
             return "";
         }
         
+        size_t TerminalManager::RestoreSessions() {
+            size_t restored = 0;
+#ifndef _WIN32
+            if (!SessionClient::GetInstance().IsEnabled()) {
+                return 0;
+            }
+            
+            for (const SessionInfo& session : SessionClient::GetInstance().List()) {
+                if (GetTerminal(session.id)) {
+                    continue;
+                }
+                auto terminal = MakeTerminal(session.id);
+                if (terminal->AttachSession(session)) {
+                    std::lock_guard<std::mutex> lock(terminals_mutex_);
+                    terminals_[session.id] = terminal;
+                    ++restored;
+                }
+            }
+            if (restored > 0) {
+                Logger::LogMessage("Restored " + std::to_string(restored) + " terminal sessions");
+            }
+#endif
+            return restored;
+        }
+        
         std::shared_ptr<TerminalProcess> TerminalManager::GetTerminal(const std::string& terminalId) {
             std::lock_guard<std::mutex> lock(terminals_mutex_);
             auto it = terminals_.find(terminalId);
@@ -413,17 +872,22 @@ namespace MikoIDE {
         }
         
         bool TerminalManager::CloseTerminal(const std::string& terminalId) {
-            std::lock_guard<std::mutex> lock(terminals_mutex_);
-            auto it = terminals_.find(terminalId);
-            
-            if (it != terminals_.end()) {
-                it->second->Kill();
+            std::shared_ptr<TerminalProcess> terminal;
+            {
+                std::lock_guard<std::mutex> lock(terminals_mutex_);
+                auto it = terminals_.find(terminalId);
+                if (it == terminals_.end()) {
+                    return false;
+                }
+                terminal = it->second;
                 terminals_.erase(it);
-                Logger::LogMessage("Closed terminal: " + terminalId);
-                return true;
             }
             
-            return false;
+            // Kill() waits for the reactor, whose callbacks may need other
+            // locks, so terminals_mutex_ is not held across it
+            terminal->Kill();
+            Logger::LogMessage("Closed terminal: " + terminalId);
+            return true;
         }
         
         bool TerminalManager::SendInput(const std::string& terminalId, const std::string& input) {
@@ -449,6 +913,16 @@ namespace MikoIDE {
             return result;
         }
         
+        std::vector<std::string> TerminalManager::GetTerminalIds() const {
+            std::lock_guard<std::mutex> lock(const_cast<std::mutex&>(terminals_mutex_));
+            std::vector<std::string> result;
+            result.reserve(terminals_.size());
+            for (const auto& pair : terminals_) {
+                result.push_back(pair.first);
+            }
+            return result;
+        }
+        
         void TerminalManager::SetGlobalOutputCallback(std::function<void(const std::string&, const TerminalMessage&)> callback) {
             global_callback_ = callback;
         }
@@ -458,7 +932,53 @@ namespace MikoIDE {
             return terminal ? terminal->Resize(cols, rows) : false;
         }
         
+        void TerminalManager::AcknowledgeOutput(const std::string& terminalId, size_t bytes) {
+            auto terminal = GetTerminal(terminalId);
+            if (terminal) {
+                terminal->AcknowledgeOutput(bytes);
+            }
+        }
+        
+        bool TerminalManager::EnableScreen(const std::string& terminalId, int cols, int rows) {
+            auto terminal = GetTerminal(terminalId);
+            return terminal ? terminal->EnableScreen(cols, rows) : false;
+        }
+        
+        bool TerminalManager::TakeScreenDiff(const std::string& terminalId, std::vector<std::string>& records,
+                                             size_t maxRecordSize) {
+            auto terminal = GetTerminal(terminalId);
+            return terminal ? terminal->TakeScreenDiff(records, maxRecordSize) : false;
+        }
+        
+        bool TerminalManager::TakeDiagnostics(const std::string& terminalId, std::vector<Diagnostic>& diagnostics) {
+            auto terminal = GetTerminal(terminalId);
+            return terminal ? terminal->TakeDiagnostics(diagnostics) : false;
+        }
+        
+        std::vector<double> TerminalManager::GetScrollbackRange(const std::string& terminalId) {
+            auto terminal = GetTerminal(terminalId);
+            Scrollback* scrollback = terminal ? terminal->GetScrollback() : nullptr;
+            if (!scrollback) {
+                return {0, 0};
+            }
+            return {static_cast<double>(scrollback->GetFirstLine()), static_cast<double>(scrollback->GetEndLine())};
+        }
+        
+        std::vector<uint8_t> TerminalManager::GetScrollback(const std::string& terminalId, uint64_t firstLine, int count) {
+            auto terminal = GetTerminal(terminalId);
+            Scrollback* scrollback = terminal ? terminal->GetScrollback() : nullptr;
+            
+            std::string lines(sizeof(uint32_t), '\0');
+            uint32_t read = 0;
+            if (scrollback && count > 0) {
+                read = static_cast<uint32_t>(scrollback->ReadLines(firstLine, static_cast<size_t>(count), lines));
+            }
+            memcpy(&lines[0], &read, sizeof(read));
+            return std::vector<uint8_t>(lines.begin(), lines.end());
+        }
+        
         std::string TerminalManager::GenerateTerminalId() {
+            // Only called with terminals_mutex_ held, which guards the generator
             static std::random_device rd;
             static std::mt19937 gen(rd());
             static std::uniform_int_distribution<> dis(0, 15);
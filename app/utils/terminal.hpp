@@ -5,10 +5,15 @@
 #include <functional>
 #include <thread>
 #include <mutex>
-#include <condition_variable>
 #include <queue>
 #include <atomic>
 #include <map>
+#include <set>
+#include "byte-buffer.hpp"
+#include "diagnostic-matcher.hpp"
+#include "io-reactor.hpp"
+#include "vt-screen.hpp"
+#include "scrollback.hpp"
 
 #ifdef _WIN32
 #include <windows.h>
@@ -24,30 +29,92 @@
 namespace MikoIDE {
     namespace Utils {
         
+        struct SessionInfo;
+        
         struct TerminalMessage {
             enum Type {
                 OUTPUT,
                 TERMINAL_ERROR,
                 EXIT,
-                INPUT
+                INPUT,
+                // The screen went from clean to changed; collect the changes
+                // with TakeScreenDiff()
+                SCREEN,
+                // Compiler diagnostics were found in the output; collect them
+                // with TakeDiagnostics()
+                DIAGNOSTICS
             };
             
             Type type;
-            std::string data;
+            std::string data;       // status text
+            ByteBuffer buffer;      // OUTPUT and TERMINAL_ERROR bytes, pooled
             int exitCode;
             
             TerminalMessage(Type t, const std::string& d, int code = 0) 
                 : type(t), data(d), exitCode(code) {}
+            TerminalMessage(Type t, ByteBuffer b)
+                : type(t), buffer(std::move(b)), exitCode(0) {}
+            
+            // The payload, whichever of buffer and data holds it
+            const char* GetData() const { return buffer ? buffer.GetData() : data.data(); }
+            size_t GetSize() const { return buffer ? buffer.GetSize() : data.size(); }
         };
         
-        class TerminalProcess {
+        // On POSIX every terminal's PTY master is serviced by the manager's
+        // shared IoReactor, so an idle terminal costs no thread and no wakeups.
+        // Input is written immediately with non-blocking writes; whatever the
+        // PTY does not accept waits for writability on the reactor.
+        //
+        // Output is flow-controlled: bytes handed to the output callback count
+        // as outstanding until the consumer calls AcknowledgeOutput(). Above
+        // kOutputHighWatermark reads pause, leaving the child blocked on a full
+        // PTY, and resume below kOutputLowWatermark.
+        //
+        // With EnableScreen() output is parsed into a VtScreen instead of being
+        // forwarded raw, and consumers collect row diffs at their own pace.
+        // The screen absorbs any amount of output, so it is not flow-controlled.
+        // Lines scrolled off the screen are kept in a Scrollback.
+        //
+        // Either way the output is scanned for compiler diagnostics (see
+        // DiagnosticMatcher) as it is read, so consumers get a problems feed
+        // without parsing build logs themselves.
+        //
+        // With the session daemon enabled (see SessionClient) the daemon owns
+        // the PTY and master_fd_ is a stream socket to it instead; reading,
+        // writing and flow control work unchanged, while resizing, killing
+        // and exit codes go through daemon requests.
+        //
+        // Windows keeps blocking reader threads on the anonymous pipes.
+        class TerminalProcess : public std::enable_shared_from_this<TerminalProcess> {
         public:
+#ifdef _WIN32
             TerminalProcess();
+#else
+            explicit TerminalProcess(IoReactor& reactor);
+#endif
             ~TerminalProcess();
             
             // Start a new terminal process
             bool Start(const std::string& command = "", const std::string& workingDir = "");
             
+#ifndef _WIN32
+            // Like Start(), in a daemon session named |sessionId| that
+            // outlives this process
+            bool StartSession(const std::string& sessionId, const std::string& command = "",
+                              const std::string& workingDir = "");
+            
+            // Serves a session left running by an earlier instance. The screen
+            // is emulated from the start, so the daemon's snapshot lands in it.
+            bool AttachSession(const SessionInfo& session);
+#endif
+            
+            // Stops serving the terminal; a daemon session keeps running, any
+            // other terminal is killed
+            void Detach();
+            
+            static constexpr size_t kOutputHighWatermark = 1024 * 1024;
+            static constexpr size_t kOutputLowWatermark = 256 * 1024;
+            
             // Send input to the terminal
             bool SendInput(const std::string& input);
             
@@ -69,6 +136,30 @@ namespace MikoIDE {
             // Resize terminal (for PTY)
             bool Resize(int cols, int rows);
             
+            // |bytes| of output have been delivered downstream; any thread
+            void AcknowledgeOutput(size_t bytes);
+            bool IsOutputPaused() const;
+            
+            // Emulates the terminal natively from now on; the first diff is full
+            bool EnableScreen(int cols, int rows);
+            
+            // Appends diff records (see VtScreen::EncodeDiff) if the screen
+            // changed; any thread
+            bool TakeScreenDiff(std::vector<std::string>& records, size_t maxRecordSize);
+            
+            // Null until EnableScreen(); lives as long as the terminal
+            Scrollback* GetScrollback();
+            
+            // Appends the visible rows in Scrollback::ReadText form; they are
+            // numbered from |firstLine|, the scrollback's end line
+            bool ReadScreenText(uint64_t& firstLine, std::string& text, std::vector<uint32_t>& lineEnds);
+            
+            // Diagnostics the consumer has not taken are capped; later ones are dropped
+            static constexpr size_t kMaxPendingDiagnostics = 4096;
+            
+            // Moves out the diagnostics found since the last call; any thread
+            bool TakeDiagnostics(std::vector<Diagnostic>& diagnostics);
+            
         private:
             std::atomic<bool> running_;
             std::atomic<bool> should_stop_;
@@ -80,27 +171,68 @@ namespace MikoIDE {
             HANDLE stdout_read_;
             HANDLE stderr_read_;
             DWORD process_id_;
+            std::thread output_thread_;
+            std::thread error_thread_;
 #else
+            IoReactor& reactor_;
             pid_t process_id_;
             int master_fd_;
             int slave_fd_;
-#endif
             
-            std::thread output_thread_;
-            std::thread error_thread_;
-            std::function<void(const TerminalMessage&)> output_callback_;
+            // Input the PTY has not accepted yet, and the reactor interest
+            // derived from it and from flow control; guarded by input_mutex_
+            std::queue<std::string> input_queue_;
+            std::string input_pending_;
+            bool write_interest_;
+            bool output_paused_;
+            std::atomic<size_t> output_outstanding_;
+            
+            // Start of a UTF-8 sequence split by the last read; reactor thread
+            char utf8_carry_[4];
+            size_t utf8_carry_size_;
             
+            DiagnosticMatcher diagnostic_matcher_;  // reactor thread
+            
+            std::string session_id_;    // empty unless the session daemon owns the PTY
+#endif
+            std::function<void(const TerminalMessage&)> output_callback_;
             std::mutex input_mutex_;
-            std::queue<std::string> input_queue_;
-            std::condition_variable input_cv_;
+            
+            std::unique_ptr<Scrollback> scrollback_;   // outlives screen_, which feeds it
+            std::unique_ptr<VtScreen> screen_;
+            std::mutex screen_mutex_;
+            
+            // Returns false when there is no screen and |data| goes out raw
+            bool FeedScreen(const char* data, size_t size);
+            
+            // Runs |matcher| over newly read output; |finish| at the end of it
+            void ScanDiagnostics(DiagnosticMatcher& matcher, const char* data, size_t size, bool finish = false);
+            std::vector<Diagnostic> pending_diagnostics_;
+            std::mutex diagnostics_mutex_;
             
             // Platform-specific implementations
             bool StartWindows(const std::string& command, const std::string& workingDir);
             bool StartUnix(const std::string& command, const std::string& workingDir);
             
+#ifdef _WIN32
             void OutputReaderThread();
             void ErrorReaderThread();
-            void InputWriterThread();
+            void ReadPipe(HANDLE pipe, TerminalMessage::Type type);
+#else
+            bool WatchMaster();
+            ssize_t WriteMaster(const char* data, size_t size);
+            bool KillSession();
+            void OnMasterReady(uint32_t events);
+            bool WritePendingLocked();
+            void UpdateInterestLocked();
+            void FlushInput();
+            void OnChildExited();
+#endif
+            
+            // Sends the EXIT message once, whichever of Kill() and the child's
+            // own exit gets there first
+            void ReportExit(const std::string& message, int exitCode);
+            std::atomic<bool> exit_reported_;
             
             void Cleanup();
         };
@@ -113,6 +245,10 @@ namespace MikoIDE {
             // Create a new terminal session
             std::string CreateTerminal(const std::string& command = "", const std::string& workingDir = "");
             
+            // Serves the daemon sessions left by an earlier instance under
+            // their old ids; returns how many. Without the daemon there are none.
+            size_t RestoreSessions();
+            
             // Get terminal by ID
             std::shared_ptr<TerminalProcess> GetTerminal(const std::string& terminalId);
             
@@ -128,18 +264,45 @@ namespace MikoIDE {
             // List all active terminals
             std::vector<std::string> GetActiveTerminals() const;
             
+            // All terminal sessions, including ones whose process exited
+            std::vector<std::string> GetTerminalIds() const;
+            
             // Set global output callback for all terminals
             void SetGlobalOutputCallback(std::function<void(const std::string&, const TerminalMessage&)> callback);
             
             // Resize terminal
             bool ResizeTerminal(const std::string& terminalId, int cols, int rows);
             
+            // Output flow control, see TerminalProcess::AcknowledgeOutput
+            void AcknowledgeOutput(const std::string& terminalId, size_t bytes);
+            
+            // Native emulation, see TerminalProcess::EnableScreen
+            bool EnableScreen(const std::string& terminalId, int cols, int rows);
+            bool TakeScreenDiff(const std::string& terminalId, std::vector<std::string>& records,
+                                size_t maxRecordSize);
+            
+            // See TerminalProcess::TakeDiagnostics
+            bool TakeDiagnostics(const std::string& terminalId, std::vector<Diagnostic>& diagnostics);
+            
+            // Scrollback of a terminal with a screen: [firstLine, endLine), and
+            // up to |count| lines from |firstLine| as u32 lineCount followed
+            // by lines in Scrollback::ReadLines format
+            std::vector<double> GetScrollbackRange(const std::string& terminalId);
+            std::vector<uint8_t> GetScrollback(const std::string& terminalId, uint64_t firstLine, int count);
+            
         private:
+#ifndef _WIN32
+            // Declared first so it outlives the terminals registered with it
+            IoReactor reactor_;
+#endif
             std::map<std::string, std::shared_ptr<TerminalProcess>> terminals_;
             std::mutex terminals_mutex_;
+            // Ids of terminals still starting; guarded by terminals_mutex_
+            std::set<std::string> starting_ids_;
             std::function<void(const std::string&, const TerminalMessage&)> global_callback_;
             
             std::string GenerateTerminalId();
+            std::shared_ptr<TerminalProcess> MakeTerminal(const std::string& terminalId);
         };
         
         // Singleton instance for global access
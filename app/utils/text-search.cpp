@@ -0,0 +1,239 @@
+#include "text-search.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MIKO_TEXT_SEARCH_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define MIKO_TEXT_SEARCH_NEON
+#endif
+
+namespace MikoIDE {
+    namespace Utils {
+        
+        namespace {
+            int CountTrailingZeros(uint64_t value) {
+#if defined(_MSC_VER)
+                unsigned long index;
+                _BitScanForward64(&index, value);
+                return static_cast<int>(index);
+#else
+                return __builtin_ctzll(value);
+#endif
+            }
+            
+            const char* FindScalar(const char* begin, const char* end, const std::string& needle) {
+                const size_t length = needle.size();
+                const char* last = end - length;
+                for (const char* p = begin; p <= last; ++p) {
+                    p = static_cast<const char*>(memchr(p, needle[0], static_cast<size_t>(last - p) + 1));
+                    if (!p) {
+                        return nullptr;
+                    }
+                    if (memcmp(p + 1, needle.data() + 1, length - 1) == 0) {
+                        return p;
+                    }
+                }
+                return nullptr;
+            }
+            
+            bool IsQuantifier(char c) {
+                return c == '*' || c == '+' || c == '?' || c == '{';
+            }
+            
+            bool IsHexDigit(char c) {
+                return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+            }
+            
+            // |i| is at the letter or digit of an escape; returns the index of
+            // the escape's last character: \xHH, \uHHHH, \u{H...}, \cX, \k<name>
+            // and multi-digit back-references
+            size_t SkipEscapeOperand(const std::string& pattern, size_t i) {
+                const char escaped = pattern[i];
+                size_t hexDigits = 0;
+                if (escaped == 'x') {
+                    hexDigits = 2;
+                } else if (escaped == 'u') {
+                    if (i + 1 < pattern.size() && pattern[i + 1] == '{') {
+                        const size_t close = pattern.find('}', i + 1);
+                        return close == std::string::npos ? pattern.size() - 1 : close;
+                    }
+                    hexDigits = 4;
+                } else if (escaped == 'c') {
+                    return std::min(i + 1, pattern.size() - 1);
+                } else if (escaped == 'k') {
+                    if (i + 1 < pattern.size() && pattern[i + 1] == '<') {
+                        const size_t close = pattern.find('>', i + 1);
+                        return close == std::string::npos ? pattern.size() - 1 : close;
+                    }
+                } else if (escaped >= '0' && escaped <= '9') {
+                    while (i + 1 < pattern.size() && pattern[i + 1] >= '0' && pattern[i + 1] <= '9') {
+                        ++i;
+                    }
+                }
+                for (; hexDigits > 0 && i + 1 < pattern.size() && IsHexDigit(pattern[i + 1]); --hexDigits) {
+                    ++i;
+                }
+                return i;
+            }
+        }
+        
+        LiteralFinder::LiteralFinder(std::string needle) : needle_(std::move(needle)) {
+        }
+        
+        const char* LiteralFinder::Find(const char* begin, const char* end) const {
+            const size_t length = needle_.size();
+            if (length == 0) {
+                return begin;
+            }
+            if (static_cast<size_t>(end - begin) < length) {
+                return nullptr;
+            }
+            if (length == 1) {
+                return static_cast<const char*>(memchr(begin, needle_[0], static_cast<size_t>(end - begin)));
+            }
+            
+            const char* p = begin;
+            // The last byte compared is p + length - 1 + 15
+            const size_t size = static_cast<size_t>(end - begin);
+            const char* simdEnd = size > length + 15 ? end - length - 15 : begin;
+
+#if defined(MIKO_TEXT_SEARCH_SSE2)
+            const __m128i first = _mm_set1_epi8(needle_[0]);
+            const __m128i last = _mm_set1_epi8(needle_[length - 1]);
+            for (; p < simdEnd; p += 16) {
+                const __m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+                const __m128i blockLast = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + length - 1));
+                uint64_t mask = static_cast<uint32_t>(_mm_movemask_epi8(
+                    _mm_and_si128(_mm_cmpeq_epi8(blockFirst, first), _mm_cmpeq_epi8(blockLast, last))));
+                while (mask) {
+                    const int bit = CountTrailingZeros(mask);
+                    if (memcmp(p + bit + 1, needle_.data() + 1, length - 2) == 0) {
+                        return p + bit;
+                    }
+                    mask &= mask - 1;
+                }
+            }
+#elif defined(MIKO_TEXT_SEARCH_NEON)
+            const uint8x16_t first = vdupq_n_u8(static_cast<uint8_t>(needle_[0]));
+            const uint8x16_t last = vdupq_n_u8(static_cast<uint8_t>(needle_[length - 1]));
+            for (; p < simdEnd; p += 16) {
+                const uint8x16_t blockFirst = vld1q_u8(reinterpret_cast<const uint8_t*>(p));
+                const uint8x16_t blockLast = vld1q_u8(reinterpret_cast<const uint8_t*>(p + length - 1));
+                const uint8x16_t eq = vandq_u8(vceqq_u8(blockFirst, first), vceqq_u8(blockLast, last));
+                // Narrow to four bits per byte, the NEON stand-in for movemask
+                uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+                while (mask) {
+                    const int bit = CountTrailingZeros(mask) / 4;
+                    if (memcmp(p + bit + 1, needle_.data() + 1, length - 2) == 0) {
+                        return p + bit;
+                    }
+                    mask &= ~(uint64_t(0xf) << (bit * 4));
+                }
+            }
+#endif
+            (void)simdEnd;
+            return FindScalar(p, end, needle_);
+        }
+        
+        std::string ExtractRequiredLiteral(const std::string& pattern) {
+            std::string best;
+            std::string current;
+            auto finishRun = [&]() {
+                if (current.size() > best.size()) {
+                    best = current;
+                }
+                current.clear();
+            };
+            
+            for (size_t i = 0; i < pattern.size(); ++i) {
+                const char c = pattern[i];
+                const bool quantified = i + 1 < pattern.size() && IsQuantifier(pattern[i + 1]);
+                
+                if (c == '|') {
+                    // Either side may match alone
+                    return std::string();
+                }
+                
+                if (c == '(' || c == '[') {
+                    // Skip the group or class; neither contributes a literal
+                    int depth = 0;
+                    for (; i < pattern.size(); ++i) {
+                        if (pattern[i] == '\\') {
+                            ++i;
+                        } else if (c == '[' ? pattern[i] == '[' && depth == 0 : pattern[i] == '(') {
+                            ++depth;
+                        } else if (pattern[i] == (c == '[' ? ']' : ')') && --depth == 0) {
+                            break;
+                        }
+                    }
+                    finishRun();
+                    continue;
+                }
+                
+                if (IsQuantifier(c)) {
+                    if (c == '{') {
+                        while (i < pattern.size() && pattern[i] != '}') {
+                            ++i;
+                        }
+                    }
+                    finishRun();
+                    continue;
+                }
+                
+                char literal;
+                if (c == '\\') {
+                    if (i + 1 >= pattern.size()) {
+                        break;
+                    }
+                    const char escaped = pattern[++i];
+                    const bool quantifiedEscape = i + 1 < pattern.size() && IsQuantifier(pattern[i + 1]);
+                    if ((escaped >= 'a' && escaped <= 'z') || (escaped >= 'A' && escaped <= 'Z') ||
+                        (escaped >= '0' && escaped <= '9')) {
+                        // Classes, anchors, back-references and control escapes;
+                        // their operands are not literal text either
+                        finishRun();
+                        i = SkipEscapeOperand(pattern, i);
+                        continue;
+                    }
+                    literal = escaped;
+                    if (quantifiedEscape) {
+                        if (pattern[i + 1] == '+') {
+                            current.push_back(literal);
+                        }
+                        finishRun();
+                        continue;
+                    }
+                } else if (c == '.' || c == '^' || c == '$' || c == ')' || c == ']' || c == '}') {
+                    finishRun();
+                    continue;
+                } else {
+                    literal = c;
+                    if (quantified) {
+                        // x+ still needs one x; x*, x? and x{0,} may have none
+                        if (pattern[i + 1] == '+') {
+                            current.push_back(literal);
+                        }
+                        finishRun();
+                        continue;
+                    }
+                }
+                current.push_back(literal);
+            }
+            finishRun();
+            return best;
+        }
+        
+        void AsciiToLower(std::string& text) {
+            for (char& c : text) {
+                if (c >= 'A' && c <= 'Z') {
+                    c = static_cast<char>(c - 'A' + 'a');
+                }
+            }
+        }
+        
+    }
+}
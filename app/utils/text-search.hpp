@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+namespace MikoIDE {
+    namespace Utils {
+        
+        // Substring search for one fixed needle over large buffers. With SSE2
+        // or NEON, 16 candidate positions are tested per step by comparing the
+        // needle's first and last bytes, and only positions where both match
+        // are verified with memcmp; otherwise it falls back to memchr.
+        class LiteralFinder {
+        public:
+            explicit LiteralFinder(std::string needle);
+            
+            // First occurrence in [begin, end), or nullptr
+            const char* Find(const char* begin, const char* end) const;
+            
+            const std::string& GetNeedle() const { return needle_; }
+        
+        private:
+            std::string needle_;
+        };
+        
+        // Returns the longest literal that every match of the ECMAScript
+        // |pattern| must contain, or an empty string when none can be proven
+        // (top-level alternation, or nothing but classes and groups). Only
+        // plain characters outside groups and classes are considered.
+        std::string ExtractRequiredLiteral(const std::string& pattern);
+        
+        // ASCII-only case folding, matching std::regex::icase in the C locale
+        void AsciiToLower(std::string& text);
+        
+    }
+}
@@ -0,0 +1,72 @@
+#include "thread-pool.hpp"
+#include "../core/logger.hpp"
+#include <exception>
+
+namespace MikoIDE {
+    namespace Utils {
+        
+        ThreadPool::ThreadPool(size_t threadCount) : stopping_(false) {
+            if (threadCount == 0) {
+                threadCount = 1;
+            }
+            for (size_t i = 0; i < threadCount; ++i) {
+                workers_.emplace_back(&ThreadPool::WorkerLoop, this);
+            }
+        }
+        
+        ThreadPool::~ThreadPool() {
+            Shutdown();
+        }
+        
+        bool ThreadPool::Post(std::function<void()> job) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (stopping_) {
+                    return false;
+                }
+                jobs_.push(std::move(job));
+            }
+            cv_.notify_one();
+            return true;
+        }
+        
+        void ThreadPool::Shutdown() {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (stopping_) {
+                    return;
+                }
+                stopping_ = true;
+            }
+            cv_.notify_all();
+            
+            for (auto& worker : workers_) {
+                if (worker.joinable()) {
+                    worker.join();
+                }
+            }
+        }
+        
+        void ThreadPool::WorkerLoop() {
+            while (true) {
+                std::function<void()> job;
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    cv_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+                    if (jobs_.empty()) {
+                        return;
+                    }
+                    job = std::move(jobs_.front());
+                    jobs_.pop();
+                }
+                
+                try {
+                    job();
+                } catch (const std::exception& e) {
+                    Logger::LogMessage("Worker job failed: " + std::string(e.what()));
+                }
+            }
+        }
+        
+    }
+}
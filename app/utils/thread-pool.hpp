@@ -0,0 +1,40 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace MikoIDE {
+    namespace Utils {
+        
+        // Fixed-size pool of worker threads draining a FIFO of jobs
+        class ThreadPool {
+        public:
+            explicit ThreadPool(size_t threadCount);
+            ~ThreadPool();
+            
+            ThreadPool(const ThreadPool&) = delete;
+            ThreadPool& operator=(const ThreadPool&) = delete;
+            
+            // Returns false once Shutdown() has started
+            bool Post(std::function<void()> job);
+            
+            // Runs the queued jobs, then joins the workers
+            void Shutdown();
+            
+            size_t GetThreadCount() const { return workers_.size(); }
+            
+        private:
+            void WorkerLoop();
+            
+            std::vector<std::thread> workers_;
+            std::queue<std::function<void()>> jobs_;
+            std::mutex mutex_;
+            std::condition_variable cv_;
+            bool stopping_;
+        };
+        
+    }
+}
@@ -0,0 +1,260 @@
+#include "vt-parser.hpp"
+
+namespace MikoIDE {
+    namespace Utils {
+        
+        namespace {
+            constexpr uint8_t ESC = 0x1b;
+            constexpr uint8_t BEL = 0x07;
+            constexpr uint32_t kReplacementCharacter = 0xfffd;
+            
+            bool IsC0(uint8_t byte) {
+                return byte < 0x20 && byte != ESC;
+            }
+            
+            bool IsIntermediate(uint8_t byte) {
+                return byte >= 0x20 && byte <= 0x2f;
+            }
+        }
+        
+        VtParser::VtParser(VtHandler& handler) : handler_(handler) {
+            Reset();
+        }
+        
+        void VtParser::Reset() {
+            state_ = State::Ground;
+            utf8_codepoint_ = 0;
+            utf8_remaining_ = 0;
+            string_escape_ = false;
+            osc_.clear();
+            Clear();
+        }
+        
+        void VtParser::Clear() {
+            prefix_ = 0;
+            intermediates_.clear();
+            param_count_ = 0;
+            subparams_ = 0;
+            param_started_ = false;
+            for (uint16_t& param : params_) {
+                param = 0;
+            }
+        }
+        
+        void VtParser::Feed(const char* data, size_t size) {
+            for (size_t i = 0; i < size; ++i) {
+                Advance(static_cast<uint8_t>(data[i]));
+            }
+        }
+        
+        void VtParser::AbortUtf8() {
+            if (utf8_remaining_ > 0) {
+                utf8_remaining_ = 0;
+                handler_.Print(kReplacementCharacter);
+            }
+        }
+        
+        void VtParser::DecodeUtf8(uint8_t byte) {
+            if (utf8_remaining_ > 0) {
+                if ((byte & 0xc0) == 0x80) {
+                    utf8_codepoint_ = (utf8_codepoint_ << 6) | (byte & 0x3f);
+                    if (--utf8_remaining_ == 0) {
+                        handler_.Print(utf8_codepoint_);
+                    }
+                    return;
+                }
+                // Truncated sequence; the byte starts something new
+                AbortUtf8();
+            }
+            
+            if (byte < 0x80) {
+                handler_.Print(byte);
+            } else if ((byte & 0xe0) == 0xc0) {
+                utf8_codepoint_ = byte & 0x1f;
+                utf8_remaining_ = 1;
+            } else if ((byte & 0xf0) == 0xe0) {
+                utf8_codepoint_ = byte & 0x0f;
+                utf8_remaining_ = 2;
+            } else if ((byte & 0xf8) == 0xf0) {
+                utf8_codepoint_ = byte & 0x07;
+                utf8_remaining_ = 3;
+            } else {
+                handler_.Print(kReplacementCharacter);
+            }
+        }
+        
+        void VtParser::Param(uint8_t byte) {
+            if (byte == ';' || byte == ':') {
+                if (param_count_ < kMaxParams) {
+                    ++param_count_;
+                    if (byte == ':' && param_count_ < kMaxParams) {
+                        subparams_ |= 1u << param_count_;
+                    }
+                }
+                param_started_ = false;
+                return;
+            }
+            
+            if (param_count_ >= kMaxParams) {
+                return;
+            }
+            uint32_t value = params_[param_count_] * 10u + (byte - '0');
+            params_[param_count_] = static_cast<uint16_t>(value > 0xffff ? 0xffff : value);
+            param_started_ = true;
+        }
+        
+        void VtParser::DispatchCsi(uint8_t final) {
+            // "CSI m" has no parameters; "CSI 1;m" has two
+            size_t count = param_count_ + ((param_started_ || param_count_ > 0) && param_count_ < kMaxParams ? 1 : 0);
+            handler_.CsiDispatch(prefix_, params_, count, subparams_, intermediates_, final);
+        }
+        
+        void VtParser::Advance(uint8_t byte) {
+            // Transitions from anywhere
+            if (byte == 0x18 || byte == 0x1a) {
+                AbortUtf8();
+                if (state_ != State::OscString && state_ != State::IgnoredString) {
+                    handler_.Execute(byte);
+                }
+                state_ = State::Ground;
+                return;
+            }
+            if (byte == ESC && state_ != State::OscString && state_ != State::IgnoredString) {
+                AbortUtf8();
+                Clear();
+                state_ = State::Escape;
+                return;
+            }
+            
+            switch (state_) {
+                case State::Ground:
+                    // A control cuts short a partial character, which shows
+                    // as U+FFFD before the control takes effect
+                    if (IsC0(byte)) {
+                        AbortUtf8();
+                        handler_.Execute(byte);
+                    } else if (byte != 0x7f) {
+                        DecodeUtf8(byte);
+                    }
+                    return;
+                
+                case State::Escape:
+                    if (IsC0(byte)) {
+                        handler_.Execute(byte);
+                    } else if (IsIntermediate(byte)) {
+                        intermediates_.push_back(static_cast<char>(byte));
+                        state_ = State::EscapeIntermediate;
+                    } else if (byte == '[') {
+                        state_ = State::CsiEntry;
+                    } else if (byte == ']') {
+                        osc_.clear();
+                        string_escape_ = false;
+                        state_ = State::OscString;
+                    } else if (byte == 'P' || byte == 'X' || byte == '^' || byte == '_') {
+                        string_escape_ = false;
+                        state_ = State::IgnoredString;
+                    } else if (byte >= 0x30 && byte <= 0x7e) {
+                        handler_.EscDispatch(intermediates_, byte);
+                        state_ = State::Ground;
+                    }
+                    return;
+                
+                case State::EscapeIntermediate:
+                    if (IsC0(byte)) {
+                        handler_.Execute(byte);
+                    } else if (IsIntermediate(byte)) {
+                        intermediates_.push_back(static_cast<char>(byte));
+                    } else if (byte >= 0x30 && byte <= 0x7e) {
+                        handler_.EscDispatch(intermediates_, byte);
+                        state_ = State::Ground;
+                    }
+                    return;
+                
+                case State::CsiEntry:
+                    if (IsC0(byte)) {
+                        handler_.Execute(byte);
+                    } else if (byte >= '<' && byte <= '?') {
+                        prefix_ = byte;
+                        state_ = State::CsiParam;
+                    } else if ((byte >= '0' && byte <= '9') || byte == ';' || byte == ':') {
+                        Param(byte);
+                        state_ = State::CsiParam;
+                    } else if (IsIntermediate(byte)) {
+                        intermediates_.push_back(static_cast<char>(byte));
+                        state_ = State::CsiIntermediate;
+                    } else if (byte >= 0x40 && byte <= 0x7e) {
+                        DispatchCsi(byte);
+                        state_ = State::Ground;
+                    }
+                    return;
+                
+                case State::CsiParam:
+                    if (IsC0(byte)) {
+                        handler_.Execute(byte);
+                    } else if ((byte >= '0' && byte <= '9') || byte == ';' || byte == ':') {
+                        Param(byte);
+                    } else if (byte >= '<' && byte <= '?') {
+                        state_ = State::CsiIgnore;
+                    } else if (IsIntermediate(byte)) {
+                        intermediates_.push_back(static_cast<char>(byte));
+                        state_ = State::CsiIntermediate;
+                    } else if (byte >= 0x40 && byte <= 0x7e) {
+                        DispatchCsi(byte);
+                        state_ = State::Ground;
+                    }
+                    return;
+                
+                case State::CsiIntermediate:
+                    if (IsC0(byte)) {
+                        handler_.Execute(byte);
+                    } else if (IsIntermediate(byte)) {
+                        intermediates_.push_back(static_cast<char>(byte));
+                    } else if (byte >= 0x30 && byte <= 0x3f) {
+                        state_ = State::CsiIgnore;
+                    } else if (byte >= 0x40 && byte <= 0x7e) {
+                        DispatchCsi(byte);
+                        state_ = State::Ground;
+                    }
+                    return;
+                
+                case State::CsiIgnore:
+                    if (IsC0(byte)) {
+                        handler_.Execute(byte);
+                    } else if (byte >= 0x40 && byte <= 0x7e) {
+                        state_ = State::Ground;
+                    }
+                    return;
+                
+                case State::OscString:
+                case State::IgnoredString:
+                    // Terminated by BEL (xterm) or ST (ESC \)
+                    if (string_escape_) {
+                        string_escape_ = false;
+                        if (state_ == State::OscString) {
+                            handler_.OscDispatch(osc_);
+                        }
+                        state_ = State::Ground;
+                        if (byte != '\\') {
+                            // ESC starting a new sequence right after the string
+                            Clear();
+                            state_ = State::Escape;
+                            Advance(byte);
+                        }
+                        return;
+                    }
+                    if (byte == ESC) {
+                        string_escape_ = true;
+                    } else if (byte == BEL) {
+                        if (state_ == State::OscString) {
+                            handler_.OscDispatch(osc_);
+                        }
+                        state_ = State::Ground;
+                    } else if (state_ == State::OscString && byte >= 0x20 && osc_.size() < kMaxOscLength) {
+                        osc_.push_back(static_cast<char>(byte));
+                    }
+                    return;
+            }
+        }
+        
+    }
+}
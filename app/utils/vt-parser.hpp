@@ -0,0 +1,83 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace MikoIDE {
+    namespace Utils {
+        
+        // Receives the actions recognized by VtParser
+        class VtHandler {
+        public:
+            virtual ~VtHandler() = default;
+            
+            // A printable character, already decoded from UTF-8
+            virtual void Print(uint32_t codepoint) = 0;
+            // C0 control such as BS, HT, LF or CR
+            virtual void Execute(uint8_t control) = 0;
+            virtual void EscDispatch(const std::string& intermediates, uint8_t final) = 0;
+            // |params| holds |count| values; omitted parameters are 0. Bit i of
+            // |subparams| is set when params[i] followed a ':' separator
+            // (as in 38:2::r:g:b). |prefix| is the private marker
+            // ('?', '>', '<', '=') or 0.
+            virtual void CsiDispatch(uint8_t prefix, const uint16_t* params, size_t count,
+                                     uint32_t subparams, const std::string& intermediates,
+                                     uint8_t final) = 0;
+            // Operating system command, e.g. "0;title"
+            virtual void OscDispatch(const std::string& data) = 0;
+        };
+        
+        // Byte-at-a-time escape sequence parser following the DEC/ANSI state
+        // machine described by Paul Williams (vt100.net/emu/dec_ansi_parser),
+        // with UTF-8 decoding in the ground state. DCS, SOS, PM and APC
+        // strings are consumed and ignored. Input may be split anywhere.
+        class VtParser {
+        public:
+            static constexpr size_t kMaxParams = 16;
+            static constexpr size_t kMaxOscLength = 4096;
+            
+            explicit VtParser(VtHandler& handler);
+            
+            void Feed(const char* data, size_t size);
+            void Reset();
+            
+        private:
+            enum class State {
+                Ground,
+                Escape,
+                EscapeIntermediate,
+                CsiEntry,
+                CsiParam,
+                CsiIntermediate,
+                CsiIgnore,
+                OscString,
+                IgnoredString
+            };
+            
+            void Advance(uint8_t byte);
+            void DecodeUtf8(uint8_t byte);
+            // Prints U+FFFD for a partial character, if there is one
+            void AbortUtf8();
+            void Clear();
+            void Param(uint8_t byte);
+            void DispatchCsi(uint8_t final);
+            
+            VtHandler& handler_;
+            State state_;
+            
+            uint8_t prefix_;
+            std::string intermediates_;
+            uint16_t params_[kMaxParams];
+            size_t param_count_;
+            uint32_t subparams_;
+            bool param_started_;
+            
+            std::string osc_;
+            bool string_escape_;    // ESC seen inside a string, expecting '\'
+            
+            uint32_t utf8_codepoint_;
+            int utf8_remaining_;
+        };
+        
+    }
+}
@@ -0,0 +1,1230 @@
+#include "vt-screen.hpp"
+#include "scrollback.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace MikoIDE {
+    namespace Utils {
+        
+        namespace {
+            constexpr int kMaxDimension = 4096;
+            constexpr int kTabWidth = 8;
+            
+            // DEC special graphics for 0x5f..0x7e, selected with ESC ( 0
+            const uint32_t kLineDrawing[32] = {
+                0x00a0, 0x25c6, 0x2592, 0x2409, 0x240c, 0x240d, 0x240a, 0x00b0,
+                0x00b1, 0x2424, 0x240b, 0x2518, 0x2510, 0x250c, 0x2514, 0x253c,
+                0x23ba, 0x23bb, 0x2500, 0x23bc, 0x23bd, 0x251c, 0x2524, 0x2534,
+                0x252c, 0x2502, 0x2264, 0x2265, 0x03c0, 0x2260, 0x00a3, 0x00b7
+            };
+            
+            struct Range {
+                uint32_t first;
+                uint32_t last;
+            };
+            
+            const Range kZeroWidth[] = {
+                {0x0300, 0x036f}, {0x0483, 0x0489}, {0x0591, 0x05bd}, {0x0610, 0x061a},
+                {0x064b, 0x065f}, {0x0e31, 0x0e31}, {0x0e34, 0x0e3a}, {0x0e47, 0x0e4e},
+                {0x1ab0, 0x1aff}, {0x1dc0, 0x1dff}, {0x200b, 0x200f}, {0x20d0, 0x20ff},
+                {0xfe00, 0xfe0f}, {0xfe20, 0xfe2f}, {0xfeff, 0xfeff}, {0xe0100, 0xe01ef}
+            };
+            
+            const Range kDoubleWidth[] = {
+                {0x1100, 0x115f}, {0x231a, 0x231b}, {0x2329, 0x232a}, {0x23e9, 0x23ec},
+                {0x25fd, 0x25fe}, {0x2614, 0x2615}, {0x2648, 0x2653}, {0x26aa, 0x26ab},
+                {0x26bd, 0x26be}, {0x26c4, 0x26c5}, {0x26ce, 0x26ce}, {0x26d4, 0x26d4},
+                {0x26ea, 0x26ea}, {0x26f2, 0x26f5}, {0x26fa, 0x26fd}, {0x2705, 0x2705},
+                {0x270a, 0x270b}, {0x2728, 0x2728}, {0x274c, 0x274c}, {0x2753, 0x2755},
+                {0x2757, 0x2757}, {0x2795, 0x2797}, {0x27b0, 0x27b0}, {0x27bf, 0x27bf},
+                {0x2b1b, 0x2b1c}, {0x2b50, 0x2b50}, {0x2b55, 0x2b55}, {0x2e80, 0x303e},
+                {0x3041, 0x33ff}, {0x3400, 0x4dbf}, {0x4e00, 0x9fff}, {0xa000, 0xa4cf},
+                {0xa960, 0xa97f}, {0xac00, 0xd7a3}, {0xf900, 0xfaff}, {0xfe10, 0xfe19},
+                {0xfe30, 0xfe6f}, {0xff00, 0xff60}, {0xffe0, 0xffe6}, {0x16fe0, 0x18aff},
+                {0x1b000, 0x1b2ff}, {0x1f004, 0x1f004}, {0x1f0cf, 0x1f0cf}, {0x1f18e, 0x1f18e},
+                {0x1f191, 0x1f19a}, {0x1f200, 0x1f251}, {0x1f300, 0x1f64f}, {0x1f680, 0x1f6ff},
+                {0x1f7e0, 0x1f7eb}, {0x1f90c, 0x1f9ff}, {0x1fa70, 0x1faff}, {0x20000, 0x3fffd}
+            };
+            
+            template <size_t N>
+            bool InRanges(const Range (&ranges)[N], uint32_t codepoint) {
+                if (codepoint < ranges[0].first || codepoint > ranges[N - 1].last) {
+                    return false;
+                }
+                size_t low = 0;
+                size_t high = N;
+                while (low < high) {
+                    size_t mid = (low + high) / 2;
+                    if (codepoint > ranges[mid].last) {
+                        low = mid + 1;
+                    } else if (codepoint < ranges[mid].first) {
+                        high = mid;
+                    } else {
+                        return true;
+                    }
+                }
+                return false;
+            }
+            
+            void AppendU16(std::string& out, uint32_t value) {
+                char bytes[2] = {
+                    static_cast<char>(value & 0xff),
+                    static_cast<char>((value >> 8) & 0xff)
+                };
+                out.append(bytes, sizeof(bytes));
+            }
+            
+            void AppendU32(std::string& out, uint32_t value) {
+                char bytes[4] = {
+                    static_cast<char>(value & 0xff),
+                    static_cast<char>((value >> 8) & 0xff),
+                    static_cast<char>((value >> 16) & 0xff),
+                    static_cast<char>((value >> 24) & 0xff)
+                };
+                out.append(bytes, sizeof(bytes));
+            }
+            
+            void StoreU32(std::string& out, size_t offset, uint32_t value) {
+                for (int i = 0; i < 4; ++i) {
+                    out[offset + i] = static_cast<char>((value >> (i * 8)) & 0xff);
+                }
+            }
+            
+            bool SameStyle(const VtCell& a, const VtCell& b) {
+                return a.fg == b.fg && a.bg == b.bg && a.flags == b.flags;
+            }
+            
+            uint32_t LoadU16(const char* data) {
+                return static_cast<uint8_t>(data[0]) | (static_cast<uint8_t>(data[1]) << 8);
+            }
+            
+            uint32_t LoadU32(const char* data) {
+                uint32_t value;
+                memcpy(&value, data, sizeof(value));
+                return value;
+            }
+            
+            void AppendUtf8(std::string& out, uint32_t codepoint) {
+                if (codepoint < 0x80) {
+                    out.push_back(static_cast<char>(codepoint));
+                } else if (codepoint < 0x800) {
+                    out.push_back(static_cast<char>(0xc0 | (codepoint >> 6)));
+                    out.push_back(static_cast<char>(0x80 | (codepoint & 0x3f)));
+                } else if (codepoint < 0x10000) {
+                    out.push_back(static_cast<char>(0xe0 | (codepoint >> 12)));
+                    out.push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3f)));
+                    out.push_back(static_cast<char>(0x80 | (codepoint & 0x3f)));
+                } else {
+                    out.push_back(static_cast<char>(0xf0 | (codepoint >> 18)));
+                    out.push_back(static_cast<char>(0x80 | ((codepoint >> 12) & 0x3f)));
+                    out.push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3f)));
+                    out.push_back(static_cast<char>(0x80 | (codepoint & 0x3f)));
+                }
+            }
+            
+            // |base| is 30 for the foreground and 40 for the background
+            void AppendSgrColor(uint32_t color, int base, std::string& out) {
+                if (color & VtScreen::kColorRgb) {
+                    out += ';' + std::to_string(base + 8) + ";2;" + std::to_string((color >> 16) & 0xff) + ';' +
+                           std::to_string((color >> 8) & 0xff) + ';' + std::to_string(color & 0xff);
+                } else if (color & VtScreen::kColorPalette) {
+                    const uint32_t index = color & 0xff;
+                    if (index < 8) {
+                        out += ';' + std::to_string(base + index);
+                    } else if (index < 16) {
+                        out += ';' + std::to_string(base + 60 + index - 8);
+                    } else {
+                        out += ';' + std::to_string(base + 8) + ";5;" + std::to_string(index);
+                    }
+                }
+            }
+            
+            void AppendCursorPosition(int row, int col, std::string& out) {
+                out += "\x1b[" + std::to_string(row + 1) + ';' + std::to_string(col + 1) + 'H';
+            }
+            
+            constexpr uint16_t kWidthFlags = VtScreen::kWide | VtScreen::kWideContinuation;
+        }
+        
+        int VtCharWidth(uint32_t codepoint) {
+            if (codepoint < 0x0300) {
+                return 1;
+            }
+            if (InRanges(kZeroWidth, codepoint)) {
+                return 0;
+            }
+            return InRanges(kDoubleWidth, codepoint) ? 2 : 1;
+        }
+        
+        VtScreen::VtScreen(int cols, int rows)
+            : parser_(*this),
+              scrollback_(nullptr),
+              cols_(std::clamp(cols, 1, kMaxDimension)),
+              rows_(std::clamp(rows, 1, kMaxDimension)),
+              active_(&primary_),
+              changed_(true),
+              needs_full_(true),
+              encoded_col_(0),
+              encoded_row_(0),
+              encoded_modes_(0),
+              scroll_top_(0),
+              scroll_bottom_(rows_ - 1),
+              autowrap_(true),
+              insert_mode_(false),
+              modes_(kCursorVisible),
+              last_printed_(' '),
+              title_changed_(false) {
+            primary_.assign(rows_, Row(cols_));
+            alternate_.assign(rows_, Row(cols_));
+            shadow_.assign(rows_, Row(cols_));
+            dirty_.assign(rows_, 1);
+            tab_stops_.assign(cols_, 0);
+            for (int col = 0; col < cols_; col += kTabWidth) {
+                tab_stops_[col] = 1;
+            }
+        }
+        
+        void VtScreen::Feed(const char* data, size_t size) {
+            parser_.Feed(data, size);
+            if (cursor_.col != encoded_col_ || cursor_.row != encoded_row_ || modes_ != encoded_modes_) {
+                changed_ = true;
+            }
+        }
+        
+        std::string VtScreen::TakeResponses() {
+            std::string responses;
+            responses.swap(responses_);
+            return responses;
+        }
+        
+        void VtScreen::Resize(int cols, int rows) {
+            cols = std::clamp(cols, 1, kMaxDimension);
+            rows = std::clamp(rows, 1, kMaxDimension);
+            if (cols == cols_ && rows == rows_) {
+                return;
+            }
+            
+            // Keep the cursor line visible by pushing lines off the top
+            if (cursor_.row >= rows) {
+                int excess = cursor_.row - rows + 1;
+                if (scrollback_ && active_ == &primary_) {
+                    for (int row = 0; row < excess; ++row) {
+                        scrollback_->AppendLine(primary_[row].data(), primary_[row].size());
+                    }
+                }
+                active_->erase(active_->begin(), active_->begin() + excess);
+                active_->resize(rows_, Row(cols_));
+                cursor_.row -= excess;
+                saved_cursor_.row = std::max(0, saved_cursor_.row - excess);
+            }
+            
+            for (Grid* grid : {&primary_, &alternate_}) {
+                grid->resize(rows, Row(cols));
+                for (Row& row : *grid) {
+                    row.resize(cols);
+                    // A wide character cut in half at the new right edge
+                    if (row[cols - 1].flags & kWide) {
+                        row[cols - 1] = VtCell();
+                    }
+                }
+            }
+            shadow_.assign(rows, Row(cols));
+            dirty_.assign(rows, 1);
+            
+            size_t old_cols = tab_stops_.size();
+            tab_stops_.resize(cols, 0);
+            for (size_t col = old_cols; col < tab_stops_.size(); ++col) {
+                tab_stops_[col] = (col % kTabWidth) == 0;
+            }
+            
+            cols_ = cols;
+            rows_ = rows;
+            scroll_top_ = 0;
+            scroll_bottom_ = rows_ - 1;
+            for (Cursor* cursor : {&cursor_, &saved_cursor_, &saved_primary_cursor_}) {
+                cursor->col = std::min(cursor->col, cols_ - 1);
+                cursor->row = std::min(cursor->row, rows_ - 1);
+                cursor->pending_wrap = false;
+            }
+            needs_full_ = true;
+            changed_ = true;
+        }
+        
+        void VtScreen::EncodeDiff(std::vector<std::string>& records, size_t max_record_size, bool full) {
+            full = full || needs_full_;
+            bool include_title = title_changed_ || (full && !title_.empty());
+            
+            std::string* out = nullptr;
+            size_t count_offset = 0;
+            uint32_t runs = 0;
+            
+            auto begin_record = [&]() {
+                records.emplace_back();
+                out = &records.back();
+                AppendU16(*out, cols_);
+                AppendU16(*out, rows_);
+                AppendU16(*out, cursor_.col);
+                AppendU16(*out, cursor_.row);
+                AppendU32(*out, modes_);
+                if (include_title) {
+                    AppendU16(*out, static_cast<uint32_t>(title_.size()));
+                    out->append(title_);
+                    include_title = false;
+                } else {
+                    AppendU16(*out, 0);
+                }
+                count_offset = out->size();
+                AppendU32(*out, 0);
+                runs = 0;
+            };
+            begin_record();
+            
+            for (int row = 0; row < rows_; ++row) {
+                if (!full && !dirty_[row]) {
+                    continue;
+                }
+                const Row& current = (*active_)[row];
+                Row& previous = shadow_[row];
+                
+                int first = 0;
+                int last = cols_ - 1;
+                if (!full) {
+                    while (first < cols_ && current[first] == previous[first]) {
+                        ++first;
+                    }
+                    if (first == cols_) {
+                        continue;
+                    }
+                    while (last > first && current[last] == previous[last]) {
+                        --last;
+                    }
+                }
+                
+                int start = first;
+                while (start <= last) {
+                    int end = start + 1;
+                    while (end <= last && SameStyle(current[end], current[start])) {
+                        ++end;
+                    }
+                    if (runs > 0 && out->size() >= max_record_size) {
+                        StoreU32(*out, count_offset, runs);
+                        begin_record();
+                    }
+                    
+                    const VtCell& style = current[start];
+                    AppendU16(*out, row);
+                    AppendU16(*out, start);
+                    AppendU16(*out, end - start);
+                    AppendU32(*out, style.fg);
+                    AppendU32(*out, style.bg);
+                    AppendU16(*out, style.flags);
+                    for (int col = start; col < end; ++col) {
+                        AppendU32(*out, current[col].codepoint);
+                    }
+                    ++runs;
+                    start = end;
+                }
+                std::copy(current.begin() + first, current.begin() + last + 1, previous.begin() + first);
+            }
+            StoreU32(*out, count_offset, runs);
+            
+            std::fill(dirty_.begin(), dirty_.end(), 0);
+            changed_ = false;
+            needs_full_ = false;
+            title_changed_ = false;
+            encoded_col_ = cursor_.col;
+            encoded_row_ = cursor_.row;
+            encoded_modes_ = modes_;
+        }
+        
+        void VtScreen::AppendRowText(int row, std::string& out) const {
+            const std::vector<VtCell>& cells = (*active_)[row];
+            const VtCell blank;
+            int count = cols_;
+            while (count > 0 && cells[count - 1] == blank) {
+                --count;
+            }
+            
+            for (int col = 0; col < count; ++col) {
+                // Right halves of wide characters have no codepoint
+                if (cells[col].codepoint != 0) {
+                    AppendUtf8(out, cells[col].codepoint);
+                }
+            }
+        }
+        
+        void VtScreen::AppendSgr(uint32_t fg, uint32_t bg, uint16_t flags, std::string& out) {
+            static const struct {
+                uint16_t flag;
+                char code;
+            } kFlagCodes[] = {
+                {kBold, '1'}, {kDim, '2'}, {kItalic, '3'}, {kUnderline, '4'},
+                {kBlink, '5'}, {kInverse, '7'}, {kHidden, '8'}, {kStrikethrough, '9'}
+            };
+            
+            out += "\x1b[0";
+            for (const auto& entry : kFlagCodes) {
+                if (flags & entry.flag) {
+                    out += ';';
+                    out += entry.code;
+                }
+            }
+            AppendSgrColor(fg, 30, out);
+            AppendSgrColor(bg, 40, out);
+            out += 'm';
+        }
+        
+        void VtScreen::AppendRowSnapshot(const Row& cells, VtCell& style, std::string& out) const {
+            const VtCell blank;
+            int count = cols_;
+            while (count > 0 && cells[count - 1] == blank) {
+                --count;
+            }
+            
+            for (int col = 0; col < count; ++col) {
+                const VtCell& cell = cells[col];
+                if (cell.flags & kWideContinuation) {
+                    continue;
+                }
+                const uint16_t flags = cell.flags & ~kWidthFlags;
+                if (cell.fg != style.fg || cell.bg != style.bg || flags != style.flags) {
+                    AppendSgr(cell.fg, cell.bg, flags, out);
+                    style.fg = cell.fg;
+                    style.bg = cell.bg;
+                    style.flags = flags;
+                }
+                AppendUtf8(out, cell.codepoint != 0 ? cell.codepoint : ' ');
+            }
+        }
+        
+        void VtScreen::EncodeSnapshot(std::string& out, size_t scrollback_lines) const {
+            VtCell style;
+            out += "\x1b[0m";
+            
+            if (scrollback_ && scrollback_lines > 0) {
+                const uint64_t end = scrollback_->GetEndLine();
+                const uint64_t first = std::max(scrollback_->GetFirstLine(),
+                                                end - std::min<uint64_t>(end, scrollback_lines));
+                std::string lines;
+                const size_t count = scrollback_->ReadLines(first, static_cast<size_t>(end - first), lines);
+                
+                // Lines as Scrollback::ReadLines returns them, runs re-styled
+                const char* p = lines.data();
+                for (size_t i = 0; i < count; ++i) {
+                    const char* next = p + sizeof(uint32_t) + LoadU32(p);
+                    const char* run = p + sizeof(uint32_t) + sizeof(uint16_t);
+                    for (uint32_t runs = LoadU16(p + sizeof(uint32_t)); runs > 0; --runs) {
+                        const uint32_t fg = LoadU32(run);
+                        const uint32_t bg = LoadU32(run + 4);
+                        const uint16_t flags = static_cast<uint16_t>(LoadU16(run + 8));
+                        const uint32_t length = LoadU16(run + 10);
+                        if (fg != style.fg || bg != style.bg || flags != style.flags) {
+                            AppendSgr(fg, bg, flags, out);
+                            style.fg = fg;
+                            style.bg = bg;
+                            style.flags = flags;
+                        }
+                        out.append(run + 12, length);
+                        run += 12 + length;
+                    }
+                    out += "\r\n";
+                    p = next;
+                }
+            }
+            
+            for (int row = 0; row < rows_; ++row) {
+                AppendRowSnapshot(primary_[row], style, out);
+                if (row + 1 < rows_) {
+                    out += "\r\n";
+                }
+            }
+            
+            // 1049 saves the cursor the primary screen returns to
+            if (active_ == &alternate_) {
+                AppendCursorPosition(saved_primary_cursor_.row, saved_primary_cursor_.col, out);
+                out += "\x1b[?1049h";
+                for (int row = 0; row < rows_; ++row) {
+                    AppendCursorPosition(row, 0, out);
+                    AppendRowSnapshot(alternate_[row], style, out);
+                }
+            }
+            
+            if (scroll_top_ != 0 || scroll_bottom_ != rows_ - 1) {
+                out += "\x1b[" + std::to_string(scroll_top_ + 1) + ';' + std::to_string(scroll_bottom_ + 1) + 'r';
+            }
+            
+            static const struct {
+                uint32_t mode;
+                const char* sequence;
+            } kModeSequences[] = {
+                {kApplicationCursor, "\x1b[?1h"}, {kApplicationKeypad, "\x1b="},
+                {kBracketedPaste, "\x1b[?2004h"}, {kFocusEvents, "\x1b[?1004h"},
+                {kMouseClick, "\x1b[?1000h"}, {kMouseDrag, "\x1b[?1002h"},
+                {kMouseMotion, "\x1b[?1003h"}, {kMouseSgr, "\x1b[?1006h"}
+            };
+            for (const auto& entry : kModeSequences) {
+                if (modes_ & entry.mode) {
+                    out += entry.sequence;
+                }
+            }
+            if (!(modes_ & kCursorVisible)) {
+                out += "\x1b[?25l";
+            }
+            if (!autowrap_) {
+                out += "\x1b[?7l";
+            }
+            if (insert_mode_) {
+                out += "\x1b[4h";
+            }
+            
+            int cursorRow = cursor_.row;
+            if (cursor_.origin_mode) {
+                out += "\x1b[?6h";
+                cursorRow -= scroll_top_;
+            }
+            AppendCursorPosition(cursorRow, cursor_.col, out);
+            AppendSgr(cursor_.pen.fg, cursor_.pen.bg, cursor_.pen.flags, out);
+            if (cursor_.line_drawing) {
+                out += "\x1b(0";
+            }
+            if (!title_.empty()) {
+                out += "\x1b]2;" + title_ + '\a';
+            }
+        }
+        
+        void VtScreen::MarkDirty(int row) {
+            dirty_[row] = 1;
+            changed_ = true;
+        }
+        
+        void VtScreen::MarkAllDirty() {
+            std::fill(dirty_.begin(), dirty_.end(), 1);
+            changed_ = true;
+        }
+        
+        VtCell VtScreen::BlankCell() const {
+            // Erased cells take the current background (bce)
+            VtCell cell;
+            cell.bg = cursor_.pen.bg;
+            return cell;
+        }
+        
+        void VtScreen::BreakWideCharacter(int row, int col) {
+            Row& cells = (*active_)[row];
+            if ((cells[col].flags & kWideContinuation) && col > 0) {
+                cells[col - 1] = BlankCell();
+            } else if ((cells[col].flags & kWide) && col + 1 < cols_) {
+                cells[col + 1] = BlankCell();
+            }
+        }
+        
+        void VtScreen::Print(uint32_t codepoint) {
+            if (cursor_.line_drawing && codepoint >= 0x5f && codepoint <= 0x7e) {
+                codepoint = kLineDrawing[codepoint - 0x5f];
+            }
+            int width = VtCharWidth(codepoint);
+            if (width == 0) {
+                return;
+            }
+            if (width == 2 && cols_ < 2) {
+                width = 1;
+            }
+            
+            if (cursor_.pending_wrap) {
+                cursor_.col = 0;
+                LineFeed();
+            }
+            if (width == 2 && cursor_.col == cols_ - 1) {
+                if (!autowrap_) {
+                    return;
+                }
+                EraseCells(cursor_.row, cursor_.col, cursor_.col);
+                cursor_.col = 0;
+                LineFeed();
+            }
+            if (insert_mode_) {
+                InsertCells(width);
+            }
+            
+            Row& cells = (*active_)[cursor_.row];
+            BreakWideCharacter(cursor_.row, cursor_.col);
+            VtCell& cell = cells[cursor_.col];
+            cell = cursor_.pen;
+            cell.codepoint = codepoint;
+            if (width == 2) {
+                BreakWideCharacter(cursor_.row, cursor_.col + 1);
+                cell.flags |= kWide;
+                VtCell& continuation = cells[cursor_.col + 1];
+                continuation = cursor_.pen;
+                continuation.codepoint = 0;
+                continuation.flags |= kWideContinuation;
+            }
+            MarkDirty(cursor_.row);
+            last_printed_ = codepoint;
+            
+            cursor_.col += width;
+            if (cursor_.col >= cols_) {
+                cursor_.col = cols_ - 1;
+                cursor_.pending_wrap = autowrap_;
+            }
+        }
+        
+        void VtScreen::Execute(uint8_t control) {
+            switch (control) {
+                case 0x08:  // BS
+                    if (cursor_.col > 0) {
+                        --cursor_.col;
+                    }
+                    cursor_.pending_wrap = false;
+                    break;
+                case 0x09:  // HT
+                    while (cursor_.col < cols_ - 1) {
+                        if (tab_stops_[++cursor_.col]) {
+                            break;
+                        }
+                    }
+                    cursor_.pending_wrap = false;
+                    break;
+                case 0x0a:  // LF
+                case 0x0b:  // VT
+                case 0x0c:  // FF
+                    LineFeed();
+                    break;
+                case 0x0d:  // CR
+                    cursor_.col = 0;
+                    cursor_.pending_wrap = false;
+                    break;
+                case 0x0e:  // SO: G1 is never designated, keep G0
+                case 0x0f:  // SI
+                default:
+                    break;
+            }
+        }
+        
+        void VtScreen::LineFeed() {
+            cursor_.pending_wrap = false;
+            if (cursor_.row == scroll_bottom_) {
+                ScrollUp(scroll_top_, scroll_bottom_, 1, true);
+            } else if (cursor_.row < rows_ - 1) {
+                ++cursor_.row;
+            }
+        }
+        
+        void VtScreen::ReverseLineFeed() {
+            cursor_.pending_wrap = false;
+            if (cursor_.row == scroll_top_) {
+                ScrollDown(scroll_top_, scroll_bottom_, 1);
+            } else if (cursor_.row > 0) {
+                --cursor_.row;
+            }
+        }
+        
+        void VtScreen::ScrollUp(int top, int bottom, int lines, bool save) {
+            lines = std::min(lines, bottom - top + 1);
+            if (lines <= 0) {
+                return;
+            }
+            Grid& grid = *active_;
+            if (save && scrollback_ && top == 0 && active_ == &primary_) {
+                for (int row = 0; row < lines; ++row) {
+                    scrollback_->AppendLine(grid[row].data(), grid[row].size());
+                }
+            }
+            std::rotate(grid.begin() + top, grid.begin() + top + lines, grid.begin() + bottom + 1);
+            for (int row = bottom - lines + 1; row <= bottom; ++row) {
+                std::fill(grid[row].begin(), grid[row].end(), BlankCell());
+            }
+            for (int row = top; row <= bottom; ++row) {
+                MarkDirty(row);
+            }
+        }
+        
+        void VtScreen::ScrollDown(int top, int bottom, int lines) {
+            lines = std::min(lines, bottom - top + 1);
+            if (lines <= 0) {
+                return;
+            }
+            Grid& grid = *active_;
+            std::rotate(grid.begin() + top, grid.begin() + bottom + 1 - lines, grid.begin() + bottom + 1);
+            for (int row = top; row < top + lines; ++row) {
+                std::fill(grid[row].begin(), grid[row].end(), BlankCell());
+            }
+            for (int row = top; row <= bottom; ++row) {
+                MarkDirty(row);
+            }
+        }
+        
+        void VtScreen::MoveTo(int col, int row) {
+            if (cursor_.origin_mode) {
+                cursor_.row = std::clamp(row + scroll_top_, scroll_top_, scroll_bottom_);
+            } else {
+                cursor_.row = std::clamp(row, 0, rows_ - 1);
+            }
+            cursor_.col = std::clamp(col, 0, cols_ - 1);
+            cursor_.pending_wrap = false;
+        }
+        
+        void VtScreen::EraseCells(int row, int from, int to) {
+            from = std::max(from, 0);
+            to = std::min(to, cols_ - 1);
+            if (from > to) {
+                return;
+            }
+            BreakWideCharacter(row, from);
+            BreakWideCharacter(row, to);
+            Row& cells = (*active_)[row];
+            std::fill(cells.begin() + from, cells.begin() + to + 1, BlankCell());
+            MarkDirty(row);
+        }
+        
+        void VtScreen::InsertCells(int count) {
+            Row& cells = (*active_)[cursor_.row];
+            count = std::min(count, cols_ - cursor_.col);
+            BreakWideCharacter(cursor_.row, cursor_.col);
+            std::copy_backward(cells.begin() + cursor_.col, cells.end() - count, cells.end());
+            std::fill(cells.begin() + cursor_.col, cells.begin() + cursor_.col + count, BlankCell());
+            if (cells[cols_ - 1].flags & kWide) {
+                cells[cols_ - 1] = BlankCell();
+            }
+            MarkDirty(cursor_.row);
+        }
+        
+        void VtScreen::DeleteCells(int count) {
+            Row& cells = (*active_)[cursor_.row];
+            count = std::min(count, cols_ - cursor_.col);
+            BreakWideCharacter(cursor_.row, cursor_.col);
+            if (cursor_.col + count < cols_) {
+                BreakWideCharacter(cursor_.row, cursor_.col + count);
+            }
+            std::copy(cells.begin() + cursor_.col + count, cells.end(), cells.begin() + cursor_.col);
+            std::fill(cells.end() - count, cells.end(), BlankCell());
+            MarkDirty(cursor_.row);
+        }
+        
+        void VtScreen::EscDispatch(const std::string& intermediates, uint8_t final) {
+            if (intermediates == "(") {
+                // G0 designation: '0' is DEC special graphics, anything else ASCII
+                cursor_.line_drawing = final == '0';
+                return;
+            }
+            if (intermediates == "#" && final == '8') {
+                // DECALN: fill the screen with 'E'
+                for (int row = 0; row < rows_; ++row) {
+                    for (VtCell& cell : (*active_)[row]) {
+                        cell = VtCell();
+                        cell.codepoint = 'E';
+                    }
+                    MarkDirty(row);
+                }
+                return;
+            }
+            if (!intermediates.empty()) {
+                return;
+            }
+            
+            switch (final) {
+                case '7':  // DECSC
+                    saved_cursor_ = cursor_;
+                    break;
+                case '8':  // DECRC
+                    cursor_ = saved_cursor_;
+                    break;
+                case 'D':  // IND
+                    LineFeed();
+                    break;
+                case 'E':  // NEL
+                    cursor_.col = 0;
+                    LineFeed();
+                    break;
+                case 'H':  // HTS
+                    tab_stops_[cursor_.col] = 1;
+                    break;
+                case 'M':  // RI
+                    ReverseLineFeed();
+                    break;
+                case 'c':  // RIS
+                    FullReset();
+                    break;
+                case '=':  // DECKPAM
+                    modes_ |= kApplicationKeypad;
+                    break;
+                case '>':  // DECKPNM
+                    modes_ &= ~kApplicationKeypad;
+                    break;
+                default:
+                    break;
+            }
+        }
+        
+        void VtScreen::CsiDispatch(uint8_t prefix, const uint16_t* params, size_t count,
+                                   uint32_t subparams, const std::string& intermediates,
+                                   uint8_t final) {
+            auto param = [&](size_t index, int fallback) -> int {
+                return index < count && params[index] != 0 ? params[index] : fallback;
+            };
+            
+            if (prefix == '?') {
+                if (intermediates.empty() && (final == 'h' || final == 'l')) {
+                    for (size_t i = 0; i < count; ++i) {
+                        SetPrivateMode(params[i], final == 'h');
+                    }
+                }
+                return;
+            }
+            if (prefix == '>') {
+                if (final == 'c' && intermediates.empty()) {
+                    // Secondary device attributes
+                    responses_ += "\x1b[>0;10;1c";
+                }
+                return;
+            }
+            if (prefix != 0) {
+                return;
+            }
+            if (!intermediates.empty()) {
+                if (intermediates == "!" && final == 'p') {
+                    // DECSTR soft reset
+                    cursor_.pen = VtCell();
+                    cursor_.origin_mode = false;
+                    cursor_.line_drawing = false;
+                    autowrap_ = true;
+                    insert_mode_ = false;
+                    scroll_top_ = 0;
+                    scroll_bottom_ = rows_ - 1;
+                    modes_ = (modes_ | kCursorVisible) & ~(kApplicationCursor | kApplicationKeypad);
+                    saved_cursor_ = Cursor();
+                }
+                return;
+            }
+            
+            switch (final) {
+                case '@':  // ICH
+                    InsertCells(param(0, 1));
+                    break;
+                case 'A': {  // CUU
+                    int top = cursor_.row >= scroll_top_ ? scroll_top_ : 0;
+                    cursor_.row = std::max(top, cursor_.row - param(0, 1));
+                    cursor_.pending_wrap = false;
+                    break;
+                }
+                case 'B':  // CUD
+                case 'e': {  // VPR
+                    int bottom = cursor_.row <= scroll_bottom_ ? scroll_bottom_ : rows_ - 1;
+                    cursor_.row = std::min(bottom, cursor_.row + param(0, 1));
+                    cursor_.pending_wrap = false;
+                    break;
+                }
+                case 'C':  // CUF
+                case 'a':  // HPR
+                    cursor_.col = std::min(cols_ - 1, cursor_.col + param(0, 1));
+                    cursor_.pending_wrap = false;
+                    break;
+                case 'D':  // CUB
+                    cursor_.col = std::max(0, cursor_.col - param(0, 1));
+                    cursor_.pending_wrap = false;
+                    break;
+                case 'E':  // CNL
+                    CsiDispatch(0, params, count, 0, intermediates, 'B');
+                    cursor_.col = 0;
+                    break;
+                case 'F':  // CPL
+                    CsiDispatch(0, params, count, 0, intermediates, 'A');
+                    cursor_.col = 0;
+                    break;
+                case 'G':  // CHA
+                case '`':  // HPA
+                    cursor_.col = std::clamp(param(0, 1) - 1, 0, cols_ - 1);
+                    cursor_.pending_wrap = false;
+                    break;
+                case 'H':  // CUP
+                case 'f':  // HVP
+                    MoveTo(param(1, 1) - 1, param(0, 1) - 1);
+                    break;
+                case 'I':  // CHT
+                    for (int i = param(0, 1); i > 0; --i) {
+                        Execute(0x09);
+                    }
+                    break;
+                case 'Z':  // CBT
+                    for (int i = param(0, 1); i > 0 && cursor_.col > 0; --i) {
+                        while (--cursor_.col > 0 && !tab_stops_[cursor_.col]) {
+                        }
+                    }
+                    cursor_.pending_wrap = false;
+                    break;
+                case 'J':  // ED
+                    switch (param(0, 0)) {
+                        case 0:
+                            EraseCells(cursor_.row, cursor_.col, cols_ - 1);
+                            for (int row = cursor_.row + 1; row < rows_; ++row) {
+                                EraseCells(row, 0, cols_ - 1);
+                            }
+                            break;
+                        case 1:
+                            for (int row = 0; row < cursor_.row; ++row) {
+                                EraseCells(row, 0, cols_ - 1);
+                            }
+                            EraseCells(cursor_.row, 0, cursor_.col);
+                            break;
+                        case 2:
+                            for (int row = 0; row < rows_; ++row) {
+                                EraseCells(row, 0, cols_ - 1);
+                            }
+                            break;
+                        case 3:
+                            // xterm: clear the scrollback, leave the screen
+                            if (scrollback_) {
+                                scrollback_->Clear();
+                            }
+                            break;
+                    }
+                    break;
+                case 'K':  // EL
+                    switch (param(0, 0)) {
+                        case 0:
+                            EraseCells(cursor_.row, cursor_.col, cols_ - 1);
+                            break;
+                        case 1:
+                            EraseCells(cursor_.row, 0, cursor_.col);
+                            break;
+                        case 2:
+                            EraseCells(cursor_.row, 0, cols_ - 1);
+                            break;
+                    }
+                    break;
+                case 'L':  // IL
+                    if (cursor_.row >= scroll_top_ && cursor_.row <= scroll_bottom_) {
+                        ScrollDown(cursor_.row, scroll_bottom_, param(0, 1));
+                        cursor_.col = 0;
+                        cursor_.pending_wrap = false;
+                    }
+                    break;
+                case 'M':  // DL
+                    if (cursor_.row >= scroll_top_ && cursor_.row <= scroll_bottom_) {
+                        ScrollUp(cursor_.row, scroll_bottom_, param(0, 1));
+                        cursor_.col = 0;
+                        cursor_.pending_wrap = false;
+                    }
+                    break;
+                case 'P':  // DCH
+                    DeleteCells(param(0, 1));
+                    break;
+                case 'S':  // SU
+                    ScrollUp(scroll_top_, scroll_bottom_, param(0, 1), true);
+                    break;
+                case 'T':  // SD; the five-parameter form is mouse highlighting
+                    if (count <= 1) {
+                        ScrollDown(scroll_top_, scroll_bottom_, param(0, 1));
+                    }
+                    break;
+                case 'X':  // ECH
+                    EraseCells(cursor_.row, cursor_.col, cursor_.col + param(0, 1) - 1);
+                    break;
+                case 'b': {  // REP
+                    int repeat = std::min(param(0, 1), cols_ * rows_);
+                    for (int i = 0; i < repeat; ++i) {
+                        Print(last_printed_);
+                    }
+                    break;
+                }
+                case 'c':  // DA
+                    if (param(0, 0) == 0) {
+                        responses_ += "\x1b[?1;2c";
+                    }
+                    break;
+                case 'd':  // VPA
+                    MoveTo(cursor_.col, param(0, 1) - 1);
+                    break;
+                case 'g':  // TBC
+                    if (param(0, 0) == 0) {
+                        tab_stops_[cursor_.col] = 0;
+                    } else if (param(0, 0) == 3) {
+                        std::fill(tab_stops_.begin(), tab_stops_.end(), 0);
+                    }
+                    break;
+                case 'h':  // SM
+                case 'l':  // RM
+                    for (size_t i = 0; i < count; ++i) {
+                        if (params[i] == 4) {
+                            insert_mode_ = final == 'h';
+                        }
+                    }
+                    break;
+                case 'm':  // SGR
+                    SelectGraphicRendition(params, count, subparams);
+                    break;
+                case 'n':  // DSR
+                    if (param(0, 0) == 5) {
+                        responses_ += "\x1b[0n";
+                    } else if (param(0, 0) == 6) {
+                        int row = cursor_.row - (cursor_.origin_mode ? scroll_top_ : 0);
+                        responses_ += "\x1b[" + std::to_string(row + 1) + ";" +
+                                      std::to_string(cursor_.col + 1) + "R";
+                    }
+                    break;
+                case 'r': {  // DECSTBM
+                    int top = param(0, 1) - 1;
+                    int bottom = std::min(param(1, rows_), rows_) - 1;
+                    if (top < bottom) {
+                        scroll_top_ = top;
+                        scroll_bottom_ = bottom;
+                        MoveTo(0, 0);
+                    }
+                    break;
+                }
+                case 's':  // SCOSC
+                    if (count == 0) {
+                        saved_cursor_ = cursor_;
+                    }
+                    break;
+                case 'u':  // SCORC
+                    cursor_ = saved_cursor_;
+                    break;
+                default:
+                    break;
+            }
+        }
+        
+        void VtScreen::SetPrivateMode(uint16_t mode, bool enabled) {
+            auto set = [&](uint32_t flag) {
+                modes_ = enabled ? (modes_ | flag) : (modes_ & ~flag);
+            };
+            
+            switch (mode) {
+                case 1:
+                    set(kApplicationCursor);
+                    break;
+                case 6:
+                    cursor_.origin_mode = enabled;
+                    MoveTo(0, 0);
+                    break;
+                case 7:
+                    autowrap_ = enabled;
+                    cursor_.pending_wrap = false;
+                    break;
+                case 25:
+                    set(kCursorVisible);
+                    break;
+                case 47:
+                case 1047:
+                    SetAlternateScreen(enabled, false);
+                    break;
+                case 1048:
+                    if (enabled) {
+                        saved_cursor_ = cursor_;
+                    } else {
+                        cursor_ = saved_cursor_;
+                    }
+                    break;
+                case 1049:
+                    SetAlternateScreen(enabled, true);
+                    break;
+                case 1000:
+                    set(kMouseClick);
+                    break;
+                case 1002:
+                    set(kMouseDrag);
+                    break;
+                case 1003:
+                    set(kMouseMotion);
+                    break;
+                case 1004:
+                    set(kFocusEvents);
+                    break;
+                case 1006:
+                    set(kMouseSgr);
+                    break;
+                case 2004:
+                    set(kBracketedPaste);
+                    break;
+                default:
+                    break;
+            }
+        }
+        
+        void VtScreen::SetAlternateScreen(bool enabled, bool save_cursor) {
+            if (enabled == (active_ == &alternate_)) {
+                return;
+            }
+            if (enabled) {
+                if (save_cursor) {
+                    saved_primary_cursor_ = cursor_;
+                }
+                active_ = &alternate_;
+                for (Row& row : alternate_) {
+                    std::fill(row.begin(), row.end(), VtCell());
+                }
+                modes_ |= kAlternateScreen;
+            } else {
+                active_ = &primary_;
+                if (save_cursor) {
+                    cursor_ = saved_primary_cursor_;
+                }
+                modes_ &= ~kAlternateScreen;
+            }
+            MarkAllDirty();
+        }
+        
+        void VtScreen::SelectGraphicRendition(const uint16_t* params, size_t count, uint32_t subparams) {
+            VtCell& pen = cursor_.pen;
+            if (count == 0) {
+                pen = VtCell();
+                return;
+            }
+            
+            auto is_subparam = [&](size_t index) {
+                return index < count && (subparams & (1u << index)) != 0;
+            };
+            
+            for (size_t i = 0; i < count; ++i) {
+                uint16_t code = params[i];
+                
+                // Number of ':' sub-parameters attached to this one
+                size_t attached = 0;
+                while (is_subparam(i + 1 + attached)) {
+                    ++attached;
+                }
+                
+                if (code == 38 || code == 48 || code == 58) {
+                    uint32_t color = 0;
+                    bool valid = false;
+                    const uint16_t* rest = params + i + 1;
+                    size_t available = attached > 0 ? attached : count - i - 1;
+                    size_t consumed = 0;
+                    if (available >= 2 && rest[0] == 5) {
+                        color = kColorPalette | (rest[1] & 0xff);
+                        valid = true;
+                        consumed = 2;
+                    } else if (available >= 4 && rest[0] == 2) {
+                        // 38:2:<colorspace>:r:g:b carries an extra field
+                        size_t offset = (attached >= 5) ? 2 : 1;
+                        color = kColorRgb | ((rest[offset] & 0xff) << 16) |
+                                ((rest[offset + 1] & 0xff) << 8) | (rest[offset + 2] & 0xff);
+                        valid = true;
+                        consumed = offset + 3;
+                    }
+                    if (valid && code == 38) {
+                        pen.fg = color;
+                    } else if (valid && code == 48) {
+                        pen.bg = color;
+                    }
+                    i += attached > 0 ? attached : std::min(consumed, available);
+                    continue;
+                }
+                
+                switch (code) {
+                    case 0:
+                        pen = VtCell();
+                        break;
+                    case 1:
+                        pen.flags |= kBold;
+                        break;
+                    case 2:
+                        pen.flags |= kDim;
+                        break;
+                    case 3:
+                        pen.flags |= kItalic;
+                        break;
+                    case 4:
+                        // 4:0 turns underline off; other styles render as underline
+                        if (attached > 0 && params[i + 1] == 0) {
+                            pen.flags &= ~kUnderline;
+                        } else {
+                            pen.flags |= kUnderline;
+                        }
+                        break;
+                    case 5:
+                    case 6:
+                        pen.flags |= kBlink;
+                        break;
+                    case 7:
+                        pen.flags |= kInverse;
+                        break;
+                    case 8:
+                        pen.flags |= kHidden;
+                        break;
+                    case 9:
+                        pen.flags |= kStrikethrough;
+                        break;
+                    case 21:
+                        pen.flags |= kUnderline;
+                        break;
+                    case 22:
+                        pen.flags &= ~(kBold | kDim);
+                        break;
+                    case 23:
+                        pen.flags &= ~kItalic;
+                        break;
+                    case 24:
+                        pen.flags &= ~kUnderline;
+                        break;
+                    case 25:
+                        pen.flags &= ~kBlink;
+                        break;
+                    case 27:
+                        pen.flags &= ~kInverse;
+                        break;
+                    case 28:
+                        pen.flags &= ~kHidden;
+                        break;
+                    case 29:
+                        pen.flags &= ~kStrikethrough;
+                        break;
+                    case 39:
+                        pen.fg = 0;
+                        break;
+                    case 49:
+                        pen.bg = 0;
+                        break;
+                    default:
+                        if (code >= 30 && code <= 37) {
+                            pen.fg = kColorPalette | (code - 30);
+                        } else if (code >= 40 && code <= 47) {
+                            pen.bg = kColorPalette | (code - 40);
+                        } else if (code >= 90 && code <= 97) {
+                            pen.fg = kColorPalette | (code - 90 + 8);
+                        } else if (code >= 100 && code <= 107) {
+                            pen.bg = kColorPalette | (code - 100 + 8);
+                        }
+                        break;
+                }
+                i += attached;
+            }
+        }
+        
+        void VtScreen::OscDispatch(const std::string& data) {
+            size_t separator = data.find(';');
+            if (separator == std::string::npos) {
+                return;
+            }
+            std::string command = data.substr(0, separator);
+            if (command == "0" || command == "2") {
+                title_ = data.substr(separator + 1);
+                title_changed_ = true;
+                changed_ = true;
+            }
+        }
+        
+        void VtScreen::FullReset() {
+            for (Grid* grid : {&primary_, &alternate_}) {
+                for (Row& row : *grid) {
+                    std::fill(row.begin(), row.end(), VtCell());
+                }
+            }
+            active_ = &primary_;
+            cursor_ = Cursor();
+            saved_cursor_ = Cursor();
+            saved_primary_cursor_ = Cursor();
+            scroll_top_ = 0;
+            scroll_bottom_ = rows_ - 1;
+            autowrap_ = true;
+            insert_mode_ = false;
+            modes_ = kCursorVisible;
+            for (int col = 0; col < cols_; ++col) {
+                tab_stops_[col] = (col % kTabWidth) == 0;
+            }
+            MarkAllDirty();
+        }
+        
+    }
+}
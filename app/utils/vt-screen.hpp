@@ -0,0 +1,191 @@
+#pragma once
+#include "vt-parser.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace MikoIDE {
+    namespace Utils {
+        
+        // One character cell. Colors are 0 for the default color,
+        // kColorPalette | index for the 256-color palette, or
+        // kColorRgb | 0xRRGGBB for direct color.
+        struct VtCell {
+            uint32_t codepoint = ' ';
+            uint32_t fg = 0;
+            uint32_t bg = 0;
+            uint16_t flags = 0;
+            
+            bool operator==(const VtCell& other) const {
+                return codepoint == other.codepoint && fg == other.fg &&
+                       bg == other.bg && flags == other.flags;
+            }
+            bool operator!=(const VtCell& other) const { return !(*this == other); }
+        };
+        
+        class Scrollback;
+        
+        // Screen model driven by VtParser: a grid of cells with cursor,
+        // attributes, scroll region, tab stops and the alternate screen.
+        // Changes are tracked per row and encoded as cell runs by EncodeDiff.
+        // Not thread-safe; the owner serializes Feed and EncodeDiff.
+        class VtScreen : private VtHandler {
+        public:
+            static constexpr uint32_t kColorPalette = 0x01000000;
+            static constexpr uint32_t kColorRgb = 0x02000000;
+            
+            enum CellFlags : uint16_t {
+                kBold = 1 << 0,
+                kDim = 1 << 1,
+                kItalic = 1 << 2,
+                kUnderline = 1 << 3,
+                kBlink = 1 << 4,
+                kInverse = 1 << 5,
+                kHidden = 1 << 6,
+                kStrikethrough = 1 << 7,
+                kWide = 1 << 8,             // first half of a double-width character
+                kWideContinuation = 1 << 9  // second half; codepoint is 0
+            };
+            
+            // Terminal modes the renderer needs to encode input
+            enum Modes : uint32_t {
+                kCursorVisible = 1 << 0,
+                kAlternateScreen = 1 << 1,
+                kApplicationCursor = 1 << 2,
+                kApplicationKeypad = 1 << 3,
+                kBracketedPaste = 1 << 4,
+                kFocusEvents = 1 << 5,
+                kMouseClick = 1 << 6,       // 1000
+                kMouseDrag = 1 << 7,        // 1002
+                kMouseMotion = 1 << 8,      // 1003
+                kMouseSgr = 1 << 9          // 1006
+            };
+            
+            VtScreen(int cols, int rows);
+            
+            void Feed(const char* data, size_t size);
+            void Resize(int cols, int rows);
+            
+            // Lines scrolled off the top of the primary screen go here
+            void SetScrollback(Scrollback* scrollback) { scrollback_ = scrollback; }
+            
+            // Replies the application asked for (DA, DSR); write back to the PTY
+            std::string TakeResponses();
+            
+            bool HasChanges() const { return changed_; }
+            
+            // Encodes the rows changed since the previous call, or the whole
+            // screen when |full| is set, as one or more records of at most
+            // roughly |max_record_size| bytes. Each record stands alone and is
+            // little-endian:
+            //   u16 cols, u16 rows, u16 cursorCol, u16 cursorRow, u32 modes,
+            //   u16 titleLength, title (UTF-8, only when changed), u32 runCount,
+            //   runs: u16 row, u16 col, u16 length, u32 fg, u32 bg, u16 flags,
+            //         length x u32 codepoint
+            // A run covers consecutive cells of one row sharing a style.
+            void EncodeDiff(std::vector<std::string>& records, size_t max_record_size, bool full = false);
+            
+            int GetCols() const { return cols_; }
+            int GetRows() const { return rows_; }
+            int GetCursorCol() const { return cursor_.col; }
+            int GetCursorRow() const { return cursor_.row; }
+            uint32_t GetModes() const { return modes_; }
+            const std::string& GetTitle() const { return title_; }
+            const VtCell& GetCell(int col, int row) const { return (*active_)[row][col]; }
+            
+            // Appends the row's characters as UTF-8, trailing blanks trimmed
+            void AppendRowText(int row, std::string& out) const;
+            
+            // Appends escape sequences that rebuild this screen on a blank
+            // terminal of the same size: up to |scrollback_lines| lines of
+            // scrollback and the primary screen printed line by line, so they
+            // scroll into the other terminal's scrollback, then the alternate
+            // screen if active, the scroll region, modes, cursor, pen and title
+            void EncodeSnapshot(std::string& out, size_t scrollback_lines) const;
+            
+            // SGR sequence that sets exactly this style
+            static void AppendSgr(uint32_t fg, uint32_t bg, uint16_t flags, std::string& out);
+            
+        private:
+            using Row = std::vector<VtCell>;
+            using Grid = std::vector<Row>;
+            
+            struct Cursor {
+                int col = 0;
+                int row = 0;
+                VtCell pen;
+                bool origin_mode = false;
+                bool line_drawing = false;
+                bool pending_wrap = false;
+            };
+            
+            // VtHandler
+            void Print(uint32_t codepoint) override;
+            void Execute(uint8_t control) override;
+            void EscDispatch(const std::string& intermediates, uint8_t final) override;
+            void CsiDispatch(uint8_t prefix, const uint16_t* params, size_t count,
+                             uint32_t subparams, const std::string& intermediates,
+                             uint8_t final) override;
+            void OscDispatch(const std::string& data) override;
+            
+            void SetPrivateMode(uint16_t mode, bool enabled);
+            void SelectGraphicRendition(const uint16_t* params, size_t count, uint32_t subparams);
+            void SetAlternateScreen(bool enabled, bool save_cursor);
+            void FullReset();
+            
+            void LineFeed();
+            void ReverseLineFeed();
+            // |save| keeps lines leaving the top of the primary screen
+            void ScrollUp(int top, int bottom, int lines, bool save = false);
+            void ScrollDown(int top, int bottom, int lines);
+            void MoveTo(int col, int row);
+            void EraseCells(int row, int from, int to);
+            void BreakWideCharacter(int row, int col);
+            void InsertCells(int count);
+            void DeleteCells(int count);
+            VtCell BlankCell() const;
+            
+            void MarkDirty(int row);
+            void MarkAllDirty();
+            
+            // |style| holds the SGR last emitted and is updated
+            void AppendRowSnapshot(const Row& cells, VtCell& style, std::string& out) const;
+            
+            VtParser parser_;
+            Scrollback* scrollback_;
+            int cols_;
+            int rows_;
+            
+            Grid primary_;
+            Grid alternate_;
+            Grid* active_;
+            Grid shadow_;               // last encoded state of the active grid
+            std::vector<uint8_t> dirty_;
+            bool changed_;
+            bool needs_full_;           // after a resize the renderer reallocates
+            int encoded_col_;
+            int encoded_row_;
+            uint32_t encoded_modes_;
+            
+            Cursor cursor_;
+            Cursor saved_cursor_;
+            Cursor saved_primary_cursor_;
+            int scroll_top_;
+            int scroll_bottom_;
+            bool autowrap_;
+            bool insert_mode_;
+            std::vector<uint8_t> tab_stops_;
+            uint32_t modes_;
+            uint32_t last_printed_;
+            
+            std::string title_;
+            bool title_changed_;
+            std::string responses_;
+        };
+        
+        // Display width of a codepoint: 0 for combining marks, 2 for East
+        // Asian wide and fullwidth characters, 1 otherwise
+        int VtCharWidth(uint32_t codepoint);
+        
+    }
+}
@@ -0,0 +1,130 @@
+// Throughput of diagnostic extraction over build output: DiagnosticMatcher
+// fed in PTY-sized chunks, against splitting into lines and running a
+// std::regex per line, which is what the frontend did before.
+//
+//   diagnostic-benchmark [MiB] [build log]
+//
+// Without a log, a synthetic one is generated: colored make/ninja progress
+// lines with one gcc, MSVC or tsc diagnostic per ~200 lines. Both sides
+// report how many diagnostics they found.
+#include "../app/utils/diagnostic-matcher.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <regex>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+using namespace MikoIDE::Utils;
+
+namespace {
+    constexpr size_t kChunkSize = 64 * 1024;
+    
+    std::string GenerateLog(size_t size) {
+        std::string log;
+        log.reserve(size + 256);
+        char line[256];
+        for (unsigned i = 0; log.size() < size; ++i) {
+            switch (i % 200) {
+                case 50:
+                    snprintf(line, sizeof(line),
+                             "\x1b[01m\x1b[Ksrc/module%u/file.cpp:%u:%u:\x1b[m\x1b[K \x1b[01;35m\x1b[Kwarning: "
+                             "\x1b[m\x1b[Kunused variable 'x' [-Wunused-variable]\n", i % 97, i % 500 + 1, i % 40 + 1);
+                    break;
+                case 120:
+                    snprintf(line, sizeof(line), "C:\\src\\module%u\\file.cpp(%u): error C2065: 'y': undeclared identifier\r\n",
+                             i % 97, i % 500 + 1);
+                    break;
+                case 170:
+                    snprintf(line, sizeof(line), "src/view%u.ts(%u,%u): error TS2322: Type 'string' is not assignable to type 'number'.\n",
+                             i % 97, i % 500 + 1, i % 40 + 1);
+                    break;
+                default:
+                    snprintf(line, sizeof(line), "[%3u/%u] Building CXX object src/module%u/CMakeFiles/module.dir/source%u.cpp.o\n",
+                             i % 1000, 1000, i % 97, i);
+                    break;
+            }
+            log += line;
+        }
+        return log;
+    }
+    
+    size_t RunMatcher(const std::string& log) {
+        DiagnosticMatcher matcher;
+        std::vector<Diagnostic> found;
+        size_t count = 0;
+        for (size_t offset = 0; offset < log.size(); offset += kChunkSize) {
+            matcher.Feed(log.data() + offset, std::min(kChunkSize, log.size() - offset), found);
+            count += found.size();
+            found.clear();
+        }
+        matcher.Finish(found);
+        return count + found.size();
+    }
+    
+    size_t RunRegex(const std::string& log) {
+        static const std::regex pattern(
+            R"(^\s*(.+?)(?::(\d+)(?::(\d+))?|\((\d+)(?:,(\d+))?\))\s*(?::| -)\s*(fatal error|error|warning|note)\b\s*([A-Za-z]*\d+)?:\s*(.*)$)");
+        size_t count = 0;
+        std::string line;
+        size_t begin = 0;
+        while (begin < log.size()) {
+            size_t end = log.find('\n', begin);
+            if (end == std::string::npos) {
+                end = log.size();
+            }
+            
+            // Escapes are stripped first, as the frontend has to
+            line.clear();
+            for (size_t i = begin; i < end; ++i) {
+                if (log[i] == '\x1b' && i + 1 < end && log[i + 1] == '[') {
+                    i += 2;
+                    while (i < end && !(log[i] >= 0x40 && log[i] <= 0x7e)) {
+                        ++i;
+                    }
+                } else if (log[i] != '\r') {
+                    line.push_back(log[i]);
+                }
+            }
+            if (std::regex_search(line, pattern)) {
+                ++count;
+            }
+            begin = end + 1;
+        }
+        return count;
+    }
+    
+    template <typename Run>
+    void Measure(const char* name, const std::string& log, Run run) {
+        const auto start = Clock::now();
+        const size_t count = run(log);
+        const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        printf("%-8s %10.1f MB/s  %8.1f ms  %zu diagnostics\n",
+               name, log.size() / seconds / 1e6, seconds * 1000.0, count);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    const size_t mebibytes = argc > 1 ? static_cast<size_t>(std::max(1, atoi(argv[1]))) : 64;
+    
+    std::string log;
+    if (argc > 2) {
+        std::ifstream file(argv[2], std::ios::binary);
+        if (!file) {
+            fprintf(stderr, "diagnostic-benchmark: cannot read %s\n", argv[2]);
+            return 1;
+        }
+        log.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    } else {
+        log = GenerateLog(mebibytes * 1024 * 1024);
+    }
+    printf("%zu bytes of build output\n", log.size());
+    
+    Measure("matcher", log, RunMatcher);
+    Measure("regex", log, RunRegex);
+    return 0;
+}
@@ -0,0 +1,120 @@
+// Compares serving the UI bundle from loose files against the mapped pack.
+//
+//   pack-benchmark <dist dir> <app.pak> [iterations]
+//
+// Each iteration looks up and reads every file once: open+read+close for
+// loose files, Find+memcpy for the pack. Both sides copy into the same
+// buffer so the difference is lookup and syscall cost.
+#include "../app/resources/resource-pack.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+    struct Result {
+        double total_ms = 0.0;
+        double per_lookup_ns = 0.0;
+        size_t bytes = 0;
+    };
+    
+    void Report(const char* name, const Result& result) {
+        printf("%-12s %10.2f ms  %10.1f ns/file  %zu bytes\n",
+               name, result.total_ms, result.per_lookup_ns, result.bytes);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: pack-benchmark <dist dir> <app.pak> [iterations]\n");
+        return 2;
+    }
+    
+    const fs::path root = argv[1];
+    const int iterations = argc > 3 ? std::max(1, atoi(argv[3])) : 1000;
+    
+    std::vector<std::string> names;
+    size_t largest = 0;
+    for (const auto& item : fs::recursive_directory_iterator(root)) {
+        if (item.is_regular_file() && item.path().extension() != ".gz" && item.path().extension() != ".br") {
+            names.push_back(fs::relative(item.path(), root).generic_string());
+            largest = std::max<size_t>(largest, item.file_size());
+        }
+    }
+    if (names.empty()) {
+        fprintf(stderr, "pack-benchmark: no files under %s\n", root.string().c_str());
+        return 1;
+    }
+    
+    MikoIDE::Resources::ResourcePack pack;
+    if (!pack.Open(argv[2])) {
+        fprintf(stderr, "pack-benchmark: %s\n", pack.GetLastError().c_str());
+        return 1;
+    }
+    
+    std::vector<char> buffer(largest + 1);
+    std::vector<std::string> paths;
+    for (const std::string& name : names) {
+        paths.push_back((root / name).string());
+    }
+    const double lookups = static_cast<double>(iterations) * names.size();
+    
+    Result loose;
+    auto start = Clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        for (const std::string& path : paths) {
+            FILE* file = fopen(path.c_str(), "rb");
+            if (!file) {
+                fprintf(stderr, "pack-benchmark: cannot open %s\n", path.c_str());
+                return 1;
+            }
+            loose.bytes += fread(buffer.data(), 1, buffer.size(), file);
+            fclose(file);
+        }
+    }
+    loose.total_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    loose.per_lookup_ns = loose.total_ms * 1e6 / lookups;
+    
+    Result packed;
+    MikoIDE::Resources::PackResource resource;
+    start = Clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        for (const std::string& name : names) {
+            if (!pack.Find(name, resource)) {
+                fprintf(stderr, "pack-benchmark: %s is not in the pack\n", name.c_str());
+                return 1;
+            }
+            memcpy(buffer.data(), resource.data(), resource.size());
+            packed.bytes += resource.size();
+        }
+    }
+    packed.total_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    packed.per_lookup_ns = packed.total_ms * 1e6 / lookups;
+    
+    // Lookup alone, without touching payload pages
+    Result lookup;
+    start = Clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        for (const std::string& name : names) {
+            lookup.bytes += pack.Find(name, resource) ? resource.size() : 0;
+        }
+    }
+    lookup.total_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    lookup.per_lookup_ns = lookup.total_ms * 1e6 / lookups;
+    
+    printf("%zu files x %d iterations\n", names.size(), iterations);
+    Report("loose", loose);
+    Report("pack", packed);
+    Report("pack-find", lookup);
+    if (loose.bytes != packed.bytes) {
+        fprintf(stderr, "pack-benchmark: byte count mismatch (%zu vs %zu)\n", loose.bytes, packed.bytes);
+        return 1;
+    }
+    return 0;
+}
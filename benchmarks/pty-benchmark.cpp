@@ -0,0 +1,567 @@
+// Terminal throughput and keystroke latency from recorded PTY sessions.
+//
+//   pty-benchmark record <capture> <command>
+//   pty-benchmark replay <capture> [--timed] [--screen] [--repeat N]
+//
+// record runs |command| under a PTY and saves everything it writes with
+// timestamps; from a terminal it is interactive, so TUI apps can be driven.
+// replay starts this binary again as a fake child through TerminalManager,
+// which plays the capture into its PTY at full speed or, with --timed, at
+// the recorded pace. Meanwhile a keystroke goes in every 5 ms and the child
+// answers each read with a title escape, so echo latency is measured through
+// the same reactor, flow control and, with --screen, VtScreen path as the
+// output. Reports MB/s, chunks/s, echo latency percentiles and peak RSS.
+//
+// Capture format, little-endian: "MIKOPTY1", u16 cols, u16 rows, then
+// records of u64 nanoseconds since start, u32 length, length bytes.
+// POSIX only.
+#include "../app/utils/latency-histogram.hpp"
+#include "../app/utils/spawn-helper.hpp"
+#include "../app/utils/terminal.hpp"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <poll.h>
+#include <pty.h>
+#include <string>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <termios.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+using namespace MikoIDE::Utils;
+
+namespace {
+    const char kMagic[8] = {'M', 'I', 'K', 'O', 'P', 'T', 'Y', '1'};
+    const char kTitlePrefix[] = "\x1b]2;miko-bench ";
+    const size_t kTitlePrefixSize = sizeof(kTitlePrefix) - 1;
+    const auto kKeystrokeInterval = std::chrono::milliseconds(5);
+    
+    struct Chunk {
+        uint64_t time;      // nanoseconds since the recording started
+        uint64_t offset;    // into Capture::data
+        uint32_t size;
+    };
+    
+    struct Capture {
+        uint16_t cols = 80;
+        uint16_t rows = 24;
+        std::vector<Chunk> chunks;
+        std::string data;   // empty unless loaded with data
+        uint64_t bytes = 0;
+    };
+    
+    uint64_t Nanoseconds(Clock::time_point from, Clock::time_point to) {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count());
+    }
+    
+    bool WriteFully(int fd, const char* data, size_t size) {
+        while (size > 0) {
+            ssize_t written = write(fd, data, size);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            data += written;
+            size -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+    
+    uint64_t LoadLittleEndian(const unsigned char* bytes, size_t size) {
+        uint64_t value = 0;
+        for (size_t i = 0; i < size; ++i) {
+            value |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+        }
+        return value;
+    }
+    
+    void AppendLittleEndian(std::string& out, uint64_t value, size_t size) {
+        for (size_t i = 0; i < size; ++i) {
+            out.push_back(static_cast<char>(value >> (8 * i)));
+        }
+    }
+    
+    // Without |withData| only the chunk index is kept, so the measuring
+    // process does not carry the capture in its RSS
+    bool LoadCapture(const char* path, bool withData, Capture& capture) {
+        FILE* file = fopen(path, "rb");
+        if (!file) {
+            perror(path);
+            return false;
+        }
+        
+        unsigned char header[12];
+        bool ok = fread(header, 1, sizeof(header), file) == sizeof(header) &&
+                  memcmp(header, kMagic, sizeof(kMagic)) == 0;
+        if (ok) {
+            capture.cols = static_cast<uint16_t>(LoadLittleEndian(header + 8, 2));
+            capture.rows = static_cast<uint16_t>(LoadLittleEndian(header + 10, 2));
+        }
+        
+        unsigned char record[12];
+        while (ok && fread(record, 1, sizeof(record), file) == sizeof(record)) {
+            Chunk chunk;
+            chunk.time = LoadLittleEndian(record, 8);
+            chunk.size = static_cast<uint32_t>(LoadLittleEndian(record + 8, 4));
+            chunk.offset = capture.bytes;
+            if (withData) {
+                capture.data.resize(capture.bytes + chunk.size);
+                ok = fread(&capture.data[capture.bytes], 1, chunk.size, file) == chunk.size;
+            } else {
+                ok = fseek(file, chunk.size, SEEK_CUR) == 0;
+            }
+            capture.bytes += chunk.size;
+            capture.chunks.push_back(chunk);
+        }
+        fclose(file);
+        
+        if (!ok) {
+            fprintf(stderr, "pty-benchmark: %s is not a complete capture\n", path);
+        }
+        return ok;
+    }
+    
+    int Record(const char* path, const std::string& command) {
+        FILE* file = fopen(path, "wb");
+        if (!file) {
+            perror(path);
+            return 1;
+        }
+        
+        const bool interactive = isatty(STDIN_FILENO);
+        struct winsize size = {};
+        if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) != 0 || size.ws_col == 0) {
+            size.ws_col = 120;
+            size.ws_row = 40;
+        }
+        
+        int master;
+        int slave;
+        if (openpty(&master, &slave, nullptr, nullptr, &size) == -1) {
+            perror("pty-benchmark: openpty");
+            return 1;
+        }
+        fcntl(master, F_SETFD, FD_CLOEXEC);
+        fcntl(slave, F_SETFD, FD_CLOEXEC);
+        
+        pid_t pid = SpawnHelper::ForkChild(command, "", slave);
+        close(slave);
+        if (pid < 0) {
+            perror("pty-benchmark: fork");
+            return 1;
+        }
+        
+        // Keys go to the child untouched, as they would from a terminal
+        struct termios saved;
+        if (interactive) {
+            tcgetattr(STDIN_FILENO, &saved);
+            struct termios raw = saved;
+            cfmakeraw(&raw);
+            tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+        }
+        
+        std::string header(kMagic, sizeof(kMagic));
+        AppendLittleEndian(header, size.ws_col, 2);
+        AppendLittleEndian(header, size.ws_row, 2);
+        fwrite(header.data(), 1, header.size(), file);
+        
+        const Clock::time_point start = Clock::now();
+        std::vector<char> buffer(64 * 1024);
+        std::string record;
+        uint64_t bytes = 0;
+        uint64_t chunks = 0;
+        pollfd fds[2] = {{master, POLLIN, 0}, {STDIN_FILENO, POLLIN, 0}};
+        for (;;) {
+            if (poll(fds, interactive ? 2 : 1, -1) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+            if (fds[1].revents & POLLIN) {
+                ssize_t keys = read(STDIN_FILENO, buffer.data(), buffer.size());
+                if (keys > 0) {
+                    WriteFully(master, buffer.data(), static_cast<size_t>(keys));
+                }
+            }
+            if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+                // EOF, or EIO once the child's side is closed
+                ssize_t received = read(master, buffer.data(), buffer.size());
+                if (received <= 0) {
+                    break;
+                }
+                record.clear();
+                AppendLittleEndian(record, Nanoseconds(start, Clock::now()), 8);
+                AppendLittleEndian(record, static_cast<uint64_t>(received), 4);
+                record.append(buffer.data(), static_cast<size_t>(received));
+                fwrite(record.data(), 1, record.size(), file);
+                WriteFully(STDOUT_FILENO, buffer.data(), static_cast<size_t>(received));
+                bytes += static_cast<uint64_t>(received);
+                ++chunks;
+            }
+        }
+        const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        
+        if (interactive) {
+            tcsetattr(STDIN_FILENO, TCSANOW, &saved);
+        }
+        close(master);
+        int status = 0;
+        waitpid(pid, &status, 0);
+        const bool written = fclose(file) == 0;
+        
+        fprintf(stderr, "\r\nrecorded %.2f MB in %llu chunks over %.2f s (%ux%u), exit %d\n", bytes / 1e6,
+                static_cast<unsigned long long>(chunks), seconds, size.ws_col, size.ws_row,
+                WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+        return written ? 0 : 1;
+    }
+    
+    void SendTitle(const std::string& text) {
+        std::string title(kTitlePrefix, kTitlePrefixSize);
+        title += text;
+        title += '\a';
+        WriteFully(STDOUT_FILENO, title.data(), title.size());
+    }
+    
+    // The fake child: announces itself, waits for the start key, then plays
+    // the capture while answering every read of keys with the running count
+    int Play(const char* path, bool timed, int repeat) {
+        Capture capture;
+        if (!LoadCapture(path, true, capture)) {
+            return 1;
+        }
+        
+        struct termios raw;
+        tcgetattr(STDIN_FILENO, &raw);
+        cfmakeraw(&raw);
+        tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+        
+        uint64_t keys = 0;
+        char input[256];
+        auto drainKeys = [&](int timeout) {
+            pollfd fd = {STDIN_FILENO, POLLIN, 0};
+            while (poll(&fd, 1, timeout) > 0) {
+                ssize_t received = read(STDIN_FILENO, input, sizeof(input));
+                if (received <= 0) {
+                    return false;
+                }
+                keys += static_cast<uint64_t>(received);
+                SendTitle(std::to_string(keys));
+                timeout = 0;
+            }
+            return true;
+        };
+        
+        SendTitle("ready");
+        if (read(STDIN_FILENO, input, 1) != 1) {
+            return 1;
+        }
+        
+        const uint64_t duration = capture.chunks.empty() ? 0 : capture.chunks.back().time;
+        const Clock::time_point start = Clock::now();
+        for (int round = 0; round < repeat; ++round) {
+            for (const Chunk& chunk : capture.chunks) {
+                const Clock::time_point due = start + std::chrono::nanoseconds(round * duration + chunk.time);
+                while (timed && Clock::now() < due) {
+                    const auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(due - Clock::now());
+                    if (!drainKeys(static_cast<int>(wait.count()) + 1)) {
+                        return 1;
+                    }
+                }
+                if (!drainKeys(0) || !WriteFully(STDOUT_FILENO, capture.data.data() + chunk.offset, chunk.size)) {
+                    return 1;
+                }
+            }
+        }
+        return 0;
+    }
+    
+    // Finds the child's title escapes in a stream that may split them
+    class TitleScanner {
+    public:
+        // Calls |onTitle| with the text after the prefix
+        template <typename Callback>
+        void Scan(const char* data, size_t size, Callback&& onTitle) {
+            const char* end = data + size;
+            while (data < end) {
+                if (matched_ == 0) {
+                    data = static_cast<const char*>(memchr(data, '\x1b', static_cast<size_t>(end - data)));
+                    if (!data) {
+                        return;
+                    }
+                }
+                const char c = *data++;
+                if (matched_ < kTitlePrefixSize) {
+                    matched_ = c == kTitlePrefix[matched_] ? matched_ + 1 : (c == '\x1b' ? 1 : 0);
+                } else if (c == '\a') {
+                    onTitle(text_);
+                    text_.clear();
+                    matched_ = 0;
+                } else if (text_.size() < 32) {
+                    text_.push_back(c);
+                } else {
+                    text_.clear();
+                    matched_ = 0;
+                }
+            }
+        }
+    
+    private:
+        size_t matched_ = 0;
+        std::string text_;
+    };
+    
+    // The title in the first diff record, if it changed
+    bool ReadDiffTitle(const std::string& record, std::string& title) {
+        if (record.size() < 14) {
+            return false;
+        }
+        const size_t size = LoadLittleEndian(reinterpret_cast<const unsigned char*>(record.data()) + 12, 2);
+        if (size < kTitlePrefixSize - 4 || record.size() < 14 + size) {
+            return false;
+        }
+        title.assign(record, 14, size);
+        const std::string prefix(kTitlePrefix + 4, kTitlePrefixSize - 4);
+        if (title.compare(0, prefix.size(), prefix) != 0) {
+            return false;
+        }
+        title.erase(0, prefix.size());
+        return true;
+    }
+    
+    std::string ShellQuote(const std::string& value) {
+        std::string quoted = "'";
+        for (char c : value) {
+            if (c == '\'') {
+                quoted += "'\\''";
+            } else {
+                quoted += c;
+            }
+        }
+        return quoted + "'";
+    }
+    
+    struct ReplayState {
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool ready = false;
+        bool screen_changed = false;
+        bool exited = false;
+        Clock::time_point exit_time;
+        
+        uint64_t messages = 0;
+        uint64_t raw_bytes = 0;
+        uint64_t diffs = 0;
+        uint64_t diff_bytes = 0;
+        
+        // Keystroke i was sent at sent[i - 1]; keys up to |answered| are echoed
+        std::vector<Clock::time_point> sent;
+        uint64_t answered = 0;
+        LatencyHistogram latency;
+    };
+    
+    // Caller holds state.mutex
+    void OnTitle(ReplayState& state, const std::string& title) {
+        if (title == "ready") {
+            state.ready = true;
+            state.cv.notify_all();
+            return;
+        }
+        const uint64_t keys = strtoull(title.c_str(), nullptr, 10);
+        const Clock::time_point now = Clock::now();
+        for (; state.answered < keys && state.answered < state.sent.size(); ++state.answered) {
+            state.latency.Record(Nanoseconds(state.sent[state.answered], now));
+        }
+    }
+    
+    int Replay(const char* self, const char* path, bool timed, bool screen, int repeat) {
+        Capture capture;
+        if (!LoadCapture(path, false, capture)) {
+            return 1;
+        }
+        SpawnHelper::GetInstance().Start();
+        
+        TerminalManager& terminals = Terminal::GetInstance();
+        ReplayState state;
+        TitleScanner scanner;
+        terminals.SetGlobalOutputCallback([&](const std::string& terminalId, const TerminalMessage& message) {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            if (message.type == TerminalMessage::OUTPUT) {
+                ++state.messages;
+                state.raw_bytes += message.GetSize();
+                scanner.Scan(message.GetData(), message.GetSize(),
+                             [&](const std::string& title) { OnTitle(state, title); });
+                terminals.AcknowledgeOutput(terminalId, message.GetSize());
+            } else if (message.type == TerminalMessage::SCREEN) {
+                state.screen_changed = true;
+                state.cv.notify_all();
+            } else if (message.type == TerminalMessage::EXIT) {
+                state.exited = true;
+                state.exit_time = Clock::now();
+                state.cv.notify_all();
+            }
+        });
+        
+        const std::string command = ShellQuote(self) + " play " + ShellQuote(path) + (timed ? " 1 " : " 0 ") +
+                                    std::to_string(repeat);
+        const std::string terminalId = terminals.CreateTerminal(command);
+        if (terminalId.empty()) {
+            return 1;
+        }
+        terminals.ResizeTerminal(terminalId, capture.cols, capture.rows);
+        if (screen) {
+            terminals.EnableScreen(terminalId, capture.cols, capture.rows);
+        }
+        
+        // Diffs are taken as soon as the screen changes, like an idle
+        // renderer that keeps up with every frame
+        std::thread renderer;
+        if (screen) {
+            renderer = std::thread([&]() {
+                std::vector<std::string> records;
+                std::string title;
+                std::unique_lock<std::mutex> lock(state.mutex);
+                for (;;) {
+                    state.cv.wait(lock, [&]() { return state.screen_changed || state.exited; });
+                    const bool last = state.exited;
+                    state.screen_changed = false;
+                    lock.unlock();
+                    records.clear();
+                    const bool changed = terminals.TakeScreenDiff(terminalId, records, 256 * 1024);
+                    lock.lock();
+                    if (changed) {
+                        ++state.diffs;
+                        for (const std::string& record : records) {
+                            state.diff_bytes += record.size();
+                        }
+                        if (!records.empty() && ReadDiffTitle(records[0], title)) {
+                            OnTitle(state, title);
+                        }
+                    }
+                    if (last) {
+                        state.exit_time = Clock::now();
+                        return;
+                    }
+                }
+            });
+        }
+        
+        Clock::time_point start;
+        {
+            std::unique_lock<std::mutex> lock(state.mutex);
+            if (!state.cv.wait_for(lock, std::chrono::seconds(10), [&]() { return state.ready || state.exited; }) ||
+                !state.ready) {
+                fprintf(stderr, "pty-benchmark: the replay child did not start\n");
+                return 1;
+            }
+            state.messages = 0;
+            state.raw_bytes = 0;
+            start = Clock::now();
+        }
+        terminals.SendInput(terminalId, "s");
+        
+        for (;;) {
+            std::unique_lock<std::mutex> lock(state.mutex);
+            if (state.cv.wait_for(lock, kKeystrokeInterval, [&]() { return state.exited; })) {
+                break;
+            }
+            state.sent.push_back(Clock::now());
+            lock.unlock();
+            terminals.SendInput(terminalId, "k");
+        }
+        if (renderer.joinable()) {
+            renderer.join();
+        }
+        
+        const double seconds = std::chrono::duration<double>(state.exit_time - start).count();
+        const double megabytes = capture.bytes * repeat / 1e6;
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        
+        printf("%s, %ux%u, %s%s, %d x %.2f MB in %zu chunks\n", path, capture.cols, capture.rows,
+               timed ? "recorded timing" : "full speed", screen ? ", native screen" : "", repeat,
+               capture.bytes / 1e6, capture.chunks.size());
+        printf("throughput   %.2f s, %.1f MB/s\n", seconds, megabytes / seconds);
+        if (screen) {
+            printf("chunks       %.0f diffs/s, %.1f MB of diffs\n", state.diffs / seconds, state.diff_bytes / 1e6);
+        } else {
+            printf("chunks       %.0f messages/s, %.0f bytes each\n", state.messages / seconds,
+                   state.messages ? static_cast<double>(state.raw_bytes) / state.messages : 0.0);
+        }
+        printf("echo (us)    p50 %.1f  p90 %.1f  p99 %.1f  max %.1f  (%llu of %zu keys)\n",
+               state.latency.GetPercentile(50) / 1e3, state.latency.GetPercentile(90) / 1e3,
+               state.latency.GetPercentile(99) / 1e3, state.latency.GetMax() / 1e3,
+               static_cast<unsigned long long>(state.latency.GetCount()), state.sent.size());
+        printf("peak RSS     %.1f MiB\n", usage.ru_maxrss / 1024.0);
+        
+        terminals.CloseTerminal(terminalId);
+        SpawnHelper::GetInstance().Stop();
+        return 0;
+    }
+    
+    int Usage() {
+        fprintf(stderr, "usage: pty-benchmark record <capture> <command>\n"
+                        "       pty-benchmark replay <capture> [--timed] [--screen] [--repeat N]\n");
+        return 2;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        return Usage();
+    }
+    const std::string mode = argv[1];
+    
+    if (mode == "record" && argc >= 4) {
+        std::string command = argv[3];
+        for (int i = 4; i < argc; ++i) {
+            command += ' ';
+            command += argv[i];
+        }
+        return Record(argv[2], command);
+    }
+    
+    if (mode == "play" && argc == 5) {
+        return Play(argv[2], atoi(argv[3]) != 0, atoi(argv[4]));
+    }
+    
+    if (mode == "replay") {
+        bool timed = false;
+        bool screen = false;
+        int repeat = 1;
+        for (int i = 3; i < argc; ++i) {
+            const std::string option = argv[i];
+            if (option == "--timed") {
+                timed = true;
+            } else if (option == "--screen") {
+                screen = true;
+            } else if (option == "--repeat" && i + 1 < argc) {
+                repeat = std::max(1, atoi(argv[++i]));
+            } else {
+                return Usage();
+            }
+        }
+        
+        // The fake child is this binary, found again by absolute path
+        char self[4096];
+        ssize_t length = readlink("/proc/self/exe", self, sizeof(self) - 1);
+        if (length <= 0) {
+            perror("pty-benchmark: /proc/self/exe");
+            return 1;
+        }
+        self[length] = '\0';
+        return Replay(self, argv[2], timed, screen, repeat);
+    }
+    return Usage();
+}
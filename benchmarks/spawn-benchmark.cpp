@@ -0,0 +1,136 @@
+// Terminal spawn latency: fork() from a large, threaded process, which is
+// how terminals used to start, against a request to SpawnHelper, which
+// starts the child from a small helper forked before the heap grew.
+//
+//   spawn-benchmark [ballast MiB] [threads] [spawns]
+//
+// The helper is started first, then the ballast is allocated and touched
+// and idle threads are parked, like the browser after CefInitialize. Each
+// spawn runs `exit 0` on a fresh PTY; "spawn" is the time until the pid is
+// known and "exit" until its exit code is. POSIX only.
+#include "../app/utils/latency-histogram.hpp"
+#include "../app/utils/spawn-helper.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <future>
+#include <mutex>
+#include <pty.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+using MikoIDE::Utils::LatencyHistogram;
+using MikoIDE::Utils::SpawnHelper;
+
+namespace {
+    struct Timings {
+        LatencyHistogram spawn;
+        LatencyHistogram exit;
+    };
+    
+    uint64_t Nanoseconds(Clock::time_point from, Clock::time_point to) {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count());
+    }
+    
+    bool SpawnOnce(bool viaHelper, Timings& timings) {
+        int master;
+        int slave;
+        if (openpty(&master, &slave, nullptr, nullptr, nullptr) == -1) {
+            perror("spawn-benchmark: openpty");
+            return false;
+        }
+        fcntl(master, F_SETFD, FD_CLOEXEC);
+        fcntl(slave, F_SETFD, FD_CLOEXEC);
+        
+        const Clock::time_point start = Clock::now();
+        pid_t pid = viaHelper ? SpawnHelper::GetInstance().Spawn("exit 0", "", slave)
+                              : SpawnHelper::ForkChild("exit 0", "", slave);
+        const Clock::time_point spawned = Clock::now();
+        close(slave);
+        if (pid < 0) {
+            fprintf(stderr, "spawn-benchmark: spawn failed\n");
+            close(master);
+            return false;
+        }
+        
+        // Drain until the child's side of the PTY closes
+        char buffer[256];
+        while (read(master, buffer, sizeof(buffer)) > 0) {
+        }
+        std::promise<int> exited;
+        SpawnHelper::GetInstance().WatchExit(pid, [&exited](int exitCode) { exited.set_value(exitCode); });
+        const int exitCode = exited.get_future().get();
+        const Clock::time_point done = Clock::now();
+        close(master);
+        
+        if (exitCode != 0) {
+            fprintf(stderr, "spawn-benchmark: child exited with %d\n", exitCode);
+            return false;
+        }
+        timings.spawn.Record(Nanoseconds(start, spawned));
+        timings.exit.Record(Nanoseconds(start, done));
+        return true;
+    }
+    
+    void Print(const char* name, const Timings& timings) {
+        printf("%-12s %10.1f %10.1f %10.1f %10.1f\n", name,
+               timings.spawn.GetPercentile(50) / 1e3, timings.spawn.GetPercentile(99) / 1e3,
+               timings.exit.GetPercentile(50) / 1e3, timings.exit.GetPercentile(99) / 1e3);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    size_t ballastMiB = argc > 1 ? static_cast<size_t>(atoi(argv[1])) : 2048;
+    int threadCount = argc > 2 ? atoi(argv[2]) : 32;
+    int spawns = argc > 3 ? atoi(argv[3]) : 200;
+    
+    if (!SpawnHelper::GetInstance().Start()) {
+        return 1;
+    }
+    
+    std::vector<char> ballast(ballastMiB << 20);
+    for (size_t i = 0; i < ballast.size(); i += 4096) {
+        ballast[i] = static_cast<char>(i);
+    }
+    
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stop = false;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < threadCount; ++i) {
+        threads.emplace_back([&]() {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&]() { return stop; });
+        });
+    }
+    
+    printf("%zu MiB ballast, %d threads, %d spawns\n", ballastMiB, threadCount, spawns);
+    printf("%-12s %10s %10s %10s %10s  (us)\n", "path", "spawn p50", "spawn p99", "exit p50", "exit p99");
+    
+    Timings forked;
+    Timings helper;
+    for (int i = 0; i < spawns; ++i) {
+        // Interleaved so both paths see the same machine state
+        if (!SpawnOnce(false, forked) || !SpawnOnce(true, helper)) {
+            return 1;
+        }
+    }
+    Print("fork", forked);
+    Print("helper", helper);
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    cv.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    SpawnHelper::GetInstance().Stop();
+    return 0;
+}
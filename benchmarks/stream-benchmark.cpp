@@ -0,0 +1,220 @@
+// Sustained browser->renderer streaming throughput: the shared-memory ring
+// with a one-byte doorbell against framed messages over a socketpair, which
+// is how a serialized process message crosses the process boundary.
+//
+//   stream-benchmark [total MiB] [chunk KiB...]
+//
+// The consumer runs in a forked child and checksums every byte so neither
+// side can skip work. POSIX only.
+#include "../app/utils/shared-ring.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+    constexpr uint32_t kEndOfStream = 0xffffffffu;
+    
+    uint64_t Checksum(const uint8_t* data, size_t size, uint64_t sum) {
+        for (size_t i = 0; i < size; ++i) {
+            sum = sum * 31 + data[i];
+        }
+        return sum;
+    }
+    
+    bool ReadFully(int fd, void* buffer, size_t size) {
+        uint8_t* out = static_cast<uint8_t*>(buffer);
+        while (size > 0) {
+            ssize_t n = read(fd, out, size);
+            if (n <= 0) {
+                return false;
+            }
+            out += n;
+            size -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+    
+    bool WriteFully(int fd, const void* buffer, size_t size) {
+        const uint8_t* in = static_cast<const uint8_t*>(buffer);
+        while (size > 0) {
+            ssize_t n = write(fd, in, size);
+            if (n <= 0) {
+                return false;
+            }
+            in += n;
+            size -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+    
+    struct Result {
+        double seconds = 0.0;
+        uint64_t checksum = 0;
+    };
+    
+    // Doorbell and "drained" notifications are single bytes on pipes, standing
+    // in for the tiny process messages the host sends
+    bool RunRing(const std::vector<uint8_t>& payload, size_t total, size_t chunk, Result& result) {
+        std::string name = "miko-bench-" + std::to_string(getpid());
+        MikoIDE::Utils::SharedRing producer;
+        if (!producer.Create(name, 4 << 20)) {
+            fprintf(stderr, "stream-benchmark: %s\n", producer.GetLastError().c_str());
+            return false;
+        }
+        
+        int doorbell[2];
+        int drained[2];
+        int reply[2];
+        if (pipe(doorbell) != 0 || pipe(drained) != 0 || pipe(reply) != 0) {
+            return false;
+        }
+        
+        pid_t child = fork();
+        if (child == 0) {
+            MikoIDE::Utils::SharedRing consumer;
+            if (!consumer.Open(name)) {
+                _exit(1);
+            }
+            
+            uint64_t sum = 0;
+            bool done = false;
+            char byte;
+            while (!done && ReadFully(doorbell[0], &byte, 1)) {
+                consumer.ResetDoorbell();
+                MikoIDE::Utils::SharedRing::Record record;
+                while (consumer.Peek(record)) {
+                    if (record.stream == kEndOfStream) {
+                        done = true;
+                    } else {
+                        sum = Checksum(record.data, record.size, sum);
+                    }
+                    consumer.Release(record);
+                }
+                if (consumer.TakeProducerBlocked()) {
+                    WriteFully(drained[1], "d", 1);
+                }
+            }
+            WriteFully(reply[1], &sum, sizeof(sum));
+            _exit(0);
+        }
+        
+        auto start = Clock::now();
+        for (size_t sent = 0; sent <= total; sent += chunk) {
+            bool last = sent >= total;
+            const void* data = last ? nullptr : payload.data() + (sent % (payload.size() - chunk));
+            size_t size = last ? 0 : chunk;
+            uint32_t stream = last ? kEndOfStream : 1;
+            
+            while (!producer.Write(stream, data, size)) {
+                char byte;
+                ReadFully(drained[0], &byte, 1);
+            }
+            if (producer.TakeDoorbell()) {
+                WriteFully(doorbell[1], "r", 1);
+            }
+        }
+        
+        ReadFully(reply[0], &result.checksum, sizeof(result.checksum));
+        result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        waitpid(child, nullptr, 0);
+        
+        for (int fd : {doorbell[0], doorbell[1], drained[0], drained[1], reply[0], reply[1]}) {
+            close(fd);
+        }
+        return true;
+    }
+    
+    // Each message is serialized into a fresh buffer on send and deserialized
+    // into another on receive, as with a binary process message argument
+    bool RunSocket(const std::vector<uint8_t>& payload, size_t total, size_t chunk, Result& result) {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+            return false;
+        }
+        
+        pid_t child = fork();
+        if (child == 0) {
+            close(fds[0]);
+            uint64_t sum = 0;
+            uint32_t size = 0;
+            while (ReadFully(fds[1], &size, sizeof(size)) && size != kEndOfStream) {
+                std::vector<uint8_t> message(size);
+                ReadFully(fds[1], message.data(), size);
+                sum = Checksum(message.data(), message.size(), sum);
+            }
+            WriteFully(fds[1], &sum, sizeof(sum));
+            _exit(0);
+        }
+        
+        close(fds[1]);
+        auto start = Clock::now();
+        for (size_t sent = 0; sent < total; sent += chunk) {
+            const uint8_t* data = payload.data() + (sent % (payload.size() - chunk));
+            // Built with insert so the compiler can see the frame's size
+            const uint32_t size = static_cast<uint32_t>(chunk);
+            std::vector<uint8_t> message;
+            message.reserve(sizeof(size) + chunk);
+            message.insert(message.end(), reinterpret_cast<const uint8_t*>(&size),
+                           reinterpret_cast<const uint8_t*>(&size) + sizeof(size));
+            message.insert(message.end(), data, data + chunk);
+            WriteFully(fds[0], message.data(), message.size());
+        }
+        uint32_t end = kEndOfStream;
+        WriteFully(fds[0], &end, sizeof(end));
+        
+        ReadFully(fds[0], &result.checksum, sizeof(result.checksum));
+        result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        waitpid(child, nullptr, 0);
+        close(fds[0]);
+        return true;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    size_t totalMiB = argc > 1 ? static_cast<size_t>(atoi(argv[1])) : 512;
+    std::vector<size_t> chunks;
+    for (int i = 2; i < argc; ++i) {
+        int chunkKiB = atoi(argv[i]);
+        if (chunkKiB > 0 && chunkKiB <= 1024) {
+            chunks.push_back(static_cast<size_t>(chunkKiB) * 1024);
+        }
+    }
+    if (chunks.empty()) {
+        chunks = {1024, 4096, 16384, 65536};
+    }
+    
+    std::vector<uint8_t> payload(8 << 20);
+    for (size_t i = 0; i < payload.size(); ++i) {
+        payload[i] = static_cast<uint8_t>(i * 2654435761u >> 24);
+    }
+    
+    const size_t total = totalMiB << 20;
+    printf("%zu MiB per run\n", totalMiB);
+    printf("%-8s %14s %14s %10s\n", "chunk", "ring MiB/s", "socket MiB/s", "speedup");
+    for (size_t chunk : chunks) {
+        Result ring;
+        Result socket;
+        if (!RunRing(payload, total, chunk, ring) || !RunSocket(payload, total, chunk, socket)) {
+            return 1;
+        }
+        if (ring.checksum != socket.checksum) {
+            fprintf(stderr, "stream-benchmark: checksum mismatch at chunk %zu\n", chunk);
+            return 1;
+        }
+        
+        double ringRate = totalMiB / ring.seconds;
+        double socketRate = totalMiB / socket.seconds;
+        printf("%-8zu %14.1f %14.1f %9.2fx\n", chunk, ringRate, socketRate, ringRate / socketRate);
+    }
+    return 0;
+}
@@ -0,0 +1,103 @@
+// Heap allocations per MiB of raw terminal output, through the real
+// TerminalManager path: a child writes mixed ASCII and multi-byte UTF-8 to
+// its PTY, the reactor reads it, and a consumer acknowledges each message
+// like TerminalForwarder does. Every operator new in the process counts.
+//
+//   terminal-output-benchmark [MiB]
+//
+// Also reports messages that end inside a UTF-8 sequence, which should be
+// none. POSIX only.
+#include "../app/utils/spawn-helper.hpp"
+#include "../app/utils/terminal.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <string>
+
+namespace {
+    std::atomic<uint64_t> g_allocations(0);
+}
+
+void* operator new(size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+using Clock = std::chrono::steady_clock;
+using namespace MikoIDE::Utils;
+
+int main(int argc, char* argv[]) {
+    size_t mebibytes = argc > 1 ? static_cast<size_t>(atoi(argv[1])) : 64;
+    SpawnHelper::GetInstance().Start();
+    
+    TerminalManager& terminals = Terminal::GetInstance();
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool exited = false;
+    uint64_t bytes = 0;
+    uint64_t messages = 0;
+    uint64_t splits = 0;
+    uint64_t allocationsAtExit = 0;
+    
+    terminals.SetGlobalOutputCallback([&](const std::string& terminalId, const TerminalMessage& message) {
+        if (message.type == TerminalMessage::EXIT) {
+            std::lock_guard<std::mutex> lock(mutex);
+            allocationsAtExit = g_allocations.load();
+            exited = true;
+            cv.notify_all();
+            return;
+        }
+        if (message.type != TerminalMessage::OUTPUT) {
+            return;
+        }
+        bytes += message.GetSize();
+        ++messages;
+        if (Utf8CompleteLength(message.GetData(), message.GetSize()) != message.GetSize()) {
+            ++splits;
+        }
+        terminals.AcknowledgeOutput(terminalId, message.GetSize());
+    });
+    
+    // stty keeps the line discipline from doubling each newline's size
+    const std::string command = "stty raw -echo; yes 'build: compiled m\\303\\263dulo \\342\\234\\223 "
+                                "\\346\\274\\242\\345\\255\\227 \\360\\237\\232\\200 target' | head -c " +
+                                std::to_string(mebibytes << 20);
+    const uint64_t allocationsAtStart = g_allocations.load();
+    const Clock::time_point start = Clock::now();
+    std::string terminalId = terminals.CreateTerminal(command);
+    if (terminalId.empty()) {
+        return 1;
+    }
+    
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&]() { return exited; });
+    }
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    const double received = bytes / double(1 << 20);
+    const uint64_t allocations = allocationsAtExit - allocationsAtStart;
+    
+    printf("%.1f MiB in %llu messages, %.2f s (%.0f MiB/s)\n", received,
+           static_cast<unsigned long long>(messages), seconds, received / seconds);
+    printf("allocations: %llu total, %.1f per MiB\n", static_cast<unsigned long long>(allocations),
+           allocations / received);
+    printf("messages ending inside a UTF-8 sequence: %llu\n", static_cast<unsigned long long>(splits));
+    
+    terminals.CloseTerminal(terminalId);
+    return 0;
+}
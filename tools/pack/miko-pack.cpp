@@ -0,0 +1,175 @@
+// miko-pack: builds an app.pak from the renderer build output.
+//
+//   miko-pack <dist dir> <output.pak>
+//
+// Existing foo.js.gz / foo.js.br files next to foo.js are stored as
+// precompressed variants of foo.js; without foo.js they are packed as files
+// of their own. When built with zlib and/or brotli the
+// missing variants are generated for compressible types. A variant is only
+// kept if it saves at least 10% over the identity bytes.
+#include "../../app/resources/pack-writer.hpp"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#ifdef MIKO_PACK_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef MIKO_PACK_HAVE_BROTLI
+#include <brotli/encode.h>
+#endif
+
+namespace fs = std::filesystem;
+using MikoIDE::Resources::PackEncoding;
+using MikoIDE::Resources::PackWriter;
+
+namespace {
+    bool ReadFile(const fs::path& path, std::vector<uint8_t>& data) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in.is_open()) {
+            return false;
+        }
+        data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        return true;
+    }
+    
+    bool IsWorthStoring(const std::vector<uint8_t>& variant, size_t identitySize) {
+        return !variant.empty() && variant.size() * 10 < identitySize * 9;
+    }
+    
+#ifdef MIKO_PACK_HAVE_ZLIB
+    std::vector<uint8_t> Gzip(const std::vector<uint8_t>& input) {
+        z_stream stream = {};
+        // windowBits 15 + 16 selects the gzip wrapper
+        if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK) {
+            return {};
+        }
+        
+        std::vector<uint8_t> output(deflateBound(&stream, static_cast<uLong>(input.size())));
+        stream.next_in = const_cast<Bytef*>(input.data());
+        stream.avail_in = static_cast<uInt>(input.size());
+        stream.next_out = output.data();
+        stream.avail_out = static_cast<uInt>(output.size());
+        
+        int result = deflate(&stream, Z_FINISH);
+        output.resize(stream.total_out);
+        deflateEnd(&stream);
+        return result == Z_STREAM_END ? output : std::vector<uint8_t>();
+    }
+#endif
+    
+#ifdef MIKO_PACK_HAVE_BROTLI
+    std::vector<uint8_t> Brotli(const std::vector<uint8_t>& input) {
+        size_t size = BrotliEncoderMaxCompressedSize(input.size());
+        std::vector<uint8_t> output(size);
+        if (!BrotliEncoderCompress(BROTLI_MAX_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT,
+                                   input.size(), input.data(), &size, output.data())) {
+            return {};
+        }
+        output.resize(size);
+        return output;
+    }
+#endif
+    
+    // Generates the precompressed variants this build of the packer supports
+    std::vector<std::pair<PackEncoding, std::vector<uint8_t>>> Compress(const std::vector<uint8_t>& data,
+                                                                         const std::string& mimeType) {
+        std::vector<std::pair<PackEncoding, std::vector<uint8_t>>> variants;
+        if (!PackWriter::IsCompressible(mimeType)) {
+            return variants;
+        }
+        
+#ifdef MIKO_PACK_HAVE_ZLIB
+        std::vector<uint8_t> gzip = Gzip(data);
+        if (IsWorthStoring(gzip, data.size())) {
+            variants.emplace_back(MikoIDE::Resources::kPackEncodingGzip, std::move(gzip));
+        }
+#endif
+#ifdef MIKO_PACK_HAVE_BROTLI
+        std::vector<uint8_t> brotli = Brotli(data);
+        if (IsWorthStoring(brotli, data.size())) {
+            variants.emplace_back(MikoIDE::Resources::kPackEncodingBrotli, std::move(brotli));
+        }
+#endif
+        return variants;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        std::cerr << "usage: miko-pack <dist dir> <output.pak>" << std::endl;
+        return 2;
+    }
+    
+    const fs::path root = argv[1];
+    std::error_code ec;
+    if (!fs::is_directory(root, ec)) {
+        std::cerr << "miko-pack: not a directory: " << root.string() << std::endl;
+        return 1;
+    }
+    
+    // Identity files first so precompressed siblings can attach to them. A
+    // .gz or .br without its uncompressed file is an asset in its own right.
+    std::vector<fs::path> files;
+    std::vector<std::pair<fs::path, PackEncoding>> siblings;
+    for (const auto& item : fs::recursive_directory_iterator(root)) {
+        if (!item.is_regular_file()) {
+            continue;
+        }
+        
+        const fs::path& path = item.path();
+        const bool hasBase = fs::is_regular_file(fs::path(path).replace_extension(), ec);
+        if (hasBase && path.extension() == ".gz") {
+            siblings.emplace_back(path, MikoIDE::Resources::kPackEncodingGzip);
+        } else if (hasBase && path.extension() == ".br") {
+            siblings.emplace_back(path, MikoIDE::Resources::kPackEncodingBrotli);
+        } else {
+            files.push_back(path);
+        }
+    }
+    
+    PackWriter writer;
+    size_t identityBytes = 0;
+    for (const fs::path& path : files) {
+        std::vector<uint8_t> data;
+        if (!ReadFile(path, data)) {
+            std::cerr << "miko-pack: cannot read " << path.string() << std::endl;
+            return 1;
+        }
+        identityBytes += data.size();
+        
+        std::string name = fs::relative(path, root).generic_string();
+        auto variants = Compress(data, PackWriter::GetMimeType(name));
+        writer.AddFile(name, std::move(data));
+        for (auto& variant : variants) {
+            writer.AddVariant(name, variant.first, std::move(variant.second));
+        }
+    }
+    
+    // Prebuilt siblings win over generated variants
+    for (const auto& sibling : siblings) {
+        std::string name = fs::relative(sibling.first, root).replace_extension().generic_string();
+        std::vector<uint8_t> data;
+        if (!writer.HasFile(name) || !ReadFile(sibling.first, data)) {
+            std::cerr << "miko-pack: skipping orphan " << sibling.first.string() << std::endl;
+            continue;
+        }
+        writer.AddVariant(name, sibling.second, std::move(data));
+    }
+    
+    fs::path output = argv[2];
+    if (output.has_parent_path()) {
+        fs::create_directories(output.parent_path(), ec);
+    }
+    
+    std::string error;
+    if (!writer.Write(output.string(), error)) {
+        std::cerr << "miko-pack: " << error << std::endl;
+        return 1;
+    }
+    
+    std::cout << "miko-pack: " << writer.GetFileCount() << " files, " << identityBytes
+              << " bytes -> " << output.string() << " (" << fs::file_size(output, ec) << " bytes)" << std::endl;
+    return 0;
+}
@@ -0,0 +1,112 @@
+// miko-sessiond: keeps terminal sessions alive across IDE restarts.
+//
+//   miko-sessiond [--socket=<path>] [--snapshot-lines=<n>]
+//                 [--scrollback-memory=<MB>] [--idle-timeout=<seconds>]
+//                 [--foreground]
+//
+// The IDE starts it with --terminal-sessions and talks to it over the Unix
+// socket (see SessionProtocol). Unless --foreground is given it detaches
+// into its own session, and the starting process returns once the socket
+// accepts connections, or at once when a daemon is already serving it.
+// The working directory is kept, so the daemon logs beside the IDE.
+#include "../../app/utils/scrollback.hpp"
+#include "../../app/utils/session-daemon.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <string>
+#include <unistd.h>
+
+using MikoIDE::Utils::ScrollbackBudget;
+using MikoIDE::Utils::SessionDaemon;
+
+namespace {
+    bool ReadSwitchValue(const std::string& token, const std::string& name, std::string& value) {
+        if (token.compare(0, name.size(), name) != 0 || token.size() <= name.size() ||
+            token[name.size()] != '=') {
+            return false;
+        }
+        value = token.substr(name.size() + 1);
+        return true;
+    }
+    
+    void RedirectStdio() {
+        int null = open("/dev/null", O_RDWR);
+        if (null == -1) {
+            return;
+        }
+        dup2(null, STDIN_FILENO);
+        dup2(null, STDOUT_FILENO);
+        dup2(null, STDERR_FILENO);
+        if (null > STDERR_FILENO) {
+            close(null);
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    SessionDaemon::Options options;
+    size_t scrollbackMemoryMB = 64;
+    bool foreground = false;
+    
+    for (int i = 1; i < argc; ++i) {
+        const std::string token = argv[i];
+        std::string value;
+        if (token == "--foreground") {
+            foreground = true;
+        } else if (ReadSwitchValue(token, "--socket", value)) {
+            options.socket_path = value;
+        } else if (ReadSwitchValue(token, "--snapshot-lines", value)) {
+            options.snapshot_lines = static_cast<size_t>(std::max(std::atoi(value.c_str()), 0));
+        } else if (ReadSwitchValue(token, "--scrollback-memory", value)) {
+            scrollbackMemoryMB = static_cast<size_t>(std::max(std::atoi(value.c_str()), 1));
+        } else if (ReadSwitchValue(token, "--idle-timeout", value)) {
+            options.idle_timeout_seconds = std::max(std::atoi(value.c_str()), 0);
+        } else {
+            fprintf(stderr, "miko-sessiond: unknown argument %s\n", token.c_str());
+            return 2;
+        }
+    }
+    
+    // Snapshots only need the newest lines, so nothing spills to disk
+    ScrollbackBudget::GetInstance().SetLimits(scrollbackMemoryMB * 1024 * 1024, 0);
+    
+    // The parent waits on |ready| for the child's verdict: 1 serving, 0 failed
+    int ready[2] = {-1, -1};
+    if (!foreground) {
+        if (pipe(ready) != 0) {
+            perror("miko-sessiond: pipe");
+            return 1;
+        }
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("miko-sessiond: fork");
+            return 1;
+        }
+        if (pid > 0) {
+            close(ready[1]);
+            char verdict = 0;
+            const bool serving = read(ready[0], &verdict, 1) == 1 && verdict == 1;
+            return serving ? 0 : 1;
+        }
+        close(ready[0]);
+        setsid();
+        RedirectStdio();
+    }
+    
+    SessionDaemon daemon(options);
+    bool alreadyRunning = false;
+    const bool listening = daemon.Listen(alreadyRunning);
+    if (ready[1] != -1) {
+        const char verdict = (listening || alreadyRunning) ? 1 : 0;
+        (void)!write(ready[1], &verdict, 1);
+        close(ready[1]);
+    }
+    if (!listening) {
+        return alreadyRunning ? 0 : 1;
+    }
+    
+    daemon.Run();
+    return 0;
+}